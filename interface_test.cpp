@@ -57,6 +57,237 @@ void int_set_interface_test()
                     mm.size() == 5);
     }
 
+    {
+        std_int_vector vec;
+        int_vector_append_sequential(vec, def_insert_count);
+
+        _int_set aa(xxfl::sorted_unique, vec.begin(), vec.end());
+        _int_set bb(vec.begin(), vec.end());
+
+        success &= (aa.size() == def_insert_count && aa == bb);
+
+        aa.bulk_load(vec.begin(), vec.end(), 0.5f);
+        success &= (aa.size() == def_insert_count && aa == bb);
+
+        aa.erase(aa.find(100), aa.find(9000));
+        aa.insert(vec.begin(), vec.end());
+        success &= (aa.size() == def_insert_count && aa == bb);
+
+        aa.bulk_load(vec.begin(), vec.begin() + 5);
+        success &= (aa.size() == 5 && *aa.rbegin() == 4);
+
+        aa.bulk_load(vec.begin(), vec.begin());
+        success &= aa.empty();
+
+        // a tree emptied by erase keeps its root leaf, which bulk_load must not leak
+        aa.insert(1);
+        aa.erase(1);
+        aa.bulk_load(vec.begin(), vec.begin() + 5);
+        success &= (aa.size() == 5 && *aa.begin() == 0);
+    }
+
+    {
+        std_int_vector vec;
+        int_vector_append_sequential(vec, def_insert_count);
+        std::reverse(vec.begin(), vec.end());
+        vec.insert(vec.end(), vec.begin(), vec.begin() + 1000);
+
+        _int_set aa, bb(vec.begin(), vec.end());
+
+        aa.insert_batch(vec.begin() + 5000, vec.end());
+        aa.insert_batch(vec.begin(), vec.begin() + 5000);
+        success &= (aa.size() == def_insert_count && aa == bb);
+
+        aa.erase(aa.find(100), aa.find(9000));
+        aa.insert_batch(vec.begin(), vec.end());
+        aa.insert_batch(vec.begin(), vec.begin());
+        success &= (aa.size() == def_insert_count && aa == bb);
+
+        _int_set cc = { 1 };
+        cc.erase(1);
+        cc.insert_batch(vec.begin(), vec.end());
+        success &= (cc == bb);
+    }
+
+    {
+        _int_set aa;
+        std::vector<uint32_t> keys = { 5, 3, 100, 20000, 0, 7 };
+        std::vector<typename _int_set::const_iterator> its(keys.size());
+        std::vector<bool> found(keys.size());
+
+        aa.find_batch(keys.begin(), keys.end(), its.begin());
+        success &= (its[0] == aa.end() && its[5] == aa.end());
+
+        container_insert_sequential(aa, def_insert_count);
+        keys.resize(100, 1);
+
+        its.resize(keys.size());
+        found.resize(keys.size());
+
+        aa.find_batch(keys.begin(), keys.end(), its.begin());
+        aa.contains_batch(keys.begin(), keys.end(), found.begin());
+
+        for (size_t i = 0; i < keys.size(); ++i)
+        {
+            success &= (its[i] == aa.find(keys[i]) && found[i] == (aa.count(keys[i]) == 1));
+        }
+    }
+
+    {
+        _int_set aa, bb;
+        container_insert_sequential(aa, def_insert_count);
+
+        for (uint32_t i = 0; i < def_insert_count * 2; i += 3)
+        {
+            bb.insert(i);
+        }
+
+        _int_set cc = set_union(aa, bb);
+        _int_set dd = set_intersection(aa, bb);
+        _int_set ee = set_difference(aa, bb);
+
+        success &= (cc.size() == def_insert_count + (def_insert_count * 2 / 3 + 1) - (def_insert_count / 3 + 1) &&
+                    dd.size() == def_insert_count / 3 + 1 &&
+                    ee.size() == def_insert_count - dd.size() &&
+                    *cc.rbegin() == def_insert_count * 2 - 2 &&
+                    *dd.rbegin() == def_insert_count - 1 &&
+                    ee.count(3) == 0 && ee.count(4) == 1);
+
+        bb = set_intersection(bb, _int_set({ 0, 6, 7, 9999, 100000 }));
+        success &= (bb == _int_set({ 0, 6, 9999 }));
+
+        success &= (set_union(aa, _int_set()) == aa &&
+                    set_intersection(_int_set(), aa).empty() &&
+                    set_difference(aa, aa).empty());
+    }
+
+    {
+        _int_set aa(yy), bb;
+        _int_set cc = aa.split(5000);
+
+        success &= (aa.size() == 5000 && cc.size() == def_insert_count - 5000 &&
+                    *aa.rbegin() == 4999 && *cc.begin() == 5000);
+
+        bb = cc.split(def_insert_count);
+        success &= (bb.empty() && cc.size() == def_insert_count - 5000);
+
+        bb = aa.split(0);
+        success &= (aa.empty() && bb.size() == 5000);
+
+        bb.join(cc);
+        aa.join(bb);
+        success &= (aa == yy && bb.empty() && cc.empty());
+
+        cc = { 20000, 20001 };
+        aa.join(cc);
+        success &= (aa.size() == def_insert_count + 2 && *aa.rbegin() == 20001);
+
+        cc = { 0 };
+        bb = aa.split(1);
+        cc.join(bb);
+        success &= (cc.size() == def_insert_count + 2 && cc.count(1) == 1 && *cc.rbegin() == 20001);
+    }
+
+    {
+        // the cut and grafted edges are balanced, repeated splits and joins don't make the tree any higher
+        xxfl_small_node_int_set aa;
+
+        for (uint32_t i = 0; i < 2000; ++i)
+        {
+            aa.insert(i);
+        }
+
+        for (uint32_t i = 0; i < 300; ++i)
+        {
+            xxfl_small_node_int_set bb = aa.split(i * 7919 % 2000);
+            aa.join(bb);
+        }
+
+        test_int expected = 2000;
+        for (auto it = aa.rbegin(); it != aa.rend(); ++it)
+        {
+            success &= (*it == --expected);
+        }
+
+        success &= (aa.size() == 2000 && expected == 0);
+    }
+
+    {
+        // runs of nearby keys with jumps between them, with finger search most descents start from the last leaf
+        _int_set aa;
+
+        for (uint32_t run = 0; run < 100; ++run)
+        {
+            uint32_t base = run * 7919 % 100 * 1000;
+
+            for (uint32_t i = 0; i < 100; ++i)
+            {
+                aa.insert(base + i * 3);
+            }
+
+            for (uint32_t i = 0; i < 100; i += 2)
+            {
+                aa.erase(base + i * 3);
+            }
+
+            for (uint32_t i = 0; i < 100; ++i)
+            {
+                success &= (aa.count(base + i * 3) == i % 2 && *aa.lower_bound(base + i * 3) == base + (i | 1) * 3);
+            }
+        }
+
+        success &= (aa.size() == 5000 && *aa.begin() == 3 && *aa.rbegin() == 99000 + 99 * 3);
+    }
+
+    {
+        _int_set aa(yy);
+        aa.erase(aa.find(100), aa.find(200));
+
+        success &= (aa.rank(0) == 0 && aa.rank(150) == 100 && aa.rank(200) == 100 &&
+                    aa.rank(def_insert_count) == def_insert_count - 100 &&
+                    aa.count_range(50, 250) == 100 && aa.count_range(250, 50) == 0);
+
+        success &= (*aa.select(0) == 0 && *aa.select(100) == 200 && aa.select(def_insert_count - 100) == aa.end() &&
+                    aa.index_of(aa.find(300)) == 200 && aa.index_of(aa.end()) == aa.size());
+
+        _const_iterator it = ((const _int_set&)aa).select(aa.index_of(aa.begin()) + 5000);
+        success &= (*it == 5100);
+    }
+
+    {
+        _int_set aa(yy), bb, cc;
+
+        typename _int_set::node_type nh = aa.extract(100);
+        success &= (nh && nh.value() == 100 && aa.size() == def_insert_count - 1 && aa.count(100) == 0);
+        success &= aa.extract(100).empty();
+
+        nh.value() = 20000;
+        typename _int_set::insert_return_type ret = aa.insert(std::move(nh));
+        success &= (ret.inserted && *ret.position == 20000 && nh.empty() && ret.node.empty());
+
+        nh = aa.extract(aa.begin());
+        bb.insert(0);
+        ret = bb.insert(std::move(nh));
+        success &= (!ret.inserted && *ret.position == 0 && ret.node.value() == 0);
+        success &= (*aa.insert(aa.end(), std::move(ret.node)) == 0 && aa.size() == def_insert_count);
+
+        bb = { 30000, 30001 };
+        aa.merge(bb);
+        cc = { 0, 1 };
+        cc.merge(aa);
+        success &= (bb.empty() && cc.size() == def_insert_count + 2 && aa == _int_set({ 0, 1 }));
+
+        for (uint32_t i = 0; i < def_insert_count * 2; i += 3)
+        {
+            bb.insert(i);
+        }
+
+        aa = yy;
+        aa.merge(bb);
+        success &= (aa.size() == def_insert_count + (def_insert_count * 2 / 3 + 1) - (def_insert_count / 3 + 1) &&
+                    bb.size() == def_insert_count / 3 + 1 && *bb.rbegin() == def_insert_count - 1);
+    }
+
     {
         _int_set aa, bb, cc;
         aa = xx;
@@ -569,6 +800,115 @@ void int_map_interface_test()
                     mm.size() == 5);
     }
 
+    {
+        std_int_pair_vector vec;
+        int_pair_vector_append_sequential(vec, def_insert_count);
+
+        _int_map aa(xxfl::sorted_unique, vec.begin(), vec.end());
+        _int_map bb(vec.begin(), vec.end());
+
+        success &= (aa.size() == def_insert_count && aa == bb);
+
+        aa.bulk_load(vec.begin(), vec.end(), 0.5f);
+        success &= (aa.size() == def_insert_count && aa == bb);
+
+        aa.erase(aa.find(100), aa.find(9000));
+        aa.insert(vec.begin(), vec.end());
+        success &= (aa.size() == def_insert_count && aa == bb);
+
+        aa.bulk_load(vec.begin(), vec.begin() + 5);
+        success &= (aa.size() == 5 && aa.rbegin()->first == 4);
+
+        aa.bulk_load(vec.begin(), vec.begin());
+        success &= aa.empty();
+
+        aa[1] = 1;
+        aa.erase(1);
+        aa.bulk_load(vec.begin(), vec.begin() + 5);
+        success &= (aa.size() == 5 && aa.begin()->first == 0);
+    }
+
+    {
+        std_int_pair_vector seq;
+        int_pair_vector_append_sequential(seq, def_insert_count);
+
+        std_int_pair_vector vec(seq.rbegin(), seq.rend());
+        vec.push_back(int_pair(0, 1));
+
+        _int_map aa, bb(vec.begin(), vec.end());
+
+        aa.insert_batch(vec.begin() + 5000, vec.end());
+        aa.insert_batch(vec.begin(), vec.begin() + 5000);
+        success &= (aa.size() == def_insert_count && aa == bb && aa[0] == 0);
+
+        aa.erase(aa.find(100), aa.find(9000));
+        aa.insert_batch(vec.begin(), vec.end());
+        success &= (aa.size() == def_insert_count && aa == bb);
+    }
+
+    {
+        _int_map aa, bb;
+        container_insert_sequential(aa, def_insert_count);
+
+        success &= (!aa.try_emplace(5, 9).second && aa[5] == 5);
+        success &= (aa.try_emplace(20000, 9).second && aa[20000] == 9);
+        success &= (!aa.insert_or_assign(5, 9).second && aa[5] == 9);
+        success &= (aa.insert_or_assign(aa.end(), 20001, 7)->second == 7);
+
+        typename _int_map::node_type nh = aa.extract(aa.find(20000));
+        nh.key() = 30000;
+        nh.mapped() = 1;
+        success &= (aa.insert(std::move(nh)).inserted && aa[30000] == 1 && aa.count(20000) == 0);
+
+        bb.insert(int_pair(5, 0));
+        bb.insert(int_pair(40000, 0));
+        aa.merge(bb);
+        success &= (bb.size() == 1 && bb[5] == 0 && aa[40000] == 0 && aa.size() == def_insert_count + 3);
+    }
+
+    {
+        _int_map aa;
+        container_insert_sequential(aa, def_insert_count);
+
+        _int_map bb = aa.split(3000);
+        success &= (aa.size() == 3000 && bb.size() == def_insert_count - 3000 &&
+                    bb.begin()->first == 3000 && aa.rbegin()->first == 2999);
+
+        aa.join(bb);
+        success &= (aa.size() == def_insert_count && bb.empty() && aa[3000] == 3000);
+    }
+
+    {
+        _int_map aa;
+        container_insert_sequential(aa, def_insert_count);
+
+        success &= (aa.rank(3000) == 3000 && aa.count_range(10, 20) == 10 &&
+                    aa.select(3000)->first == 3000 && aa.index_of(aa.find(4000)) == 4000);
+    }
+
+    {
+        _int_map aa;
+        container_insert_sequential(aa, def_insert_count);
+
+        std::vector<uint32_t> keys = { 5, 3, 100, 20000, 0, 7 };
+        std::vector<typename _int_map::iterator> its(keys.size());
+        std::vector<typename _int_map::const_iterator> const_its(keys.size());
+        std::vector<bool> found(keys.size());
+
+        aa.find_batch(keys.begin(), keys.end(), its.begin());
+        ((const _int_map&)aa).find_batch(keys.begin(), keys.end(), const_its.begin());
+        aa.contains_batch(keys.begin(), keys.end(), found.begin());
+
+        for (size_t i = 0; i < keys.size(); ++i)
+        {
+            success &= (its[i] == aa.find(keys[i]) && const_its[i] == aa.find(keys[i]) &&
+                        found[i] == (aa.count(keys[i]) == 1));
+        }
+
+        aa.at(its[0]->first) = 9;
+        success &= (aa[5] == 9);
+    }
+
     {
         _int_map aa, bb, cc;
         aa = xx;
@@ -1104,17 +1444,817 @@ void string_map_interface_test()
     std::printf("%s\n", success? "passed" : "error");
 }
 
+void transparent_lookup_interface_test()
+{
+    bool success = true;
+
+    xxfl_transparent_string_map aa({ { "apple", "1" }, { "banana", "2" }, { "cherry", "3" }, { "date", "4" } });
+    const xxfl_transparent_string_map& bb = aa;
+
+    success &= (aa.find("banana")->second == "2" && bb.find("banana") == aa.find(std::string("banana")) &&
+                aa.find("berry") == aa.end() && aa.count("cherry") == 1 && aa.count("") == 0);
+
+    success &= (aa.lower_bound("banana")->first == "banana" && aa.upper_bound("banana")->first == "cherry" &&
+                bb.lower_bound("berry")->first == "cherry" && bb.upper_bound("date") == bb.end());
+
+    std::pair<xxfl_transparent_string_map::iterator, xxfl_transparent_string_map::iterator> range = aa.equal_range("apple");
+    success &= (range.first == aa.begin() && range.second->first == "banana");
+
+    success &= (aa.erase("banana") == 1 && aa.erase("banana") == 0 && aa.size() == 3);
+    success &= (aa.erase(aa.find("cherry"))->first == "date" && aa.count(std::string("cherry")) == 0);
+
+    std::printf("%s\n", success? "passed" : "error");
+}
+
+void aggregate_interface_test()
+{
+    bool success = true;
+
+    xxfl_sum_int_map aa;
+    container_insert_sequential(aa, def_insert_count);
+
+    uint64_t sum = (uint64_t)def_insert_count * (def_insert_count - 1) / 2;
+    success &= (aa.reduce(0, def_insert_count) == sum && aa.reduce(100, 200) == 14950 &&
+                aa.reduce(5, 6) == 5 && aa.reduce(200, 100) == 0);
+
+    aa.erase(aa.find(100), aa.find(150));
+    aa.erase(199);
+    success &= (aa.reduce(100, 200) == 14950 - 6225 - 199);
+
+    aa.insert_or_assign(120, 1000);
+    aa[160] = 0;
+    aa.at(170) = 70;
+    aa[170] = aa[170];
+    success &= (aa.reduce(100, 200) == 14950 - 6225 - 199 + 1000 - 160 - 100 && aa.at(170) == 70);
+
+    sum += 1000 - 6225 - 199 - 160 - 100;
+    xxfl_sum_int_map bb = aa.split(5000);
+    success &= (aa.reduce(0, 5000) + bb.reduce(5000, def_insert_count) == sum && aa.reduce(0, def_insert_count) < sum);
+
+    aa.join(bb);
+    success &= (aa.reduce(0, def_insert_count) == sum);
+
+    xxfl::aggregate_map<test_int, test_int, xxfl::max_of_mapped<test_int> > cc({ int_pair(1, 5), int_pair(2, 9), int_pair(3, 4) });
+    success &= (cc.reduce(1, 4) == 9 && cc.reduce(3, 4) == 4 && cc.reduce(4, 5) == 0);
+
+    std::printf("%s\n", success? "passed" : "error");
+}
+
+// runs of equal keys longer than a leaf, checked against std::multiset and std::multimap
+void multi_interface_test()
+{
+    bool success = true;
+
+    const test_int key_count = 50;
+
+    xxfl_int_multiset aa;
+    std_int_multiset std_aa;
+    xxfl_int_multimap bb;
+    std_int_multimap std_bb;
+
+    for (uint32_t i = 0; i < def_insert_count; ++i)
+    {
+        test_int key = (test_int)(rand_gen() % key_count);
+
+        aa.insert(key);
+        std_aa.insert(key);
+        bb.insert(int_pair(key, i));
+        std_bb.insert(int_pair(key, i));
+    }
+
+    success &= (aa.size() == def_insert_count && std::equal(aa.begin(), aa.end(), std_aa.begin()) &&
+                bb.size() == def_insert_count && std::equal(bb.begin(), bb.end(), std_bb.begin()));
+
+    for (test_int key = 0; key <= key_count; ++key)
+    {
+        std::pair<xxfl_int_multimap::iterator, xxfl_int_multimap::iterator> range = bb.equal_range(key);
+
+        success &= (aa.count(key) == std_aa.count(key) && bb.count(key) == std_bb.count(key) &&
+                    aa.index_of(aa.lower_bound(key)) == aa.rank(key) &&
+                    aa.index_of(aa.upper_bound(key)) == aa.rank(key) + aa.count(key) &&
+                    (size_t)std::distance(range.first, range.second) == std_bb.count(key) &&
+                    std::equal(range.first, range.second, std_bb.equal_range(key).first) &&
+                    aa.find(key) == aa.lower_bound(key) && (bb.find(key) == bb.end()) == (key == key_count));
+    }
+
+    aa.insert(aa.find(7), 7);
+    aa.insert(aa.end(), key_count);
+    aa.insert(aa.begin(), key_count);
+    bb.insert(bb.find(7), int_pair(7, def_insert_count));
+    std_aa.insert(std_aa.find(7), 7);
+    std_aa.insert(std_aa.end(), key_count);
+    std_aa.insert(std_aa.begin(), key_count);
+    std_bb.insert(std_bb.find(7), int_pair(7, def_insert_count));
+
+    success &= (aa.erase(3) == std_aa.erase(3) && bb.erase(3) == std_bb.erase(3) && aa.erase(key_count + 1) == 0 &&
+                aa.count(3) == 0 && bb.find(3) == bb.end() && std::equal(bb.begin(), bb.end(), std_bb.begin()));
+
+    aa.erase(aa.upper_bound(10), aa.lower_bound(20));
+    std_aa.erase(std_aa.upper_bound(10), std_aa.lower_bound(20));
+    bb.erase(bb.find(40));
+    std_bb.erase(std_bb.find(40));
+
+    success &= (aa.size() == std_aa.size() && std::equal(aa.begin(), aa.end(), std_aa.begin()) &&
+                bb.size() == std_bb.size() && std::equal(bb.begin(), bb.end(), std_bb.begin()) &&
+                aa.count(15) == 0 && aa.count(10) == std_aa.count(10) && aa.count(key_count) == 2);
+
+    xxfl_int_multiset cc({ 3, 1, 3, 2, 3 });
+    xxfl_int_multiset::node_type nh = cc.extract(3);
+    success &= (cc.size() == 4 && nh.value() == 3 && *cc.insert(std::move(nh)) == 3 && cc.count(3) == 3);
+
+    std::printf("%s\n", success? "passed" : "error");
+}
+
+// the internal iteration against the iterators, and the comparisons running on leaf spans
+void for_each_interface_test()
+{
+    bool success = true;
+
+    xxfl_int_set aa;
+    container_insert_random_1(aa, def_insert_count);
+
+    uint64_t sum = 0, span_sum = 0, range_sum = 0, iterator_sum = 0, iterator_range_sum = 0;
+    size_t spans_count = 0;
+
+    aa.for_each([&sum](test_int value) { sum += value; });
+    aa.for_each_span([&span_sum, &spans_count](const test_int* first, const test_int* last)
+    {
+        for (; first != last; ++first)
+        {
+            span_sum += *first;
+        }
+
+        ++spans_count;
+    });
+    test_int lower_key = *aa.select(100);
+    test_int upper_key = *aa.select(aa.size() - 100);
+    aa.for_each_range(lower_key, upper_key, [&range_sum](test_int value) { range_sum += value; });
+
+    for (xxfl_int_set::iterator it = aa.begin(); it != aa.end(); ++it)
+    {
+        iterator_sum += *it;
+        iterator_range_sum += (*it >= lower_key && *it < upper_key)? *it : 0;
+    }
+
+    success &= (sum == iterator_sum && span_sum == iterator_sum && spans_count > 1 && spans_count < aa.size() &&
+                range_sum == iterator_range_sum);
+
+    xxfl_int_map bb;
+    container_insert_sequential(bb, def_insert_count);
+
+    size_t range_count = 0;
+    bb.for_each_span_range(200, 100, [&range_count](const int_pair*, const int_pair*) { ++range_count; });
+    bb.for_each_span_range(def_insert_count * 2, def_insert_count * 3,
+                           [&range_count](const int_pair*, const int_pair*) { ++range_count; });
+    success &= (range_count == 0);
+
+    uint64_t mapped_sum = 0;
+    bb.for_each_range(10, 20, [&mapped_sum](const int_pair& x) { mapped_sum += x.second; });
+    success &= (mapped_sum == 145);
+
+    xxfl_soa_int_map cc;
+    container_insert_sequential(cc, def_insert_count);
+
+    uint64_t key_sum = 0;
+    mapped_sum = 0;
+    cc.for_each([&key_sum](test_int key, test_int) { key_sum += key; });
+    cc.for_each_span_range(10, 20, [&mapped_sum](const test_int* first, const test_int* last, const test_int* mapped)
+    {
+        for (; first != last; ++first, ++mapped)
+        {
+            mapped_sum += *mapped;
+        }
+    });
+    success &= (key_sum == (uint64_t)def_insert_count * (def_insert_count - 1) / 2 && mapped_sum == 145);
+
+    xxfl_int_set dd(aa), ee;
+    xxfl_soa_int_map ff(cc);
+    container_insert_random_2(ee, def_insert_count);
+
+    success &= (aa == dd && !(aa < dd) && (aa < ee) == std::lexicographical_compare(aa.begin(), aa.end(), ee.begin(), ee.end()));
+
+    dd.erase(--dd.end());
+    success &= (aa != dd && dd < aa && !(aa < dd));
+
+    ff[def_insert_count / 2] = 0;
+    success &= (cc == cc && cc != ff && ff < cc && !(cc < ff));
+
+    std::printf("%s\n", success? "passed" : "error");
+}
+
+// checks the values for_each_range() visits: from key on, in key order, each mapped to twice its key. the concurrent
+// map hands out the key and the mapped value, the sharded map the pair.
+struct concurrent_range_checker
+{
+    test_int _key;
+    test_int _last;
+    uint64_t _count;
+    uint32_t _errors;
+
+    concurrent_range_checker(test_int key) : _key(key), _last(0), _count(0), _errors(0) {}
+
+    void operator () (const test_int& key, const test_int& mapped)
+    {
+        if (mapped != key * 2 || (_count > 0 && !(_last < key)) || key < _key)
+        {
+            ++_errors;
+        }
+        _last = key;
+        ++_count;
+    }
+
+    void operator () (const int_pair& x)
+    { (*this)(x.first, x.second); }
+};
+
+// writers on interleaved keys beside readers checking every value they see, the writers leave every other run of
+// thread_count keys
+template<typename _int_map>
+bool concurrent_writers_readers_test(_int_map& aa, uint32_t thread_count, uint32_t key_count)
+{
+    std::atomic<bool> writing(true);
+    std::atomic<uint32_t> errors(0);
+    std::vector<std::thread> writers, readers;
+
+    for (uint32_t t = 0; t < thread_count; ++t)
+    {
+        writers.push_back(std::thread([&aa, t, thread_count, key_count]()
+        {
+            for (uint32_t i = t; i < key_count; i += thread_count)
+            {
+                aa.insert((test_int)i, (test_int)(i * 2));
+            }
+            for (uint32_t i = t; i < key_count; i += thread_count * 2)
+            {
+                aa.erase((test_int)i);
+            }
+        }));
+
+        uint32_t seed = rand_gen();
+        readers.push_back(std::thread([&aa, &writing, &errors, key_count, seed]()
+        {
+            std::mt19937 gen(seed);
+            while (writing.load())
+            {
+                test_int key = (test_int)(gen() % key_count), mapped = 0;
+                if (aa.find(key, mapped) && mapped != key * 2)
+                {
+                    ++errors;
+                }
+
+                errors += aa.for_each_range(key, key + 1000, concurrent_range_checker(key))._errors;
+            }
+        }));
+    }
+
+    for (size_t i = 0; i < writers.size(); ++i)
+    {
+        writers[i].join();
+    }
+    writing.store(false);
+    for (size_t i = 0; i < readers.size(); ++i)
+    {
+        readers[i].join();
+    }
+
+    return (errors.load() == 0 && aa.size() == key_count / 2);
+}
+
+// the writes on single keys after concurrent_writers_readers_test(), key 5 is left mapped to 1
+template<typename _int_map>
+bool concurrent_single_writes_test(_int_map& aa, uint32_t key_count)
+{
+    concurrent_range_checker checker = aa.for_each_range(0, (test_int)key_count, concurrent_range_checker(0));
+
+    bool success = (checker._errors == 0 && checker._count == key_count / 2 && !aa.insert(5, 0) &&
+                    !aa.insert_or_assign(5, 1) && aa.insert(0, 0) && aa.contains(0) && aa.erase(0) && !aa.erase(0) &&
+                    aa.size() == key_count / 2);
+
+    test_int mapped = 0;
+    success &= (aa.find(5, mapped) && mapped == 1);
+
+    return success;
+}
+
+// the shared writers and readers, then the result against the keys
+void concurrent_interface_test()
+{
+    const uint32_t thread_count = 4;
+    const uint32_t key_count = def_insert_count * 10;
+
+    xxfl_concurrent_int_map aa;
+    bool success = concurrent_writers_readers_test(aa, thread_count, key_count);
+
+    for (uint32_t i = 0; i < key_count; ++i)
+    {
+        test_int mapped = 0;
+        bool erased = (i % (thread_count * 2)) < thread_count;
+        success &= (aa.find((test_int)i, mapped) == !erased && (erased || mapped == i * 2));
+    }
+
+    success &= concurrent_single_writes_test(aa, key_count);
+
+    aa.clear();
+    success &= (aa.empty() && !aa.contains(5));
+
+    std::printf("%s\n", success? "passed" : "error");
+}
+
+// the shared writers and readers, then the order across the shards and their balance
+void sharded_interface_test()
+{
+    const uint32_t thread_count = 4;
+    const uint32_t key_count = def_insert_count * 10;
+
+    xxfl_sharded_int_map aa;
+    bool success = concurrent_writers_readers_test(aa, thread_count, key_count);
+
+    test_int next_key = 0;
+    aa.for_each([&](const int_pair& x)
+    {
+        while ((next_key % (thread_count * 2)) < thread_count)
+        {
+            ++next_key;
+        }
+        success &= (x.first == next_key && x.second == next_key * 2);
+        ++next_key;
+    });
+    success &= (next_key == key_count);
+
+    size_t shards_in_use = 0, shard_sizes = 0;
+    for (uint32_t i = 0; i < 8; ++i)
+    {
+        shards_in_use += (aa.shard_size(i) > 0);
+        shard_sizes += aa.shard_size(i);
+    }
+    success &= (shards_in_use > 1 && shard_sizes == aa.size());
+
+    std::pair<test_int, test_int> x;
+    success &= (aa.lower_bound(0, x) && x.first == thread_count && aa.lower_bound(key_count / 2, x) &&
+                x.first == key_count / 2 + thread_count && x.second == x.first * 2 && !aa.lower_bound(key_count, x));
+
+    success &= concurrent_single_writes_test(aa, key_count);
+
+    aa.clear();
+    success &= (aa.empty() && !aa.contains(5) && aa.shard_size(1) == 0);
+
+    // a window of keys sliding upwards, the erases at its lower end keep the shards balanced
+    const uint32_t window_count = key_count / 2;
+    for (uint32_t i = 0; i < key_count * 2; ++i)
+    {
+        aa.insert(i, i);
+        if (i >= window_count)
+        {
+            aa.erase(i - window_count);
+        }
+    }
+
+    size_t shard_size_max = 0;
+    for (uint32_t i = 0; i < 8; ++i)
+    {
+        shard_size_max = std::max(shard_size_max, aa.shard_size(i));
+    }
+    success &= (aa.size() == window_count && shard_size_max < window_count / 2);
+
+    std::printf("%s\n", success? "passed" : "error");
+}
+
+// the parallel scans against the sequential ones, the values of the runs gathered in order
+void parallel_interface_test()
+{
+    bool success = true;
+
+    xxfl::thread_executor thread_executor;
+    auto inline_executor = [](std::function<void()> task) { task(); };
+
+    xxfl_int_set aa;
+    container_insert_random_1(aa, def_insert_count * 10);
+
+    std::atomic<uint64_t> sum(0);
+    uint64_t iterator_sum = 0, range_sum = 0;
+    aa.parallel_for_each(thread_executor, [&sum](test_int value) { sum += value; });
+    aa.for_each([&iterator_sum](test_int value) { iterator_sum += value; });
+    success &= (sum.load() == iterator_sum);
+
+    test_int lower_key = *aa.select(100);
+    test_int upper_key = *aa.select(aa.size() - 100);
+    sum = 0;
+    aa.parallel_for_each_range(inline_executor, lower_key, upper_key, [&sum](test_int value) { sum += value; });
+    aa.for_each_range(lower_key, upper_key, [&range_sum](test_int value) { range_sum += value; });
+    success &= (sum.load() == range_sum);
+
+    auto append_value = [](std_int_vector& x, test_int value) -> std_int_vector&
+    {
+        x.push_back(value);
+        return x;
+    };
+    auto append_values = [](std_int_vector& x, const std_int_vector& y) -> std_int_vector&
+    {
+        x.insert(x.end(), y.begin(), y.end());
+        return x;
+    };
+
+    std_int_vector values = aa.parallel_reduce(thread_executor, lower_key, upper_key, std_int_vector(), append_value,
+                                               append_values);
+    success &= (values.size() == aa.size() - 200 && std::equal(values.begin(), values.end(), aa.select(100)));
+
+    auto plus = [](uint64_t x, uint64_t y) { return x + y; };
+    success &= (aa.parallel_reduce(thread_executor, upper_key, lower_key, (uint64_t)0, plus, plus) == 0 &&
+                xxfl_int_set().parallel_reduce(thread_executor, 0, 100, (uint64_t)0, plus, plus) == 0);
+
+    xxfl_soa_int_map bb;
+    container_insert_sequential(bb, def_insert_count);
+
+    uint64_t mapped_sum = bb.parallel_reduce(thread_executor, 10, 20, (uint64_t)0,
+                                             [](uint64_t x, test_int, test_int mapped) { return x + mapped; }, plus);
+    success &= (mapped_sum == 145);
+
+    xxfl_int_multiset cc;
+    for (uint32_t i = 0; i < def_insert_count * 10; ++i)
+    {
+        cc.insert((test_int)(rand_gen() % 10));
+    }
+
+    uint64_t count = cc.parallel_reduce(thread_executor, 3, 7, (uint64_t)0,
+                                        [](uint64_t x, test_int) { return x + 1; }, plus);
+    success &= (count == cc.count_range(3, 7));
+
+    // an executor failing on its fourth task, the three tasks it took are done before its exception gets out
+    std::atomic<uint32_t> tasks_done(0);
+    uint32_t tasks_taken = 0;
+    auto failing_executor = [&thread_executor, &tasks_taken](std::function<void()> task)
+    {
+        if (++tasks_taken == 4)
+        {
+            throw std::runtime_error("executor");
+        }
+        thread_executor(std::move(task));
+    };
+
+    try
+    {
+        xxfl::run_tasks(failing_executor, 8, [&tasks_done](size_t)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            ++tasks_done;
+        });
+        success = false;
+    }
+    catch (const std::runtime_error&)
+    {
+        success &= (tasks_done.load() == 3);
+    }
+
+    std::printf("%s\n", success? "passed" : "error");
+}
+
+#if !XXFL_BPLUS_TREE_FINGER_SEARCH
+// a writer moving a window of keys up while readers check every snapshot they get is a whole window
+void single_writer_interface_test()
+{
+    const uint32_t thread_count = 4;
+    const uint32_t round_count = 2000;
+
+    xxfl_single_writer_int_map aa;
+    std::atomic<bool> writing(true);
+    std::atomic<uint32_t> errors(0);
+    std::vector<std::thread> readers;
+
+    for (uint32_t t = 0; t < thread_count; ++t)
+    {
+        readers.push_back(std::thread([&aa, &writing, &errors]()
+        {
+            while (writing.load())
+            {
+                xxfl_single_writer_int_map::read_guard guard = aa.read();
+
+                if (guard->empty())
+                {
+                    continue;
+                }
+
+                test_int lower_key = guard->begin()->first;
+                test_int upper_key = guard->rbegin()->first + 1;
+                size_t count = 0;
+                guard->for_each([&](const int_pair& x)
+                {
+                    count += (x.second == x.first * 2);
+                });
+
+                if (guard->size() != upper_key - lower_key || count != guard->size())
+                {
+                    ++errors;
+                }
+            }
+        }));
+    }
+
+    test_int lower_key = 0, upper_key = 0;
+    for (uint32_t round = 0; round < round_count; ++round)
+    {
+        aa.write([&](xxfl_single_writer_int_map::container_type& x)
+        {
+            for (uint32_t i = 0; i < 10; ++i, ++upper_key)
+            {
+                x.insert(int_pair(upper_key, upper_key * 2));
+            }
+
+            x.insert_or_assign((lower_key + upper_key) / 2, (lower_key + upper_key) / 2 * 2);
+            x[lower_key] = lower_key * 2;
+
+            // written through iterators and restored before the publish, the readers must never see it
+            if (round % 10 == 0)
+            {
+                for (auto& value : x)
+                {
+                    ++value.second;
+                }
+
+                for (auto it = x.rbegin(); it != x.rend(); ++it)
+                {
+                    --it->second;
+                }
+            }
+
+            if (round % 2 == 1)
+            {
+                x.erase(x.begin(), x.find(lower_key + 10));
+                lower_key += 10;
+            }
+        });
+    }
+
+    writing.store(false);
+    for (size_t i = 0; i < readers.size(); ++i)
+    {
+        readers[i].join();
+    }
+
+    aa.reclaim();
+
+    bool success = (errors.load() == 0 && aa.retired_count() == 0 &&
+                    aa.read([](const xxfl_single_writer_int_map::container_type& x) { return x.size(); }) ==
+                    upper_key - lower_key && aa.writer().size() == upper_key - lower_key);
+
+    std::printf("%s\n", success? "passed" : "error");
+}
+#endif
+
+// a mapped value whose copy throws once copies_left runs out, moves never throw
+struct throwing_copy_value
+{
+    static int copies_left;
+    int _value;
+
+    throwing_copy_value(int value = 0) : _value(value) {}
+
+    throwing_copy_value(const throwing_copy_value& x) : _value(x._value)
+    {
+        if (--copies_left < 0)
+        {
+            throw std::runtime_error("copy");
+        }
+    }
+
+    throwing_copy_value(throwing_copy_value&& x) noexcept : _value(x._value) {}
+    throwing_copy_value& operator = (const throwing_copy_value& x) { _value = x._value; return *this; }
+    throwing_copy_value& operator = (throwing_copy_value&& x) noexcept { _value = x._value; return *this; }
+};
+
+int throwing_copy_value::copies_left = INT32_MAX;
+
+// snapshots against copies, while the original and the snapshots are changed by every kind of write
+void snapshot_interface_test()
+{
+    bool success = true;
+
+    xxfl_int_set aa;
+    container_insert_random_1(aa, def_insert_count);
+
+    xxfl_int_set aa_copy(aa);
+    xxfl_int_set aa_snapshot = aa.snapshot();
+    xxfl_int_set aa_snapshot_2 = aa_snapshot.snapshot();
+
+    aa.insert((test_int)def_insert_count * 4);
+    aa.erase(*aa.select(100));
+    aa.erase(aa.select(200), aa.select(3000));
+    aa_snapshot_2.erase(aa_snapshot_2.begin());
+    xxfl_int_set::node_type nh = aa.extract(aa.select(10));
+    xxfl_int_set bb = aa.split(*aa.select(aa.size() / 2));
+
+    success &= (aa_snapshot == aa_copy && aa_snapshot_2.size() == aa_copy.size() - 1 &&
+                aa.size() + bb.size() < aa_copy.size() && aa_snapshot.count(nh.value()) == 1);
+
+    xxfl_int_set cc;
+    container_insert_random_2(cc, def_insert_count);
+    xxfl_int_set cc_copy(cc);
+    xxfl_int_set cc_snapshot = cc.snapshot();
+
+    aa.merge(cc);
+    aa.join(bb);
+    cc = cc_snapshot.snapshot();
+    cc.clear();
+
+    success &= (aa_snapshot == aa_copy && cc_snapshot == cc_copy && aa.size() > cc_copy.size());
+
+    xxfl_int_map dd;
+    container_insert_sequential(dd, def_insert_count);
+
+    xxfl_int_map dd_copy(dd);
+    xxfl_int_map dd_snapshot = dd.snapshot();
+
+    dd[10] = 0;
+    dd[def_insert_count] = 0;
+    dd.at(20) = 0;
+    dd.insert_or_assign(30, 0);
+    dd.erase(40);
+
+    success &= (dd_snapshot == dd_copy && dd[10] == 0 && dd.at(20) == 0 && dd_snapshot.at(30) == 30);
+
+    xxfl_int_map dd_copy_2(dd);
+    xxfl_int_map dd_snapshot_2 = dd.snapshot();
+
+    for (auto& value : dd)
+    {
+        value.second = 7;
+    }
+
+    dd.find(50)->second = 8;
+    dd.rbegin()->second = 9;
+
+    xxfl_int_map dd_snapshot_3 = dd.snapshot();
+
+    for (auto it = dd.rbegin(); it != dd.rend(); ++it)
+    {
+        it->second = 6;
+    }
+
+    std::vector<test_int> keys = { 1, 5000, 9000 };
+    std::vector<xxfl_int_map::iterator> its(keys.size());
+    dd.find_batch(keys.begin(), keys.end(), its.begin());
+
+    for (auto& it : its)
+    {
+        it->second = 5;
+    }
+
+    success &= (dd_snapshot == dd_copy && dd_snapshot_2 == dd_copy_2 && dd_snapshot_3.at(1) == 7 &&
+                dd_snapshot_3.at(50) == 8 && dd_snapshot_3.at(def_insert_count) == 9 &&
+                dd.at(2) == 6 && dd.at(5000) == 5 && dd.at(def_insert_count) == 6);
+
+    xxfl_soa_int_map ee;
+    container_insert_sequential(ee, def_insert_count);
+
+    xxfl_soa_int_map ee_copy(ee);
+    xxfl_soa_int_map ee_snapshot = ee.snapshot();
+
+    ee[10] = 0;
+    ee.at(20) = 0;
+    ee.insert_or_assign(30, 0);
+    ee_snapshot.erase(ee_snapshot.find(40), ee_snapshot.find(50));
+
+    success &= (ee_snapshot.size() == ee_copy.size() - 10 && ee_snapshot.at(10) == 10 && ee_snapshot.at(30) == 30 &&
+                ee.size() == ee_copy.size() && ee.at(20) == 0 && ee.at(45) == 45);
+
+    xxfl_soa_int_map ee_snapshot_2 = ee.snapshot();
+
+    for (auto value : ee)
+    {
+        value.second = 7;
+    }
+
+    (--ee.end())->second = 8;
+
+    success &= (ee_snapshot_2.at(20) == 0 && ee_snapshot_2.at(45) == 45 &&
+                ee_snapshot_2.at(def_insert_count - 1) == def_insert_count - 1 &&
+                ee.at(45) == 7 && ee.at(def_insert_count - 1) == 8);
+
+    xxfl_sum_int_map ff;
+    container_insert_sequential(ff, def_insert_count);
+
+    uint64_t sum = (uint64_t)def_insert_count * (def_insert_count - 1) / 2;
+    xxfl_sum_int_map ff_snapshot = ff.snapshot();
+
+    ff.insert_or_assign(120, 1000);
+    ff.erase(199);
+
+    success &= (ff_snapshot.reduce(0, def_insert_count) == sum && ff.reduce(0, def_insert_count) == sum + 880 - 199);
+
+    xxfl_int_multiset gg({ 3, 1, 3, 2, 3 });
+    xxfl_int_multiset gg_snapshot = gg.snapshot();
+
+    gg.erase(3);
+    success &= (gg.size() == 2 && gg_snapshot.count(3) == 3);
+
+    // a leaf copy failing halfway leaves both trees as they were, the next write copies it again. leaves linked to
+    // their neighbours are copied by snapshot() already.
+    xxfl::map<test_int, throwing_copy_value> hh;
+    for (uint32_t i = 0; i < def_insert_count; ++i)
+    {
+        hh.emplace((test_int)i, throwing_copy_value((int)i));
+    }
+
+    xxfl::map<test_int, throwing_copy_value> hh_snapshot = hh.snapshot();
+
+    throwing_copy_value::copies_left = 3;
+
+    bool is_throw = false;
+    try
+    {
+        hh.find(5000)->second._value = -1;
+    }
+    catch (const std::runtime_error&)
+    {
+        is_throw = true;
+    }
+    success &= (is_throw != (XXFL_BPLUS_TREE_LEAF_LINKS != 0));
+
+    throwing_copy_value::copies_left = INT32_MAX;
+    hh.find(5000)->second._value = -2;
+
+    success &= (hh.size() == def_insert_count && hh_snapshot.size() == def_insert_count &&
+                hh.at(5000)._value == -2 && hh_snapshot.at(5000)._value == 5000 &&
+                hh.at(4999)._value == 4999 && hh.rbegin()->second._value == (int)def_insert_count - 1);
+
+    std::printf("%s\n", success? "passed" : "error");
+}
+
+// constructed before the node pool is first used, so it gives its nodes back to the pool after main returns
+static xxfl_pooled_int_set pooled_int_set_static;
+
+void pooled_interface_test()
+{
+    bool success = true;
+
+    pooled_int_set_static.clear();
+    container_insert_sequential(pooled_int_set_static, def_insert_count);
+
+    success &= (pooled_int_set_static.size() == def_insert_count && *pooled_int_set_static.rbegin() == def_insert_count - 1);
+
+    xxfl_pooled_int_set aa(pooled_int_set_static);
+    aa.erase(aa.begin(), aa.find(def_insert_count / 2));
+
+    success &= (aa.size() == def_insert_count / 2 && *aa.begin() == def_insert_count / 2 &&
+                pooled_int_set_static.size() == def_insert_count);
+
+    std::printf("%s\n", success? "passed" : "error");
+}
+
 void interface_test()
 {
     std::printf("xxfl_int_set: ");
     int_set_interface_test<xxfl_int_set>();
 
+    std::printf("xxfl_pooled_int_set: ");
+    pooled_interface_test();
+
     std::printf("xxfl_string_set: ");
     string_set_interface_test<xxfl_string_set>();
 
+    std::printf("xxfl_packed_string_set: ");
+    string_set_interface_test<xxfl_packed_string_set>();
+
     std::printf("xxfl_int_map: ");
     int_map_interface_test<xxfl_int_map>();
 
+    std::printf("xxfl_soa_int_map: ");
+    int_map_interface_test<xxfl_soa_int_map>();
+
     std::printf("xxfl_string_map: ");
     string_map_interface_test<xxfl_string_map>();
+
+    std::printf("xxfl_packed_string_map: ");
+    string_map_interface_test<xxfl_packed_string_map>();
+
+    std::printf("xxfl_transparent_string_map: ");
+    transparent_lookup_interface_test();
+
+    std::printf("xxfl_sum_int_map: ");
+    int_map_interface_test<xxfl_sum_int_map>();
+
+    std::printf("xxfl_sum_int_map reduce: ");
+    aggregate_interface_test();
+
+    std::printf("xxfl_int_multiset, xxfl_int_multimap: ");
+    multi_interface_test();
+
+    std::printf("xxfl_int_set, xxfl_int_map, xxfl_soa_int_map for_each: ");
+    for_each_interface_test();
+
+    std::printf("xxfl_concurrent_int_map: ");
+    concurrent_interface_test();
+
+    std::printf("xxfl_sharded_int_map: ");
+    sharded_interface_test();
+
+    std::printf("xxfl_int_set, xxfl_int_map, xxfl_soa_int_map snapshot: ");
+    snapshot_interface_test();
+
+#if !XXFL_BPLUS_TREE_FINGER_SEARCH
+    std::printf("xxfl_single_writer_int_map: ");
+    single_writer_interface_test();
+#endif
+
+    std::printf("xxfl_int_set, xxfl_soa_int_map, xxfl_int_multiset parallel: ");
+    parallel_interface_test();
 }
@@ -141,6 +141,12 @@ void memory_usage_test()
         std::printf("xxfl_string_set(random): ");
         container_test_memory_usage_random<xxfl_string_set>(insert_count, containers_count);
 
+        std::printf("xxfl_packed_string_set(sequential): ");
+        container_test_memory_usage_sequential<xxfl_packed_string_set>(insert_count, containers_count);
+
+        std::printf("xxfl_packed_string_set(random): ");
+        container_test_memory_usage_random<xxfl_packed_string_set>(insert_count, containers_count);
+
         std::printf("\n");
     }
 
@@ -167,16 +173,23 @@ void memory_usage_test()
         std::printf("xxfl_string_map(random): ");
         container_test_memory_usage_random<xxfl_string_map>(insert_count, containers_count);
 
+        std::printf("xxfl_packed_string_map(sequential): ");
+        container_test_memory_usage_sequential<xxfl_packed_string_map>(insert_count, containers_count);
+
+        std::printf("xxfl_packed_string_map(random): ");
+        container_test_memory_usage_random<xxfl_packed_string_map>(insert_count, containers_count);
+
         std::printf("\n");
     }
 }
 
-void verification_test()
+template<typename _container>
+void container_verification_test()
 {
     const uint32_t values_count = 100000;
 
     std_int_set aa;
-    xxfl_int_set bb;
+    _container bb;
 
     std::printf("testing...");
 
@@ -213,6 +226,18 @@ void verification_test()
     std::printf("%s\n", success? "passed" : "error");
 }
 
+void verification_test()
+{
+    std::printf("xxfl_int_set: ");
+    container_verification_test<xxfl_int_set>();
+
+    std::printf("xxfl_small_leaf_int_set: ");
+    container_verification_test<xxfl_small_leaf_int_set>();
+
+    std::printf("xxfl_pooled_int_set: ");
+    container_verification_test<xxfl_pooled_int_set>();
+}
+
 template<typename _container>
 void container_get_max_capacity()
 {
@@ -235,6 +260,9 @@ void get_max_capacity()
     std::printf("xxfl_int_map:\n");
     container_get_max_capacity<xxfl_int_map>();
 
+    std::printf("xxfl_small_leaf_int_map:\n");
+    container_get_max_capacity<xxfl_small_leaf_int_map>();
+
     std::printf("xxfl_string_map:\n");
     container_get_max_capacity<xxfl_string_map>();
 }
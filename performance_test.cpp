@@ -1,4 +1,6 @@
 #include <chrono>
+#include <iterator>
+#include <mutex>
 #include "xxfl_set_test.h"
 
 typedef std::chrono::steady_clock::time_point timestamp_t;
@@ -28,6 +30,58 @@ void container_test_insert_performance_sequential(uint32_t insert_count, uint32_
     std::printf("%f sec\n", get_elapsed_time(start_time));
 }
 
+template<typename _container>
+void container_test_bulk_load_performance(uint32_t insert_count, uint32_t loops_count)
+{
+    std_int_vector vec;
+    int_vector_append_sequential(vec, insert_count);
+
+    timestamp_t start_time = get_cur_time();
+
+    for (uint32_t i = 0; i < loops_count; ++i)
+    {
+        _container aa(xxfl::sorted_unique, vec.begin(), vec.end());
+    }
+
+    std::printf("%f sec\n", get_elapsed_time(start_time));
+}
+
+// the second half of a random vector is inserted into a container holding the first half, either one by one or
+// as one batch
+template<typename _container>
+void container_test_insert_batch_performance(uint32_t insert_count, uint32_t loops_count, bool batch)
+{
+    std_int_vector vec;
+    vec.reserve(insert_count);
+
+    for (uint32_t i = 0; i < insert_count; ++i)
+    {
+        vec.push_back(rand_gen());
+    }
+
+    double elapsed_time = 0;
+
+    for (uint32_t i = 0; i < loops_count; ++i)
+    {
+        _container aa(vec.begin(), vec.begin() + insert_count / 2);
+
+        timestamp_t start_time = get_cur_time();
+
+        if (batch)
+        {
+            aa.insert_batch(vec.begin() + insert_count / 2, vec.end());
+        }
+        else
+        {
+            aa.insert(vec.begin() + insert_count / 2, vec.end());
+        }
+
+        elapsed_time += get_elapsed_time(start_time);
+    }
+
+    std::printf("%f sec\n", elapsed_time);
+}
+
 template<typename _container>
 void container_test_insert_performance_random(uint32_t insert_count, uint32_t loops_count)
 {
@@ -70,6 +124,9 @@ void test_insert_performance()
         std::printf("xxfl_int_set(sequential): ");
         container_test_insert_performance_sequential<xxfl_int_set>(insert_count, loops_count);
 
+        std::printf("xxfl_int_set(bulk load): ");
+        container_test_bulk_load_performance<xxfl_int_set>(insert_count, loops_count);
+
         std::printf("\n");
     }
 
@@ -83,6 +140,16 @@ void test_insert_performance()
         std::printf("\n");
     }
 
+    {
+        std::printf("xxfl_int_set(random half, one by one): ");
+        container_test_insert_batch_performance<xxfl_int_set>(insert_count, loops_count, false);
+
+        std::printf("xxfl_int_set(random half, batch): ");
+        container_test_insert_batch_performance<xxfl_int_set>(insert_count, loops_count, true);
+
+        std::printf("\n");
+    }
+
     {
         std::printf("std_string_set(sequential): ");
         container_test_insert_performance_sequential<std_string_set>(insert_count, loops_count);
@@ -120,6 +187,9 @@ void test_insert_performance()
         std::printf("xxfl_int_map(random): ");
         container_test_insert_performance_random<xxfl_int_map>(insert_count, loops_count);
 
+        std::printf("xxfl_small_leaf_int_map(random): ");
+        container_test_insert_performance_random<xxfl_small_leaf_int_map>(insert_count, loops_count);
+
         std::printf("\n");
     }
 
@@ -298,7 +368,40 @@ void container_test_find_performance(uint32_t values_count, uint32_t find_count)
     for (uint32_t i = 0; i < find_count; ++i)
     {
         auto it = container_op<_container>::find(aa, rand_gen() % values_count);
-        tmp += (uint64_t)&it;
+        tmp += (it != aa.end());
+    }
+
+    std::printf("%f sec\n", get_elapsed_time(start_time));
+}
+
+// the keys are looked up 64 at a time, like the probes of a join
+template<typename _container>
+void container_test_find_batch_performance(uint32_t values_count, uint32_t find_count)
+{
+    const uint32_t batch_size = 64;
+
+    _container aa;
+    container_insert_sequential(aa, values_count);
+
+    timestamp_t start_time = get_cur_time();
+
+    uint32_t keys[batch_size];
+    typename _container::iterator its[batch_size];
+
+    volatile uint64_t tmp = 0;
+    for (uint32_t i = 0; i < find_count; i += batch_size)
+    {
+        for (uint32_t j = 0; j < batch_size; ++j)
+        {
+            keys[j] = rand_gen() % values_count;
+        }
+
+        aa.find_batch(keys, keys + batch_size, its);
+
+        for (uint32_t j = 0; j < batch_size; ++j)
+        {
+            tmp += (its[j] != aa.end());
+        }
     }
 
     std::printf("%f sec\n", get_elapsed_time(start_time));
@@ -327,6 +430,12 @@ void test_find_performance()
         std::printf("xxfl_int_set: ");
         container_test_find_performance<xxfl_int_set>(values_count, find_count_def);
 
+        std::printf("xxfl_pooled_int_set: ");
+        container_test_find_performance<xxfl_pooled_int_set>(values_count, find_count_def);
+
+        std::printf("xxfl_int_set(batch): ");
+        container_test_find_batch_performance<xxfl_int_set>(values_count, find_count_def);
+
         std::printf("\n");
     }
 
@@ -347,6 +456,12 @@ void test_find_performance()
         std::printf("xxfl_int_map: ");
         container_test_find_performance<xxfl_int_map>(values_count, find_count_def);
 
+        std::printf("xxfl_soa_int_map: ");
+        container_test_find_performance<xxfl_soa_int_map>(values_count, find_count_def);
+
+        std::printf("xxfl_int_map(batch): ");
+        container_test_find_batch_performance<xxfl_int_map>(values_count, find_count_def);
+
         std::printf("\n");
     }
 
@@ -381,6 +496,64 @@ void container_test_traversing_performance(uint32_t values_count, uint32_t loops
     std::printf("%f sec\n", get_elapsed_time(start_time));
 }
 
+// sums the keys through iterators, or through the leaf spans of for_each_span which the compiler can vectorize
+template<typename _container>
+void container_test_sum_performance(uint32_t values_count, uint32_t loops_count, bool spans)
+{
+    _container aa;
+    container_insert_sequential(aa, values_count);
+
+    timestamp_t start_time = get_cur_time();
+
+    volatile uint64_t tmp = 0;
+    for (uint32_t i = 0; i < loops_count; ++i)
+    {
+        uint64_t sum = 0;
+
+        if (spans)
+        {
+            aa.for_each_span([&sum](const test_int* first, const test_int* last)
+            {
+                for (; first != last; ++first)
+                {
+                    sum += *first;
+                }
+            });
+        }
+        else
+        {
+            for (auto value : aa)
+            {
+                sum += value;
+            }
+        }
+
+        tmp += sum;
+    }
+
+    std::printf("%f sec\n", get_elapsed_time(start_time));
+}
+
+// the same sum by parallel_reduce, on a thread for each run
+template<typename _container>
+void container_test_parallel_sum_performance(uint32_t values_count, uint32_t loops_count)
+{
+    _container aa;
+    container_insert_sequential(aa, values_count);
+
+    timestamp_t start_time = get_cur_time();
+
+    volatile uint64_t tmp = 0;
+    for (uint32_t i = 0; i < loops_count; ++i)
+    {
+        tmp += aa.parallel_reduce(xxfl::thread_executor(), 0, (test_int)values_count, (uint64_t)0,
+                                  [](uint64_t sum, test_int value) { return sum + value; },
+                                  [](uint64_t x, uint64_t y) { return x + y; });
+    }
+
+    std::printf("%f sec\n", get_elapsed_time(start_time));
+}
+
 void test_traversing_performance()
 {
     const uint32_t total_increment_count_min = 50000000;
@@ -412,6 +585,19 @@ void test_traversing_performance()
         std::printf("\n");
     }
 
+    {
+        std::printf("xxfl_int_set(sum, iterator): ");
+        container_test_sum_performance<xxfl_int_set>(values_count, loops_count, false);
+
+        std::printf("xxfl_int_set(sum, for_each_span): ");
+        container_test_sum_performance<xxfl_int_set>(values_count, loops_count, true);
+
+        std::printf("xxfl_int_set(sum, parallel_reduce): ");
+        container_test_parallel_sum_performance<xxfl_int_set>(values_count, loops_count);
+
+        std::printf("\n");
+    }
+
     {
         std::printf("std_string_set: ");
         container_test_traversing_performance<std_string_set>(values_count, loops_count);
@@ -537,6 +723,276 @@ void test_combined_performance()
     }
 }
 
+// meant for containers much larger than the cache, compare builds with different XXFL_BPLUS_TREE_PREFETCH_* settings
+template<typename _container>
+void container_test_prefetch_performance(uint32_t values_count, uint32_t find_count, uint32_t loops_count)
+{
+    _container aa;
+    container_insert_random_1(aa, values_count);
+
+    timestamp_t start_time = get_cur_time();
+
+    volatile uint64_t tmp = 0;
+    for (uint32_t i = 0; i < find_count; ++i)
+    {
+        auto it = container_op<_container>::find(aa, rand_gen());
+        tmp += (it != aa.end());
+    }
+
+    std::printf("find %f sec, ", get_elapsed_time(start_time));
+
+    start_time = get_cur_time();
+
+    for (uint32_t i = 0; i < loops_count; ++i)
+    {
+        for (auto& value : aa)
+        {
+            tmp += value.second;
+        }
+    }
+
+    std::printf("traversing %f sec\n", get_elapsed_time(start_time));
+}
+
+void test_prefetch_performance()
+{
+    const uint32_t find_count_def = 500000;
+    const uint32_t total_increment_count_min = 50000000;
+
+    std::printf("descent prefetch: %d, scan prefetch distance: %d, leaf links: %d\n",
+                XXFL_BPLUS_TREE_PREFETCH_DESCENT, XXFL_BPLUS_TREE_PREFETCH_SCAN_DISTANCE, XXFL_BPLUS_TREE_LEAF_LINKS);
+
+    std::printf("values count: ");
+    uint32_t values_count = 0;
+    int ns = std::scanf("%u", &values_count);
+    std::printf("\n");
+
+    if (values_count == 0 || ns < 1)
+    {
+        return;
+    }
+
+    uint32_t loops_count = 1;
+    if (values_count <= total_increment_count_min / 2)
+    {
+        loops_count = total_increment_count_min / values_count;
+    }
+
+    std::printf("find %u times, traverse %u times\n\n", find_count_def, loops_count);
+
+    {
+        std::printf("xxfl_int_map: ");
+        container_test_prefetch_performance<xxfl_int_map>(values_count, find_count_def, loops_count);
+
+        std::printf("\n");
+    }
+}
+
+// x holds the multiples of 2 and y the multiples of step, through the std algorithms on iterators or the
+// operations of the trees
+template<typename _container>
+void container_test_set_operations_performance(uint32_t values_count, uint32_t step, uint32_t loops_count, bool native)
+{
+    _container x, y;
+
+    for (uint32_t i = 0; i < values_count; ++i)
+    {
+        x.insert(i * 2);
+    }
+
+    for (uint32_t i = 0; i < values_count * 2; i += step)
+    {
+        y.insert(i);
+    }
+
+    timestamp_t start_time = get_cur_time();
+
+    volatile uint64_t tmp = 0;
+
+    for (uint32_t i = 0; i < loops_count; ++i)
+    {
+        if (native)
+        {
+            tmp += set_union(x, y).size();
+            tmp += set_intersection(x, y).size();
+            tmp += set_difference(x, y).size();
+        }
+        else
+        {
+            _container u, n, d;
+            std::set_union(x.begin(), x.end(), y.begin(), y.end(), std::inserter(u, u.end()));
+            std::set_intersection(x.begin(), x.end(), y.begin(), y.end(), std::inserter(n, n.end()));
+            std::set_difference(x.begin(), x.end(), y.begin(), y.end(), std::inserter(d, d.end()));
+            tmp += u.size() + n.size() + d.size();
+        }
+    }
+
+    std::printf("%f sec\n", get_elapsed_time(start_time));
+}
+
+void test_set_operations_performance()
+{
+    const uint32_t total_values_count_min = 5000000;
+
+    std::printf("values count: ");
+    uint32_t values_count = 0;
+    int ns = std::scanf("%u", &values_count);
+    std::printf("\n");
+
+    if (values_count == 0 || ns < 1)
+    {
+        return;
+    }
+
+    uint32_t loops_count = 1;
+    if (values_count <= total_values_count_min / 2)
+    {
+        loops_count = total_values_count_min / values_count;
+        std::printf("loop %u times\n\n", loops_count);
+    }
+
+    {
+        std::printf("xxfl_int_set(std algorithms): ");
+        container_test_set_operations_performance<xxfl_int_set>(values_count, 3, loops_count, false);
+
+        std::printf("xxfl_int_set(tree operations): ");
+        container_test_set_operations_performance<xxfl_int_set>(values_count, 3, loops_count, true);
+
+        std::printf("\n");
+    }
+
+    {
+        std::printf("xxfl_int_set(sparse y, std algorithms): ");
+        container_test_set_operations_performance<xxfl_int_set>(values_count, 10007, loops_count, false);
+
+        std::printf("xxfl_int_set(sparse y, tree operations): ");
+        container_test_set_operations_performance<xxfl_int_set>(values_count, 10007, loops_count, true);
+
+        std::printf("\n");
+    }
+}
+
+// runs f(seed) on thread_count threads at once, the time until the last one ends
+template<typename _function>
+double run_threads_test(uint32_t thread_count, _function f)
+{
+    std::vector<std::thread> threads;
+    timestamp_t start_time = get_cur_time();
+
+    for (uint32_t t = 0; t < thread_count; ++t)
+    {
+        threads.push_back(std::thread(f, (uint32_t)rand_gen()));
+    }
+    for (uint32_t t = 0; t < thread_count; ++t)
+    {
+        threads[t].join();
+    }
+
+    return get_elapsed_time(start_time);
+}
+
+// every thread runs its operations on random keys, one in ten an insert or assign and the rest finds
+void test_concurrent_performance()
+{
+    const uint32_t ops_count_def = 1000000;
+
+    std::printf("values count: ");
+    uint32_t values_count = 0;
+    int ns = std::scanf("%u", &values_count);
+    std::printf("\n");
+
+    if (values_count == 0 || ns < 1)
+    {
+        return;
+    }
+
+    std::printf("%u operations per thread, 10%% writes\n\n", ops_count_def);
+
+    uint32_t thread_count_max = std::max(1u, std::thread::hardware_concurrency());
+
+    for (uint32_t thread_count = 1; ; thread_count = std::min(thread_count * 2, thread_count_max))
+    {
+        xxfl_concurrent_int_map aa;
+        xxfl_sharded_int_map cc;
+        xxfl_int_map bb;
+        std::mutex bb_mutex;
+
+        for (uint32_t i = 0; i < values_count; ++i)
+        {
+            aa.insert((test_int)i, (test_int)i);
+            cc.insert((test_int)i, (test_int)i);
+            bb.emplace((test_int)i, (test_int)i);
+        }
+
+        double elapsed = run_threads_test(thread_count, [&aa, values_count](uint32_t seed)
+        {
+            std::mt19937 gen(seed);
+            volatile uint64_t tmp = 0;
+            for (uint32_t i = 0; i < ops_count_def; ++i)
+            {
+                test_int key = (test_int)(gen() % values_count), mapped = 0;
+                if (i % 10 == 0)
+                {
+                    aa.insert_or_assign(key, (test_int)i);
+                }
+                else if (aa.find(key, mapped))
+                {
+                    tmp += mapped;
+                }
+            }
+        });
+        std::printf("xxfl_concurrent_int_map, %u threads: %f sec\n", thread_count, elapsed);
+
+        elapsed = run_threads_test(thread_count, [&cc, values_count](uint32_t seed)
+        {
+            std::mt19937 gen(seed);
+            volatile uint64_t tmp = 0;
+            for (uint32_t i = 0; i < ops_count_def; ++i)
+            {
+                test_int key = (test_int)(gen() % values_count), mapped = 0;
+                if (i % 10 == 0)
+                {
+                    cc.insert_or_assign(key, (test_int)i);
+                }
+                else if (cc.find(key, mapped))
+                {
+                    tmp += mapped;
+                }
+            }
+        });
+        std::printf("xxfl_sharded_int_map, %u threads: %f sec\n", thread_count, elapsed);
+
+        elapsed = run_threads_test(thread_count, [&bb, &bb_mutex, values_count](uint32_t seed)
+        {
+            std::mt19937 gen(seed);
+            volatile uint64_t tmp = 0;
+            for (uint32_t i = 0; i < ops_count_def; ++i)
+            {
+                test_int key = (test_int)(gen() % values_count);
+                std::lock_guard<std::mutex> lock(bb_mutex);
+                if (i % 10 == 0)
+                {
+                    bb[key] = (test_int)i;
+                }
+                else
+                {
+                    xxfl_int_map::const_iterator it = bb.find(key);
+                    if (it != bb.end())
+                    {
+                        tmp += it->second;
+                    }
+                }
+            }
+        });
+        std::printf("xxfl_int_map with a mutex, %u threads: %f sec\n\n", thread_count, elapsed);
+
+        if (thread_count == thread_count_max)
+        {
+            break;
+        }
+    }
+}
+
 void performance_test()
 {
     while (true)
@@ -548,6 +1004,9 @@ void performance_test()
                     "  3. find performance\n"
                     "  4. traversing performance\n"
                     "  5. combined performance\n"
+                    "  6. prefetch performance\n"
+                    "  7. set operations performance\n"
+                    "  8. concurrent performance\n"
                     "select: ");
 
         uint32_t select_idx = 0;
@@ -578,6 +1037,18 @@ void performance_test()
         {
             test_combined_performance();
         }
+        else if (select_idx == 6)
+        {
+            test_prefetch_performance();
+        }
+        else if (select_idx == 7)
+        {
+            test_set_operations_performance();
+        }
+        else if (select_idx == 8)
+        {
+            test_concurrent_performance();
+        }
 
         std::printf("\n");
     }
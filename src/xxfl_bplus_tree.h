@@ -1,9 +1,12 @@
 ﻿#pragma once
 
+#include <cassert>
 #include <cstddef>
 #include <algorithm>
 #include <cstring>
+#include <vector>
 #include "xxfl_bplus_tree_iterator.h"
+#include "xxfl_bplus_tree_simd.h"
 
 #if !defined(XXFL_BPLUS_TREE_BUCKET_BYSIZE_MAX_DEFAULT)
 #define XXFL_BPLUS_TREE_BUCKET_BYSIZE_MAX_DEFAULT 2048
@@ -13,8 +16,125 @@
 #define XXFL_BPLUS_TREE_HEIGHT_MAX_DEFAULT 4
 #endif
 
+// keys which are trivially copyable and not larger than this size are copied into internal nodes
+// as separators, so descending never leaves the internal node being searched. set to 0 to disable.
+#if !defined(XXFL_BPLUS_TREE_SEPARATOR_KEY_BYSIZE_MAX)
+#define XXFL_BPLUS_TREE_SEPARATOR_KEY_BYSIZE_MAX 16
+#endif
+
+// set to 1 to remember the path of the leaf reached by the last descent, a search whose key falls into that leaf
+// starts from it instead of the root. const lookups update it too, so a tree can't be read by several threads at once.
+#if !defined(XXFL_BPLUS_TREE_FINGER_SEARCH)
+#define XXFL_BPLUS_TREE_FINGER_SEARCH 0
+#endif
+
+// set to 1 to make the bucket sizes above the sizes of whole nodes, the node header is taken out of the bucket.
+// a tree of 4096 byte nodes then allocates exactly one page per node.
+#if !defined(XXFL_BPLUS_TREE_BUCKET_INCLUDES_HEADER)
+#define XXFL_BPLUS_TREE_BUCKET_INCLUDES_HEADER 0
+#endif
+
+// the number of lookups find_batch and contains_batch advance together, enough of them to keep the outstanding
+// cache misses of a core busy.
+#if !defined(XXFL_BPLUS_TREE_FIND_BATCH_GROUP_SIZE)
+#define XXFL_BPLUS_TREE_FIND_BATCH_GROUP_SIZE 16
+#endif
+
+// set to 1 to keep the number of values under every child in internal nodes, rank, select and index_of then
+// take O(log n) instead of walking the subtrees they skip.
+#if !defined(XXFL_BPLUS_TREE_SUBTREE_COUNTS)
+#define XXFL_BPLUS_TREE_SUBTREE_COUNTS 0
+#endif
+
 namespace xxfl {
 
+// tag of the constructors taking a range which is sorted without equal keys
+struct sorted_unique_t {};
+constexpr sorted_unique_t sorted_unique = sorted_unique_t();
+
+// the values live in the leaves, so unlike the one of std::set a node handle can't keep the allocation of an
+// extracted value. it holds the value itself, which is moved back into a leaf when the handle is inserted.
+template<typename _moveable_value_type, typename _allocator>
+struct _node_handle_base
+{
+    typedef _allocator allocator_type;
+
+    _node_handle_base() noexcept : _has_value(false) {}
+
+    _node_handle_base(_node_handle_base&& x)
+    noexcept(std::is_nothrow_move_constructible<_moveable_value_type>::value)
+    : _alloc(x._alloc), _has_value(false)
+    {
+        if (x._has_value)
+        {
+            _emplace(std::move(x._value()));
+            x._reset();
+        }
+    }
+
+    _node_handle_base& operator = (_node_handle_base&& x)
+    {
+        if (this != &x)
+        {
+            _reset();
+            _alloc = x._alloc;
+
+            if (x._has_value)
+            {
+                _emplace(std::move(x._value()));
+                x._reset();
+            }
+        }
+
+        return *this;
+    }
+
+    ~_node_handle_base() { _reset(); }
+
+    allocator_type get_allocator() const { return _alloc; }
+
+    bool empty() const noexcept { return !_has_value; }
+    explicit operator bool () const noexcept { return _has_value; }
+
+    void swap(_node_handle_base& x)
+    {
+        _node_handle_base tmp(std::move(x));
+        x = std::move(*this);
+        *this = std::move(tmp);
+    }
+
+    template<typename... _args>
+    void _emplace(_args&&... args)
+    {
+        new (&_storage) _moveable_value_type(std::forward<_args>(args)...);
+        _has_value = true;
+    }
+
+    _moveable_value_type& _value() const noexcept
+    { return *(_moveable_value_type*)&_storage; }
+
+    void _reset() noexcept
+    {
+        if (_has_value)
+        {
+            _value().~_moveable_value_type();
+            _has_value = false;
+        }
+    }
+
+    typename std::aligned_storage<sizeof(_moveable_value_type), alignof(_moveable_value_type)>::type _storage;
+    allocator_type _alloc;
+    bool _has_value;
+};
+
+template<typename _iterator, typename _node_type>
+struct _insert_return_type
+{
+    _iterator position;
+    bool inserted;
+    _node_type node;
+};
+
 template<typename _value_type, uint32_t _tree_height_max>
 struct _bplus_tree_base
 {
@@ -22,13 +142,19 @@ struct _bplus_tree_base
     typedef _bplus_tree_const_iterator<_value_type, _tree_height_max> _const_iterator;
     typedef std::reverse_iterator<_iterator>                          _reverse_iterator;
     typedef std::reverse_iterator<_const_iterator>                    _const_reverse_iterator;
+    typedef _bplus_tree_iterator_base<_value_type, _tree_height_max>  _path;
     typedef _bplus_tree_node<_value_type>                             _node_type;
 
     _node_type* _root_node;
     size_t _values_count;
     uint32_t _tree_height;
+    bool _shared_nodes; // some nodes may be shared with other trees, they are copied before they are changed
+
+    // copies the shared nodes on the path of a mutable iterator, which steps into a leaf it may write, see writable()
+    void (*_unshare_path_of)(_bplus_tree_base* tree, _path& it);
 
-    _bplus_tree_base() noexcept : _root_node(nullptr), _values_count(0), _tree_height(0) {}
+    _bplus_tree_base() noexcept
+    : _root_node(nullptr), _values_count(0), _tree_height(0), _shared_nodes(false), _unshare_path_of(nullptr) {}
 
     _iterator begin() noexcept
     {
@@ -54,9 +180,19 @@ struct _bplus_tree_base
     _const_reverse_iterator crend() const noexcept { return _const_reverse_iterator(cbegin()); }
 };
 
-template<typename _key_type, typename _value_type, typename _moveable_value_type,
+// the monoid of a tree which keeps no aggregates
+struct _no_monoid
+{
+    typedef uint8_t value_type;
+
+    value_type identity() const noexcept { return 0; }
+    value_type combine(value_type, value_type) const noexcept { return 0; }
+};
+
+template<typename _key_type, typename _value_type, typename _moveable_value_type, typename _soa_mapped_type,
          typename _key_of_value, typename _compare, typename _allocator,
-         uint32_t _bucket_bysize_max, uint32_t _tree_height_max>
+         uint32_t _leaf_bucket_bysize_max, uint32_t _internal_bucket_bysize_max, uint32_t _tree_height_max,
+         typename _monoid = void, bool _equal_keys = false>
 struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
 {
     typedef _bplus_tree_base<_value_type, _tree_height_max> _base;
@@ -65,11 +201,14 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
     using typename _base::_const_iterator;
     using typename _base::_reverse_iterator;
     using typename _base::_const_reverse_iterator;
+    using typename _base::_path;
     using typename _base::_node_type;
 
     using _base::_root_node;
     using _base::_values_count;
     using _base::_tree_height;
+    using _base::_shared_nodes;
+    using _base::_unshare_path_of;
 
     typedef typename __alloc_wrapper<_allocator>::template rebind<uint8_t>::other _node_allocator;
     typedef __alloc_wrapper<_node_allocator> _alloc_wrapper;
@@ -77,10 +216,100 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
     _compare _comp;
     _alloc_wrapper _awrapper;
 
-    static const uint32_t __node_bysize_max = sizeof(_node_type) + _bucket_bysize_max;
+#if XXFL_BPLUS_TREE_FINGER_SEARCH
+    struct _finger_type
+    {
+        _node_type** _stack[_tree_height_max];
+        _node_type* _leaf_node;
+        bool _leftmost;
+        bool _rightmost;
+
+        _finger_type() noexcept : _leaf_node(nullptr) {}
+    };
+
+    mutable _finger_type _finger;
+#endif
+
+    static const bool __separator_keys = std::is_trivially_copyable<_key_type>::value &&
+                                         sizeof(_key_type) <= XXFL_BPLUS_TREE_SEPARATOR_KEY_BYSIZE_MAX;
+
+    static const bool __subtree_counts = XXFL_BPLUS_TREE_SUBTREE_COUNTS != 0;
+
+    // internal bucket layout: [node pointers][separator keys][subtree counts][aggregates], keys[i] is the lower bound
+    // of nodes[i] (i > 0), counts[i] the number of values under nodes[i] and aggregates[i] their aggregate
+    static const uint32_t __separator_key_bysize = __separator_keys? sizeof(_key_type) : 0;
+    static const uint32_t __separator_key_align  = __separator_keys? alignof(_key_type) : 1;
+    static const uint32_t __separator_key_padding = (__separator_key_align > sizeof(_node_type*))?
+                                                    __separator_key_align - sizeof(_node_type*) : 0;
+
+    static const uint32_t __subtree_count_bysize = __subtree_counts? sizeof(size_t) : 0;
+    static const uint32_t __subtree_count_padding = __subtree_counts? alignof(size_t) - 1 : 0;
+
+    // a map given a monoid keeps the aggregate of the values under every child after the subtree counts, its reduce
+    // combines whole subtrees
+    static const bool __aggregates = !std::is_void<_monoid>::value;
+
+    typedef typename std::conditional<__aggregates, _monoid, _no_monoid>::type _monoid_type;
+    typedef typename _monoid_type::value_type _aggregate_type;
 
-    static const uint32_t __bucket_values_capacity_max = _bucket_bysize_max / sizeof(_value_type);
-    static const uint32_t __bucket_nodes_capacity_max  = _bucket_bysize_max / sizeof(_node_type*);
+    static_assert(std::is_trivially_copyable<_aggregate_type>::value, "the aggregates are moved by memmove");
+
+    static const uint32_t __aggregate_bysize = __aggregates? sizeof(_aggregate_type) : 0;
+    static const uint32_t __aggregate_padding = __aggregates? alignof(_aggregate_type) - 1 : 0;
+
+    static const bool __leaf_links = XXFL_BPLUS_TREE_LEAF_LINKS != 0;
+
+    // the trees of multisets and multimaps keep equal keys, a run of them may span several leaves and its separators
+    // then equal the key, so lookups descend into the last child whose separator is less than the key and insertions
+    // into the last one not larger than it
+    static const bool __equal_keys = _equal_keys;
+
+    // soa leaf layout: [keys][mapped values], the leaves of soa trees hold only the keys as their values and keep
+    // the mapped values in a parallel array, so searching a leaf never touches them. void for the usual layout.
+    static const bool __soa_leaves = !std::is_void<_soa_mapped_type>::value;
+
+    typedef typename std::conditional<__soa_leaves, _soa_mapped_type, uint8_t>::type _mapped_type;
+
+    static const uint32_t __mapped_value_bysize = __soa_leaves? sizeof(_mapped_type) : 0;
+    static const uint32_t __mapped_value_align  = __soa_leaves? alignof(_mapped_type) : 1;
+    static const uint32_t __mapped_value_padding = (__mapped_value_align > alignof(_value_type))?
+                                                   __mapped_value_align - alignof(_value_type) : 0;
+
+    static const bool __simd_search = _simd_search<_key_type>::__enabled && std::is_same<_compare, std::less<_key_type> >::value;
+    static const bool __simd_search_values = __simd_search &&
+                                             (__soa_leaves || std::is_same<_key_of_value, std::__identity<_key_type> >::value);
+    static const bool __simd_search_keys = __simd_search && __separator_keys;
+    // leaves and internal nodes have independent bucket sizes, small leaves keep the shifting on insert and erase
+    // cheap while large internal nodes keep the tree low
+    static const uint32_t __node_header_bysize = XXFL_BPLUS_TREE_BUCKET_INCLUDES_HEADER? sizeof(_node_type) : 0;
+    static const uint32_t __leaf_bucket_bysize = _leaf_bucket_bysize_max - __node_header_bysize;
+    static const uint32_t __internal_bucket_bysize = _internal_bucket_bysize_max - __node_header_bysize;
+
+    static const uint32_t __bucket_values_capacity_max = (__leaf_bucket_bysize - __mapped_value_padding) /
+                                                         (sizeof(_value_type) + __mapped_value_bysize);
+    static const uint32_t __bucket_nodes_capacity_max  = (__internal_bucket_bysize - __separator_key_padding - __subtree_count_padding -
+                                                          __aggregate_padding) /
+                                                         (sizeof(_node_type*) + __separator_key_bysize + __subtree_count_bysize +
+                                                          __aggregate_bysize);
+
+    // separator keys, subtree counts, aggregates and an included header all take room from the internal bucket, an
+    // internal node has to hold at least 4 children for splits and merges to keep it half full
+    static_assert(__bucket_nodes_capacity_max >= 4, "internal bucket too small");
+
+    static const uint32_t __separator_keys_offset = (__bucket_nodes_capacity_max * sizeof(_node_type*) + __separator_key_align - 1) &
+                                                    ~(__separator_key_align - 1);
+
+    static const uint32_t __subtree_counts_offset = (__separator_keys_offset + __bucket_nodes_capacity_max * __separator_key_bysize +
+                                                     alignof(size_t) - 1) & ~(uint32_t)(alignof(size_t) - 1);
+
+    static const uint32_t __aggregates_offset = (__subtree_counts_offset + __bucket_nodes_capacity_max * __subtree_count_bysize +
+                                                 alignof(_aggregate_type) - 1) & ~(uint32_t)(alignof(_aggregate_type) - 1);
+
+    static const uint32_t __mapped_values_offset = (__bucket_values_capacity_max * sizeof(_value_type) + __mapped_value_align - 1) &
+                                                   ~(__mapped_value_align - 1);
+
+    static uint32_t bucket_bysize_max(uint32_t depth) noexcept
+    { return (depth > 0)? __internal_bucket_bysize : __leaf_bucket_bysize; }
 
     static uint64_t max_capacity_in_theory()
     {
@@ -195,663 +424,3882 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
     {
         if (_root_node != nullptr)
         {
-            clear_node(_root_node, _tree_height);
-            deallocate_root_node();
+            release_root_node();
         }
     }
 
-    _node_type* allocate_node()
+    _node_type* allocate_node(uint32_t depth)
     {
-        return (_node_type*)_awrapper.allocate(__node_bysize_max);
+        drop_finger();
+        _node_type* node = (_node_type*)_awrapper.allocate(sizeof(_node_type) + bucket_bysize_max(depth));
+        ::new((void*)&node->_shares) std::atomic<uint32_t>(0);
+        return node;
     }
 
     _node_type* allocate_root_node(uint32_t bucket_bysize)
     {
+        drop_finger();
         _node_type* root_node = (_node_type*)_awrapper.allocate(sizeof(_node_type) + bucket_bysize);
+        ::new((void*)&root_node->_shares) std::atomic<uint32_t>(0);
         root_node->_bucket_bysize = bucket_bysize;
+        link_leaf(root_node, nullptr, nullptr);
         return root_node;
     }
 
-    void deallocate_node(_node_type* node)
+    void deallocate_node(_node_type* node, uint32_t depth)
     {
-        _awrapper.deallocate((uint8_t*)node, __node_bysize_max);
+        drop_finger();
+        _awrapper.deallocate((uint8_t*)node, sizeof(_node_type) + bucket_bysize_max(depth));
     }
 
     void deallocate_root_node()
     {
+        drop_finger();
         _awrapper.deallocate((uint8_t*)_root_node, sizeof(_node_type) + _root_node->_bucket_bysize);
     }
 
-    size_t max_size() const noexcept
+    // the values of leaves are only moved through the functions below, so that soa leaves can move their mapped
+    // values along. the root leaf of a soa tree always has the full size, its mapped values are at the same offset.
+    static _mapped_type* mapped_values(const _node_type* node) noexcept
+    { return (_mapped_type*)((uint8_t*)node->values() + __mapped_values_offset); }
+
+    template<typename... _args>
+    void construct_value(_node_type* node, _value_type* value_ptr, _args&&... args)
+    { construct_value(std::integral_constant<bool, __soa_leaves>(), node, value_ptr, std::forward<_args>(args)...); }
+
+    template<typename... _args>
+    void construct_value(std::false_type /*soa_leaves*/, _node_type*, _value_type* value_ptr, _args&&... args)
+    { _awrapper.construct(value_ptr, std::forward<_args>(args)...); }
+
+    template<typename... _args>
+    void construct_value(std::true_type /*soa_leaves*/, _node_type* node, _value_type* value_ptr, _args&&... args)
     {
-        uint64_t alloc_value_max_size = _awrapper.max_size() * (__bucket_values_capacity_max / 2);
-        return (size_t)std::min(alloc_value_max_size, max_capacity_in_practice());
+        std::pair<_key_type, _mapped_type> x(std::forward<_args>(args)...);
+        _awrapper.construct(value_ptr, std::move(x.first));
+        _awrapper.construct(mapped_values(node) + (value_ptr - node->values()), std::move(x.second));
     }
 
-    void clear_node(_node_type* node, uint32_t depth)
+    template<typename... _args>
+    void assign_value(_node_type* node, _value_type* value_ptr, _args&&... args)
+    { assign_value(std::integral_constant<bool, __soa_leaves>(), node, value_ptr, std::forward<_args>(args)...); }
+
+    template<typename... _args>
+    void assign_value(std::false_type /*soa_leaves*/, _node_type*, _value_type* value_ptr, _args&&... args)
+    { *(_moveable_value_type*)value_ptr = _moveable_value_type(std::forward<_args>(args)...); }
+
+    template<typename... _args>
+    void assign_value(std::true_type /*soa_leaves*/, _node_type* node, _value_type* value_ptr, _args&&... args)
     {
-        if (depth > 0)
+        std::pair<_key_type, _mapped_type> x(std::forward<_args>(args)...);
+        *value_ptr = std::move(x.first);
+        mapped_values(node)[value_ptr - node->values()] = std::move(x.second);
+    }
+
+    // a value moved out of its leaf, together with its mapped value for soa leaves
+    typedef typename std::conditional<__soa_leaves, std::pair<_key_type, _mapped_type>, _moveable_value_type>::type
+            _taken_value_type;
+
+    _taken_value_type take_value(_node_type* node, _value_type* value_ptr)
+    { return take_value(std::integral_constant<bool, __soa_leaves>(), node, value_ptr); }
+
+    _taken_value_type take_value(std::false_type /*soa_leaves*/, _node_type*, _value_type* value_ptr)
+    { return std::move(*(_moveable_value_type*)value_ptr); }
+
+    _taken_value_type take_value(std::true_type /*soa_leaves*/, _node_type* node, _value_type* value_ptr)
+    { return _taken_value_type(std::move(*value_ptr), std::move(mapped_values(node)[value_ptr - node->values()])); }
+
+    // the values copied before a copy throws are destroyed again, dst_node is left without values
+    void copy_values(_node_type* dst_node, const _node_type* src_node)
+    {
+        uint32_t i = 0;
+
+        try
         {
-            uint32_t child_depth = depth - 1;
-            for (uint32_t i = 0; i < node->_count; ++i)
+            for (; i < src_node->_count; ++i)
             {
-                _node_type* child_node = node->nodes()[i];
-                clear_node(child_node, child_depth);
-                deallocate_node(child_node);
+                _awrapper.construct(dst_node->values() + i, src_node->values()[i]);
             }
         }
-        else
+        catch (...)
         {
-            _awrapper.destroy(node->values(), node->values_end());
-            _values_count -= node->_count;
+            _awrapper.destroy(dst_node->values(), dst_node->values() + i);
+            throw;
+        }
+
+        if (__soa_leaves)
+        {
+            try
+            {
+                for (i = 0; i < src_node->_count; ++i)
+                {
+                    _awrapper.construct(mapped_values(dst_node) + i, mapped_values(src_node)[i]);
+                }
+            }
+            catch (...)
+            {
+                _awrapper.destroy(mapped_values(dst_node), mapped_values(dst_node) + i);
+                _awrapper.destroy(dst_node->values(), dst_node->values() + src_node->_count);
+                throw;
+            }
         }
     }
 
-    void clear() noexcept
+    // the source stays constructed
+    void move_construct_value(_node_type* dst_node, uint32_t dst_pos, _node_type* src_node, uint32_t src_pos)
     {
-        if (_values_count > 0)
-        {
-            clear_node(_root_node, _tree_height);
-            deallocate_root_node();
-            _root_node = nullptr;
+        _awrapper.construct(dst_node->values() + dst_pos, std::move(src_node->values()[src_pos]));
 
-            _values_count = 0;
-            _tree_height = 0;
+        if (__soa_leaves)
+        {
+            _awrapper.construct(mapped_values(dst_node) + dst_pos, std::move(mapped_values(src_node)[src_pos]));
         }
     }
 
-    void clone_node(_node_type** dst_node_ptr, const _node_type* src_node, uint32_t depth) noexcept
+    // moves count values into uninitialized slots and destroys the sources
+    void relocate_values(_node_type* dst_node, uint32_t dst_pos, _node_type* src_node, uint32_t src_pos, uint32_t count)
     {
-        _node_type* dst_node = allocate_node();
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            _awrapper.construct(dst_node->values() + dst_pos + i, std::move(src_node->values()[src_pos + i]));
+            _awrapper.destroy(src_node->values() + src_pos + i);
+        }
 
-        if (depth > 0)
+        if (__soa_leaves)
         {
-            uint32_t child_depth = depth - 1;
-            for (uint32_t i = 0; i < src_node->_count; ++i)
+            for (uint32_t i = 0; i < count; ++i)
             {
-                clone_node(dst_node->nodes() + i, src_node->nodes()[i], child_depth);
+                _awrapper.construct(mapped_values(dst_node) + dst_pos + i, std::move(mapped_values(src_node)[src_pos + i]));
+                _awrapper.destroy(mapped_values(src_node) + src_pos + i);
             }
-
-            dst_node->_ref_value = (*dst_node->nodes())->_ref_value;
         }
-        else
+    }
+
+    // move assignments inside one node, like std::move and std::move_backward
+    void move_values(_node_type* node, uint32_t first_pos, uint32_t last_pos, uint32_t dst_pos)
+    {
+        std::move(node->values() + first_pos,
+                  node->values() + last_pos,
+                  (_moveable_value_type*)node->values() + dst_pos);
+
+        if (__soa_leaves)
         {
-            for (uint32_t i = 0; i < src_node->_count; ++i)
-            {
-                _awrapper.construct(dst_node->values() + i, src_node->values()[i]);
-            }
+            std::move(mapped_values(node) + first_pos,
+                      mapped_values(node) + last_pos,
+                      mapped_values(node) + dst_pos);
+        }
+    }
+
+    void move_values_backward(_node_type* node, uint32_t first_pos, uint32_t last_pos, uint32_t dst_last_pos)
+    {
+        std::move_backward(node->values() + first_pos,
+                           node->values() + last_pos,
+                           (_moveable_value_type*)node->values() + dst_last_pos);
 
-            dst_node->_ref_value = dst_node->values();
+        if (__soa_leaves)
+        {
+            std::move_backward(mapped_values(node) + first_pos,
+                               mapped_values(node) + last_pos,
+                               mapped_values(node) + dst_last_pos);
         }
+    }
 
-        dst_node->_count = src_node->_count;
-        *dst_node_ptr = dst_node;
+    void destroy_values(_node_type* node, uint32_t first_pos, uint32_t last_pos)
+    {
+        _awrapper.destroy(node->values() + first_pos, node->values() + last_pos);
+
+        if (__soa_leaves)
+        {
+            _awrapper.destroy(mapped_values(node) + first_pos, mapped_values(node) + last_pos);
+        }
     }
 
-    void clone_root_node(const _node_type* root_node, uint32_t tree_height) noexcept
+#if XXFL_BPLUS_TREE_LEAF_LINKS
+    static void link_leaf(_node_type* node, _node_type* prev_node, _node_type* next_node) noexcept
     {
-        _root_node = allocate_root_node(root_node->_bucket_bysize);
+        node->_prev_leaf = prev_node;
+        node->_next_leaf = next_node;
 
-        if (tree_height > 0)
+        if (prev_node != nullptr)
         {
-            uint32_t child_depth = tree_height - 1;
-            for (uint32_t i = 0; i < root_node->_count; ++i)
-            {
-                clone_node(_root_node->nodes() + i, root_node->nodes()[i], child_depth);
-            }
+            prev_node->_next_leaf = node;
         }
-        else
+        if (next_node != nullptr)
         {
-            for (uint32_t i = 0; i < root_node->_count; ++i)
-            {
-                _awrapper.construct(_root_node->values() + i, root_node->values()[i]);
-            }
+            next_node->_prev_leaf = node;
         }
+    }
 
-        _root_node->_count = root_node->_count;
+    static void link_leaf_after(_node_type* node, _node_type* prev_node) noexcept
+    { link_leaf(node, prev_node, prev_node->_next_leaf); }
+
+    static void unlink_leaf(_node_type* node) noexcept
+    {
+        if (node->_prev_leaf != nullptr)
+        {
+            node->_prev_leaf->_next_leaf = node->_next_leaf;
+        }
+        if (node->_next_leaf != nullptr)
+        {
+            node->_next_leaf->_prev_leaf = node->_prev_leaf;
+        }
     }
 
-    void move_data(_bplus_tree& tree, std::true_type)
+    // links the leaf of path with the leaves found before and after it by walking the tree
+    static void relink_leaf(const _path& path) noexcept
     {
-        _root_node = tree._root_node;
-        _values_count = tree._values_count;
-        _tree_height = tree._tree_height;
+        _path prev_path(path);
+        _path next_path(path);
 
-        tree._root_node = nullptr;
-        tree._values_count = 0;
-        tree._tree_height = 0;
+        prev_path.cross_node_decrement();
+        next_path.cross_node_increment();
+
+        link_leaf(*path._stack[0],
+                  (prev_path._value_ptr != nullptr)? *prev_path._stack[0] : nullptr,
+                  (next_path._value_ptr != nullptr)? *next_path._stack[0] : nullptr);
     }
 
-    void move_data(_bplus_tree& tree, std::false_type)
+    // the leaf chain is cut before next_node or joined between prev_node and next_node when trees are split or joined
+    static void cut_leaf_links(_node_type* next_node) noexcept
     {
-        if (_awrapper._alloc == tree._awrapper._alloc)
+        if (next_node->_prev_leaf != nullptr)
         {
-            move_data(tree, std::true_type());
+            next_node->_prev_leaf->_next_leaf = nullptr;
+            next_node->_prev_leaf = nullptr;
         }
-        else if (tree._values_count > 0)
+    }
+
+    static void join_leaf_links(_node_type* prev_node, _node_type* next_node) noexcept
+    {
+        prev_node->_next_leaf = next_node;
+        next_node->_prev_leaf = prev_node;
+    }
+#else
+    static void link_leaf(_node_type*, _node_type*, _node_type*) noexcept {}
+    static void link_leaf_after(_node_type*, _node_type*) noexcept {}
+    static void unlink_leaf(_node_type*) noexcept {}
+    static void relink_leaf(const _path&) noexcept {}
+    static void cut_leaf_links(_node_type*) noexcept {}
+    static void join_leaf_links(_node_type*, _node_type*) noexcept {}
+#endif
+
+#if XXFL_BPLUS_TREE_FINGER_SEARCH
+    // the path of the finger stays valid as long as no node is allocated or deallocated, values moving between
+    // siblings don't matter since the key is checked against the current content of the leaf.
+    void drop_finger() const noexcept { _finger._leaf_node = nullptr; }
+
+    template<typename _kt>
+    bool load_finger(const _kt& key, _node_type*** stack, _node_type*& cur_node) const
+    {
+        _node_type* leaf_node = _finger._leaf_node;
+
+        if (leaf_node != nullptr &&
+            (_finger._leftmost || key_larger(key, *leaf_node->values())) &&
+            (_finger._rightmost || !key_larger(key, *(leaf_node->values_end() - 1))))
         {
-            clone_root_node(tree._root_node, tree._tree_height);
-            _values_count = tree._values_count;
-            _tree_height = tree._tree_height;
+            std::memcpy((void*)stack, (const void*)_finger._stack, _tree_height * sizeof(_node_type**));
+            cur_node = leaf_node;
+            return true;
         }
+
+        return false;
     }
 
-    _bplus_tree& operator = (const _bplus_tree& tree)
+    void store_finger(_node_type*** stack, _node_type* leaf_node) const noexcept
     {
-        if (this != &tree)
+        if (_tree_height == 0)
         {
-            clear();
-            _comp = tree._comp;
+            return;
+        }
 
-            if (_alloc_wrapper::propagate_on_container_copy_assignment())
+        bool leftmost = true;
+        bool rightmost = true;
+
+        for (uint32_t depth = 0; depth < _tree_height; ++depth)
+        {
+            _node_type* parent_node = (depth + 1 < _tree_height)? *stack[depth + 1] : _root_node;
+
+            leftmost &= (stack[depth] == parent_node->nodes());
+            rightmost &= (stack[depth] + 1 == parent_node->nodes_end());
+        }
+
+        std::memcpy((void*)_finger._stack, (const void*)stack, _tree_height * sizeof(_node_type**));
+        _finger._leaf_node = leaf_node;
+        _finger._leftmost = leftmost;
+        _finger._rightmost = rightmost;
+    }
+#else
+    void drop_finger() const noexcept {}
+    template<typename _kt>
+    bool load_finger(const _kt&, _node_type***, _node_type*&) const noexcept { return false; }
+    void store_finger(_node_type***, _node_type*) const noexcept {}
+#endif
+
+    // iterators are worked on directly when they carry their path, otherwise through a path converted at the end
+    template<typename _output_iterator>
+    using _path_for = typename std::conditional<__leaf_links, _path, _output_iterator>::type;
+
+    const _path& make_path(const _path& it, std::false_type /*leaf_links*/) const noexcept
+    { return it; }
+
+    // a leaf linked iterator doesn't know its parents, they are found again by descending on its key
+    _path make_path(const _const_iterator& it, std::true_type /*leaf_links*/) const
+    {
+        _path path(const_cast<_bplus_tree*>(this), it._value_ptr);
+
+        if (it._value_ptr != nullptr)
+        {
+            _node_type* cur_node;
+            path._value_ptr = lower_bound_core(_key_of_value()(*it._value_ptr), path._stack, cur_node);
+
+            // the key leads to the first of its equal keys, the leaf of it is among the leaves of their run
+            if (__equal_keys)
             {
-                if (!_alloc_wrapper::allocator_always_compares_equal() &&
-                    _awrapper._alloc != tree._awrapper._alloc)
+                while (path.leaf_node() != it.leaf_node())
                 {
-                    _awrapper.copy_allocator(tree._awrapper._alloc);
+                    path.cross_node_increment();
                 }
-            }
 
-            if (tree._values_count > 0)
-            {
-                clone_root_node(tree._root_node, tree._tree_height);
-                _values_count = tree._values_count;
-                _tree_height = tree._tree_height;
+                path._value_ptr = it._value_ptr;
             }
         }
 
-        return *this;
+        return path;
     }
 
-    void move_assign(_bplus_tree& tree)
+    size_t max_size() const noexcept
     {
-        clear();
-        _comp = tree._comp;
+        uint64_t alloc_value_max_size = _awrapper.max_size() * (__bucket_values_capacity_max / 2);
+        return (size_t)std::min(alloc_value_max_size, max_capacity_in_practice());
+    }
 
-        if (_alloc_wrapper::propagate_on_container_move_assignment() ||
-            _alloc_wrapper::allocator_always_compares_equal() ||
-            _awrapper._alloc == tree._awrapper._alloc)
+    // the values of the leaves cleared here are taken off _values_count, the subtrees shared with other trees are only
+    // dropped and not counted
+    void clear_node(_node_type* node, uint32_t depth)
+    {
+        if (depth > 0)
         {
-            move_data(tree, std::true_type());
-            _awrapper.move_allocator(tree._awrapper._alloc);
+            uint32_t child_depth = depth - 1;
+            for (uint32_t i = 0; i < node->_count; ++i)
+            {
+                _node_type* child_node = node->nodes()[i];
+                if (!drop_shared_node(child_node))
+                {
+                    clear_node(child_node, child_depth);
+                    deallocate_node(child_node, child_depth);
+                }
+            }
         }
         else
         {
-            insert_range(std::__make_move_if_noexcept_iterator(tree.begin()),
-                         std::__make_move_if_noexcept_iterator(tree.end()));
-            tree.clear();
+            destroy_values(node, 0, node->_count);
+            _values_count -= node->_count;
         }
     }
 
-    void swap(_bplus_tree& tree) noexcept(_alloc_wrapper::is_nothrow_swap())
+    // frees a subtree cut out of the tree and takes its values off _values_count
+    void destroy_node(_node_type* node, uint32_t depth)
     {
-        if (_root_node == nullptr)
+        size_t values_count = _values_count - (_shared_nodes? count_values(node, depth) : 0);
+
+        if (!drop_shared_node(node))
         {
-            if (tree._root_node != nullptr)
+            clear_node(node, depth);
+            deallocate_node(node, depth);
+        }
+
+        if (_shared_nodes)
+        {
+            _values_count = values_count;
+        }
+    }
+
+    // frees the root and everything under it, only the references to the nodes shared with other trees are dropped
+    void release_root_node()
+    {
+        if (!drop_shared_node(_root_node))
+        {
+            clear_node(_root_node, _tree_height);
+            deallocate_root_node();
+        }
+    }
+
+    // a tree emptied by erase still has its root leaf, which is released here too
+    void clear() noexcept
+    {
+        if (_root_node != nullptr)
+        {
+            release_root_node();
+            _root_node = nullptr;
+
+            _values_count = 0;
+            _tree_height = 0;
+            _shared_nodes = false;
+        }
+    }
+
+    void clone_node(_node_type** dst_node_ptr, const _node_type* src_node, uint32_t depth,
+                    _node_type*& prev_leaf_node) noexcept
+    {
+        _node_type* dst_node = allocate_node(depth);
+
+        if (depth > 0)
+        {
+            uint32_t child_depth = depth - 1;
+            for (uint32_t i = 0; i < src_node->_count; ++i)
             {
-                _root_node = tree._root_node;
-                _values_count = tree._values_count;
-                _tree_height = tree._tree_height;
+                clone_node(dst_node->nodes() + i, src_node->nodes()[i], child_depth, prev_leaf_node);
+            }
 
-                tree._root_node = nullptr;
-                tree._values_count = 0;
-                tree._tree_height = 0;
+            if (__separator_keys)
+            {
+                std::memcpy((void*)separator_keys(dst_node),
+                            (const void*)separator_keys(src_node),
+                            src_node->_count * sizeof(_key_type));
+            }
+            else
+            {
+                dst_node->_ref_value = (*dst_node->nodes())->_ref_value;
+            }
+
+            if (__subtree_counts)
+            {
+                std::memcpy(subtree_counts(dst_node), subtree_counts(src_node), src_node->_count * sizeof(size_t));
+            }
+
+            if (__aggregates)
+            {
+                std::memcpy(slot_aggregates(dst_node), slot_aggregates(src_node), src_node->_count * sizeof(_aggregate_type));
             }
         }
-        else if (tree._root_node == nullptr)
+        else
+        {
+            copy_values(dst_node, src_node);
+
+            if (!__separator_keys)
+            {
+                dst_node->_ref_value = dst_node->values();
+            }
+
+            link_leaf(dst_node, prev_leaf_node, nullptr);
+            prev_leaf_node = dst_node;
+        }
+
+        dst_node->_count = src_node->_count;
+        *dst_node_ptr = dst_node;
+    }
+
+    void clone_root_node(const _node_type* root_node, uint32_t tree_height) noexcept
+    {
+        _root_node = allocate_root_node(root_node->_bucket_bysize);
+
+        if (tree_height > 0)
+        {
+            _node_type* prev_leaf_node = nullptr;
+            uint32_t child_depth = tree_height - 1;
+            for (uint32_t i = 0; i < root_node->_count; ++i)
+            {
+                clone_node(_root_node->nodes() + i, root_node->nodes()[i], child_depth, prev_leaf_node);
+            }
+
+            if (__separator_keys)
+            {
+                std::memcpy((void*)separator_keys(_root_node),
+                            (const void*)separator_keys(root_node),
+                            root_node->_count * sizeof(_key_type));
+            }
+
+            if (__subtree_counts)
+            {
+                std::memcpy(subtree_counts(_root_node), subtree_counts(root_node), root_node->_count * sizeof(size_t));
+            }
+
+            if (__aggregates)
+            {
+                std::memcpy(slot_aggregates(_root_node), slot_aggregates(root_node), root_node->_count * sizeof(_aggregate_type));
+            }
+        }
+        else
+        {
+            copy_values(_root_node, root_node);
+        }
+
+        _root_node->_count = root_node->_count;
+    }
+
+    // tree gets the nodes of this tree without copying any, they are shared by both from then on. the tree changing
+    // a node first copies it, and the nodes on the path from its root to it, then drops its references to the
+    // originals, so each tree keeps its content, and a tree written by one thread while another reads the other never
+    // touches the nodes the other can reach. the share counts are atomic, either tree may be destroyed on any thread.
+    void share_with(_bplus_tree& tree)
+    {
+        share_with(tree, std::integral_constant<bool, __leaf_links>());
+    }
+
+    void share_with(_bplus_tree& tree, std::false_type /*leaf_links*/)
+    {
+        tree.clear();
+
+        if (_values_count > 0)
         {
+            _root_node->_shares.fetch_add(1, std::memory_order_relaxed);
+
             tree._root_node = _root_node;
             tree._values_count = _values_count;
             tree._tree_height = _tree_height;
 
-            _root_node = nullptr;
+            _shared_nodes = tree._shared_nodes = true;
+            _unshare_path_of = tree._unshare_path_of = &unshare_path_of;
+        }
+    }
+
+    // leaves linked to their neighbours can't be shared, tree gets a copy of every node instead
+    void share_with(_bplus_tree& tree, std::true_type /*leaf_links*/)
+    {
+        tree = *this;
+    }
+
+    // drops the reference of this tree to a node and tells whether another tree still holds one, the tree dropping the
+    // last reference frees the node
+    bool drop_shared_node(_node_type* node) const noexcept
+    {
+        return _shared_nodes && node->_shares.load(std::memory_order_acquire) > 0 &&
+               node->_shares.fetch_sub(1, std::memory_order_acq_rel) > 0;
+    }
+
+    // a copy of a shared node, which takes a reference to each of its children. a leaf whose values throw while
+    // they're copied is freed again and node is left as it was.
+    _node_type* copy_shared_node(const _node_type* node, uint32_t depth, bool is_root)
+    {
+        _node_type* new_node = is_root? allocate_root_node(node->_bucket_bysize) : allocate_node(depth);
+
+        if (depth > 0)
+        {
+            for (uint32_t i = 0; i < node->_count; ++i)
+            {
+                new_node->nodes()[i] = node->nodes()[i];
+                node->nodes()[i]->_shares.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            if (__separator_keys)
+            {
+                std::memcpy((void*)separator_keys(new_node), (const void*)separator_keys(node), node->_count * sizeof(_key_type));
+            }
+            else if (!is_root)
+            {
+                new_node->_ref_value = node->_ref_value;
+            }
+
+            if (__subtree_counts)
+            {
+                std::memcpy(subtree_counts(new_node), subtree_counts(node), node->_count * sizeof(size_t));
+            }
+
+            if (__aggregates)
+            {
+                std::memcpy(slot_aggregates(new_node), slot_aggregates(node), node->_count * sizeof(_aggregate_type));
+            }
+        }
+        else
+        {
+            try
+            {
+                copy_values(new_node, node);
+            }
+            catch (...)
+            {
+                if (is_root)
+                {
+                    _awrapper.deallocate((uint8_t*)new_node, sizeof(_node_type) + new_node->_bucket_bysize);
+                }
+                else
+                {
+                    deallocate_node(new_node, depth);
+                }
+                throw;
+            }
+
+            if (!__separator_keys && !is_root)
+            {
+                new_node->_ref_value = new_node->values();
+            }
+        }
+
+        new_node->_count = node->_count;
+        return new_node;
+    }
+
+    void unshare_root_node()
+    {
+        if (_root_node->_shares.load(std::memory_order_acquire) > 0)
+        {
+            _node_type* new_root_node = copy_shared_node(_root_node, _tree_height, true);
+            size_t values_count = _values_count;
+
+            if (!drop_shared_node(_root_node))
+            {
+                clear_node(_root_node, _tree_height);
+                deallocate_root_node();
+            }
+
+            _root_node = new_root_node;
+            _values_count = values_count;
+        }
+    }
+
+    // the child in slot pos of node, which is owned by this tree alone, is copied when it's shared
+    void unshare_slot(_node_type* node, uint32_t pos, uint32_t depth)
+    {
+        _node_type* child_node = node->nodes()[pos];
+
+        if (child_node->_shares.load(std::memory_order_acquire) > 0)
+        {
+            node->nodes()[pos] = copy_shared_node(child_node, depth - 1, false);
+            size_t values_count = _values_count;
+
+            if (!drop_shared_node(child_node))
+            {
+                clear_node(child_node, depth - 1);
+                deallocate_node(child_node, depth - 1);
+            }
+
+            _values_count = values_count;
+        }
+    }
+
+    // the positions of the nodes on the path of it from the root down, then of its value in the leaf. they still
+    // lead to the same value after the nodes on the way were copied.
+    void path_slots(const _path& it, uint32_t* slots) const noexcept
+    {
+        for (uint32_t depth = 0; depth < _tree_height; ++depth)
+        {
+            _node_type* parent_node = (depth + 1 < _tree_height)? *it._stack[depth + 1] : _root_node;
+            slots[depth] = (uint32_t)(it._stack[depth] - parent_node->nodes());
+        }
+
+        slots[_tree_height] = (uint32_t)(it._value_ptr - it.leaf_node()->values());
+    }
+
+    // makes the nodes on the path of slots owned by this tree alone, with the siblings beside them when values or
+    // slots may be moved into or out of these, and points it at them. when a copy throws, the nodes copied before
+    // stay in the tree, the others stay shared, and it is pointed at its value through both.
+    void unshare_slots(_path& it, const uint32_t* slots, bool siblings)
+    {
+        unshare_root_node();
+
+        try
+        {
+            _node_type* cur_node = _root_node;
+
+            for (uint32_t depth = _tree_height; depth > 0; --depth)
+            {
+                uint32_t pos = slots[depth - 1];
+
+                unshare_slot(cur_node, pos, depth);
+
+                if (siblings && pos > 0)
+                {
+                    unshare_slot(cur_node, pos - 1, depth);
+                }
+                if (siblings && pos + 1 < cur_node->_count)
+                {
+                    unshare_slot(cur_node, pos + 1, depth);
+                }
+
+                cur_node = cur_node->nodes()[pos];
+            }
+        }
+        catch (...)
+        {
+            follow_slots(it, slots);
+            throw;
+        }
+
+        follow_slots(it, slots);
+    }
+
+    // points it at the slots from the root down, after some of the nodes on the way were copied
+    void follow_slots(_path& it, const uint32_t* slots) noexcept
+    {
+        _node_type* cur_node = _root_node;
+
+        for (uint32_t depth = _tree_height; depth > 0; --depth)
+        {
+            it._stack[depth - 1] = cur_node->nodes() + slots[depth - 1];
+            cur_node = *it._stack[depth - 1];
+        }
+
+        it._value_ptr = cur_node->values() + slots[_tree_height];
+
+        // the first values of the copied leaves are elsewhere, the internal nodes above refer to them
+        if (!__separator_keys)
+        {
+            for (uint32_t depth = 1; depth < _tree_height; ++depth)
+            {
+                _node_type* node = *it._stack[depth];
+                node->_ref_value = (*node->nodes())->_ref_value;
+            }
+        }
+    }
+
+    void unshare_path(_path& it, bool siblings)
+    {
+        uint32_t slots[_tree_height_max + 1];
+        path_slots(it, slots);
+        unshare_slots(it, slots, siblings);
+    }
+
+    // the slots of both paths are taken before either is unshared, copying the nodes of one moves the other
+    void unshare_paths(_path& first, _path& last)
+    {
+        uint32_t first_slots[_tree_height_max + 1];
+        uint32_t last_slots[_tree_height_max + 1];
+        path_slots(first, first_slots);
+        path_slots(last, last_slots);
+
+        unshare_slots(first, first_slots, true);
+        unshare_slots(last, last_slots, true);
+    }
+
+    // the value of it is written in place by the containers, it has to be in a leaf of this tree alone
+    template<typename _iterator_type>
+    void unshare_value(_iterator_type& it)
+    {
+        unshare_value(it, std::integral_constant<bool, __leaf_links>());
+    }
+
+    void unshare_value(_path& it, std::false_type /*leaf_links*/)
+    {
+        if (_shared_nodes && it._value_ptr != nullptr)
+        {
+            unshare_path(it, false);
+        }
+    }
+
+    template<typename _iterator_type>
+    void unshare_value(_iterator_type&, std::true_type /*leaf_links*/) noexcept {}
+
+    static void unshare_path_of(_base* tree, _path& it)
+    {
+        static_cast<_bplus_tree*>(tree)->unshare_path(it, false);
+    }
+
+    // the mutable iterators the containers hand out lead through nodes of this tree alone, so a value written through
+    // one never reaches a snapshot. they copy the nodes on their path again when they step into another leaf. only
+    // shared nodes are copied, an iterator made writable before stays valid, one taken before share_with() does not.
+    template<typename _iterator_type>
+    _iterator_type writable(_iterator_type it)
+    {
+        if (!std::is_const<typename std::remove_reference<typename _iterator_type::reference>::type>::value)
+        {
+            unshare_value(it);
+        }
+
+        return it;
+    }
+
+    template<typename _iterator_type>
+    std::pair<_iterator_type, bool> writable(std::pair<_iterator_type, bool> ret)
+    {
+        ret.first = writable(ret.first);
+        return ret;
+    }
+
+    template<typename _iterator_type>
+    std::pair<_iterator_type, _iterator_type> writable(std::pair<_iterator_type, _iterator_type> range)
+    {
+        if (!std::is_const<typename std::remove_reference<typename _iterator_type::reference>::type>::value)
+        {
+            unshare_values(range.first, range.second, std::integral_constant<bool, __leaf_links>());
+        }
+
+        return range;
+    }
+
+    // the slots of both are taken first, copying the nodes of one moves the other, as in unshare_paths()
+    void unshare_values(_path& first, _path& last, std::false_type /*leaf_links*/)
+    {
+        if (_shared_nodes)
+        {
+            uint32_t first_slots[_tree_height_max + 1];
+            uint32_t last_slots[_tree_height_max + 1];
+
+            if (first._value_ptr != nullptr)
+            {
+                path_slots(first, first_slots);
+            }
+            if (last._value_ptr != nullptr)
+            {
+                path_slots(last, last_slots);
+            }
+
+            if (first._value_ptr != nullptr)
+            {
+                unshare_slots(first, first_slots, false);
+            }
+            if (last._value_ptr != nullptr)
+            {
+                unshare_slots(last, last_slots, false);
+            }
+        }
+    }
+
+    template<typename _iterator_type>
+    void unshare_values(_iterator_type&, _iterator_type&, std::true_type /*leaf_links*/) noexcept {}
+
+    // copies all shared nodes, for the operations which move whole subtrees or the values of every leaf
+    void unshare_all()
+    {
+        if (_shared_nodes && _values_count > 0)
+        {
+            unshare_root_node();
+            unshare_subtree(_root_node, _tree_height);
+        }
+
+        _shared_nodes = false;
+    }
+
+    // the first value of node is taken again from its first child, also when a copy below throws
+    void unshare_subtree(_node_type* node, uint32_t depth)
+    {
+        if (depth > 0)
+        {
+            try
+            {
+                for (uint32_t i = 0; i < node->_count; ++i)
+                {
+                    unshare_slot(node, i, depth);
+                    unshare_subtree(node->nodes()[i], depth - 1);
+                }
+            }
+            catch (...)
+            {
+                if (!__separator_keys && node != _root_node)
+                {
+                    node->_ref_value = (*node->nodes())->_ref_value;
+                }
+                throw;
+            }
+
+            if (!__separator_keys && node != _root_node)
+            {
+                node->_ref_value = (*node->nodes())->_ref_value;
+            }
+        }
+    }
+
+    void move_data(_bplus_tree& tree, std::true_type)
+    {
+        drop_finger();
+        tree.drop_finger();
+
+        _root_node = tree._root_node;
+        _values_count = tree._values_count;
+        _tree_height = tree._tree_height;
+        _shared_nodes = tree._shared_nodes;
+        _unshare_path_of = tree._unshare_path_of;
+
+        tree._root_node = nullptr;
+        tree._values_count = 0;
+        tree._tree_height = 0;
+        tree._shared_nodes = false;
+    }
+
+    void move_data(_bplus_tree& tree, std::false_type)
+    {
+        if (_awrapper._alloc == tree._awrapper._alloc)
+        {
+            move_data(tree, std::true_type());
+        }
+        else if (tree._values_count > 0)
+        {
+            clone_root_node(tree._root_node, tree._tree_height);
+            _values_count = tree._values_count;
+            _tree_height = tree._tree_height;
+        }
+    }
+
+    _bplus_tree& operator = (const _bplus_tree& tree)
+    {
+        if (this != &tree)
+        {
+            clear();
+            _comp = tree._comp;
+
+            if (_alloc_wrapper::propagate_on_container_copy_assignment())
+            {
+                if (!_alloc_wrapper::allocator_always_compares_equal() &&
+                    _awrapper._alloc != tree._awrapper._alloc)
+                {
+                    _awrapper.copy_allocator(tree._awrapper._alloc);
+                }
+            }
+
+            if (tree._values_count > 0)
+            {
+                clone_root_node(tree._root_node, tree._tree_height);
+                _values_count = tree._values_count;
+                _tree_height = tree._tree_height;
+            }
+        }
+
+        return *this;
+    }
+
+    void move_assign(_bplus_tree& tree)
+    {
+        clear();
+        _comp = tree._comp;
+
+        if (_alloc_wrapper::propagate_on_container_move_assignment() ||
+            _alloc_wrapper::allocator_always_compares_equal() ||
+            _awrapper._alloc == tree._awrapper._alloc)
+        {
+            move_data(tree, std::true_type());
+            _awrapper.move_allocator(tree._awrapper._alloc);
+        }
+        else
+        {
+            move_values_from(tree, std::integral_constant<bool, __soa_leaves>());
+            tree.clear();
+        }
+    }
+
+    void move_values_from(_bplus_tree& tree, std::false_type /*soa_leaves*/)
+    {
+        insert_range(std::__make_move_if_noexcept_iterator(tree.begin()),
+                     std::__make_move_if_noexcept_iterator(tree.end()));
+    }
+
+    // the iterators of the tree only reach the keys of soa leaves
+    void move_values_from(_bplus_tree& tree, std::true_type /*soa_leaves*/)
+    {
+        if (tree._values_count > 0)
+        {
+            clone_root_node(tree._root_node, tree._tree_height);
+            _values_count = tree._values_count;
+            _tree_height = tree._tree_height;
+        }
+    }
+
+    void swap(_bplus_tree& tree) noexcept(_alloc_wrapper::is_nothrow_swap())
+    {
+        drop_finger();
+        tree.drop_finger();
+
+        if (_root_node == nullptr)
+        {
+            if (tree._root_node != nullptr)
+            {
+                _root_node = tree._root_node;
+                _values_count = tree._values_count;
+                _tree_height = tree._tree_height;
+
+                tree._root_node = nullptr;
+                tree._values_count = 0;
+                tree._tree_height = 0;
+            }
+        }
+        else if (tree._root_node == nullptr)
+        {
+            tree._root_node = _root_node;
+            tree._values_count = _values_count;
+            tree._tree_height = _tree_height;
+
+            _root_node = nullptr;
+            _values_count = 0;
+            _tree_height = 0;
+        }
+        else
+        {
+            std::swap(_root_node, tree._root_node);
+            std::swap(_values_count, tree._values_count);
+            std::swap(_tree_height, tree._tree_height);
+        }
+
+        std::swap(_shared_nodes, tree._shared_nodes);
+        std::swap(_unshare_path_of, tree._unshare_path_of);
+
+        std::swap(_comp, tree._comp);
+        _awrapper.swap_allocator(tree._awrapper._alloc);
+    }
+
+    // the arguments may be anything the key extractor accepts, e.g. the pairs inserted into a soa tree
+    template<typename _x, typename _y>
+    bool value_compare(const _x& x, const _y& y) const
+    { return _comp(_key_of_value()(x), _key_of_value()(y)); }
+
+    // lookups take any key type _kt the comparator accepts along with _key_type, see is_transparent in the
+    // containers. a _kt key must be equivalent to one _key_type key at most, like a string_view to a string.
+    template<typename _kt>
+    bool key_less(const _kt& key, const _value_type& x) const
+    { return _comp(key, _key_of_value()(x)); }
+
+    template<typename _kt>
+    bool key_larger(const _kt& key, const _value_type& x) const
+    { return _comp(_key_of_value()(x), key); }
+
+    // the simd searches load the key into vector registers, they are only taken for keys of _key_type itself
+    template<typename _kt>
+    using _simd_search_values_for = std::integral_constant<bool, __simd_search_values && std::is_same<_kt, _key_type>::value>;
+
+    template<typename _kt>
+    using _simd_search_keys_for = std::integral_constant<bool, __simd_search_keys && std::is_same<_kt, _key_type>::value>;
+
+    _key_type* separator_keys(const _node_type* node) const noexcept
+    { return (_key_type*)((uint8_t*)node->nodes() + __separator_keys_offset); }
+
+    // only valid for a node which was just split out, it's used as the separator of the node in its parent
+    const _key_type& split_node_key(const _node_type* node, uint32_t depth) const noexcept
+    { return (depth > 0)? *separator_keys(node) : _key_of_value()(*node->values()); }
+
+    size_t* subtree_counts(const _node_type* node) const noexcept
+    { return (size_t*)((uint8_t*)node->nodes() + __subtree_counts_offset); }
+
+    // the number of values under the child in slot pos of an internal node, walked when the counts aren't kept
+    size_t slot_count(const _node_type* node, uint32_t pos, uint32_t depth) const noexcept
+    { return __subtree_counts? subtree_counts(node)[pos] : count_values(node->nodes()[pos], depth - 1); }
+
+    size_t count_values(const _node_type* node, uint32_t depth) const noexcept
+    {
+        if (depth == 0)
+        {
+            return node->_count;
+        }
+
+        size_t count = 0;
+        for (uint32_t i = 0; i < node->_count; ++i)
+        {
+            count += slot_count(node, i, depth);
+        }
+
+        return count;
+    }
+
+    // adds delta to the counts of all slots on the path of stack
+    void add_subtree_counts(_node_type*** stack, ptrdiff_t delta) noexcept
+    {
+        if (__subtree_counts)
+        {
+            for (uint32_t depth = 0; depth < _tree_height; ++depth)
+            {
+                _node_type* parent_node = (depth + 1 < _tree_height)? *stack[depth + 1] : _root_node;
+                subtree_counts(parent_node)[stack[depth] - parent_node->nodes()] += delta;
+            }
+        }
+    }
+
+    _aggregate_type* slot_aggregates(const _node_type* node) const noexcept
+    { return (_aggregate_type*)((uint8_t*)node->nodes() + __aggregates_offset); }
+
+    _aggregate_type value_aggregate(const _value_type& value, std::true_type /*aggregates*/) const
+    { return _monoid_type().lift(value.first, value.second); }
+
+    _aggregate_type value_aggregate(const _value_type&, std::false_type /*aggregates*/) const
+    { return _monoid_type().identity(); }
+
+    // combines the values in [first, last) of a leaf or the aggregates of the slots in [first, last) of an internal node
+    _aggregate_type aggregate_range(const _node_type* node, uint32_t depth, uint32_t first, uint32_t last) const
+    {
+        _monoid_type monoid;
+        _aggregate_type aggregate = monoid.identity();
+
+        for (uint32_t i = first; i < last; ++i)
+        {
+            aggregate = monoid.combine(aggregate, (depth > 0)? slot_aggregates(node)[i] :
+                                                               value_aggregate(node->values()[i], std::integral_constant<bool, __aggregates>()));
+        }
+
+        return aggregate;
+    }
+
+    // recomputes the aggregate of the child in slot pos of an internal node at depth
+    void refresh_aggregate(_node_type* node, uint32_t pos, uint32_t depth) noexcept
+    {
+        if (__aggregates)
+        {
+            _node_type* child_node = node->nodes()[pos];
+            slot_aggregates(node)[pos] = aggregate_range(child_node, depth - 1, 0, child_node->_count);
+        }
+    }
+
+    // recomputes the aggregates of the slots on the path of stack from from_depth up
+    void refresh_aggregates(_node_type** const* stack, uint32_t from_depth) noexcept
+    {
+        if (__aggregates)
+        {
+            for (uint32_t depth = from_depth; depth < _tree_height; ++depth)
+            {
+                _node_type* parent_node = (depth + 1 < _tree_height)? *stack[depth + 1] : _root_node;
+                refresh_aggregate(parent_node, (uint32_t)(stack[depth] - parent_node->nodes()), depth + 1);
+            }
+        }
+    }
+
+    // recounts slot pos of an internal node at depth whose child has changed
+    void refresh_slot(_node_type* node, uint32_t pos, uint32_t depth) noexcept
+    {
+        if (__subtree_counts)
+        {
+            subtree_counts(node)[pos] = count_values(node->nodes()[pos], depth - 1);
+        }
+
+        refresh_aggregate(node, pos, depth);
+    }
+
+    // recounts the slots on two paths bottom up after a change whose delta isn't known per level, the paths are
+    // walked together since a node on one of them may have a child on the other
+    void refresh_slots(_node_type** const* stack_1, _node_type** const* stack_2) noexcept
+    {
+        if (__subtree_counts || __aggregates)
+        {
+            for (uint32_t depth = 0; depth < _tree_height; ++depth)
+            {
+                _node_type* parent_node = (depth + 1 < _tree_height)? *stack_1[depth + 1] : _root_node;
+                refresh_slot(parent_node, (uint32_t)(stack_1[depth] - parent_node->nodes()), depth + 1);
+
+                parent_node = (depth + 1 < _tree_height)? *stack_2[depth + 1] : _root_node;
+                refresh_slot(parent_node, (uint32_t)(stack_2[depth] - parent_node->nodes()), depth + 1);
+            }
+        }
+    }
+
+    // the child in slot pos + 1 of an internal node at depth was merged into the one in slot pos
+    void refresh_merged_slot(_node_type* node, uint32_t pos, uint32_t depth) noexcept
+    {
+        if (__subtree_counts)
+        {
+            subtree_counts(node)[pos] += subtree_counts(node)[pos + 1];
+        }
+
+        refresh_aggregate(node, pos, depth);
+    }
+
+    void move_slots(_node_type* dst_node, uint32_t dst_pos,
+                    const _node_type* src_node, uint32_t src_pos, uint32_t count) noexcept
+    {
+        std::memmove(dst_node->nodes() + dst_pos, src_node->nodes() + src_pos, count * sizeof(_node_type*));
+
+        if (__separator_keys)
+        {
+            std::memmove((void*)(separator_keys(dst_node) + dst_pos),
+                         (const void*)(separator_keys(src_node) + src_pos),
+                         count * sizeof(_key_type));
+        }
+
+        if (__subtree_counts)
+        {
+            std::memmove(subtree_counts(dst_node) + dst_pos, subtree_counts(src_node) + src_pos, count * sizeof(size_t));
+        }
+
+        if (__aggregates)
+        {
+            std::memmove(slot_aggregates(dst_node) + dst_pos, slot_aggregates(src_node) + src_pos,
+                         count * sizeof(_aggregate_type));
+        }
+    }
+
+    void set_slot(_node_type* node, uint32_t pos, _node_type* child_node, uint32_t child_depth) noexcept
+    {
+        node->nodes()[pos] = child_node;
+
+        if (__separator_keys)
+        {
+            separator_keys(node)[pos] = split_node_key(child_node, child_depth);
+        }
+
+        if (__subtree_counts)
+        {
+            subtree_counts(node)[pos] = count_values(child_node, child_depth);
+        }
+
+        if (__aggregates)
+        {
+            slot_aggregates(node)[pos] = aggregate_range(child_node, child_depth, 0, child_node->_count);
+        }
+    }
+
+    // appends all slots of src_node to dst_node, the separator of src_node is pulled down from parent_node
+    void merge_slots(_node_type* dst_node, const _node_type* src_node,
+                     const _node_type* parent_node, uint32_t src_node_pos) noexcept
+    {
+        move_slots(dst_node, dst_node->_count, src_node, 0, src_node->_count);
+
+        if (__separator_keys)
+        {
+            separator_keys(dst_node)[dst_node->_count] = separator_keys(parent_node)[src_node_pos];
+        }
+    }
+
+    // a hinted insertion may put a new minimum into a leaf, so its separator has to follow the new value
+    void update_separator(_node_type*** stack, const _key_type& key) noexcept
+    {
+        for (uint32_t depth = 0; depth < _tree_height; ++depth)
+        {
+            _node_type* parent_node = (depth + 1 < _tree_height)? *stack[depth + 1] : _root_node;
+            uint32_t node_pos = (uint32_t)(stack[depth] - parent_node->nodes());
+
+            if (node_pos > 0)
+            {
+                separator_keys(parent_node)[node_pos] = key;
+                return;
+            }
+        }
+    }
+
+    uint32_t search_child(const _key_type& key, const _node_type* node, std::true_type /*simd_search*/) const
+    {
+        const _key_type* first_key = separator_keys(node) + 1;
+
+        return (uint32_t)(_simd_search<_key_type>::upper_bound(first_key, node->_count - 1, key) - first_key);
+    }
+
+    template<typename _kt>
+    uint32_t search_child(const _kt& key, const _node_type* node, std::false_type /*simd_search*/) const
+    {
+        if (__separator_keys)
+        {
+            const _key_type* key_ptr = separator_keys(node) + 1;
+            uint32_t check_keys_count = node->_count - 1;
+
+            while (check_keys_count > 0)
+            {
+                uint32_t step = check_keys_count >> 1;
+
+                bool key_not_less_than = !_comp(key, key_ptr[step]);
+
+                check_keys_count = (check_keys_count - key_not_less_than) >> 1;
+                key_ptr += (step + 1) * key_not_less_than;
+            }
+
+            return (uint32_t)(key_ptr - (separator_keys(node) + 1));
+        }
+        else
+        {
+            uint32_t check_nodes_count = node->_count;
+            _node_type** node_ptr = node->nodes();
+
+            do
+            {
+                uint32_t step = check_nodes_count >> 1;
+
+                bool key_not_less_than = !key_less(key, *(node_ptr[step]->_ref_value));
+
+                check_nodes_count = (check_nodes_count + key_not_less_than) >> 1;
+                node_ptr += step * key_not_less_than;
+            }
+            while (check_nodes_count > 1);
+
+            return (uint32_t)(node_ptr - node->nodes());
+        }
+    }
+
+    template<typename _kt>
+    uint32_t search_child(const _kt& key, const _node_type* node) const
+    { return search_child(key, node, _simd_search_keys_for<_kt>()); }
+
+    // the last child whose lower bound is less than key, it holds the first of the values equal to key or is followed
+    // by it. only the trees keeping equal keys need it.
+    uint32_t search_child_lower(const _key_type& key, const _node_type* node, std::true_type /*simd_search*/) const
+    {
+        const _key_type* first_key = separator_keys(node) + 1;
+
+        return (uint32_t)(_simd_search<_key_type>::lower_bound(first_key, node->_count - 1, key) - first_key);
+    }
+
+    template<typename _kt>
+    uint32_t search_child_lower(const _kt& key, const _node_type* node, std::false_type /*simd_search*/) const
+    {
+        if (__separator_keys)
+        {
+            const _key_type* key_ptr = separator_keys(node) + 1;
+            uint32_t check_keys_count = node->_count - 1;
+
+            while (check_keys_count > 0)
+            {
+                uint32_t step = check_keys_count >> 1;
+
+                bool key_larger_than = _comp(key_ptr[step], key);
+
+                check_keys_count = (check_keys_count - key_larger_than) >> 1;
+                key_ptr += (step + 1) * key_larger_than;
+            }
+
+            return (uint32_t)(key_ptr - (separator_keys(node) + 1));
+        }
+        else
+        {
+            uint32_t check_nodes_count = node->_count;
+            _node_type** node_ptr = node->nodes();
+
+            do
+            {
+                uint32_t step = check_nodes_count >> 1;
+
+                bool key_larger_than = key_larger(key, *(node_ptr[step]->_ref_value));
+
+                check_nodes_count = (check_nodes_count + key_larger_than) >> 1;
+                node_ptr += step * key_larger_than;
+            }
+            while (check_nodes_count > 1);
+
+            return (uint32_t)(node_ptr - node->nodes());
+        }
+    }
+
+    template<typename _kt>
+    uint32_t search_child_lower(const _kt& key, const _node_type* node) const
+    { return search_child_lower(key, node, _simd_search_keys_for<_kt>()); }
+
+    _value_type* search_value(const _key_type& key, const _node_type* node, std::true_type /*simd_search*/) const
+    { return (_value_type*)_simd_search<_key_type>::lower_bound((const _key_type*)node->values(), node->_count, key); }
+
+    template<typename _kt>
+    _value_type* search_value(const _kt& key, const _node_type* node, std::false_type /*simd_search*/) const
+    {
+        uint32_t check_values_count = node->_count;
+        _value_type* value_ptr = node->values();
+
+        do
+        {
+            uint32_t step = check_values_count >> 1;
+
+            bool key_larger_than = key_larger(key, value_ptr[step]);
+
+            check_values_count = (check_values_count - key_larger_than) >> 1;
+            value_ptr += (step + 1) * key_larger_than;
+        }
+        while (check_values_count > 0);
+
+        return value_ptr;
+    }
+
+    // the first value larger than key
+    _value_type* search_value_upper(const _key_type& key, const _node_type* node, std::true_type /*simd_search*/) const
+    { return (_value_type*)_simd_search<_key_type>::upper_bound((const _key_type*)node->values(), node->_count, key); }
+
+    template<typename _kt>
+    _value_type* search_value_upper(const _kt& key, const _node_type* node, std::false_type /*simd_search*/) const
+    {
+        uint32_t check_values_count = node->_count;
+        _value_type* value_ptr = node->values();
+
+        do
+        {
+            uint32_t step = check_values_count >> 1;
+
+            bool key_not_less_than = !key_less(key, value_ptr[step]);
+
+            check_values_count = (check_values_count - key_not_less_than) >> 1;
+            value_ptr += (step + 1) * key_not_less_than;
+        }
+        while (check_values_count > 0);
+
+        return value_ptr;
+    }
+
+    void prefetch_node(const _node_type* node, uint32_t depth) const noexcept
+    {
+        if (XXFL_BPLUS_TREE_PREFETCH_DESCENT)
+        {
+            prefetch_search_area(node, depth);
+        }
+    }
+
+    void prefetch_search_area(const _node_type* node, uint32_t depth) const noexcept
+    {
+        if (depth == 0)
+        {
+            _prefetch_range(node, sizeof(_node_type) + __bucket_values_capacity_max * sizeof(_value_type));
+        }
+        else if (__separator_keys)
+        {
+            _prefetch_range(node, sizeof(_node_type));
+            _prefetch_range(separator_keys(node), __bucket_nodes_capacity_max * sizeof(_key_type));
+        }
+        else
+        {
+            _prefetch_range(node, sizeof(_node_type) + __bucket_nodes_capacity_max * sizeof(_node_type*));
+        }
+    }
+
+    template<typename _kt>
+    _value_type* lower_bound_core(const _kt& key,
+                                  _node_type*** stack,
+                                  _node_type*& cur_node) const
+    {
+        if (load_finger(key, stack, cur_node))
+        {
+            return search_value(key, cur_node, _simd_search_values_for<_kt>());
+        }
+
+        cur_node = _root_node;
+
+        for (uint32_t depth = _tree_height - 1; depth != (uint32_t)-1; --depth)
+        {
+            _node_type** node_ptr = cur_node->nodes() + (__equal_keys? search_child_lower(key, cur_node) :
+                                                                         search_child(key, cur_node));
+
+            stack[depth] = node_ptr;
+            cur_node = *node_ptr;
+
+            prefetch_node(cur_node, depth);
+        }
+
+        store_finger(stack, cur_node);
+
+        return search_value(key, cur_node, _simd_search_values_for<_kt>());
+    }
+
+    // the position after the last value not larger than key, where the trees keeping equal keys insert a value. like
+    // the lower bound it may be the end of a leaf.
+    template<typename _kt>
+    _value_type* upper_bound_core(const _kt& key,
+                                  _node_type*** stack,
+                                  _node_type*& cur_node) const
+    {
+        cur_node = _root_node;
+
+        for (uint32_t depth = _tree_height - 1; depth != (uint32_t)-1; --depth)
+        {
+            _node_type** node_ptr = cur_node->nodes() + search_child(key, cur_node);
+
+            stack[depth] = node_ptr;
+            cur_node = *node_ptr;
+
+            prefetch_node(cur_node, depth);
+        }
+
+        return search_value_upper(key, cur_node, _simd_search_values_for<_kt>());
+    }
+
+    template<typename _output_iterator, typename _kt>
+    _output_iterator find(const _kt& key) const
+    {
+        _path_for<_output_iterator> it(const_cast<_bplus_tree*>(this));
+
+        if (_values_count > 0)
+        {
+            _node_type* cur_node;
+            it._value_ptr = lower_bound_core(key, it._stack, cur_node);
+
+            // the first of equal keys may begin the next leaf
+            if (__equal_keys && it._value_ptr == cur_node->values_end())
+            {
+                it.cross_node_increment();
+
+                if (it._value_ptr != nullptr && !key_less(key, *it._value_ptr))
+                {
+                    return it;
+                }
+            }
+            else if (it._value_ptr != cur_node->values_end() && !key_less(key, *it._value_ptr))
+            {
+                return it;
+            }
+        }
+
+        it._value_ptr = nullptr;
+        return it;
+    }
+
+    // looks up a group of keys together, each level is searched for all of them before going down, and the nodes of
+    // the next level are prefetched meanwhile, so the cache misses of the group overlap instead of adding up
+    template<typename _output_iterator, typename _forward_iterator, typename _result_iterator>
+    _result_iterator find_batch(_forward_iterator first, _forward_iterator last, _result_iterator out) const
+    {
+        const uint32_t group_size_max = XXFL_BPLUS_TREE_FIND_BATCH_GROUP_SIZE;
+
+        _path_for<_output_iterator> group_paths[group_size_max];
+        _node_type* group_nodes[group_size_max];
+        _forward_iterator group_keys[group_size_max];
+
+        while (first != last)
+        {
+            uint32_t group_size = 0;
+
+            for (; first != last && group_size < group_size_max; ++first, ++group_size)
+            {
+                group_paths[group_size] = _path_for<_output_iterator>(const_cast<_bplus_tree*>(this));
+                group_nodes[group_size] = _root_node;
+                group_keys[group_size] = first;
+            }
+
+            if (_values_count == 0)
+            {
+                for (uint32_t i = 0; i < group_size; ++i, ++out)
+                {
+                    group_paths[i]._value_ptr = nullptr;
+                    *out = _output_iterator(group_paths[i]);
+                }
+
+                continue;
+            }
+
+            for (uint32_t depth = _tree_height - 1; depth != (uint32_t)-1; --depth)
+            {
+                for (uint32_t i = 0; i < group_size; ++i)
+                {
+                    _node_type** node_ptr = group_nodes[i]->nodes() + search_child(*group_keys[i], group_nodes[i]);
+
+                    group_paths[i]._stack[depth] = node_ptr;
+                    group_nodes[i] = *node_ptr;
+
+                    prefetch_search_area(group_nodes[i], depth);
+                }
+            }
+
+            for (uint32_t i = 0; i < group_size; ++i, ++out)
+            {
+                const _key_type& key = *group_keys[i];
+                _value_type* value_ptr = search_value(key, group_nodes[i], std::integral_constant<bool, __simd_search_values>());
+
+                if (value_ptr == group_nodes[i]->values_end() || key_less(key, *value_ptr))
+                {
+                    value_ptr = nullptr;
+                }
+
+                group_paths[i]._value_ptr = value_ptr;
+
+                *out = _output_iterator(group_paths[i]);
+            }
+        }
+
+        return out;
+    }
+
+    template<typename _forward_iterator, typename _result_iterator>
+    _result_iterator contains_batch(_forward_iterator first, _forward_iterator last, _result_iterator out) const
+    {
+        const uint32_t group_size_max = XXFL_BPLUS_TREE_FIND_BATCH_GROUP_SIZE;
+
+        _node_type* group_nodes[group_size_max];
+        _forward_iterator group_keys[group_size_max];
+
+        while (first != last)
+        {
+            uint32_t group_size = 0;
+
+            for (; first != last && group_size < group_size_max; ++first, ++group_size)
+            {
+                group_nodes[group_size] = _root_node;
+                group_keys[group_size] = first;
+            }
+
+            if (_values_count == 0)
+            {
+                for (uint32_t i = 0; i < group_size; ++i, ++out)
+                {
+                    *out = false;
+                }
+
+                continue;
+            }
+
+            for (uint32_t depth = _tree_height - 1; depth != (uint32_t)-1; --depth)
+            {
+                for (uint32_t i = 0; i < group_size; ++i)
+                {
+                    group_nodes[i] = group_nodes[i]->nodes()[search_child(*group_keys[i], group_nodes[i])];
+
+                    prefetch_search_area(group_nodes[i], depth);
+                }
+            }
+
+            for (uint32_t i = 0; i < group_size; ++i, ++out)
+            {
+                const _key_type& key = *group_keys[i];
+                _value_type* value_ptr = search_value(key, group_nodes[i], std::integral_constant<bool, __simd_search_values>());
+
+                *out = (value_ptr != group_nodes[i]->values_end() && !key_less(key, *value_ptr));
+            }
+        }
+
+        return out;
+    }
+
+    template<typename _output_iterator, typename _kt>
+    _output_iterator lower_bound(const _kt& key) const
+    {
+        _path_for<_output_iterator> it(const_cast<_bplus_tree*>(this));
+
+        if (_values_count > 0)
+        {
+            _node_type* cur_node;
+            it._value_ptr = lower_bound_core(key, it._stack, cur_node);
+
+            if (it._value_ptr == cur_node->values_end())
+            {
+                it.cross_node_increment();
+            }
+        }
+        else
+        {
+            it._value_ptr = nullptr;
+        }
+
+        return it;
+    }
+
+    template<typename _output_iterator, typename _kt>
+    _output_iterator upper_bound(const _kt& key) const
+    {
+        _path_for<_output_iterator> it(const_cast<_bplus_tree*>(this));
+
+        if (_values_count > 0)
+        {
+            _node_type* cur_node;
+            it._value_ptr = __equal_keys? upper_bound_core(key, it._stack, cur_node) :
+                                          lower_bound_core(key, it._stack, cur_node);
+
+            if (it._value_ptr == cur_node->values_end())
+            {
+                it.cross_node_increment();
+            }
+            else if (!__equal_keys && !key_less(key, *it._value_ptr))
+            {
+                it.increment();
+            }
+        }
+        else
+        {
+            it._value_ptr = nullptr;
+        }
+
+        return it;
+    }
+
+    template<typename _output_iterator, typename _kt>
+    std::pair<_output_iterator, _output_iterator> equal_range(const _kt& key) const
+    {
+        if (__equal_keys)
+        {
+            return std::pair<_output_iterator, _output_iterator>(lower_bound<_output_iterator>(key),
+                                                                 upper_bound<_output_iterator>(key));
+        }
+
+        _output_iterator it1 = lower_bound<_output_iterator>(key);
+        _output_iterator it2(it1);
+
+        if (it2._value_ptr != nullptr && !key_less(key, *it2._value_ptr))
+        {
+            it2.increment();
+        }
+
+        return std::pair<_output_iterator, _output_iterator>(it1, it2);
+    }
+
+    // calls f(leaf, first_pos, last_pos) for each leaf from the one of first on, with the positions of its values up to
+    // last_pos of last_node, or up to the end of the tree when last_node is null. the leaves are reached by crossing
+    // nodes on the path of first, the values of a leaf are handed over as one block. f must not change the tree.
+    template<typename _function>
+    void for_each_leaf_core(_path first, const _node_type* last_node, uint32_t last_pos, _function& f) const
+    {
+        for (;;)
+        {
+            _node_type* cur_node = first.leaf_node();
+            uint32_t first_pos = (uint32_t)(first._value_ptr - cur_node->values());
+
+            if (cur_node == last_node)
+            {
+                if (first_pos < last_pos)
+                {
+                    f((const _node_type*)cur_node, first_pos, last_pos);
+                }
+
+                return;
+            }
+
+            if (first_pos < cur_node->_count)
+            {
+                f((const _node_type*)cur_node, first_pos, cur_node->_count);
+            }
+
+            first.cross_node_increment();
+
+            if (first._value_ptr == nullptr)
+            {
+                return;
+            }
+        }
+    }
+
+    template<typename _function>
+    void for_each_leaf(_function&& f) const
+    {
+        if (_values_count > 0)
+        {
+            _path first(const_cast<_bplus_tree*>(this));
+            first.set_first();
+
+            for_each_leaf_core(first, nullptr, 0, f);
+        }
+    }
+
+    // the leaves of the values not less than lower_key and less than upper_key
+    template<typename _kt1, typename _kt2, typename _function>
+    void for_each_leaf_range(const _kt1& lower_key, const _kt2& upper_key, _function&& f) const
+    {
+        if (_values_count == 0 || !_comp(lower_key, upper_key))
+        {
+            return;
+        }
+
+        _path first(const_cast<_bplus_tree*>(this));
+        _path last(const_cast<_bplus_tree*>(this));
+        _node_type* lower_node;
+        _node_type* upper_node;
+
+        first._value_ptr = lower_bound_core(lower_key, first._stack, lower_node);
+        uint32_t last_pos = (uint32_t)(lower_bound_core(upper_key, last._stack, upper_node) - upper_node->values());
+
+        for_each_leaf_core(first, upper_node, last_pos, f);
+    }
+
+    // the callbacks of for_each_leaf behind the for_each functions of the containers. _value_caller calls f(value)
+    // for each value, _span_caller f(first, last) for the values of each leaf, soa leaves hand over the key and the
+    // mapped value, or the keys and the first mapped value, side by side.
+    template<typename _function>
+    struct _value_caller
+    {
+        _function& _f;
+
+        explicit _value_caller(_function& f) : _f(f) {}
+
+        void operator () (const _node_type* node, uint32_t first_pos, uint32_t last_pos) const
+        { call(node, first_pos, last_pos, std::integral_constant<bool, __soa_leaves>()); }
+
+        void call(const _node_type* node, uint32_t first_pos, uint32_t last_pos, std::false_type /*soa_leaves*/) const
+        {
+            const _value_type* last = node->values() + last_pos;
+
+            for (const _value_type* value_ptr = node->values() + first_pos; value_ptr != last; ++value_ptr)
+            {
+                _f(*value_ptr);
+            }
+        }
+
+        void call(const _node_type* node, uint32_t first_pos, uint32_t last_pos, std::true_type /*soa_leaves*/) const
+        {
+            const _value_type* keys = node->values();
+            const _mapped_type* mapped_values = _bplus_tree::mapped_values(node);
+
+            for (uint32_t i = first_pos; i < last_pos; ++i)
+            {
+                _f(keys[i], mapped_values[i]);
+            }
+        }
+    };
+
+    template<typename _function>
+    struct _span_caller
+    {
+        _function& _f;
+
+        explicit _span_caller(_function& f) : _f(f) {}
+
+        void operator () (const _node_type* node, uint32_t first_pos, uint32_t last_pos) const
+        { call(node, first_pos, last_pos, std::integral_constant<bool, __soa_leaves>()); }
+
+        void call(const _node_type* node, uint32_t first_pos, uint32_t last_pos, std::false_type /*soa_leaves*/) const
+        { _f((const _value_type*)node->values() + first_pos, (const _value_type*)node->values() + last_pos); }
+
+        void call(const _node_type* node, uint32_t first_pos, uint32_t last_pos, std::true_type /*soa_leaves*/) const
+        {
+            _f((const _value_type*)node->values() + first_pos, (const _value_type*)node->values() + last_pos,
+               (const _mapped_type*)_bplus_tree::mapped_values(node) + first_pos);
+        }
+    };
+
+    template<typename _function>
+    void for_each_value(_function& f) const
+    { for_each_leaf(_value_caller<_function>(f)); }
+
+    template<typename _kt1, typename _kt2, typename _function>
+    void for_each_value_range(const _kt1& lower_key, const _kt2& upper_key, _function& f) const
+    { for_each_leaf_range(lower_key, upper_key, _value_caller<_function>(f)); }
+
+    template<typename _function>
+    void for_each_value_span(_function& f) const
+    { for_each_leaf(_span_caller<_function>(f)); }
+
+    template<typename _kt1, typename _kt2, typename _function>
+    void for_each_value_span_range(const _kt1& lower_key, const _kt2& upper_key, _function& f) const
+    { for_each_leaf_range(lower_key, upper_key, _span_caller<_function>(f)); }
+
+    // a run of values for the parallel functions of xxfl_parallel.h, from first up to last_pos of last_node as
+    // for_each_leaf_core takes them
+    struct _partition
+    {
+        _path _first;
+        _node_type* _last_node;
+        uint32_t _last_pos;
+
+        explicit _partition(const _path& first) noexcept : _first(first), _last_node(nullptr), _last_pos(0) {}
+    };
+
+    // cuts the values with keys in [lower_key, upper_key), all of them when the keys are null, into count runs at
+    // most. the runs begin at the first values of subtrees: the ones under the root, or the ones of the first level
+    // down with count subtrees at least, which are grouped in turn to even out the runs. cutting needs a descent for
+    // each run but no counting.
+    template<typename _kt1, typename _kt2>
+    void partitions(const _kt1* lower_key, const _kt2* upper_key, size_t count, std::vector<_partition>& parts) const
+    {
+        if (_values_count == 0 || (lower_key != nullptr && upper_key != nullptr && !_comp(*lower_key, *upper_key)))
+        {
+            return;
+        }
+
+        std::vector<const _node_type*> nodes(1, _root_node);
+        uint32_t depth = _tree_height;
+
+        while (depth > 0 && nodes.size() < count)
+        {
+            std::vector<const _node_type*> child_nodes;
+
+            for (const _node_type* node : nodes)
+            {
+                child_nodes.insert(child_nodes.end(), node->nodes(), node->nodes_end());
+            }
+
+            nodes.swap(child_nodes);
+            --depth;
+        }
+
+        _path first(const_cast<_bplus_tree*>(this));
+        _node_type* cur_node;
+
+        if (lower_key != nullptr)
+        {
+            first._value_ptr = lower_bound_core(*lower_key, first._stack, cur_node);
+        }
+        else
+        {
+            first.set_first();
+        }
+
+        parts.push_back(_partition(first));
+
+        size_t runs_count = std::min(count, nodes.size());
+        for (size_t i = 1; i < runs_count; ++i)
+        {
+            const _node_type* node = nodes[i * nodes.size() / runs_count];
+            for (uint32_t cur_depth = depth; cur_depth > 0; --cur_depth)
+            {
+                node = *node->nodes();
+            }
+
+            const _value_type& cut_value = *node->values();
+            if ((lower_key == nullptr || !key_larger(*lower_key, cut_value)) &&
+                (upper_key == nullptr || key_larger(*upper_key, cut_value)))
+            {
+                // with equal keys the descent may stop before the subtree, still in order
+                first._value_ptr = lower_bound_core(_key_of_value()(cut_value), first._stack, cur_node);
+
+                parts.back()._last_node = cur_node;
+                parts.back()._last_pos = (uint32_t)(first._value_ptr - cur_node->values());
+                parts.push_back(_partition(first));
+            }
+        }
+
+        if (upper_key != nullptr)
+        {
+            _path last(const_cast<_bplus_tree*>(this));
+            _value_type* last_value_ptr = lower_bound_core(*upper_key, last._stack, cur_node);
+
+            parts.back()._last_node = cur_node;
+            parts.back()._last_pos = (uint32_t)(last_value_ptr - cur_node->values());
+        }
+    }
+
+    // compares the values of two trees a span at a time, the overlap of the current leaves of both is compared in
+    // one go instead of stepping two iterators. the mapped values of soa leaves are compared after the keys.
+    bool equal_values(const _bplus_tree& tree) const
+    {
+        if (_values_count != tree._values_count)
+        {
+            return false;
+        }
+        else if (_values_count == 0)
+        {
+            return true;
+        }
+
+        _path x(const_cast<_bplus_tree*>(this));
+        _path y(const_cast<_bplus_tree*>(&tree));
+        x.set_first();
+        y.set_first();
+
+        for (;;)
+        {
+            _node_type* x_node = x.leaf_node();
+            _node_type* y_node = y.leaf_node();
+            uint32_t x_pos = (uint32_t)(x._value_ptr - x_node->values());
+            uint32_t y_pos = (uint32_t)(y._value_ptr - y_node->values());
+            uint32_t count = std::min(x_node->_count - x_pos, y_node->_count - y_pos);
+
+            if (!std::equal(x._value_ptr, x._value_ptr + count, y._value_ptr) ||
+                (__soa_leaves && !std::equal(mapped_values(x_node) + x_pos, mapped_values(x_node) + x_pos + count,
+                                             mapped_values(y_node) + y_pos)))
+            {
+                return false;
+            }
+
+            x._value_ptr += count;
+            y._value_ptr += count;
+
+            if (x._value_ptr == x_node->values_end())
+            {
+                x.cross_node_increment();
+
+                if (x._value_ptr == nullptr)
+                {
+                    return true;
+                }
+            }
+
+            if (y._value_ptr == y_node->values_end())
+            {
+                y.cross_node_increment();
+            }
+        }
+    }
+
+    bool less_values(const _bplus_tree& tree) const
+    {
+        _path x(const_cast<_bplus_tree*>(this));
+        _path y(const_cast<_bplus_tree*>(&tree));
+        x.set_first();
+        y.set_first();
+
+        for (;;)
+        {
+            if (y._value_ptr == nullptr)
+            {
+                return false;
+            }
+            else if (x._value_ptr == nullptr)
+            {
+                return true;
+            }
+
+            _node_type* x_node = x.leaf_node();
+            _node_type* y_node = y.leaf_node();
+            uint32_t x_pos = (uint32_t)(x._value_ptr - x_node->values());
+            uint32_t y_pos = (uint32_t)(y._value_ptr - y_node->values());
+            uint32_t count = std::min(x_node->_count - x_pos, y_node->_count - y_pos);
+
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                if (x._value_ptr[i] < y._value_ptr[i])
+                {
+                    return true;
+                }
+                else if (y._value_ptr[i] < x._value_ptr[i])
+                {
+                    return false;
+                }
+                else if (__soa_leaves)
+                {
+                    if (mapped_values(x_node)[x_pos + i] < mapped_values(y_node)[y_pos + i])
+                    {
+                        return true;
+                    }
+                    else if (mapped_values(y_node)[y_pos + i] < mapped_values(x_node)[x_pos + i])
+                    {
+                        return false;
+                    }
+                }
+            }
+
+            x._value_ptr += count;
+            y._value_ptr += count;
+
+            if (x._value_ptr == x_node->values_end())
+            {
+                x.cross_node_increment();
+            }
+
+            if (y._value_ptr == y_node->values_end())
+            {
+                y.cross_node_increment();
+            }
+        }
+    }
+
+    // the number of values before the one of path, the values of the slots left of the path are summed at each level.
+    // the value_ptr of path may be the end of its leaf.
+    size_t index_of_path(const _path& path) const noexcept
+    {
+        size_t index = (size_t)(path._value_ptr - path.leaf_node()->values());
+
+        for (uint32_t depth = 0; depth < _tree_height; ++depth)
+        {
+            _node_type* parent_node = (depth + 1 < _tree_height)? *path._stack[depth + 1] : _root_node;
+            uint32_t node_pos = (uint32_t)(path._stack[depth] - parent_node->nodes());
+
+            for (uint32_t i = 0; i < node_pos; ++i)
+            {
+                index += slot_count(parent_node, i, depth + 1);
+            }
+        }
+
+        return index;
+    }
+
+    size_t index_of(const _const_iterator& position) const
+    {
+        if (position._value_ptr == nullptr)
+        {
+            return _values_count;
+        }
+
+        return index_of_path(make_path(position, std::integral_constant<bool, __leaf_links>()));
+    }
+
+    // the number of values less than key
+    template<typename _kt>
+    size_t rank(const _kt& key) const
+    {
+        if (_values_count == 0)
+        {
+            return 0;
+        }
+
+        _path path(const_cast<_bplus_tree*>(this));
+        _node_type* cur_node;
+        path._value_ptr = lower_bound_core(key, path._stack, cur_node);
+
+        return index_of_path(path);
+    }
+
+    // the number of values not less than lower_key and less than upper_key
+    template<typename _kt1, typename _kt2>
+    size_t count_range(const _kt1& lower_key, const _kt2& upper_key) const
+    {
+        size_t lower_rank = rank(lower_key);
+        size_t upper_rank = rank(upper_key);
+
+        return (upper_rank > lower_rank)? upper_rank - lower_rank : 0;
+    }
+
+    // the number of values equal to key. the paths of its bounds are walked up together and the slots between them
+    // are counted as whole subtrees until the paths meet, so a run of equal keys is counted a leaf at a time when
+    // the subtree counts are off, and in O(log n) when they are on.
+    template<typename _kt>
+    size_t count_key(const _kt& key) const
+    {
+        if (_values_count == 0)
+        {
+            return 0;
+        }
+
+        _path lower_path(const_cast<_bplus_tree*>(this));
+        _path upper_path(const_cast<_bplus_tree*>(this));
+        _node_type* lower_node;
+        _node_type* upper_node;
+
+        lower_path._value_ptr = lower_bound_core(key, lower_path._stack, lower_node);
+        upper_path._value_ptr = upper_bound_core(key, upper_path._stack, upper_node);
+
+        if (lower_node == upper_node)
+        {
+            return (size_t)(upper_path._value_ptr - lower_path._value_ptr);
+        }
+
+        size_t count = (size_t)(lower_node->values_end() - lower_path._value_ptr) +
+                       (size_t)(upper_path._value_ptr - upper_node->values());
+
+        for (uint32_t depth = 1; ; ++depth)
+        {
+            lower_node = (depth < _tree_height)? *lower_path._stack[depth] : _root_node;
+            upper_node = (depth < _tree_height)? *upper_path._stack[depth] : _root_node;
+            uint32_t lower_pos = (uint32_t)(lower_path._stack[depth - 1] - lower_node->nodes()) + 1;
+            uint32_t upper_pos = (uint32_t)(upper_path._stack[depth - 1] - upper_node->nodes());
+
+            if (lower_node == upper_node)
+            {
+                for (uint32_t i = lower_pos; i < upper_pos; ++i)
+                {
+                    count += slot_count(lower_node, i, depth);
+                }
+
+                return count;
+            }
+
+            for (uint32_t i = lower_pos; i < lower_node->_count; ++i)
+            {
+                count += slot_count(lower_node, i, depth);
+            }
+
+            for (uint32_t i = 0; i < upper_pos; ++i)
+            {
+                count += slot_count(upper_node, i, depth);
+            }
+        }
+    }
+
+    // the value at index, descending into the slot whose values cover it at each level
+    template<typename _output_iterator>
+    _output_iterator select(size_t index) const
+    {
+        _path_for<_output_iterator> it(const_cast<_bplus_tree*>(this));
+
+        if (index >= _values_count)
+        {
+            it._value_ptr = nullptr;
+            return it;
+        }
+
+        _node_type* cur_node = _root_node;
+
+        for (uint32_t depth = _tree_height; depth > 0; --depth)
+        {
+            uint32_t node_pos = 0;
+
+            for (size_t count; index >= (count = slot_count(cur_node, node_pos, depth)); ++node_pos)
+            {
+                index -= count;
+            }
+
+            it._stack[depth - 1] = cur_node->nodes() + node_pos;
+            cur_node = cur_node->nodes()[node_pos];
+        }
+
+        it._value_ptr = cur_node->values() + index;
+        return it;
+    }
+
+    // combines the values not less than lower_key and less than upper_key. the paths of both keys are walked up
+    // together, the slots between them are taken as whole subtrees until the paths meet.
+    template<typename _kt1, typename _kt2>
+    _aggregate_type reduce(const _kt1& lower_key, const _kt2& upper_key) const
+    {
+        static_assert(__aggregates, "reduce needs a tree given a monoid");
+
+        _monoid_type monoid;
+
+        if (_values_count == 0 || !_comp(lower_key, upper_key))
+        {
+            return monoid.identity();
+        }
+
+        _path lower_path(const_cast<_bplus_tree*>(this));
+        _path upper_path(const_cast<_bplus_tree*>(this));
+        _node_type* lower_node;
+        _node_type* upper_node;
+
+        uint32_t lower_pos = (uint32_t)(lower_bound_core(lower_key, lower_path._stack, lower_node) - lower_node->values());
+        uint32_t upper_pos = (uint32_t)(lower_bound_core(upper_key, upper_path._stack, upper_node) - upper_node->values());
+
+        if (lower_node == upper_node)
+        {
+            return aggregate_range(lower_node, 0, lower_pos, upper_pos);
+        }
+
+        _aggregate_type lower_aggregate = aggregate_range(lower_node, 0, lower_pos, lower_node->_count);
+        _aggregate_type upper_aggregate = aggregate_range(upper_node, 0, 0, upper_pos);
+
+        for (uint32_t depth = 1; ; ++depth)
+        {
+            lower_node = (depth < _tree_height)? *lower_path._stack[depth] : _root_node;
+            upper_node = (depth < _tree_height)? *upper_path._stack[depth] : _root_node;
+            lower_pos = (uint32_t)(lower_path._stack[depth - 1] - lower_node->nodes()) + 1;
+            upper_pos = (uint32_t)(upper_path._stack[depth - 1] - upper_node->nodes());
+
+            if (lower_node == upper_node)
+            {
+                return monoid.combine(monoid.combine(lower_aggregate, aggregate_range(lower_node, depth, lower_pos, upper_pos)),
+                                      upper_aggregate);
+            }
+
+            lower_aggregate = monoid.combine(lower_aggregate, aggregate_range(lower_node, depth, lower_pos, lower_node->_count));
+            upper_aggregate = monoid.combine(aggregate_range(upper_node, depth, 0, upper_pos), upper_aggregate);
+        }
+    }
+
+    // the aggregates above a value follow its mapped value only when they are refreshed after it was changed in place
+    void update_aggregates(const _const_iterator& position)
+    {
+        if (__aggregates && position._value_ptr != nullptr)
+        {
+            _path it(make_path(position, std::integral_constant<bool, __leaf_links>()));
+
+            if (_shared_nodes)
+            {
+                unshare_path(it, false);
+            }
+
+            refresh_aggregates(it._stack, 0);
+        }
+    }
+
+    template<typename _output_iterator, typename... _args>
+    void insert_core(_output_iterator& it, _args&&... args)
+    {
+        if (_shared_nodes)
+        {
+            unshare_path(it, false);
+        }
+
+        ++_values_count;
+
+        _node_type* cur_node;
+
+        if (_tree_height == 0)
+        {
+            if (_root_node->_bucket_bysize < (_root_node->_count + 1) * sizeof(_value_type) &&
+                _root_node->_bucket_bysize < __leaf_bucket_bysize)
+            {
+                uint32_t root_bucket_bysize;
+                if (_root_node->_bucket_bysize << 2 > __leaf_bucket_bysize)
+                {
+                    root_bucket_bysize = __leaf_bucket_bysize;
+                }
+                else if (_root_node->_bucket_bysize << 1 > __leaf_bucket_bysize)
+                {
+                    root_bucket_bysize = __leaf_bucket_bysize;
+                }
+                else
+                {
+                    root_bucket_bysize = _root_node->_bucket_bysize << 1;
+                }
+
+                _node_type* new_root_node = allocate_root_node(root_bucket_bysize);
+                new_root_node->_count = _root_node->_count;
+
+                relocate_values(new_root_node, 0, _root_node, 0, _root_node->_count);
+
+                it._value_ptr = new_root_node->values() + (it._value_ptr - _root_node->values());
+
+                deallocate_root_node();
+                _root_node = new_root_node;
+            }
+
+            cur_node = _root_node;
+        }
+        else
+        {
+            cur_node = *it._stack[0];
+            add_subtree_counts(it._stack, 1);
+        }
+
+        if (cur_node->_count < __bucket_values_capacity_max)
+        {
+            if (it._value_ptr == cur_node->values_end())
+            {
+                construct_value(cur_node, it._value_ptr, std::forward<_args>(args)...);
+            }
+            else
+            {
+                uint32_t insert_pos = (uint32_t)(it._value_ptr - cur_node->values());
+
+                move_construct_value(cur_node, cur_node->_count, cur_node, cur_node->_count - 1);
+                move_values_backward(cur_node, insert_pos, cur_node->_count - 1, cur_node->_count);
+
+                assign_value(cur_node, it._value_ptr, std::forward<_args>(args)...);
+
+                if (__separator_keys && it._value_ptr == cur_node->values())
+                {
+                    update_separator(it._stack, _key_of_value()(*it._value_ptr));
+                }
+            }
+
+            ++cur_node->_count;
+
+            refresh_aggregates(it._stack, 0);
+            return;
+        }
+
+        _node_type *new_node = allocate_node(0);
+        if (!__separator_keys)
+        {
+            new_node->_ref_value = new_node->values();
+        }
+
+        link_leaf_after(new_node, cur_node);
+
+        bool x_in_new_node;
+        uint32_t insert_pos = (uint32_t)(it._value_ptr - cur_node->values());
+
+        if (insert_pos < __bucket_values_capacity_max - __bucket_values_capacity_max / 2)
+        {
+            move_construct_value(new_node, 0, cur_node, __bucket_values_capacity_max / 2);
+
+            relocate_values(new_node, 1, cur_node, __bucket_values_capacity_max / 2 + 1,
+                            __bucket_values_capacity_max - __bucket_values_capacity_max / 2 - 1);
+
+            move_values_backward(cur_node, insert_pos, __bucket_values_capacity_max / 2, __bucket_values_capacity_max / 2 + 1);
+
+            new_node->_count = __bucket_values_capacity_max - __bucket_values_capacity_max / 2;
+            cur_node->_count = __bucket_values_capacity_max / 2 + 1;
+
+            x_in_new_node = false;
+        }
+        else
+        {
+            const uint32_t move_pos = __bucket_values_capacity_max - __bucket_values_capacity_max / 2;
+
+            relocate_values(new_node, 0, cur_node, move_pos, insert_pos - move_pos);
+            relocate_values(new_node, insert_pos - move_pos + 1, cur_node, insert_pos, __bucket_values_capacity_max - insert_pos);
+
+            new_node->_count = __bucket_values_capacity_max / 2 + 1;
+            cur_node->_count = __bucket_values_capacity_max - __bucket_values_capacity_max / 2;
+
+            it._value_ptr = new_node->values() + insert_pos - move_pos;
+            x_in_new_node = true;
+        }
+
+        construct_value(x_in_new_node? new_node : cur_node, it._value_ptr, std::forward<_args>(args)...);
+
+        if (__separator_keys && it._value_ptr == cur_node->values())
+        {
+            update_separator(it._stack, _key_of_value()(*it._value_ptr));
+        }
+
+        for (uint32_t depth = 0; depth < _tree_height; ++depth)
+        {
+            _node_type* parent_node = (depth + 1 < _tree_height)? *(it._stack[depth + 1]) :
+                                                                  _root_node;
+            insert_pos = (uint32_t)(it._stack[depth] - parent_node->nodes() + 1);
+
+            if (__subtree_counts)
+            {
+                subtree_counts(parent_node)[insert_pos - 1] -= count_values(new_node, depth);
+            }
+
+            refresh_aggregate(parent_node, insert_pos - 1, depth + 1);
+
+            if (parent_node->_count < __bucket_nodes_capacity_max)
+            {
+                move_slots(parent_node, insert_pos + 1,
+                           parent_node, insert_pos,
+                           parent_node->_count - insert_pos);
+
+                set_slot(parent_node, insert_pos, new_node, depth);
+
+                ++parent_node->_count;
+                it._stack[depth] += x_in_new_node;
+
+                refresh_aggregates(it._stack, depth + 1);
+                return;
+            }
+
+            _node_type *new_parent_node = allocate_node(depth + 1);
+
+            if (insert_pos < __bucket_nodes_capacity_max - __bucket_nodes_capacity_max / 2)
+            {
+                move_slots(new_parent_node, 0,
+                           parent_node, __bucket_nodes_capacity_max / 2,
+                           __bucket_nodes_capacity_max - __bucket_nodes_capacity_max / 2);
+
+                move_slots(parent_node, insert_pos + 1,
+                           parent_node, insert_pos,
+                           __bucket_nodes_capacity_max / 2 - insert_pos);
+
+                set_slot(parent_node, insert_pos, new_node, depth);
+
+                new_parent_node->_count = __bucket_nodes_capacity_max - __bucket_nodes_capacity_max / 2;
+                parent_node->_count = __bucket_nodes_capacity_max / 2 + 1;
+
+                it._stack[depth] += x_in_new_node;
+                x_in_new_node = false;
+            }
+            else
+            {
+                uint32_t new_insert_pos = insert_pos - (__bucket_nodes_capacity_max - __bucket_nodes_capacity_max / 2);
+
+                move_slots(new_parent_node, 0,
+                           parent_node, __bucket_nodes_capacity_max - __bucket_nodes_capacity_max / 2,
+                           new_insert_pos);
+
+                move_slots(new_parent_node, new_insert_pos + 1,
+                           parent_node, insert_pos,
+                           __bucket_nodes_capacity_max / 2 - new_insert_pos);
+
+                set_slot(new_parent_node, new_insert_pos, new_node, depth);
+
+                new_parent_node->_count = __bucket_nodes_capacity_max / 2 + 1;
+                parent_node->_count = __bucket_nodes_capacity_max - __bucket_nodes_capacity_max / 2;
+
+                if (new_insert_pos > 0 || x_in_new_node)
+                {
+                    it._stack[depth] = new_parent_node->nodes() + (new_insert_pos - !x_in_new_node);
+                    x_in_new_node = true;
+                }
+            }
+
+            if (!__separator_keys)
+            {
+                new_parent_node->_ref_value = (*new_parent_node->nodes())->_ref_value;
+            }
+
+            new_node = new_parent_node;
+            cur_node = parent_node;
+        }
+
+        if (!__separator_keys)
+        {
+            _root_node->_ref_value = (_tree_height == 0)? _root_node->values() : (*_root_node->nodes())->_ref_value;
+        }
+
+        _root_node = allocate_root_node(__internal_bucket_bysize);
+        _root_node->_count = 2;
+        _root_node->nodes()[0] = cur_node;
+        set_slot(_root_node, 1, new_node, _tree_height);
+
+        if (__subtree_counts)
+        {
+            subtree_counts(_root_node)[0] = _values_count - subtree_counts(_root_node)[1];
+        }
+
+        refresh_aggregate(_root_node, 0, _tree_height + 1);
+
+        it._stack[_tree_height] = _root_node->nodes() + x_in_new_node;
+        ++_tree_height;
+    }
+
+    template<typename _output_iterator, typename... _args>
+    void insert_first_value(_output_iterator& it, _args&&... args)
+    {
+        if (_root_node == nullptr)
+        {
+            _root_node = allocate_root_node(__soa_leaves? __leaf_bucket_bysize : 2 * sizeof(_value_type));
+        }
+
+        it._value_ptr = _root_node->values();
+        construct_value(_root_node, it._value_ptr, std::forward<_args>(args)...);
+
+        _root_node->_count = 1;
+        _values_count = 1;
+    }
+
+    // a first value leaves the path stack of it unset, see _bplus_tree_iterator_base
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+    template<typename _output_iterator, typename _arg>
+    std::pair<_output_iterator, bool> insert(_arg&& x)
+    {
+        _path_for<_output_iterator> it(this);
+
+        if (_values_count == 0)
+        {
+            insert_first_value(it, std::forward<_arg>(x));
+            return std::pair<_output_iterator, bool>(it, true);
+        }
+
+        _node_type* cur_node;
+        it._value_ptr = lower_bound_core(_key_of_value()(x), it._stack, cur_node);
+
+        if (it._value_ptr == cur_node->values_end() || value_compare(x, *it._value_ptr))
+        {
+            insert_core(it, std::forward<_arg>(x));
+            return std::pair<_output_iterator, bool>(it, true);
+        }
+        else
+        {
+            return std::pair<_output_iterator, bool>(it, false);
+        }
+    }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+    // the value is constructed piecewise from key and args, and only when key is missing
+    template<typename _output_iterator, typename _kt, typename... _args>
+    std::pair<_output_iterator, bool> try_emplace(_kt&& key, _args&&... args)
+    {
+        _path_for<_output_iterator> it(this);
+
+        if (_values_count == 0)
+        {
+            insert_first_value(it,
+                               std::piecewise_construct,
+                               std::forward_as_tuple(std::forward<_kt>(key)),
+                               std::forward_as_tuple(std::forward<_args>(args)...));
+            return std::pair<_output_iterator, bool>(it, true);
+        }
+
+        _node_type* cur_node;
+        it._value_ptr = lower_bound_core(key, it._stack, cur_node);
+
+        if (it._value_ptr == cur_node->values_end() || key_less(key, *it._value_ptr))
+        {
+            insert_core(it,
+                        std::piecewise_construct,
+                        std::forward_as_tuple(std::forward<_kt>(key)),
+                        std::forward_as_tuple(std::forward<_args>(args)...));
+            return std::pair<_output_iterator, bool>(it, true);
+        }
+        else
+        {
+            return std::pair<_output_iterator, bool>(it, false);
+        }
+    }
+
+    template<typename _output_iterator, typename _arg>
+    _output_iterator insert(const _const_iterator& position, _arg&& x)
+    {
+        _path_for<_output_iterator> it(make_path(position, std::integral_constant<bool, __leaf_links>()));
+
+        if (_values_count == 0)
+        {
+            insert_first_value(it, std::forward<_arg>(x));
+            return it;
+        }
+
+        if (it._value_ptr == nullptr)
+        {
+            it.set_last();
+
+            if (value_compare(*it._value_ptr, x))
+            {
+                ++it._value_ptr;
+                insert_core(it, std::forward<_arg>(x));
+                return it;
+            }
+        }
+        else
+        {
+            _path before(it);
+            before.decrement();
+
+            if (before._value_ptr == nullptr || value_compare(*before._value_ptr, x))
+            {
+                if (value_compare(x, *it._value_ptr))
+                {
+                    insert_core(it, std::forward<_arg>(x));
+                    return it;
+                }
+            }
+        }
+
+        _node_type* cur_node;
+        it._value_ptr = lower_bound_core(_key_of_value()(x), it._stack, cur_node);
+
+        if (it._value_ptr == cur_node->values_end() || value_compare(x, *it._value_ptr))
+        {
+            insert_core(it, std::forward<_arg>(x));
+        }
+
+        return it;
+    }
+
+    template<typename _input_iterator>
+    void insert_range(_input_iterator&& first, _input_iterator&& last)
+    {
+        _const_iterator it_end(this, nullptr);
+
+        for (_input_iterator pos = first; pos != last; ++pos)
+        {
+            insert<_iterator>(it_end, *pos);
+        }
+    }
+
+    // the trees keeping equal keys put a value after the values equal to it
+    template<typename _output_iterator, typename _arg>
+    _output_iterator insert_equal(_arg&& x)
+    {
+        _path_for<_output_iterator> it(this);
+
+        if (_values_count == 0)
+        {
+            insert_first_value(it, std::forward<_arg>(x));
+            return it;
+        }
+
+        _node_type* cur_node;
+        it._value_ptr = upper_bound_core(_key_of_value()(x), it._stack, cur_node);
+
+        insert_core(it, std::forward<_arg>(x));
+        return it;
+    }
+
+    // the value goes right before position when it fits there, otherwise as close to position as it can: before the
+    // values equal to it when it belongs after position, after them when it belongs before
+    template<typename _output_iterator, typename _arg>
+    _output_iterator insert_equal(const _const_iterator& position, _arg&& x)
+    {
+        _path_for<_output_iterator> it(make_path(position, std::integral_constant<bool, __leaf_links>()));
+
+        if (_values_count == 0)
+        {
+            insert_first_value(it, std::forward<_arg>(x));
+            return it;
+        }
+
+        _node_type* cur_node;
+
+        if (it._value_ptr != nullptr && value_compare(*it._value_ptr, x))
+        {
+            it._value_ptr = lower_bound_core(_key_of_value()(x), it._stack, cur_node);
+
+            insert_core(it, std::forward<_arg>(x));
+            return it;
+        }
+        else if (it._value_ptr == nullptr)
+        {
+            it.set_last();
+
+            if (!value_compare(x, *it._value_ptr))
+            {
+                ++it._value_ptr;
+                insert_core(it, std::forward<_arg>(x));
+                return it;
+            }
+        }
+        else
+        {
+            _path before(it);
+            before.decrement();
+
+            if (before._value_ptr == nullptr || !value_compare(x, *before._value_ptr))
+            {
+                insert_core(it, std::forward<_arg>(x));
+                return it;
+            }
+        }
+
+        it._value_ptr = upper_bound_core(_key_of_value()(x), it._stack, cur_node);
+
+        insert_core(it, std::forward<_arg>(x));
+        return it;
+    }
+
+    template<typename _input_iterator>
+    void insert_equal_range(_input_iterator&& first, _input_iterator&& last)
+    {
+        _const_iterator it_end(this, nullptr);
+
+        for (_input_iterator pos = first; pos != last; ++pos)
+        {
+            insert_equal<_iterator>(it_end, *pos);
+        }
+    }
+
+    // inserts a range in any order. the values are sorted and the equal keys dropped, the first one is kept like for
+    // single insertions, then the keys are inserted from left to right on a shared path which is only searched again
+    // when a key goes beyond the leaf of the previous one. each key is still inserted on its own, shifting the values
+    // after it and splitting a full leaf, so only the descents are saved, not the moves.
+    template<typename _batch_value_type, typename _input_iterator>
+    void insert_batch(_input_iterator&& first, _input_iterator&& last)
+    {
+        std::vector<_batch_value_type> batch(first, last);
+
+        std::stable_sort(batch.begin(), batch.end(),
+                         [this](const _batch_value_type& x, const _batch_value_type& y) { return value_compare(x, y); });
+        batch.erase(std::unique(batch.begin(), batch.end(),
+                                [this](const _batch_value_type& x, const _batch_value_type& y) { return !value_compare(x, y); }),
+                    batch.end());
+
+        if (batch.empty())
+        {
+            return;
+        }
+
+        if (_values_count == 0)
+        {
+            clear();
+            bulk_load(std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()), 1.0f);
+            return;
+        }
+
+        _path it(this);
+        _node_type* cur_node = nullptr;
+
+        for (_batch_value_type& x : batch)
+        {
+            if (ascending_lower_bound(_key_of_value()(x), it, cur_node))
+            {
+                insert_core(it, std::move(x));
+                cur_node = (_tree_height == 0)? _root_node : *it._stack[0];
+            }
+        }
+    }
+
+    // positions it at the lower bound of key and tells whether key is missing. the keys must come in ascending order
+    // on the same it and cur_node, starting with cur_node null, then a key not beyond the leaf of the previous one is
+    // only searched in that leaf.
+    bool ascending_lower_bound(const _key_type& key, _path& it, _node_type*& cur_node)
+    {
+        if (cur_node != nullptr &&
+            (!key_larger(key, *(cur_node->values_end() - 1)) || rightmost_path(it._stack)))
+        {
+            it._value_ptr = search_value(key, cur_node, std::integral_constant<bool, __simd_search_values>());
+        }
+        else
+        {
+            it._value_ptr = lower_bound_core(key, it._stack, cur_node);
+        }
+
+        return it._value_ptr == cur_node->values_end() || key_less(key, *it._value_ptr);
+    }
+
+    bool rightmost_path(_node_type*** stack) const noexcept
+    {
+        for (uint32_t depth = 0; depth < _tree_height; ++depth)
+        {
+            _node_type* parent_node = (depth + 1 < _tree_height)? *stack[depth + 1] : _root_node;
+
+            if (stack[depth] + 1 != parent_node->nodes_end())
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // moves the values of tree with keys missing here into this tree, the others stay in tree. trees whose key ranges
+    // don't interleave are joined without moving any value, otherwise the values of tree are inserted from left to
+    // right like insert_batch and the ones left over are rebuilt into tree. the allocators must be equal.
+    void merge(_bplus_tree& tree)
+    {
+        if (&tree == this || tree._values_count == 0)
+        {
+            return;
+        }
+
+        if (_values_count == 0 ||
+            key_less(_key_of_value()(*(last_leaf_node()->values_end() - 1)), *tree.first_leaf_node()->values()))
+        {
+            join(tree);
+            return;
+        }
+
+        if (key_less(_key_of_value()(*(tree.last_leaf_node()->values_end() - 1)), *first_leaf_node()->values()))
+        {
+            tree.join(*this);
+            join(tree);
+            return;
+        }
+
+        // the values of tree are all moved out of its leaves
+        tree.unshare_all();
+
+        std::vector<_taken_value_type> rest;
+        _path src(&tree);
+        _path it(this);
+        _node_type* cur_node = nullptr;
+
+        for (src.set_first(); src._value_ptr != nullptr; src.increment())
+        {
+            _taken_value_type x(take_value(src.leaf_node(), src._value_ptr));
+
+            if (ascending_lower_bound(_key_of_value()(x), it, cur_node))
+            {
+                insert_core(it, std::move(x));
+                cur_node = (_tree_height == 0)? _root_node : *it._stack[0];
+            }
+            else
+            {
+                rest.push_back(std::move(x));
+            }
+        }
+
+        tree.replace_by(rest);
+    }
+
+    template<typename _input_iterator, typename _node_handle>
+    void extract(const _input_iterator& position, _node_handle& nh)
+    {
+        if (_shared_nodes)
+        {
+            extract_shared(position, nh, std::integral_constant<bool, __leaf_links>());
+            return;
+        }
+
+        nh._emplace(take_value(position.leaf_node(), position._value_ptr));
+        erase<_iterator>(position);
+    }
+
+    template<typename _input_iterator, typename _node_handle>
+    void extract_shared(const _input_iterator& position, _node_handle& nh, std::false_type /*leaf_links*/)
+    {
+        _path it(position);
+        unshare_path(it, true);
+
+        nh._emplace(take_value(it.leaf_node(), it._value_ptr));
+        erase_core<_path>(it);
+    }
+
+    template<typename _input_iterator, typename _node_handle>
+    void extract_shared(const _input_iterator&, _node_handle&, std::true_type /*leaf_links*/) noexcept {}
+
+    // the set operations below walk x and y leaf by leaf and copy whole runs of values from a leaf at once. when one
+    // side of an intersection or difference has to catch up with a key beyond its current leaf, it climbs to the
+    // lowest ancestor covering the key and descends from there, skipping the subtrees in between without visiting
+    // them, so a small tree intersected with a large one costs at most a partial descent per value of the small one.
+    // the result replaces the content of this tree, which may be x or y, and is built by bulk_load.
+    void set_union(const _bplus_tree& x, const _bplus_tree& y)
+    {
+        std::vector<_moveable_value_type> result;
+        result.reserve(x._values_count + y._values_count);
+
+        _path px(const_cast<_bplus_tree*>(&x));
+        _path py(const_cast<_bplus_tree*>(&y));
+        px.set_first();
+        py.set_first();
+
+        while (px._value_ptr != nullptr && py._value_ptr != nullptr)
+        {
+            if (value_compare(*px._value_ptr, *py._value_ptr))
+            {
+                append_run(result, px, _key_of_value()(*py._value_ptr));
+            }
+            else if (value_compare(*py._value_ptr, *px._value_ptr))
+            {
+                append_run(result, py, _key_of_value()(*px._value_ptr));
+            }
+            else
+            {
+                result.push_back(*px._value_ptr);
+                px.increment();
+                py.increment();
+            }
+        }
+
+        append_rest(result, px);
+        append_rest(result, py);
+
+        replace_by(result);
+    }
+
+    void set_intersection(const _bplus_tree& x, const _bplus_tree& y)
+    {
+        std::vector<_moveable_value_type> result;
+
+        _path px(const_cast<_bplus_tree*>(&x));
+        _path py(const_cast<_bplus_tree*>(&y));
+        px.set_first();
+        py.set_first();
+
+        while (px._value_ptr != nullptr && py._value_ptr != nullptr)
+        {
+            if (value_compare(*px._value_ptr, *py._value_ptr))
+            {
+                x.seek_forward(px, _key_of_value()(*py._value_ptr));
+            }
+            else if (value_compare(*py._value_ptr, *px._value_ptr))
+            {
+                y.seek_forward(py, _key_of_value()(*px._value_ptr));
+            }
+            else
+            {
+                result.push_back(*px._value_ptr);
+                px.increment();
+                py.increment();
+            }
+        }
+
+        replace_by(result);
+    }
+
+    void set_difference(const _bplus_tree& x, const _bplus_tree& y)
+    {
+        std::vector<_moveable_value_type> result;
+
+        _path px(const_cast<_bplus_tree*>(&x));
+        _path py(const_cast<_bplus_tree*>(&y));
+        px.set_first();
+        py.set_first();
+
+        while (px._value_ptr != nullptr && py._value_ptr != nullptr)
+        {
+            if (value_compare(*px._value_ptr, *py._value_ptr))
+            {
+                append_run(result, px, _key_of_value()(*py._value_ptr));
+            }
+            else if (value_compare(*py._value_ptr, *px._value_ptr))
+            {
+                y.seek_forward(py, _key_of_value()(*px._value_ptr));
+            }
+            else
+            {
+                px.increment();
+                py.increment();
+            }
+        }
+
+        append_rest(result, px);
+
+        replace_by(result);
+    }
+
+    // the first value of the leaf of path, from the one of path on, which is not less than key. the search gallops
+    // from the current value since the key is usually close to it.
+    _value_type* leaf_lower_bound(const _path& path, const _key_type& key) const
+    {
+        _value_type* first = path._value_ptr;
+        _value_type* last = path.leaf_node()->values_end();
+
+        size_t step = 1;
+        while (first + step < last && key_larger(key, first[step]))
+        {
+            first += step;
+            step <<= 1;
+        }
+
+        if (first + step < last)
+        {
+            last = first + step;
+        }
+
+        return std::lower_bound(first, last, key,
+                                [this](const _value_type& x, const _key_type& k) { return key_larger(k, x); });
+    }
+
+    // moves path to the lower bound of key. a key beyond the leaf of path climbs to the lowest ancestor whose next
+    // slot starts after key, which is found from the separators, and descends again from there only.
+    void seek_forward(_path& path, const _key_type& key) const
+    {
+        _value_type* value_ptr = leaf_lower_bound(path, key);
+
+        if (value_ptr != path.leaf_node()->values_end())
+        {
+            path._value_ptr = value_ptr;
+            return;
+        }
+
+        uint32_t depth = 0;
+        _node_type* cur_node = _root_node;
+
+        for (; depth < _tree_height; ++depth)
+        {
+            _node_type* parent_node = (depth + 1 < _tree_height)? *path._stack[depth + 1] : _root_node;
+            uint32_t next_pos = (uint32_t)(path._stack[depth] - parent_node->nodes()) + 1;
+
+            if (next_pos < parent_node->_count && key_less_than_slot(key, parent_node, next_pos))
+            {
+                cur_node = parent_node;
+                break;
+            }
+        }
+
+        // without such an ancestor the descent starts from the root
+        if (depth == _tree_height)
+        {
+            --depth;
+        }
+
+        for (; depth != (uint32_t)-1; --depth)
+        {
+            _node_type** node_ptr = cur_node->nodes() + search_child(key, cur_node);
+
+            path._stack[depth] = node_ptr;
+            cur_node = *node_ptr;
+
+            prefetch_node(cur_node, depth);
+        }
+
+        path._value_ptr = search_value(key, cur_node, std::integral_constant<bool, __simd_search_values>());
+
+        if (path._value_ptr == cur_node->values_end())
+        {
+            path.cross_node_increment();
+        }
+    }
+
+    // whether key is less than the first key in the subtree of slot pos of node
+    bool key_less_than_slot(const _key_type& key, const _node_type* node, uint32_t pos) const
+    {
+        if (__separator_keys)
+        {
+            return _comp(key, separator_keys(node)[pos]);
+        }
+        else
+        {
+            return key_less(key, *node->nodes()[pos]->_ref_value);
+        }
+    }
+
+    void append_run(std::vector<_moveable_value_type>& result, _path& path, const _key_type& key) const
+    {
+        _value_type* run_end = leaf_lower_bound(path, key);
+
+        result.insert(result.end(), path._value_ptr, run_end);
+
+        if (run_end == path.leaf_node()->values_end())
+        {
+            path.cross_node_increment();
+        }
+        else
+        {
+            path._value_ptr = run_end;
+        }
+    }
+
+    void append_rest(std::vector<_moveable_value_type>& result, _path& path) const
+    {
+        while (path._value_ptr != nullptr)
+        {
+            result.insert(result.end(), path._value_ptr, path.leaf_node()->values_end());
+            path.cross_node_increment();
+        }
+    }
+
+    template<typename _vector_value_type>
+    void replace_by(std::vector<_vector_value_type>& values)
+    {
+        clear();
+        bulk_load(std::make_move_iterator(values.begin()), std::make_move_iterator(values.end()), 1.0f);
+    }
+
+    // moves the values not less than key into tree, which must be empty and have an equal allocator. only the nodes
+    // on the path of key are cut in two, the subtrees beside the path are handed over as they are, the cut nodes are
+    // balanced with their siblings and the roots left with a single child are dropped afterwards, see balance_edge().
+    // unless the subtree counts are kept, the nodes don't know the size of their subtrees, so the values of the side
+    // with less slots in its root are counted by walking down to its leaves.
+    void split(const _key_type& key, _bplus_tree& tree)
+    {
+        if (_values_count == 0)
+        {
+            return;
+        }
+
+        tree.clear();
+        unshare_all();
+
+        std::vector<_node_type*> spare_nodes;
+        _node_type* spare_leaf_node = allocate_node(0);
+
+        try
+        {
+            allocate_spare_nodes(spare_nodes, _tree_height);
+        }
+        catch (...)
+        {
+            deallocate_node(spare_leaf_node, 0);
+            throw;
+        }
+
+        _path path(this);
+        _node_type* leaf_node;
+        path._value_ptr = lower_bound_core(key, path._stack, leaf_node);
+
+        // the parts of the node of the current level staying here and going to tree, either may be nullptr
+        _node_type* left_node = leaf_node;
+        _node_type* right_node = nullptr;
+        uint32_t split_pos = (uint32_t)(path._value_ptr - leaf_node->values());
+
+        if (split_pos == 0)
+        {
+            left_node = nullptr;
+            right_node = leaf_node;
+        }
+        else if (split_pos < leaf_node->_count)
+        {
+            right_node = spare_leaf_node;
+            spare_leaf_node = nullptr;
+
+            right_node->_count = leaf_node->_count - split_pos;
+            relocate_values(right_node, 0, leaf_node, split_pos, right_node->_count);
+            leaf_node->_count = split_pos;
+
+            if (!__separator_keys)
+            {
+                right_node->_ref_value = right_node->values();
+            }
+
+            link_leaf_after(right_node, leaf_node);
+        }
+
+        for (uint32_t depth = 0; depth < _tree_height; ++depth)
+        {
+            _node_type* parent_node = (depth + 1 < _tree_height)? *path._stack[depth + 1] : _root_node;
+            uint32_t node_pos = (uint32_t)(path._stack[depth] - parent_node->nodes());
+
+            uint32_t left_count = node_pos + (left_node != nullptr);
+            uint32_t right_count = (right_node != nullptr) + parent_node->_count - node_pos - 1;
+
+            if (left_count == 0)
+            {
+                left_node = nullptr;
+                right_node = parent_node;
+            }
+            else if (right_count == 0)
+            {
+                left_node = parent_node;
+                right_node = nullptr;
+            }
+            else
+            {
+                _node_type* new_node = spare_nodes.back();
+                spare_nodes.pop_back();
+
+                new_node->_count = right_count;
+
+                if (right_node != nullptr)
+                {
+                    set_slot(new_node, 0, right_node, depth);
+                }
+
+                move_slots(new_node, right_count - (parent_node->_count - node_pos - 1),
+                           parent_node, node_pos + 1, parent_node->_count - node_pos - 1);
+
+                if (!__separator_keys)
+                {
+                    new_node->_ref_value = (*new_node->nodes())->_ref_value;
+                }
+
+                parent_node->_count = left_count;
+
+                if (left_node != nullptr)
+                {
+                    refresh_slot(parent_node, node_pos, depth + 1);
+                }
+
+                left_node = parent_node;
+                right_node = new_node;
+            }
+        }
+
+        if (spare_leaf_node != nullptr)
+        {
+            deallocate_node(spare_leaf_node, 0);
+        }
+
+        free_spare_nodes(spare_nodes);
+        drop_finger();
+        tree.drop_finger();
+
+        uint32_t tree_height = _tree_height;
+        size_t values_count = _values_count;
+
+        _root_node = left_node;
+        tree._root_node = right_node;
+
+        if (right_node == nullptr)
+        {
+            _values_count = values_count;
+            return;
+        }
+
+        tree._tree_height = tree_height;
+
+        if (left_node == nullptr)
+        {
+            tree._values_count = values_count;
             _values_count = 0;
             _tree_height = 0;
+            return;
+        }
+
+        right_node->_bucket_bysize = bucket_bysize_max(tree_height);
+        cut_leaf_links(tree.first_leaf_node());
+
+        balance_edge(true);
+        tree.balance_edge(false);
+
+        if (_tree_height < tree._tree_height ||
+            (_tree_height == tree._tree_height && _root_node->_count < tree._root_node->_count))
+        {
+            _values_count = count_values(_root_node, _tree_height);
+            tree._values_count = values_count - _values_count;
         }
         else
         {
-            std::swap(_root_node, tree._root_node);
-            std::swap(_values_count, tree._values_count);
-            std::swap(_tree_height, tree._tree_height);
+            tree._values_count = count_values(tree._root_node, tree._tree_height);
+            _values_count = values_count - tree._values_count;
         }
-
-        std::swap(_comp, tree._comp);
-        _awrapper.swap_allocator(tree._awrapper._alloc);
     }
 
-    bool value_compare(const _value_type& x, const _value_type& y) const
-    { return _comp(_key_of_value()(x), _key_of_value()(y)); }
+    // appends the values of tree, which must all be larger than the ones here, and leaves tree empty. the lower root
+    // is hung into the edge of the higher tree at its own level and balanced with the nodes beside it, see
+    // graft_node(). the allocators must be equal.
+    void join(_bplus_tree& tree)
+    {
+        if (tree._values_count == 0)
+        {
+            return;
+        }
 
-    bool key_less(const _key_type& key, const _value_type& x) const
-    { return _comp(key, _key_of_value()(x)); }
+        if (_values_count == 0)
+        {
+            clear();
+            move_data(tree, std::true_type());
+            return;
+        }
 
-    bool key_larger(const _key_type& key, const _value_type& x) const
-    { return _comp(_key_of_value()(x), key); }
+        unshare_all();
+        tree.unshare_all();
 
-    _value_type* lower_bound_core(const _key_type& key,
-                                  _node_type*** stack,
-                                  _node_type*& cur_node) const
-    {
-        cur_node = _root_node;
+        drop_finger();
+        tree.drop_finger();
 
-        for (uint32_t depth = _tree_height - 1; depth != (uint32_t)-1; --depth)
+        if (_tree_height == 0 && tree._tree_height == 0 &&
+            _root_node->_count + tree._root_node->_count <= __bucket_values_capacity_max)
         {
-            uint32_t check_nodes_count = cur_node->_count;
-            _node_type** node_ptr = cur_node->nodes();
-
-            do
-            {
-                uint32_t step = check_nodes_count >> 1;
+            resize_root_leaf(root_leaf_bucket_bysize(_root_node->_count + tree._root_node->_count));
 
-                bool key_not_less_than = !key_less(key, *(node_ptr[step]->_ref_value));
+            relocate_values(_root_node, _root_node->_count, tree._root_node, 0, tree._root_node->_count);
+            _root_node->_count += tree._root_node->_count;
+            _values_count += tree._values_count;
 
-                check_nodes_count = (check_nodes_count + key_not_less_than) >> 1;
-                node_ptr += step * key_not_less_than;
-            }
-            while (check_nodes_count > 1);
+            tree._values_count = 0;
+            tree.deallocate_root_node();
+            tree._root_node = nullptr;
+            return;
+        }
 
-            stack[depth] = node_ptr;
-            cur_node = *node_ptr;
+        // only full sized roots can become ordinary nodes
+        if (_tree_height == 0)
+        {
+            resize_root_leaf(__leaf_bucket_bysize);
+        }
+        if (tree._tree_height == 0)
+        {
+            tree.resize_root_leaf(__leaf_bucket_bysize);
         }
 
-        uint32_t check_values_count = cur_node->_count;
-        _value_type* value_ptr = cur_node->values();
+        uint32_t height_diff = (_tree_height > tree._tree_height)? _tree_height - tree._tree_height :
+                                                                   tree._tree_height - _tree_height;
+        std::vector<_node_type*> spare_nodes;
+        allocate_spare_nodes(spare_nodes, height_diff + 1);
 
-        do
-        {
-            uint32_t step = check_values_count >> 1;
+        _key_type key = _key_of_value()(*tree.first_leaf_node()->values());
+        join_leaf_links(last_leaf_node(), tree.first_leaf_node());
 
-            bool key_larger_than = key_larger(key, value_ptr[step]);
+        if (_tree_height >= tree._tree_height)
+        {
+            graft_node(tree.demote_root(), tree._tree_height, key, true, spare_nodes);
+        }
+        else
+        {
+            tree.graft_node(demote_root(), _tree_height, key, false, spare_nodes);
 
-            check_values_count = (check_values_count - key_larger_than) >> 1;
-            value_ptr += (step + 1) * key_larger_than;
+            std::swap(_root_node, tree._root_node);
+            std::swap(_tree_height, tree._tree_height);
         }
-        while (check_values_count > 0);
 
-        return value_ptr;
+        free_spare_nodes(spare_nodes);
+
+        _values_count += tree._values_count;
+
+        tree._root_node = nullptr;
+        tree._values_count = 0;
+        tree._tree_height = 0;
     }
 
-    template<typename _output_iterator>
-    _output_iterator find(const _key_type& key) const
+    // internal nodes are allocated ahead, so that cutting and grafting can't be interrupted
+    void allocate_spare_nodes(std::vector<_node_type*>& spare_nodes, uint32_t count)
     {
-        _output_iterator it(const_cast<_bplus_tree*>(this));
+        spare_nodes.reserve(count);
 
-        if (_values_count > 0)
+        try
         {
-            _node_type* cur_node;
-            it._value_ptr = lower_bound_core(key, it._stack, cur_node);
-
-            if (it._value_ptr != cur_node->values_end() && !key_less(key, *it))
+            for (uint32_t i = 0; i < count; ++i)
             {
-                return it;
+                spare_nodes.push_back(allocate_node(1));
             }
         }
-
-        it._value_ptr = nullptr;
-        return it;
+        catch (...)
+        {
+            free_spare_nodes(spare_nodes);
+            throw;
+        }
     }
 
-    template<typename _output_iterator>
-    _output_iterator lower_bound(const _key_type& key) const
+    void free_spare_nodes(std::vector<_node_type*>& spare_nodes) noexcept
     {
-        _output_iterator it(const_cast<_bplus_tree*>(this));
+        for (_node_type* node : spare_nodes)
+        {
+            deallocate_node(node, 1);
+        }
 
-        if (_values_count > 0)
+        spare_nodes.clear();
+    }
+
+    // appends the values or slots of src_node, the sibling after dst_node at depth, to dst_node and frees src_node.
+    // src_key points to the lowest key under src_node, it's only read when the separator keys are kept.
+    void merge_next_node(_node_type* dst_node, _node_type* src_node, uint32_t depth, const _key_type* src_key)
+    {
+        if (depth > 0)
         {
-            _node_type* cur_node;
-            it._value_ptr = lower_bound_core(key, it._stack, cur_node);
+            move_slots(dst_node, dst_node->_count, src_node, 0, src_node->_count);
 
-            if (it._value_ptr == cur_node->values_end())
+            if (__separator_keys)
             {
-                it.cross_node_increment();
+                separator_keys(dst_node)[dst_node->_count] = *src_key;
             }
         }
         else
         {
-            it._value_ptr = nullptr;
+            relocate_values(dst_node, dst_node->_count, src_node, 0, src_node->_count);
+            unlink_leaf(src_node);
         }
 
-        return it;
+        dst_node->_count += src_node->_count;
+        deallocate_node(src_node, depth);
     }
 
-    template<typename _output_iterator>
-    _output_iterator upper_bound(const _key_type& key) const
+    // an empty tree may still hold its root leaf
+    _node_type* first_leaf_node() const noexcept
     {
-        _output_iterator it(const_cast<_bplus_tree*>(this));
+        _node_type* cur_node = _root_node;
 
-        if (_values_count > 0)
+        for (uint32_t depth = _tree_height; depth > 0; --depth)
         {
-            _node_type* cur_node;
-            it._value_ptr = lower_bound_core(key, it._stack, cur_node);
+            cur_node = *cur_node->nodes();
+        }
 
-            if (it._value_ptr == cur_node->values_end())
-            {
-                it.cross_node_increment();
-            }
-            else if (!key_less(key, *it))
-            {
-                it.increment();
-            }
+        return cur_node;
+    }
+
+    _node_type* last_leaf_node() const noexcept
+    {
+        _node_type* cur_node = _root_node;
+
+        for (uint32_t depth = _tree_height; depth > 0; --depth)
+        {
+            cur_node = *(cur_node->nodes_end() - 1);
         }
-        else
+
+        return cur_node;
+    }
+
+    // drops the roots which have a single child
+    void shrink_root() noexcept
+    {
+        while (_tree_height > 0 && _root_node->_count == 1)
         {
-            it._value_ptr = nullptr;
+            _node_type* new_root_node = *_root_node->nodes();
+            deallocate_root_node();
+            _root_node = new_root_node;
+            --_tree_height;
+            _root_node->_bucket_bysize = bucket_bysize_max(_tree_height);
         }
+    }
 
-        return it;
+    // the smallest bucket size of a root leaf which holds values_count values
+    static uint32_t root_leaf_bucket_bysize(uint32_t values_count) noexcept
+    {
+        if (__soa_leaves)
+        {
+            return __leaf_bucket_bysize;
+        }
+
+        uint32_t root_bucket_bysize = 2 * sizeof(_value_type);
+        while (root_bucket_bysize < values_count * sizeof(_value_type) &&
+               root_bucket_bysize < __leaf_bucket_bysize)
+        {
+            root_bucket_bysize <<= 1;
+        }
+
+        if (root_bucket_bysize > __leaf_bucket_bysize)
+        {
+            root_bucket_bysize = __leaf_bucket_bysize;
+        }
+
+        return root_bucket_bysize;
     }
 
-    template<typename _output_iterator>
-    std::pair<_output_iterator, _output_iterator> equal_range(const _key_type& key) const
+    void resize_root_leaf(uint32_t root_bucket_bysize)
     {
-        _output_iterator it1 = lower_bound<_output_iterator>(key);
-        _output_iterator it2(it1);
+        if (_root_node->_bucket_bysize == root_bucket_bysize)
+        {
+            return;
+        }
+
+        _node_type* new_root_node = allocate_root_node(root_bucket_bysize);
+        new_root_node->_count = _root_node->_count;
+
+        relocate_values(new_root_node, 0, _root_node, 0, _root_node->_count);
+
+        deallocate_root_node();
+        _root_node = new_root_node;
+    }
 
-        if (it2._value_ptr != nullptr && !key_less(key, *it2))
+    // the root of a full sized node becomes an ordinary node, which remembers its first value instead of its size
+    _node_type* demote_root() noexcept
+    {
+        if (!__separator_keys)
         {
-            it2.increment();
+            _root_node->_ref_value = (_tree_height == 0)? _root_node->values() : (*_root_node->nodes())->_ref_value;
         }
 
-        return std::pair<_output_iterator, _output_iterator>(it1, it2);
+        return _root_node;
     }
 
-    template<typename _output_iterator, typename... _args>
-    void insert_core(_output_iterator& it, _args&&... args)
+    // puts node, the root of a subtree of node_depth, at the right or the left edge of the level above node_depth,
+    // which is added if the tree isn't higher. key is the lowest key of the right one of the two trees being joined.
+    // a full edge node is split in halves as insert_core() splits it, the same going on upwards, then node and the
+    // nodes beside it are balanced like the cut nodes of split(), which drops the level added again when both roots
+    // fit into one.
+    void graft_node(_node_type* node, uint32_t node_depth, const _key_type& key, bool at_end,
+                    std::vector<_node_type*>& spare_nodes) noexcept
     {
-        ++_values_count;
+        _node_type* edge_nodes[_tree_height_max + 1];
+        edge_nodes[_tree_height] = _root_node;
 
-        _node_type* cur_node;
+        for (uint32_t depth = _tree_height; depth > node_depth + 1; --depth)
+        {
+            edge_nodes[depth - 1] = at_end? *(edge_nodes[depth]->nodes_end() - 1) : *edge_nodes[depth]->nodes();
+        }
 
-        if (_tree_height == 0)
+        // the lowest key of node at the end, or of the node after node otherwise
+        const _key_type* node_key = &key;
+
+        for (uint32_t depth = node_depth + 1; depth <= _tree_height; ++depth)
         {
-            if (_root_node->_bucket_bysize < (_root_node->_count + 1) * sizeof(_value_type) &&
-                _root_node->_bucket_bysize < _bucket_bysize_max)
+            _node_type* edge_node = edge_nodes[depth];
+
+            // the edge node below was split, it has less values under it
+            if (depth > node_depth + 1)
             {
-                uint32_t root_bucket_bysize;
-                if (_root_node->_bucket_bysize << 2 > _bucket_bysize_max)
+                refresh_slot(edge_node, at_end? edge_node->_count - 1 : 0, depth);
+            }
+
+            if (edge_node->_count < __bucket_nodes_capacity_max)
+            {
+                if (at_end)
                 {
-                    root_bucket_bysize = _bucket_bysize_max;
+                    set_slot(edge_node, edge_node->_count, node, depth - 1);
+                    if (__separator_keys)
+                    {
+                        separator_keys(edge_node)[edge_node->_count] = *node_key;
+                    }
                 }
-                else if (_root_node->_bucket_bysize << 1 > _bucket_bysize_max)
+                else
                 {
-                    root_bucket_bysize = _bucket_bysize_max;
+                    move_slots(edge_node, 1, edge_node, 0, edge_node->_count);
+                    set_slot(edge_node, 0, node, depth - 1);
+                    if (__separator_keys)
+                    {
+                        separator_keys(edge_node)[1] = *node_key;
+                    }
+                    else
+                    {
+                        for (uint32_t i = depth; i < _tree_height; ++i)
+                        {
+                            edge_nodes[i]->_ref_value = node->_ref_value;
+                        }
+                    }
                 }
-                else
+
+                ++edge_node->_count;
+
+                for (uint32_t i = depth + 1; i <= _tree_height; ++i)
                 {
-                    root_bucket_bysize = _root_node->_bucket_bysize << 1;
+                    refresh_slot(edge_nodes[i], at_end? edge_nodes[i]->_count - 1 : 0, i);
                 }
 
-                _node_type* new_root_node = allocate_root_node(root_bucket_bysize);
-                new_root_node->_count = _root_node->_count;
+                balance_edge(at_end);
+                return;
+            }
 
-                for (uint32_t i = 0; i < _root_node->_count; ++i)
+            _node_type* new_node = spare_nodes.back();
+            spare_nodes.pop_back();
+
+            if (at_end)
+            {
+                uint32_t keep_count = __bucket_nodes_capacity_max - __bucket_nodes_capacity_max / 2;
+                uint32_t move_count = __bucket_nodes_capacity_max - keep_count;
+
+                move_slots(new_node, 0, edge_node, keep_count, move_count);
+                set_slot(new_node, move_count, node, depth - 1);
+                if (__separator_keys)
                 {
-                    _awrapper.construct(new_root_node->values() + i, std::move(_root_node->values()[i]));
-                    _awrapper.destroy(_root_node->values() + i);
+                    separator_keys(new_node)[move_count] = *node_key;
                 }
 
-                it._value_ptr = new_root_node->values() + (it._value_ptr - _root_node->values());
+                new_node->_count = move_count + 1;
+                edge_node->_count = keep_count;
 
-                deallocate_root_node();
-                _root_node = new_root_node;
+                node_key = separator_keys(new_node);
             }
+            else
+            {
+                uint32_t move_count = __bucket_nodes_capacity_max / 2;
 
-            cur_node = _root_node;
+                move_slots(new_node, 1, edge_node, 0, move_count);
+                set_slot(new_node, 0, node, depth - 1);
+                if (__separator_keys)
+                {
+                    separator_keys(new_node)[1] = *node_key;
+                }
+
+                move_slots(edge_node, 0, edge_node, move_count, __bucket_nodes_capacity_max - move_count);
+
+                new_node->_count = move_count + 1;
+                edge_node->_count = __bucket_nodes_capacity_max - move_count;
+
+                node_key = separator_keys(edge_node);
+
+                if (!__separator_keys && depth < _tree_height)
+                {
+                    edge_node->_ref_value = (*edge_node->nodes())->_ref_value;
+                }
+            }
+
+            if (!__separator_keys)
+            {
+                new_node->_ref_value = (*new_node->nodes())->_ref_value;
+            }
+
+            node = new_node;
         }
-        else
+
+        // the iterators keep a stack of _tree_height_max levels, which a tree holding max_size() values never exceeds
+        assert(_tree_height < _tree_height_max);
+
+        _node_type* old_root_node = demote_root();
+
+        _root_node = allocate_root_node_from(spare_nodes);
+        _root_node->_count = 2;
+        set_slot(_root_node, at_end? 0 : 1, old_root_node, _tree_height);
+        set_slot(_root_node, at_end? 1 : 0, node, _tree_height);
+
+        if (__separator_keys)
         {
-            cur_node = *it._stack[0];
+            separator_keys(_root_node)[1] = *node_key;
         }
 
-        if (cur_node->_count < __bucket_values_capacity_max)
+        ++_tree_height;
+
+        balance_edge(at_end);
+    }
+
+    // the nodes on the right edge, or the left one, may have been left with few slots or values by split() and
+    // graft_node(). from the leaves up, each of them less than half full takes slots or values from its sibling in
+    // the edge node above, or is merged with it when both fit into one, see balance_slots(). the roots with a single
+    // child are dropped afterwards, so that repeated splits and joins don't make the tree any higher than insertions.
+    void balance_edge(bool right_edge) noexcept
+    {
+        _node_type* edge_nodes[_tree_height_max + 1];
+        edge_nodes[_tree_height] = _root_node;
+
+        for (uint32_t depth = _tree_height; depth > 1; --depth)
         {
-            if (it._value_ptr == cur_node->values_end())
+            edge_nodes[depth - 1] = right_edge? *(edge_nodes[depth]->nodes_end() - 1) : *edge_nodes[depth]->nodes();
+        }
+
+        for (uint32_t depth = 0; depth < _tree_height; ++depth)
+        {
+            _node_type* parent_node = edge_nodes[depth + 1];
+
+            if (parent_node->_count > 1)
+            {
+                balance_slots(parent_node, right_edge? parent_node->_count - 2 : 0, depth);
+            }
+        }
+
+        shrink_root();
+    }
+
+    // balances the children at depth in slots pos and pos + 1 of node when either is less than half full. the right
+    // one is merged into the left one when both fit, otherwise slots or values are moved so that both are half full.
+    // the last child of the left one and the first child of the right one end up side by side in one node then,
+    // they're balanced in turn, down to the leaves.
+    void balance_slots(_node_type* node, uint32_t pos, uint32_t depth) noexcept
+    {
+        _node_type* left_node = node->nodes()[pos];
+        _node_type* right_node = node->nodes()[pos + 1];
+        _key_type* right_key = separator_keys(node) + pos + 1;
+
+        uint32_t capacity = (depth > 0)? __bucket_nodes_capacity_max : __bucket_values_capacity_max;
+
+        if (left_node->_count >= capacity / 2 && right_node->_count >= capacity / 2)
+        {
+            return;
+        }
+
+        _node_type* seam_node = left_node;
+        uint32_t seam_pos = left_node->_count;
+
+        if (left_node->_count + right_node->_count <= capacity)
+        {
+            merge_next_node(left_node, right_node, depth, right_key);
+            refresh_merged_slot(node, pos, depth + 1);
+
+            move_slots(node, pos + 1, node, pos + 2, node->_count - pos - 2);
+            --node->_count;
+        }
+        else
+        {
+            uint32_t left_count = (left_node->_count + right_node->_count) / 2;
+
+            if (left_node->_count < left_count)
             {
-                _awrapper.construct(it._value_ptr, std::forward<_args>(args)...);
+                move_to_prev_node(left_node, right_node, left_count - left_node->_count, depth, right_key);
             }
             else
             {
-                _awrapper.construct(cur_node->values_end(), std::move(cur_node->values()[cur_node->_count - 1]));
+                seam_node = right_node;
+                seam_pos = left_node->_count - left_count;
+
+                move_to_next_node(left_node, right_node, seam_pos, depth, right_key);
+            }
+
+            if (!__separator_keys && depth > 0)
+            {
+                right_node->_ref_value = (*right_node->nodes())->_ref_value;
+            }
+
+            refresh_slot(node, pos, depth + 1);
+            refresh_slot(node, pos + 1, depth + 1);
+        }
+
+        if (depth > 0 && seam_pos > 0 && seam_pos < seam_node->_count)
+        {
+            balance_slots(seam_node, seam_pos - 1, depth - 1);
+        }
+    }
+
+    // moves the first count values or slots of right_node to the end of left_node, its sibling before it
+    void move_to_prev_node(_node_type* left_node, _node_type* right_node, uint32_t count, uint32_t depth,
+                           _key_type* right_key) noexcept
+    {
+        uint32_t right_count = right_node->_count;
 
-                std::move_backward(it._value_ptr,
-                                   cur_node->values_end() - 1,
-                                   (_moveable_value_type*)cur_node->values_end());
+        if (depth > 0)
+        {
+            move_slots(left_node, left_node->_count, right_node, 0, count);
 
-                *(_moveable_value_type*)it._value_ptr = _moveable_value_type(std::forward<_args>(args)...);
+            if (__separator_keys)
+            {
+                separator_keys(left_node)[left_node->_count] = *right_key;
+                *right_key = separator_keys(right_node)[count];
             }
 
-            ++cur_node->_count;
+            move_slots(right_node, 0, right_node, count, right_count - count);
+        }
+        else
+        {
+            relocate_values(left_node, left_node->_count, right_node, 0, count);
+            move_values(right_node, count, right_count, 0);
+            destroy_values(right_node, right_count - count, right_count);
 
-            return;
+            if (__separator_keys)
+            {
+                *right_key = _key_of_value()(*right_node->values());
+            }
         }
 
-        _node_type *new_node = allocate_node();
-        new_node->_ref_value = new_node->values();
+        left_node->_count += count;
+        right_node->_count = right_count - count;
+    }
 
-        bool x_in_new_node;
-        uint32_t insert_pos = (uint32_t)(it._value_ptr - cur_node->values());
+    // moves the last count values or slots of left_node to the front of right_node, its sibling after it
+    void move_to_next_node(_node_type* left_node, _node_type* right_node, uint32_t count, uint32_t depth,
+                           _key_type* right_key) noexcept
+    {
+        uint32_t left_count = left_node->_count - count;
 
-        if (insert_pos < __bucket_values_capacity_max - __bucket_values_capacity_max / 2)
+        if (depth > 0)
         {
-            _awrapper.construct(new_node->values(), std::move(cur_node->values()[__bucket_values_capacity_max / 2]));
+            move_slots(right_node, count, right_node, 0, right_node->_count);
+            move_slots(right_node, 0, left_node, left_count, count);
 
-            for (uint32_t i = 1; i < __bucket_values_capacity_max - __bucket_values_capacity_max / 2; ++i)
+            if (__separator_keys)
             {
-                _awrapper.construct(new_node->values() + i, std::move(cur_node->values()[__bucket_values_capacity_max / 2 + i]));
-                _awrapper.destroy(cur_node->values() + __bucket_values_capacity_max / 2 + i);
+                separator_keys(right_node)[count] = *right_key;
+                *right_key = *separator_keys(right_node);
             }
-
-            std::move_backward(it._value_ptr,
-                               cur_node->values() + __bucket_values_capacity_max / 2,
-                               (_moveable_value_type*)cur_node->values() + __bucket_values_capacity_max / 2 + 1);
-
-            new_node->_count = __bucket_values_capacity_max - __bucket_values_capacity_max / 2;
-            cur_node->_count = __bucket_values_capacity_max / 2 + 1;
-
-            x_in_new_node = false;
         }
         else
         {
-            const uint32_t move_pos = __bucket_values_capacity_max - __bucket_values_capacity_max / 2;
-
-            for (uint32_t i = move_pos; i < insert_pos; ++i)
+            for (uint32_t i = right_node->_count; i > 0; --i)
             {
-                _awrapper.construct(new_node->values() + i - move_pos, std::move(cur_node->values()[i]));
-                _awrapper.destroy(cur_node->values() + i);
+                relocate_values(right_node, i - 1 + count, right_node, i - 1, 1);
             }
-            for (uint32_t i = insert_pos; i < __bucket_values_capacity_max; ++i)
+
+            relocate_values(right_node, 0, left_node, left_count, count);
+
+            if (__separator_keys)
             {
-                _awrapper.construct(new_node->values() + i - move_pos + 1, std::move(cur_node->values()[i]));
-                _awrapper.destroy(cur_node->values() + i);
+                *right_key = _key_of_value()(*right_node->values());
             }
+        }
 
-            new_node->_count = __bucket_values_capacity_max / 2 + 1;
-            cur_node->_count = __bucket_values_capacity_max - __bucket_values_capacity_max / 2;
+        left_node->_count = left_count;
+        right_node->_count += count;
+    }
 
-            it._value_ptr = new_node->values() + insert_pos - move_pos;
-            x_in_new_node = true;
-        }
+    // the spare nodes of internal nodes have the size of an internal root
+    _node_type* allocate_root_node_from(std::vector<_node_type*>& spare_nodes) noexcept
+    {
+        _node_type* root_node = spare_nodes.back();
+        spare_nodes.pop_back();
+        root_node->_bucket_bysize = __internal_bucket_bysize;
+        return root_node;
+    }
+
+    // builds the tree bottom up from a range sorted by the compare of the tree without equal keys, the leaves and
+    // internal nodes are filled up to fill_factor of their capacity, which is kept between half and full like the
+    // nodes built by insertions. the tree must be empty.
+    template<typename _input_iterator>
+    void bulk_load(_input_iterator&& first, _input_iterator&& last, float fill_factor)
+    {
+        fill_factor = std::min(std::max(fill_factor, 0.5f), 1.0f);
 
-        _awrapper.construct(it._value_ptr, std::forward<_args>(args)...);
+        uint32_t leaf_values_count = std::max((uint32_t)(__bucket_values_capacity_max * fill_factor), (uint32_t)1);
+        uint32_t internal_nodes_count = std::max((uint32_t)(__bucket_nodes_capacity_max * fill_factor), (uint32_t)2);
 
-        for (uint32_t depth = 0; depth < _tree_height; ++depth)
+        std::vector<_node_type*> nodes;
+        uint32_t depth = 0;
+
+        try
         {
-            _node_type* parent_node = (depth + 1 < _tree_height)? *(it._stack[depth + 1]) :
-                                                                  _root_node;
-            insert_pos = (uint32_t)(it._stack[depth] - parent_node->nodes() + 1);
+            _node_type* leaf_node = nullptr;
 
-            if (parent_node->_count < __bucket_nodes_capacity_max)
+            for (_input_iterator pos = first; pos != last; ++pos)
             {
-                std::memmove(parent_node->nodes() + insert_pos + 1,
-                             parent_node->nodes() + insert_pos,
-                             (parent_node->_count - insert_pos) * sizeof(_node_type*));
+                if (leaf_node == nullptr || leaf_node->_count == leaf_values_count)
+                {
+                    nodes.push_back(nullptr);
 
-                parent_node->nodes()[insert_pos] = new_node;
+                    _node_type* prev_leaf_node = leaf_node;
+                    leaf_node = allocate_node(0);
+                    leaf_node->_count = 0;
+                    nodes.back() = leaf_node;
 
-                ++parent_node->_count;
-                it._stack[depth] += x_in_new_node;
+                    if (!__separator_keys)
+                    {
+                        leaf_node->_ref_value = leaf_node->values();
+                    }
 
-                return;
+                    link_leaf(leaf_node, prev_leaf_node, nullptr);
+                }
+
+                construct_value(leaf_node, leaf_node->values() + leaf_node->_count, *pos);
+                ++leaf_node->_count;
+                ++_values_count;
             }
 
-            _node_type *new_parent_node = allocate_node();
+            if (nodes.empty())
+            {
+                return;
+            }
 
-            if (insert_pos < __bucket_nodes_capacity_max - __bucket_nodes_capacity_max / 2)
+            if (nodes.size() == 1)
             {
-                std::memcpy(new_parent_node->nodes(),
-                            parent_node->nodes() + __bucket_nodes_capacity_max / 2,
-                            (__bucket_nodes_capacity_max - __bucket_nodes_capacity_max / 2) * sizeof(_node_type*));
+                bulk_load_root_leaf(nodes[0]);
+                return;
+            }
 
-                std::memmove(parent_node->nodes() + insert_pos + 1,
-                             parent_node->nodes() + insert_pos,
-                             (__bucket_nodes_capacity_max / 2 - insert_pos) * sizeof(_node_type*));
+            // the last leaf takes values from the one before it if it's less than half full
+            _node_type* last_node = nodes.back();
+            _node_type* prev_node = nodes[nodes.size() - 2];
 
-                parent_node->nodes()[insert_pos] = new_node;
+            if (last_node->_count < prev_node->_count / 2)
+            {
+                uint32_t move_count = (prev_node->_count - last_node->_count) / 2;
 
-                new_parent_node->_count = __bucket_nodes_capacity_max - __bucket_nodes_capacity_max / 2;
-                parent_node->_count = __bucket_nodes_capacity_max / 2 + 1;
+                for (uint32_t i = last_node->_count; i > 0; --i)
+                {
+                    relocate_values(last_node, i - 1 + move_count, last_node, i - 1, 1);
+                }
 
-                it._stack[depth] += x_in_new_node;
-                x_in_new_node = false;
+                relocate_values(last_node, 0, prev_node, prev_node->_count - move_count, move_count);
+                last_node->_count += move_count;
+                prev_node->_count -= move_count;
             }
-            else
+
+            // a level above the leaves is added until the nodes fit into the root, a level is filled more than
+            // fill_factor if the levels left under the height limit couldn't hold its nodes otherwise
+            while (nodes.size() > __bucket_nodes_capacity_max)
             {
-                uint32_t new_insert_pos = insert_pos - (__bucket_nodes_capacity_max - __bucket_nodes_capacity_max / 2);
+                uint64_t upper_capacity = 1;
+                for (uint32_t i = depth + 2; i <= _tree_height_max && upper_capacity < nodes.size(); ++i)
+                {
+                    upper_capacity *= __bucket_nodes_capacity_max;
+                }
 
-                std::memcpy(new_parent_node->nodes(),
-                            parent_node->nodes() + (__bucket_nodes_capacity_max - __bucket_nodes_capacity_max / 2),
-                            new_insert_pos * sizeof(_node_type*));
+                uint32_t nodes_count = std::max(internal_nodes_count, (uint32_t)((nodes.size() + upper_capacity - 1) / upper_capacity));
+                if (nodes_count > __bucket_nodes_capacity_max)
+                {
+                    nodes_count = __bucket_nodes_capacity_max;
+                }
 
-                std::memcpy(new_parent_node->nodes() + (new_insert_pos + 1),
-                            parent_node->nodes() + insert_pos,
-                            (__bucket_nodes_capacity_max / 2 - new_insert_pos) * sizeof(_node_type*));
+                bulk_load_level(nodes, depth, nodes_count);
+                ++depth;
+            }
 
-                new_parent_node->nodes()[new_insert_pos] = new_node;
+            _root_node = allocate_root_node(__internal_bucket_bysize);
+            _root_node->_count = (uint32_t)nodes.size();
 
-                new_parent_node->_count = __bucket_nodes_capacity_max / 2 + 1;
-                parent_node->_count = __bucket_nodes_capacity_max - __bucket_nodes_capacity_max / 2;
+            for (uint32_t i = 0; i < nodes.size(); ++i)
+            {
+                set_slot(_root_node, i, nodes[i], depth);
+            }
 
-                if (new_insert_pos > 0 || x_in_new_node)
+            _tree_height = depth + 1;
+        }
+        catch (...)
+        {
+            for (_node_type* node : nodes)
+            {
+                if (node != nullptr)
                 {
-                    it._stack[depth] = new_parent_node->nodes() + (new_insert_pos - !x_in_new_node);
-                    x_in_new_node = true;
+                    destroy_node(node, depth);
                 }
             }
 
-            new_parent_node->_ref_value = (*new_parent_node->nodes())->_ref_value;
-
-            new_node = new_parent_node;
-            cur_node = parent_node;
+            _values_count = 0;
+            throw;
         }
-
-        _root_node->_ref_value = (_tree_height == 0)? _root_node->values() : (*_root_node->nodes())->_ref_value;
-
-        _root_node = allocate_root_node(_bucket_bysize_max);
-        _root_node->_count = 2;
-        _root_node->nodes()[0] = cur_node;
-        _root_node->nodes()[1] = new_node;
-
-        it._stack[_tree_height] = _root_node->nodes() + x_in_new_node;
-        ++_tree_height;
     }
 
-    template<typename _output_iterator, typename... _args>
-    void insert_first_value(_output_iterator& it, _args&&... args)
+    // replaces the only leaf by a root leaf which is just large enough
+    void bulk_load_root_leaf(_node_type* leaf_node)
     {
-        if (_root_node == nullptr)
-        {
-            _root_node = allocate_root_node(2 * sizeof(_value_type));
-        }
+        _root_node = allocate_root_node(root_leaf_bucket_bysize(leaf_node->_count));
+        _root_node->_count = leaf_node->_count;
 
-        it._value_ptr = _root_node->values();
-        _awrapper.construct(it._value_ptr, std::forward<_args>(args)...);
+        relocate_values(_root_node, 0, leaf_node, 0, leaf_node->_count);
+        deallocate_node(leaf_node, 0);
 
-        _root_node->_count = 1;
-        _values_count = 1;
+        _tree_height = 0;
     }
 
-    template<typename _output_iterator, typename _arg>
-    std::pair<_output_iterator, bool> insert(_arg&& x)
+    // groups the nodes of one level evenly under new parent nodes of at most nodes_count slots, nodes is replaced
+    // by the parents. if an allocation fails, nodes still holds the complete level.
+    void bulk_load_level(std::vector<_node_type*>& nodes, uint32_t depth, uint32_t nodes_count)
     {
-        _output_iterator it(this);
+        uint32_t parents_count = (uint32_t)((nodes.size() + nodes_count - 1) / nodes_count);
+        uint32_t slots_count = (uint32_t)(nodes.size() / parents_count);
+        uint32_t extra_count = (uint32_t)(nodes.size() % parents_count);
 
-        if (_values_count == 0)
-        {
-            insert_first_value(it, std::forward<_arg>(x));
-            return std::pair<_output_iterator, bool>(it, true);
-        }
-
-        _node_type* cur_node;
-        it._value_ptr = lower_bound_core(_key_of_value()(x), it._stack, cur_node);
+        std::vector<_node_type*> parent_nodes;
+        parent_nodes.reserve(parents_count);
 
-        if (it._value_ptr == cur_node->values_end() || value_compare(x, *it))
+        try
         {
-            insert_core(it, std::forward<_arg>(x));
-            return std::pair<_output_iterator, bool>(it, true);
+            for (uint32_t i = 0; i < parents_count; ++i)
+            {
+                parent_nodes.push_back(allocate_node(depth + 1));
+            }
         }
-        else
+        catch (...)
         {
-            return std::pair<_output_iterator, bool>(it, false);
+            for (_node_type* node : parent_nodes)
+            {
+                deallocate_node(node, depth + 1);
+            }
+            throw;
         }
-    }
-
-    template<typename _output_iterator, typename _arg>
-    _output_iterator insert(const _const_iterator& position, _arg&& x)
-    {
-        _output_iterator it(position._const_cast());
 
-        if (_values_count == 0)
-        {
-            insert_first_value(it, std::forward<_arg>(x));
-            return it;
-        }
+        uint32_t child_pos = 0;
 
-        if (it._value_ptr == nullptr)
+        for (uint32_t i = 0; i < parents_count; ++i)
         {
-            it.set_last();
+            _node_type* parent_node = parent_nodes[i];
+            parent_node->_count = slots_count + (i < extra_count);
 
-            if (value_compare(*it, x))
+            for (uint32_t j = 0; j < parent_node->_count; ++j)
             {
-                ++it._value_ptr;
-                insert_core(it, std::forward<_arg>(x));
-                return it;
+                set_slot(parent_node, j, nodes[child_pos++], depth);
             }
-        }
-        else
-        {
-            _output_iterator before(it);
-            before.decrement();
 
-            if (before._value_ptr == nullptr || value_compare(*before, x))
+            if (!__separator_keys)
             {
-                if (value_compare(x, *it))
-                {
-                    insert_core(it, std::forward<_arg>(x));
-                    return it;
-                }
+                parent_node->_ref_value = (*parent_node->nodes())->_ref_value;
             }
         }
 
-        _node_type* cur_node;
-        it._value_ptr = lower_bound_core(_key_of_value()(x), it._stack, cur_node);
-
-        if (it._value_ptr == cur_node->values_end() || value_compare(x, *it))
-        {
-            insert_core(it, std::forward<_arg>(x));
-        }
-
-        return it;
-    }
-
-    template<typename _input_iterator>
-    void insert_range(_input_iterator&& first, _input_iterator&& last)
-    {
-        _const_iterator it_end(this, nullptr);
-
-        for (_input_iterator pos = first; pos != last; ++pos)
-        {
-            insert<_iterator>(it_end, *pos);
-        }
+        nodes.swap(parent_nodes);
     }
 
     void update_ref_value(_node_type*** stack, uint32_t depth, _value_type* ref_value)
@@ -869,20 +4317,17 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
         }
     }
 
-    template<typename _output_iterator, typename _input_iterator>
-    _output_iterator erase_core(const _input_iterator& it)
+    template<typename _output_iterator>
+    _output_iterator erase_core(const _path& it)
     {
-        _output_iterator out(it._const_cast());
+        _output_iterator out(it);
 
         _node_type* cur_node = (_tree_height > 0)? *it._stack[0] : _root_node;
         uint32_t erase_pos = (uint32_t)(it._value_ptr - cur_node->values());
         bool value_at_end = erase_pos + 1 >= cur_node->_count;
 
-        std::move(it._value_ptr + 1,
-                  cur_node->values_end(),
-                  (_moveable_value_type*)it._value_ptr);
-
-        _awrapper.destroy(cur_node->values_end() - 1);
+        move_values(cur_node, erase_pos + 1, cur_node->_count, erase_pos);
+        destroy_values(cur_node, cur_node->_count - 1, cur_node->_count);
 
         --_values_count;
         --cur_node->_count;
@@ -891,16 +4336,15 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
         {
             out._value_ptr = (_value_type*)((uintptr_t)it._value_ptr * !value_at_end);
 
-            if (_root_node->_count * sizeof(_value_type) < _root_node->_bucket_bysize >> 1)
+            // the root shrinks down to the two values it started with, below that an emptied root couldn't take the
+            // next first value
+            if (!__soa_leaves && _root_node->_count * sizeof(_value_type) < _root_node->_bucket_bysize >> 1 &&
+                _root_node->_bucket_bysize > 2 * sizeof(_value_type))
             {
                 _node_type* new_root_node = allocate_root_node(_root_node->_bucket_bysize >> 1);
                 new_root_node->_count = _root_node->_count;
 
-                for (uint32_t i = 0; i < _root_node->_count; ++i)
-                {
-                    _awrapper.construct(new_root_node->values() + i, std::move(_root_node->values()[i]));
-                    _awrapper.destroy(_root_node->values() + i);
-                }
+                relocate_values(new_root_node, 0, _root_node, 0, _root_node->_count);
 
                 if (out._value_ptr != nullptr)
                 {
@@ -914,6 +4358,8 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
             return out;
         }
 
+        add_subtree_counts(const_cast<_node_type***>(it._stack), -1);
+
         _node_type* parent_node = (_tree_height > 1)? *it._stack[1] : _root_node;
         uint32_t cur_node_pos = (uint32_t)(it._stack[0] - parent_node->nodes());
         bool node_at_end = cur_node_pos + 1 >= parent_node->_count;
@@ -926,29 +4372,26 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
             {
                 --out._stack[0];
 
-                if (cur_node_pos == 0 && parent_node != _root_node)
+                if (!__separator_keys && cur_node_pos == 0 && parent_node != _root_node)
                 {
                     parent_node->_ref_value = parent_node->nodes()[1]->_ref_value;
                     update_ref_value(const_cast<_node_type***>(it._stack), 1, parent_node->_ref_value);
                 }
 
-                std::memmove(it._stack[0],
-                             it._stack[0] + 1,
-                             (parent_node->_count - cur_node_pos - 1) * sizeof(_node_type*));
+                move_slots(parent_node, cur_node_pos,
+                           parent_node, cur_node_pos + 1,
+                           parent_node->_count - cur_node_pos - 1);
             }
 
-            deallocate_node(cur_node);
+            unlink_leaf(cur_node);
+            deallocate_node(cur_node, 0);
         }
         else if (cur_node_pos > 0 &&
                  cur_node->_count + parent_node->nodes()[cur_node_pos - 1]->_count <= __bucket_values_capacity_max / 2)
         {
             _node_type* prev_node = parent_node->nodes()[cur_node_pos - 1];
 
-            for (uint32_t i = 0; i < cur_node->_count; ++i)
-            {
-                _awrapper.construct(prev_node->values_end() + i, std::move(cur_node->values()[i]));
-                _awrapper.destroy(cur_node->values() + i);
-            }
+            relocate_values(prev_node, prev_node->_count, cur_node, 0, cur_node->_count);
 
             if (!value_at_end)
             {
@@ -962,34 +4405,36 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
             }
 
             prev_node->_count += cur_node->_count;
+            refresh_merged_slot(parent_node, cur_node_pos - 1, 1);
 
-            std::memmove(it._stack[0],
-                         it._stack[0] + 1,
-                         (parent_node->_count - cur_node_pos - 1) * sizeof(_node_type*));
+            move_slots(parent_node, cur_node_pos,
+                       parent_node, cur_node_pos + 1,
+                       parent_node->_count - cur_node_pos - 1);
 
-            deallocate_node(cur_node);
+            unlink_leaf(cur_node);
+            deallocate_node(cur_node, 0);
         }
         else if (!node_at_end &&
                  cur_node->_count + parent_node->nodes()[cur_node_pos + 1]->_count <= __bucket_values_capacity_max / 2)
         {
             _node_type* next_node = parent_node->nodes()[cur_node_pos + 1];
 
-            for (uint32_t i = 0; i < next_node->_count; ++i)
-            {
-                _awrapper.construct(cur_node->values_end() + i, std::move(next_node->values()[i]));
-                _awrapper.destroy(next_node->values() + i);
-            }
+            relocate_values(cur_node, cur_node->_count, next_node, 0, next_node->_count);
 
             cur_node->_count += next_node->_count;
+            refresh_merged_slot(parent_node, cur_node_pos, 1);
 
-            std::memmove(it._stack[0] + 1,
-                         it._stack[0] + 2,
-                         (parent_node->_count - cur_node_pos - 2) * sizeof(_node_type*));
+            move_slots(parent_node, cur_node_pos + 1,
+                       parent_node, cur_node_pos + 2,
+                       parent_node->_count - cur_node_pos - 2);
 
-            deallocate_node(next_node);
+            unlink_leaf(next_node);
+            deallocate_node(next_node, 0);
         }
         else
         {
+            refresh_aggregates(it._stack, 0);
+
             if (value_at_end)
             {
                 out.cross_node_increment();
@@ -1014,27 +4459,25 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
                 {
                     --out._stack[depth];
 
-                    if (cur_node_pos == 0 && parent_node != _root_node)
+                    if (!__separator_keys && cur_node_pos == 0 && parent_node != _root_node)
                     {
                         parent_node->_ref_value = parent_node->nodes()[1]->_ref_value;
                         update_ref_value(const_cast<_node_type***>(it._stack), depth + 1, parent_node->_ref_value);
                     }
 
-                    std::memmove(it._stack[depth],
-                                 it._stack[depth] + 1,
-                                 (parent_node->_count - cur_node_pos - 1) * sizeof(_node_type*));
+                    move_slots(parent_node, cur_node_pos,
+                               parent_node, cur_node_pos + 1,
+                               parent_node->_count - cur_node_pos - 1);
                 }
 
-                deallocate_node(cur_node);
+                deallocate_node(cur_node, depth);
             }
             else if (cur_node_pos > 0 &&
                      cur_node->_count + parent_node->nodes()[cur_node_pos - 1]->_count <= __bucket_nodes_capacity_max / 2)
             {
                 _node_type* prev_node = parent_node->nodes()[cur_node_pos - 1];
 
-                std::memcpy(prev_node->nodes_end(),
-                            cur_node->nodes(),
-                            cur_node->_count * sizeof(_node_type*));
+                merge_slots(prev_node, cur_node, parent_node, cur_node_pos);
 
                 if (out._stack[depth] == it._stack[depth])
                 {
@@ -1047,21 +4490,20 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
                 }
 
                 prev_node->_count += cur_node->_count;
+                refresh_merged_slot(parent_node, cur_node_pos - 1, depth + 1);
 
-                std::memmove(it._stack[depth],
-                             it._stack[depth] + 1,
-                             (parent_node->_count - cur_node_pos - 1) * sizeof(_node_type*));
+                move_slots(parent_node, cur_node_pos,
+                           parent_node, cur_node_pos + 1,
+                           parent_node->_count - cur_node_pos - 1);
 
-                deallocate_node(cur_node);
+                deallocate_node(cur_node, depth);
             }
             else if (!node_at_end &&
                      cur_node->_count + parent_node->nodes()[cur_node_pos + 1]->_count <= __bucket_nodes_capacity_max / 2)
             {
                 _node_type* next_node = parent_node->nodes()[cur_node_pos + 1];
 
-                std::memcpy(cur_node->nodes_end(),
-                            next_node->nodes(),
-                            next_node->_count * sizeof(_node_type*));
+                merge_slots(cur_node, next_node, parent_node, cur_node_pos + 1);
 
                 if (out._stack[depth] == it._stack[depth] + 1)
                 {
@@ -1070,15 +4512,17 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
                 }
 
                 cur_node->_count += next_node->_count;
+                refresh_merged_slot(parent_node, cur_node_pos, depth + 1);
 
-                std::memmove(it._stack[depth] + 1,
-                             it._stack[depth] + 2,
-                             (parent_node->_count - cur_node_pos - 2) * sizeof(_node_type*));
+                move_slots(parent_node, cur_node_pos + 1,
+                           parent_node, cur_node_pos + 2,
+                           parent_node->_count - cur_node_pos - 2);
 
-                deallocate_node(next_node);
+                deallocate_node(next_node, depth);
             }
             else
             {
+                refresh_aggregates(it._stack, depth);
                 return out;
             }
 
@@ -1090,9 +4534,52 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
             _node_type* new_root_node = *_root_node->nodes();
             deallocate_root_node();
             _root_node = new_root_node;
-            _root_node->_bucket_bysize = _bucket_bysize_max;
-
             --_tree_height;
+            _root_node->_bucket_bysize = bucket_bysize_max(_tree_height);
+        }
+
+        return out;
+    }
+
+    template<typename _output_iterator>
+    _output_iterator erase_at(const _const_iterator& position, std::false_type /*leaf_links*/)
+    {
+        if (_shared_nodes)
+        {
+            _path it(position);
+            unshare_path(it, true);
+            return erase_core<_output_iterator>(it);
+        }
+
+        return erase_core<_output_iterator>(position);
+    }
+
+    // a leaf which stays more than half full can't be merged, so no path is needed to erase from it unless
+    // the counts or aggregates above it have to follow
+    template<typename _output_iterator>
+    _output_iterator erase_at(const _const_iterator& position, std::true_type /*leaf_links*/)
+    {
+        _node_type* cur_node = position._leaf_node;
+
+        if (_tree_height == 0 || cur_node->_count <= __bucket_values_capacity_max / 2 + 1 || __subtree_counts || __aggregates)
+        {
+            return _output_iterator(erase_core<_path>(make_path(position, std::true_type())));
+        }
+
+        _output_iterator out(position._const_cast());
+
+        uint32_t erase_pos = (uint32_t)(out._value_ptr - cur_node->values());
+
+        move_values(cur_node, erase_pos + 1, cur_node->_count, erase_pos);
+        destroy_values(cur_node, cur_node->_count - 1, cur_node->_count);
+
+        --_values_count;
+        --cur_node->_count;
+
+        if (out._value_ptr == cur_node->values_end())
+        {
+            out._leaf_node = cur_node->_next_leaf;
+            out._value_ptr = (out._leaf_node != nullptr)? out._leaf_node->values() : nullptr;
         }
 
         return out;
@@ -1103,7 +4590,7 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
     {
         if (position._value_ptr != nullptr)
         {
-            return erase_core<_output_iterator>(position);
+            return erase_at<_output_iterator>(position, std::integral_constant<bool, __leaf_links>());
         }
         else
         {
@@ -1111,17 +4598,32 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
         }
     }
 
-    size_t erase(const _key_type& key)
+    template<typename _kt>
+    size_t erase_key(const _kt& key)
     {
+        if (__equal_keys)
+        {
+            size_t values_count = _values_count;
+            std::pair<_const_iterator, _const_iterator> range = equal_range<_const_iterator>(key);
+
+            erase_range<_const_iterator>(range.first, range.second);
+            return values_count - _values_count;
+        }
+
         if (_values_count > 0)
         {
-            _const_iterator it(this);
+            _path it(this);
             _node_type* cur_node;
             it._value_ptr = lower_bound_core(key, it._stack, cur_node);
 
-            if (it._value_ptr != cur_node->values_end() && !key_less(key, *it))
+            if (it._value_ptr != cur_node->values_end() && !key_less(key, *it._value_ptr))
             {
-                erase_core<_const_iterator>(it);
+                if (_shared_nodes)
+                {
+                    unshare_path(it, true);
+                }
+
+                erase_core<_path>(it);
                 return 1;
             }
         }
@@ -1129,12 +4631,12 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
         return 0;
     }
 
-    void erase_range_core(const _const_iterator& first)
+    void erase_range_core(const _path& first)
     {
         _node_type* cur_node = (_tree_height > 0)? *first._stack[0] : _root_node;
         uint32_t erase_count = (uint32_t)(cur_node->values_end() - first._value_ptr);
 
-        _awrapper.destroy(first._value_ptr, cur_node->values_end());
+        destroy_values(cur_node, cur_node->_count - erase_count, cur_node->_count);
 
         cur_node->_count -= erase_count;
         _values_count -= erase_count;
@@ -1150,29 +4652,24 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
 
         if (cur_node_is_empty)
         {
-            deallocate_node(cur_node);
+            deallocate_node(cur_node, 0);
         }
         else if (cur_node_pos > 0 &&
                  cur_node->_count + parent_node->nodes()[cur_node_pos - 1]->_count <= __bucket_values_capacity_max / 2)
         {
             _node_type* prev_node = parent_node->nodes()[cur_node_pos - 1];
 
-            for (uint32_t i = 0; i < cur_node->_count; ++i)
-            {
-                _awrapper.construct(prev_node->values_end() + i, std::move(cur_node->values()[i]));
-                _awrapper.destroy(cur_node->values() + i);
-            }
+            relocate_values(prev_node, prev_node->_count, cur_node, 0, cur_node->_count);
 
             prev_node->_count += cur_node->_count;
-            deallocate_node(cur_node);
+            deallocate_node(cur_node, 0);
             cur_node_is_empty = true;
         }
 
         _node_type** erase_nodes_end = parent_node->nodes_end();
         for (_node_type** node_ptr = first._stack[0] + 1; node_ptr < erase_nodes_end; ++node_ptr)
         {
-            clear_node(*node_ptr, 0);
-            deallocate_node(*node_ptr);
+            destroy_node(*node_ptr, 0);
         }
 
         parent_node->_count = cur_node_pos + !cur_node_is_empty;
@@ -1187,27 +4684,24 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
 
             if (cur_node_is_empty)
             {
-                deallocate_node(cur_node);
+                deallocate_node(cur_node, depth);
             }
             else if (cur_node_pos > 0 &&
                      cur_node->_count + parent_node->nodes()[cur_node_pos - 1]->_count <= __bucket_nodes_capacity_max / 2)
             {
                 _node_type* prev_node = parent_node->nodes()[cur_node_pos - 1];
 
-                std::memcpy(prev_node->nodes_end(),
-                            cur_node->nodes(),
-                            cur_node->_count * sizeof(_node_type*));
+                merge_slots(prev_node, cur_node, parent_node, cur_node_pos);
 
                 prev_node->_count += cur_node->_count;
-                deallocate_node(cur_node);
+                deallocate_node(cur_node, depth);
                 cur_node_is_empty = true;
             }
 
             erase_nodes_end = parent_node->nodes_end();
             for (_node_type** node_ptr = first._stack[depth] + 1; node_ptr < erase_nodes_end; ++node_ptr)
             {
-                clear_node(*node_ptr, depth);
-                deallocate_node(*node_ptr);
+                destroy_node(*node_ptr, depth);
             }
 
             parent_node->_count = cur_node_pos + !cur_node_is_empty;
@@ -1215,10 +4709,9 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
     }
 
     template<typename _output_iterator>
-    _output_iterator erase_range_core(const _const_iterator& first,
-                                      const _const_iterator& last)
+    _output_iterator erase_range_core(const _path& first, const _path& last)
     {
-        _output_iterator out(last._const_cast());
+        _output_iterator out(last);
 
         bool same_parent;
         _node_type* first_cur_node;
@@ -1242,8 +4735,9 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
         {
             first_erase_count = (uint32_t)(last._value_ptr - first._value_ptr);
 
-            std::move(last._value_ptr, first_cur_node->values_end(), (_moveable_value_type*)first._value_ptr);
-            _awrapper.destroy(first_cur_node->values_end() - first_erase_count, first_cur_node->values_end());
+            move_values(first_cur_node, (uint32_t)(last._value_ptr - first_cur_node->values()), first_cur_node->_count,
+                        (uint32_t)(first._value_ptr - first_cur_node->values()));
+            destroy_values(first_cur_node, first_cur_node->_count - first_erase_count, first_cur_node->_count);
 
             first_cur_node->_count -= first_erase_count;
             _values_count -= first_erase_count;
@@ -1258,18 +4752,21 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
         {
             first_erase_count = (uint32_t)(first_cur_node->values_end() - first._value_ptr);
 
-            _awrapper.destroy(first._value_ptr, first_cur_node->values_end());
+            destroy_values(first_cur_node, first_cur_node->_count - first_erase_count, first_cur_node->_count);
 
             first_cur_node->_count -= first_erase_count;
             _values_count -= first_erase_count;
 
             last_erase_count = (uint32_t)(last._value_ptr - last_cur_node->values());
 
-            std::move(last._value_ptr, last_cur_node->values_end(), (_moveable_value_type*)last_cur_node->values());
-            _awrapper.destroy(last_cur_node->values_end() - last_erase_count, last_cur_node->values_end());
+            if (last_erase_count > 0)
+            {
+                move_values(last_cur_node, last_erase_count, last_cur_node->_count, 0);
+                destroy_values(last_cur_node, last_cur_node->_count - last_erase_count, last_cur_node->_count);
 
-            last_cur_node->_count -= last_erase_count;
-            _values_count -= last_erase_count;
+                last_cur_node->_count -= last_erase_count;
+                _values_count -= last_erase_count;
+            }
 
             out._value_ptr = last_cur_node->values();
         }
@@ -1296,7 +4793,7 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
 
         if (first_cur_node_is_empty)
         {
-            deallocate_node(first_cur_node);
+            deallocate_node(first_cur_node, 0);
             new_first_cur_node = (first_cur_node_pos > 0)? first_parent_node->nodes()[first_cur_node_pos - 1] : nullptr;
         }
         else if (first_cur_node_pos > 0 &&
@@ -1304,11 +4801,7 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
         {
             new_first_cur_node = first_parent_node->nodes()[first_cur_node_pos - 1];
 
-            for (uint32_t i = 0; i < first_cur_node->_count; ++i)
-            {
-                _awrapper.construct(new_first_cur_node->values_end() + i, std::move(first_cur_node->values()[i]));
-                _awrapper.destroy(first_cur_node->values() + i);
-            }
+            relocate_values(new_first_cur_node, new_first_cur_node->_count, first_cur_node, 0, first_cur_node->_count);
 
             if (same_parent)
             {
@@ -1317,7 +4810,7 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
             }
 
             new_first_cur_node->_count += first_cur_node->_count;
-            deallocate_node(first_cur_node);
+            deallocate_node(first_cur_node, 0);
             first_cur_node_is_empty = true;
         }
 
@@ -1330,19 +4823,14 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
         {
             _node_type* last_next_node = last_parent_node->nodes()[last_cur_node_pos + 1];
 
-            for (uint32_t i = 0; i < last_next_node->_count; ++i)
-            {
-                _awrapper.construct(last_cur_node->values_end() + i, std::move(last_next_node->values()[i]));
-                _awrapper.destroy(last_next_node->values() + i);
-            }
+            relocate_values(last_cur_node, last_cur_node->_count, last_next_node, 0, last_next_node->_count);
 
             last_cur_node->_count += last_next_node->_count;
-            deallocate_node(last_next_node);
+            deallocate_node(last_next_node, 0);
             last_next_node_is_empty = true;
         }
 
         uint32_t old_first_parent_node_count = first_parent_node->_count;
-        uint32_t old_last_parent_node_count = last_parent_node->_count;
 
         if (parent_same_parent)
         {
@@ -1355,22 +4843,18 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
                 {
                     _node_type* first_next_node = first_parent_node->nodes()[first_cur_node_pos + 1];
 
-                    for (uint32_t i = 0; i < first_next_node->_count; ++i)
-                    {
-                        _awrapper.construct(new_first_cur_node->values_end() + i, std::move(first_next_node->values()[i]));
-                        _awrapper.destroy(first_next_node->values() + i);
-                    }
+                    relocate_values(new_first_cur_node, new_first_cur_node->_count, first_next_node, 0, first_next_node->_count);
 
                     new_first_cur_node->_count += first_next_node->_count;
-                    deallocate_node(first_next_node);
+                    deallocate_node(first_next_node, 0);
                     first_next_node_is_empty = true;
                 }
 
                 if (first_cur_node_is_empty || first_next_node_is_empty)
                 {
-                    std::memmove(first_parent_node->nodes() + (first_cur_node_pos + !first_cur_node_is_empty),
-                                 first_parent_node->nodes() + (first_cur_node_pos + 1 + first_next_node_is_empty),
-                                 (first_parent_node->_count - first_cur_node_pos - 1 - first_next_node_is_empty) * sizeof(_node_type*));
+                    move_slots(first_parent_node, first_cur_node_pos + !first_cur_node_is_empty,
+                               first_parent_node, first_cur_node_pos + 1 + first_next_node_is_empty,
+                               first_parent_node->_count - first_cur_node_pos - 1 - first_next_node_is_empty);
 
                     first_parent_node->_count -= first_cur_node_is_empty + first_next_node_is_empty;
                 }
@@ -1380,8 +4864,7 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
                 _node_type** erase_nodes_end = last._stack[0];
                 for (_node_type** node_ptr = first._stack[0] + 1; node_ptr < erase_nodes_end; ++node_ptr)
                 {
-                    clear_node(*node_ptr, 0);
-                    deallocate_node(*node_ptr);
+                    destroy_node(*node_ptr, 0);
                 }
 
                 uint32_t count_1 = first_cur_node_pos + !first_cur_node_is_empty;
@@ -1391,17 +4874,13 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
                 if (new_first_cur_node != nullptr &&
                     new_first_cur_node->_count + last_cur_node->_count <= __bucket_values_capacity_max / 2)
                 {
-                    for (uint32_t i = 0; i < last_cur_node->_count; ++i)
-                    {
-                        _awrapper.construct(new_first_cur_node->values_end() + i, std::move(last_cur_node->values()[i]));
-                        _awrapper.destroy(last_cur_node->values() + i);
-                    }
+                    relocate_values(new_first_cur_node, new_first_cur_node->_count, last_cur_node, 0, last_cur_node->_count);
 
                     out._value_ptr = new_first_cur_node->values_end();
                     out._stack[0] = first._stack[0] - first_cur_node_is_empty;
 
                     new_first_cur_node->_count += last_cur_node->_count;
-                    deallocate_node(last_cur_node);
+                    deallocate_node(last_cur_node, 0);
                     last_cur_node_is_empty = true;
                 }
                 else
@@ -1414,24 +4893,26 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
                 {
                     if (last_cur_node_is_empty)
                     {
-                        std::memmove(first_parent_node->nodes() + count_1,
-                                     erase_nodes_end + 2,
-                                     (count_2 - 2) * sizeof(_node_type*));
+                        move_slots(first_parent_node, count_1,
+                                   first_parent_node, last_cur_node_pos + 2,
+                                   count_2 - 2);
                     }
                     else
                     {
-                        first_parent_node->nodes()[count_1] = last_cur_node;
+                        move_slots(first_parent_node, count_1,
+                                   first_parent_node, last_cur_node_pos,
+                                   1);
 
-                        std::memmove(first_parent_node->nodes() + (count_1 + 1),
-                                     erase_nodes_end + 2,
-                                     (count_2 - 2) * sizeof(_node_type*));
+                        move_slots(first_parent_node, count_1 + 1,
+                                   first_parent_node, last_cur_node_pos + 2,
+                                   count_2 - 2);
                     }
                 }
                 else
                 {
-                    std::memmove(first_parent_node->nodes() + count_1,
-                                 erase_nodes_end + last_cur_node_is_empty,
-                                 (count_2 - last_cur_node_is_empty) * sizeof(_node_type*));
+                    move_slots(first_parent_node, count_1,
+                               first_parent_node, last_cur_node_pos + last_cur_node_is_empty,
+                               count_2 - last_cur_node_is_empty);
                 }
 
                 first_parent_node->_count = count_1 + count_2 - last_cur_node_is_empty - last_next_node_is_empty;
@@ -1442,8 +4923,7 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
             _node_type** erase_nodes_end = first_parent_node->nodes_end();
             for (_node_type** node_ptr = first._stack[0] + 1; node_ptr < erase_nodes_end; ++node_ptr)
             {
-                clear_node(*node_ptr, 0);
-                deallocate_node(*node_ptr);
+                destroy_node(*node_ptr, 0);
             }
 
             first_parent_node->_count = first_cur_node_pos + !first_cur_node_is_empty;
@@ -1451,15 +4931,14 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
             erase_nodes_end = last._stack[0];
             for (_node_type** node_ptr = last_parent_node->nodes(); node_ptr < erase_nodes_end; ++node_ptr)
             {
-                clear_node(*node_ptr, 0);
-                deallocate_node(*node_ptr);
+                destroy_node(*node_ptr, 0);
             }
 
             if (last_cur_node_pos + last_next_node_is_empty > 0)
             {
-                std::memmove(last_parent_node->nodes() + 1,
-                             last_parent_node->nodes() + (last_cur_node_pos + last_next_node_is_empty + 1),
-                             (last_parent_node->_count - last_cur_node_pos - last_next_node_is_empty - 1) * sizeof(_node_type*));
+                move_slots(last_parent_node, 1,
+                           last_parent_node, last_cur_node_pos + last_next_node_is_empty + 1,
+                           last_parent_node->_count - last_cur_node_pos - last_next_node_is_empty - 1);
 
                 last_parent_node->_count -= last_cur_node_pos + last_next_node_is_empty;
             }
@@ -1471,13 +4950,13 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
             }
         }
 
-        if (first_parent_node->_count == old_first_parent_node_count &&
-            last_parent_node->_count == old_last_parent_node_count)
+        if (parent_same_parent &&
+            first_parent_node->_count == old_first_parent_node_count)
         {
             return out;
         }
 
-        if (_tree_height > 1 &&
+        if (!__separator_keys && _tree_height > 1 &&
             last_parent_node->_ref_value != (*last_parent_node->nodes())->_ref_value)
         {
             last_parent_node->_ref_value = (*last_parent_node->nodes())->_ref_value;
@@ -1508,7 +4987,7 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
 
             if (first_cur_node_is_empty)
             {
-                deallocate_node(first_cur_node);
+                deallocate_node(first_cur_node, depth);
                 new_first_cur_node = (first_cur_node_pos > 0)? first_parent_node->nodes()[first_cur_node_pos - 1] : nullptr;
             }
             else if (first_cur_node_pos > 0 &&
@@ -1516,9 +4995,7 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
             {
                 new_first_cur_node = first_parent_node->nodes()[first_cur_node_pos - 1];
 
-                std::memcpy(new_first_cur_node->nodes_end(),
-                            first_cur_node->nodes(),
-                            first_cur_node->_count * sizeof(_node_type*));
+                merge_slots(new_first_cur_node, first_cur_node, first_parent_node, first_cur_node_pos);
 
                 if (same_parent)
                 {
@@ -1527,7 +5004,7 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
                 }
 
                 new_first_cur_node->_count += first_cur_node->_count;
-                deallocate_node(first_cur_node);
+                deallocate_node(first_cur_node, depth);
                 first_cur_node_is_empty = true;
             }
 
@@ -1540,17 +5017,14 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
             {
                 _node_type* last_next_node = last_parent_node->nodes()[last_cur_node_pos + 1];
 
-                std::memcpy(last_cur_node->nodes_end(),
-                            last_next_node->nodes(),
-                            last_next_node->_count * sizeof(_node_type*));
+                merge_slots(last_cur_node, last_next_node, last_parent_node, last_cur_node_pos + 1);
 
                 last_cur_node->_count += last_next_node->_count;
-                deallocate_node(last_next_node);
+                deallocate_node(last_next_node, depth);
                 last_next_node_is_empty = true;
             }
 
             old_first_parent_node_count = first_parent_node->_count;
-            old_last_parent_node_count = last_parent_node->_count;
 
             if (parent_same_parent)
             {
@@ -1563,20 +5037,18 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
                     {
                         _node_type* first_next_node = first_parent_node->nodes()[first_cur_node_pos + 1];
 
-                        std::memcpy(new_first_cur_node->nodes_end(),
-                                    first_next_node->nodes(),
-                                    first_next_node->_count * sizeof(_node_type*));
+                        merge_slots(new_first_cur_node, first_next_node, first_parent_node, first_cur_node_pos + 1);
 
                         new_first_cur_node->_count += first_next_node->_count;
-                        deallocate_node(first_next_node);
+                        deallocate_node(first_next_node, depth);
                         first_next_node_is_empty = true;
                     }
 
                     if (first_cur_node_is_empty || first_next_node_is_empty)
                     {
-                        std::memmove(first_parent_node->nodes() + (first_cur_node_pos + !first_cur_node_is_empty),
-                                     first_parent_node->nodes() + (first_cur_node_pos + 1 + first_next_node_is_empty),
-                                     (first_parent_node->_count - first_cur_node_pos - 1 - first_next_node_is_empty) * sizeof(_node_type*));
+                        move_slots(first_parent_node, first_cur_node_pos + !first_cur_node_is_empty,
+                                   first_parent_node, first_cur_node_pos + 1 + first_next_node_is_empty,
+                                   first_parent_node->_count - first_cur_node_pos - 1 - first_next_node_is_empty);
 
                         first_parent_node->_count -= first_cur_node_is_empty + first_next_node_is_empty;
                     }
@@ -1586,8 +5058,7 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
                     _node_type** erase_nodes_end = last._stack[depth];
                     for (_node_type** node_ptr = first._stack[depth] + 1; node_ptr < erase_nodes_end; ++node_ptr)
                     {
-                        clear_node(*node_ptr, depth);
-                        deallocate_node(*node_ptr);
+                        destroy_node(*node_ptr, depth);
                     }
 
                     uint32_t count_1 = first_cur_node_pos + !first_cur_node_is_empty;
@@ -1597,15 +5068,13 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
                     if (new_first_cur_node != nullptr &&
                         new_first_cur_node->_count + last_cur_node->_count <= __bucket_nodes_capacity_max / 2)
                     {
-                        std::memcpy(new_first_cur_node->nodes_end(),
-                                    last_cur_node->nodes(),
-                                    last_cur_node->_count * sizeof(_node_type*));
+                        merge_slots(new_first_cur_node, last_cur_node, first_parent_node, last_cur_node_pos);
 
                         out._stack[depth - 1] = new_first_cur_node->nodes_end();
                         out._stack[depth] = first._stack[depth] - first_cur_node_is_empty;
 
                         new_first_cur_node->_count += last_cur_node->_count;
-                        deallocate_node(last_cur_node);
+                        deallocate_node(last_cur_node, depth);
                         last_cur_node_is_empty = true;
                     }
                     else
@@ -1618,24 +5087,26 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
                     {
                         if (last_cur_node_is_empty)
                         {
-                            std::memmove(first_parent_node->nodes() + count_1,
-                                         erase_nodes_end + 2,
-                                         (count_2 - 2) * sizeof(_node_type*));
+                            move_slots(first_parent_node, count_1,
+                                       first_parent_node, last_cur_node_pos + 2,
+                                       count_2 - 2);
                         }
                         else
                         {
-                            first_parent_node->nodes()[count_1] = last_cur_node;
+                            move_slots(first_parent_node, count_1,
+                                       first_parent_node, last_cur_node_pos,
+                                       1);
 
-                            std::memmove(first_parent_node->nodes() + (count_1 + 1),
-                                         erase_nodes_end + 2,
-                                         (count_2 - 2) * sizeof(_node_type*));
+                            move_slots(first_parent_node, count_1 + 1,
+                                       first_parent_node, last_cur_node_pos + 2,
+                                       count_2 - 2);
                         }
                     }
                     else
                     {
-                        std::memmove(first_parent_node->nodes() + count_1,
-                                     erase_nodes_end + last_cur_node_is_empty,
-                                     (count_2 - last_cur_node_is_empty) * sizeof(_node_type*));
+                        move_slots(first_parent_node, count_1,
+                                   first_parent_node, last_cur_node_pos + last_cur_node_is_empty,
+                                   count_2 - last_cur_node_is_empty);
                     }
 
                     first_parent_node->_count = count_1 + count_2 - last_cur_node_is_empty - last_next_node_is_empty;
@@ -1646,8 +5117,7 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
                 _node_type** erase_nodes_end = first_parent_node->nodes_end();
                 for (_node_type** node_ptr = first._stack[depth] + 1; node_ptr < erase_nodes_end; ++node_ptr)
                 {
-                    clear_node(*node_ptr, depth);
-                    deallocate_node(*node_ptr);
+                    destroy_node(*node_ptr, depth);
                 }
 
                 first_parent_node->_count = first_cur_node_pos + !first_cur_node_is_empty;
@@ -1655,15 +5125,14 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
                 erase_nodes_end = last._stack[depth];
                 for (_node_type** node_ptr = last_parent_node->nodes(); node_ptr < erase_nodes_end; ++node_ptr)
                 {
-                    clear_node(*node_ptr, depth);
-                    deallocate_node(*node_ptr);
+                    destroy_node(*node_ptr, depth);
                 }
 
                 if (last_cur_node_pos + last_next_node_is_empty > 0)
                 {
-                    std::memmove(last_parent_node->nodes() + 1,
-                                 last_parent_node->nodes() + (last_cur_node_pos + last_next_node_is_empty + 1),
-                                 (last_parent_node->_count - last_cur_node_pos - last_next_node_is_empty - 1) * sizeof(_node_type*));
+                    move_slots(last_parent_node, 1,
+                               last_parent_node, last_cur_node_pos + last_next_node_is_empty + 1,
+                               last_parent_node->_count - last_cur_node_pos - last_next_node_is_empty - 1);
 
                     last_parent_node->_count -= last_cur_node_pos + last_next_node_is_empty;
                 }
@@ -1675,13 +5144,13 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
                 }
             }
 
-            if (first_parent_node->_count == old_first_parent_node_count &&
-                last_parent_node->_count == old_last_parent_node_count)
+            if (parent_same_parent &&
+                first_parent_node->_count == old_first_parent_node_count)
             {
                 break;
             }
 
-            if (_tree_height > depth + 1 &&
+            if (!__separator_keys && _tree_height > depth + 1 &&
                 last_parent_node->_ref_value != (*last_parent_node->nodes())->_ref_value)
             {
                 last_parent_node->_ref_value = (*last_parent_node->nodes())->_ref_value;
@@ -1696,12 +5165,16 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
     _output_iterator erase_range(const _const_iterator& first,
                                  const _const_iterator& last)
     {
-        _output_iterator out(this, nullptr);
+        _path_for<_output_iterator> out(this, nullptr);
 
         if (first._value_ptr == nullptr)
         {
             return out;
         }
+        else if (first._value_ptr == last._value_ptr)
+        {
+            return _output_iterator(last._const_cast());
+        }
         else if (last._value_ptr == nullptr)
         {
             if (first == _base::cbegin())
@@ -1710,11 +5183,26 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
                 return out;
             }
 
-            erase_range_core(first);
+            _path first_path(make_path(first, std::integral_constant<bool, __leaf_links>()));
+
+            if (_shared_nodes)
+            {
+                unshare_path(first_path, true);
+            }
+
+            erase_range_core(first_path);
         }
         else
         {
-            out = erase_range_core<_output_iterator>(first, last);
+            _path first_path(make_path(first, std::integral_constant<bool, __leaf_links>()));
+            _path last_path(make_path(last, std::integral_constant<bool, __leaf_links>()));
+
+            if (_shared_nodes)
+            {
+                unshare_paths(first_path, last_path);
+            }
+
+            out = erase_range_core<_path_for<_output_iterator> >(first_path, last_path);
         }
 
         while (_root_node->_count == 1 && _tree_height > 0)
@@ -1722,12 +5210,53 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
             _node_type* new_root_node = *_root_node->nodes();
             deallocate_root_node();
             _root_node = new_root_node;
-            _root_node->_bucket_bysize = _bucket_bysize_max;
-
             --_tree_height;
+            _root_node->_bucket_bysize = bucket_bysize_max(_tree_height);
         }
 
-        if (_tree_height == 0)
+        // only the slots on the paths of the values around the gap have changed
+        if ((__subtree_counts || __aggregates) && _tree_height > 0)
+        {
+            _path prev_path(out);
+
+            if (out._value_ptr != nullptr)
+            {
+                prev_path.decrement();
+            }
+            else
+            {
+                prev_path.set_last();
+            }
+
+            // the value before the gap may be in a leaf no path above went through
+            if (_shared_nodes)
+            {
+                unshare_path(prev_path, false);
+            }
+
+            refresh_slots(prev_path._stack, (out._value_ptr != nullptr)? out._stack : prev_path._stack);
+        }
+
+        // the erased leaves were freed without being unlinked, the links are repaired around the gap
+        if (__leaf_links)
+        {
+            if (_tree_height == 0)
+            {
+                link_leaf(_root_node, nullptr, nullptr);
+            }
+            else if (out._value_ptr != nullptr)
+            {
+                relink_leaf(out);
+            }
+            else
+            {
+                _path last_path(this);
+                last_path.set_last();
+                relink_leaf(last_path);
+            }
+        }
+
+        if (_tree_height == 0 && !__soa_leaves)
         {
             uint32_t root_bucket_bysize = _root_node->_bucket_bysize;
             uint32_t values_bysize = _root_node->_count * sizeof(_value_type);
@@ -1741,11 +5270,7 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
                 _node_type* new_root_node = allocate_root_node(root_bucket_bysize);
                 new_root_node->_count = _root_node->_count;
 
-                for (uint32_t i = 0; i < _root_node->_count; ++i)
-                {
-                    _awrapper.construct(new_root_node->values() + i, std::move(_root_node->values()[i]));
-                    _awrapper.destroy(_root_node->values() + i);
-                }
+                relocate_values(new_root_node, 0, _root_node, 0, _root_node->_count);
 
                 if (out._value_ptr != nullptr)
                 {
@@ -1762,18 +5287,20 @@ struct _bplus_tree : _bplus_tree_base<_value_type, _tree_height_max>
 
 }; // _bplus_tree
 
-template<typename _a, typename _b, typename _c, typename _d, typename _e, typename _f, uint32_t _g, uint32_t _h>
-inline bool operator == (const xxfl::_bplus_tree<_a, _b, _c, _d, _e, _f, _g, _h>& x,
-                         const xxfl::_bplus_tree<_a, _b, _c, _d, _e, _f, _g, _h>& y)
+template<typename _a, typename _b, typename _c, typename _d, typename _e, typename _f, typename _g, uint32_t _h, uint32_t _i, uint32_t _j,
+         typename _k, bool _l>
+inline bool operator == (const xxfl::_bplus_tree<_a, _b, _c, _d, _e, _f, _g, _h, _i, _j, _k, _l>& x,
+                         const xxfl::_bplus_tree<_a, _b, _c, _d, _e, _f, _g, _h, _i, _j, _k, _l>& y)
 {
-    return x._values_count == y._values_count && std::equal(x.cbegin(), x.cend(), y.cbegin());
+    return x.equal_values(y);
 }
 
-template<typename _a, typename _b, typename _c, typename _d, typename _e, typename _f, uint32_t _g, uint32_t _h>
-inline bool operator < (const xxfl::_bplus_tree<_a, _b, _c, _d, _e, _f, _g, _h>& x,
-                        const xxfl::_bplus_tree<_a, _b, _c, _d, _e, _f, _g, _h>& y)
+template<typename _a, typename _b, typename _c, typename _d, typename _e, typename _f, typename _g, uint32_t _h, uint32_t _i, uint32_t _j,
+         typename _k, bool _l>
+inline bool operator < (const xxfl::_bplus_tree<_a, _b, _c, _d, _e, _f, _g, _h, _i, _j, _k, _l>& x,
+                        const xxfl::_bplus_tree<_a, _b, _c, _d, _e, _f, _g, _h, _i, _j, _k, _l>& y)
 {
-    return std::lexicographical_compare(x.cbegin(), x.cend(), y.cbegin(), y.cend());
+    return x.less_values(y);
 }
 
 } // xxfl
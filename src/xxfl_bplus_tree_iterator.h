@@ -1,9 +1,46 @@
 ﻿#pragma once
 
+#include <atomic>
 #include "xxfl_set_platform_helper.h"
 
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#endif
+
+// leaves are chained by prev/next pointers, iterators then step between leaves without walking up the tree
+// and no longer carry the path from root. set to 1 to enable.
+#if !defined(XXFL_BPLUS_TREE_LEAF_LINKS)
+#define XXFL_BPLUS_TREE_LEAF_LINKS 0
+#endif
+
+// set to 1 to prefetch the whole search area of every node met while descending, as soon as its pointer is
+// known, so the probes of the binary search inside it no longer miss the cache one after another.
+#if !defined(XXFL_BPLUS_TREE_PREFETCH_DESCENT)
+#define XXFL_BPLUS_TREE_PREFETCH_DESCENT 0
+#endif
+
+// iterators prefetch the head of the next leaf when they get this many values away from the end of the
+// current one. set to 0 to disable.
+#if !defined(XXFL_BPLUS_TREE_PREFETCH_SCAN_DISTANCE)
+#define XXFL_BPLUS_TREE_PREFETCH_SCAN_DISTANCE 0
+#endif
+
 namespace xxfl {
 
+inline void _prefetch_range(const void* addr, size_t bysize) noexcept
+{
+    const uintptr_t line_bysize = 64;
+
+    for (uintptr_t line = (uintptr_t)addr & ~(line_bysize - 1); line < (uintptr_t)addr + bysize; line += line_bysize)
+    {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+        _mm_prefetch((const char*)line, _MM_HINT_T0);
+#elif !defined(_MSC_VER)
+        __builtin_prefetch((const void*)line);
+#endif
+    }
+}
+
 #if defined(_MSC_VER)
 #pragma warning(push)
 #pragma warning(disable : 4200)
@@ -14,12 +51,18 @@ template<typename _value_type>
 struct _bplus_tree_node
 {
     uint32_t _count;
+    std::atomic<uint32_t> _shares; // the references to this node besides the first one, see share_with()
     union
     {
         _value_type* _ref_value;
         uint32_t _bucket_bysize; // this field won't available except for root node
     };
 
+#if XXFL_BPLUS_TREE_LEAF_LINKS
+    _bplus_tree_node* _prev_leaf; // these fields won't available except for leaf nodes
+    _bplus_tree_node* _next_leaf;
+#endif
+
     union
     {
         _bplus_tree_node* _nodes_bucket[];
@@ -40,6 +83,13 @@ struct _bplus_tree_node
 template<typename _value_type, uint32_t _tree_height_max>
 struct _bplus_tree_base;
 
+// the path stack is left uninitialized, only the levels below the tree height are ever set and read, which GCC
+// can't tell when it copies or inlines an iterator
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
 template<typename _value_type, uint32_t _tree_height_max>
 struct _bplus_tree_iterator_base
 {
@@ -55,13 +105,16 @@ struct _bplus_tree_iterator_base
     _value_type* _value_ptr;
     _node_type** _stack[_tree_height_max];
 
-    _bplus_tree_iterator_base() noexcept {}
+    _bplus_tree_iterator_base() noexcept : _tree(nullptr), _value_ptr(nullptr) {}
 
-    _bplus_tree_iterator_base(_bplus_tree_type* tree) noexcept : _tree(tree) {}
+    _bplus_tree_iterator_base(_bplus_tree_type* tree) noexcept : _tree(tree), _value_ptr(nullptr) {}
 
     _bplus_tree_iterator_base(_bplus_tree_type* tree, _value_type* value_ptr) noexcept
     : _tree(tree), _value_ptr(value_ptr) {}
 
+    _node_type* leaf_node() const noexcept
+    { return (_tree->_tree_height > 0)? *_stack[0] : _tree->_root_node; }
+
     void set_first() noexcept
     {
         if (_tree->_values_count == 0)
@@ -173,6 +226,12 @@ struct _bplus_tree_iterator_base
         if (value_pos + 1 < cur_node->_count)
         {
             ++_value_ptr;
+
+            if (XXFL_BPLUS_TREE_PREFETCH_SCAN_DISTANCE > 0 &&
+                value_pos + 1 + XXFL_BPLUS_TREE_PREFETCH_SCAN_DISTANCE == cur_node->_count)
+            {
+                prefetch_next_node();
+            }
         }
         else
         {
@@ -180,6 +239,20 @@ struct _bplus_tree_iterator_base
         }
     }
 
+    // only a sibling under the same parent is prefetched, finding any other would cost a walk up the tree
+    void prefetch_next_node() const noexcept
+    {
+        if (_tree->_tree_height > 0)
+        {
+            _node_type* parent_node = (_tree->_tree_height > 1)? *_stack[1] : _tree->_root_node;
+
+            if (_stack[0] + 1 < parent_node->nodes_end())
+            {
+                _prefetch_range(_stack[0][1], sizeof(_node_type) + XXFL_BPLUS_TREE_PREFETCH_SCAN_DISTANCE * sizeof(_value_type));
+            }
+        }
+    }
+
     void decrement() noexcept
     {
         if (_value_ptr == nullptr)
@@ -200,12 +273,169 @@ struct _bplus_tree_iterator_base
             cross_node_decrement();
         }
     }
+
+    // a mutable iterator which stepped into another leaf of a tree sharing nodes gets the nodes on its new path
+    // copied, see _bplus_tree::writable(). within a leaf only the first value is reached forwards, and the last
+    // backwards, by stepping in from another leaf or from end().
+    void unshare_stepped(bool forward)
+    {
+        if (_tree->_shared_nodes && _value_ptr != nullptr)
+        {
+            _node_type* cur_node = leaf_node();
+
+            if (_value_ptr == (forward? cur_node->values() : cur_node->values() + (cur_node->_count - 1)))
+            {
+                _tree->_unshare_path_of(_tree, *this);
+            }
+        }
+    }
+};
+
+#if XXFL_BPLUS_TREE_LEAF_LINKS
+
+template<typename _value_type, uint32_t _tree_height_max>
+struct _bplus_tree_leaf_iterator_base
+{
+    typedef _value_type  value_type;
+
+    typedef std::bidirectional_iterator_tag iterator_category;
+    typedef std::ptrdiff_t                  difference_type;
+
+    typedef _bplus_tree_base<_value_type, _tree_height_max>          _bplus_tree_type;
+    typedef _bplus_tree_node<_value_type>                            _node_type;
+    typedef _bplus_tree_iterator_base<_value_type, _tree_height_max> _path_type;
+
+    _bplus_tree_type* _tree;
+    _value_type* _value_ptr;
+    _node_type* _leaf_node;
+
+    _bplus_tree_leaf_iterator_base() noexcept : _tree(nullptr), _value_ptr(nullptr), _leaf_node(nullptr) {}
+
+    _bplus_tree_leaf_iterator_base(_bplus_tree_type* tree) noexcept
+    : _tree(tree), _value_ptr(nullptr), _leaf_node(nullptr) {}
+
+    _bplus_tree_leaf_iterator_base(_bplus_tree_type* tree, _value_type* value_ptr) noexcept
+    : _tree(tree), _value_ptr(value_ptr), _leaf_node(nullptr) {}
+
+    _bplus_tree_leaf_iterator_base(const _path_type& path) noexcept
+    : _tree(path._tree), _value_ptr(path._value_ptr)
+    {
+        if (_value_ptr == nullptr)
+        {
+            _leaf_node = nullptr;
+        }
+        else
+        {
+            _leaf_node = path.leaf_node();
+        }
+    }
+
+    _node_type* leaf_node() const noexcept { return _leaf_node; }
+
+    void set_first() noexcept
+    {
+        if (_tree->_values_count == 0)
+        {
+            _value_ptr = nullptr;
+        }
+        else
+        {
+            _leaf_node = _tree->_root_node;
+
+            for (uint32_t depth = _tree->_tree_height; depth > 0; --depth)
+            {
+                _leaf_node = *_leaf_node->nodes();
+            }
+
+            _value_ptr = _leaf_node->values();
+        }
+    }
+
+    void set_last() noexcept
+    {
+        if (_tree->_values_count == 0)
+        {
+            _value_ptr = nullptr;
+        }
+        else
+        {
+            _leaf_node = _tree->_root_node;
+
+            for (uint32_t depth = _tree->_tree_height; depth > 0; --depth)
+            {
+                _leaf_node = _leaf_node->nodes()[_leaf_node->_count - 1];
+            }
+
+            _value_ptr = _leaf_node->values() + (_leaf_node->_count - 1);
+        }
+    }
+
+    void increment() noexcept
+    {
+        if (_value_ptr == nullptr)
+        {
+            return;
+        }
+
+        if (++_value_ptr == _leaf_node->values_end())
+        {
+            _leaf_node = _leaf_node->_next_leaf;
+            _value_ptr = (_leaf_node != nullptr)? _leaf_node->values() : nullptr;
+        }
+        else if (XXFL_BPLUS_TREE_PREFETCH_SCAN_DISTANCE > 0 &&
+                 _value_ptr + XXFL_BPLUS_TREE_PREFETCH_SCAN_DISTANCE == _leaf_node->values_end() &&
+                 _leaf_node->_next_leaf != nullptr)
+        {
+            _prefetch_range(_leaf_node->_next_leaf, sizeof(_node_type) + XXFL_BPLUS_TREE_PREFETCH_SCAN_DISTANCE * sizeof(_value_type));
+        }
+    }
+
+    void decrement() noexcept
+    {
+        if (_value_ptr == nullptr)
+        {
+            set_last();
+            return;
+        }
+
+        if (_value_ptr > _leaf_node->values())
+        {
+            --_value_ptr;
+        }
+        else
+        {
+            _leaf_node = _leaf_node->_prev_leaf;
+            _value_ptr = (_leaf_node != nullptr)? _leaf_node->values_end() - 1 : nullptr;
+        }
+    }
+
+    // the nodes of a tree with leaf links are never shared, see _bplus_tree::share_with()
+    void unshare_stepped(bool) noexcept {}
 };
 
 template<typename _value_type, uint32_t _tree_height_max>
-struct _bplus_tree_iterator : _bplus_tree_iterator_base<_value_type, _tree_height_max>
+using _bplus_tree_public_iterator_base = _bplus_tree_leaf_iterator_base<_value_type, _tree_height_max>;
+
+#else
+
+template<typename _value_type, uint32_t _tree_height_max>
+using _bplus_tree_public_iterator_base = _bplus_tree_iterator_base<_value_type, _tree_height_max>;
+
+#endif
+
+// operator -> of the iterators which hand out proxy references
+template<typename _reference>
+struct _arrow_proxy
 {
-    typedef _bplus_tree_iterator_base<_value_type, _tree_height_max> _base;
+    _reference _ref;
+
+    _reference* operator -> () noexcept { return &_ref; }
+};
+
+template<typename _value_type, uint32_t _tree_height_max>
+struct _bplus_tree_iterator : _bplus_tree_public_iterator_base<_value_type, _tree_height_max>
+{
+    typedef _bplus_tree_public_iterator_base<_value_type, _tree_height_max> _base;
 
     typedef _value_type& reference;
     typedef _value_type* pointer;
@@ -218,41 +448,51 @@ struct _bplus_tree_iterator : _bplus_tree_iterator_base<_value_type, _tree_heigh
 
     _bplus_tree_iterator() noexcept {}
 
-    _bplus_tree_iterator(_bplus_tree_type* tree) noexcept : _base::_bplus_tree_iterator_base(tree) {}
+    _bplus_tree_iterator(_bplus_tree_type* tree) noexcept : _base(tree) {}
 
     _bplus_tree_iterator(_bplus_tree_type* tree, _value_type* value_ptr) noexcept
-    : _base::_bplus_tree_iterator_base(tree, value_ptr) {}
+    : _base(tree, value_ptr) {}
+
+#if XXFL_BPLUS_TREE_LEAF_LINKS
+    _bplus_tree_iterator(const typename _base::_path_type& path) noexcept : _base(path) {}
+#endif
+
+    _bplus_tree_iterator(const _bplus_tree_iterator& it) noexcept : _base(it) {}
 
-    _bplus_tree_iterator(const _bplus_tree_iterator& it) noexcept : _base::_bplus_tree_iterator_base(it) {}
+    explicit _bplus_tree_iterator(const _base& it) noexcept : _base(it) {}
 
     _bplus_tree_iterator& _const_cast() const noexcept { return const_cast<_bplus_tree_iterator&>(*this); }
 
     reference operator * () const noexcept { return *_base::_value_ptr; }
     pointer operator -> () const noexcept { return _base::_value_ptr; }
 
-    _bplus_tree_iterator& operator ++ () noexcept
+    _bplus_tree_iterator& operator ++ ()
     {
         _base::increment();
+        _base::unshare_stepped(true);
         return *this;
     }
 
-    _bplus_tree_iterator operator ++ (int) noexcept
+    _bplus_tree_iterator operator ++ (int)
     {
         _bplus_tree_iterator tmp(*this);
         _base::increment();
+        _base::unshare_stepped(true);
         return tmp;
     }
 
-    _bplus_tree_iterator& operator -- () noexcept
+    _bplus_tree_iterator& operator -- ()
     {
         _base::decrement();
+        _base::unshare_stepped(false);
         return *this;
     }
 
-    _bplus_tree_iterator operator -- (int) noexcept
+    _bplus_tree_iterator operator -- (int)
     {
         _bplus_tree_iterator tmp(*this);
         _base::decrement();
+        _base::unshare_stepped(false);
         return tmp;
     }
 
@@ -264,9 +504,9 @@ struct _bplus_tree_iterator : _bplus_tree_iterator_base<_value_type, _tree_heigh
 };
 
 template<typename _value_type, uint32_t _tree_height_max>
-struct _bplus_tree_const_iterator : _bplus_tree_iterator_base<_value_type, _tree_height_max>
+struct _bplus_tree_const_iterator : _bplus_tree_public_iterator_base<_value_type, _tree_height_max>
 {
-    typedef _bplus_tree_iterator_base<_value_type, _tree_height_max> _base;
+    typedef _bplus_tree_public_iterator_base<_value_type, _tree_height_max> _base;
 
     typedef const _value_type& reference;
     typedef const _value_type* pointer;
@@ -281,12 +521,16 @@ struct _bplus_tree_const_iterator : _bplus_tree_iterator_base<_value_type, _tree
 
     _bplus_tree_const_iterator() noexcept {}
 
-    _bplus_tree_const_iterator(_bplus_tree_type* tree) noexcept : _base::_bplus_tree_iterator_base(tree) {}
+    _bplus_tree_const_iterator(_bplus_tree_type* tree) noexcept : _base(tree) {}
 
     _bplus_tree_const_iterator(_bplus_tree_type* tree, _value_type* value_ptr) noexcept
-    : _base::_bplus_tree_iterator_base(tree, value_ptr) {}
+    : _base(tree, value_ptr) {}
 
-    _bplus_tree_const_iterator(const _base& it) noexcept : _base::_bplus_tree_iterator_base(it) {}
+#if XXFL_BPLUS_TREE_LEAF_LINKS
+    _bplus_tree_const_iterator(const typename _base::_path_type& path) noexcept : _base(path) {}
+#endif
+
+    _bplus_tree_const_iterator(const _base& it) noexcept : _base(it) {}
 
     iterator& _const_cast() const noexcept { return (iterator&)(const_cast<_bplus_tree_const_iterator&>(*this)); }
 
@@ -326,6 +570,10 @@ struct _bplus_tree_const_iterator : _bplus_tree_iterator_base<_value_type, _tree
     { return _base::_value_ptr != x._value_ptr; }
 };
 
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
 template<typename _value_type, uint32_t _tree_height_max>
 inline bool
 operator == (const xxfl::_bplus_tree_iterator<_value_type, _tree_height_max>& x,
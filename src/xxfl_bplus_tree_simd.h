@@ -0,0 +1,247 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+// sorted buckets of 32/64-bit integral keys compared by std::less are narrowed by binary search down to
+// a few cache lines, which are then counted with SSE4.2 or AVX2 as detected at runtime. set to 0 to disable.
+#if !defined(XXFL_BPLUS_TREE_SIMD_SEARCH)
+#define XXFL_BPLUS_TREE_SIMD_SEARCH 1
+#endif
+
+#if XXFL_BPLUS_TREE_SIMD_SEARCH && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86))
+#define XXFL_BPLUS_TREE_SIMD_X86 1
+
+#include <immintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define XXFL_TARGET_SSE42
+#define XXFL_TARGET_AVX2
+#define XXFL_POPCOUNT(x) __popcnt(x)
+#else
+#define XXFL_TARGET_SSE42 __attribute__((target("sse4.2,popcnt")))
+#define XXFL_TARGET_AVX2  __attribute__((target("avx2,popcnt")))
+#define XXFL_POPCOUNT(x) __builtin_popcount(x)
+#endif
+
+#else
+#define XXFL_BPLUS_TREE_SIMD_X86 0
+#endif
+
+namespace xxfl {
+
+enum _simd_level
+{
+    _simd_level_none,
+    _simd_level_sse42,
+    _simd_level_avx2
+};
+
+inline _simd_level _detect_simd_level() noexcept
+{
+#if XXFL_BPLUS_TREE_SIMD_X86
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int max_leaf = info[0];
+
+    __cpuid(info, 1);
+    bool sse42 = (info[2] & (1 << 20)) != 0 && (info[2] & (1 << 23)) != 0;
+    bool avx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+    bool avx2 = false;
+
+    if (sse42 && avx && max_leaf >= 7)
+    {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+#else
+    __builtin_cpu_init();
+    bool sse42 = __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt");
+    bool avx2 = sse42 && __builtin_cpu_supports("avx2");
+#endif
+
+    if (avx2)
+    {
+        return _simd_level_avx2;
+    }
+    else if (sse42)
+    {
+        return _simd_level_sse42;
+    }
+#endif
+
+    return _simd_level_none;
+}
+
+// resolved during dynamic initialization, any search running before that sees the zero initialized
+// _simd_level_none and simply takes the scalar path
+template<typename _dummy = void>
+struct _simd_dispatch
+{
+    static const _simd_level _level;
+};
+
+template<typename _dummy>
+const _simd_level _simd_dispatch<_dummy>::_level = _detect_simd_level();
+
+inline _simd_level simd_level() noexcept { return _simd_dispatch<>::_level; }
+
+#if XXFL_BPLUS_TREE_SIMD_X86
+
+// the kernels count values of [first, first + count) which are less than key (or larger than key for _larger),
+// count has to be a multiple of the vector lanes. unsigned values are biased by the sign bit since x86 only has
+// signed compares.
+
+template<bool _larger>
+XXFL_TARGET_AVX2 inline uint32_t _simd_count_avx2(const int32_t* first, uint32_t count, int32_t key, int32_t bias) noexcept
+{
+    __m256i bias_vec = _mm256_set1_epi32(bias);
+    __m256i key_vec = _mm256_set1_epi32(key ^ bias);
+    uint32_t n = 0;
+
+    for (uint32_t i = 0; i + 8 <= count; i += 8)
+    {
+        __m256i x = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(first + i)), bias_vec);
+        __m256i mask = _larger? _mm256_cmpgt_epi32(x, key_vec) : _mm256_cmpgt_epi32(key_vec, x);
+        n += XXFL_POPCOUNT((uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(mask)));
+    }
+
+    return n;
+}
+
+template<bool _larger>
+XXFL_TARGET_AVX2 inline uint32_t _simd_count_avx2(const int64_t* first, uint32_t count, int64_t key, int64_t bias) noexcept
+{
+    __m256i bias_vec = _mm256_set1_epi64x(bias);
+    __m256i key_vec = _mm256_set1_epi64x(key ^ bias);
+    uint32_t n = 0;
+
+    for (uint32_t i = 0; i + 4 <= count; i += 4)
+    {
+        __m256i x = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(first + i)), bias_vec);
+        __m256i mask = _larger? _mm256_cmpgt_epi64(x, key_vec) : _mm256_cmpgt_epi64(key_vec, x);
+        n += XXFL_POPCOUNT((uint32_t)_mm256_movemask_pd(_mm256_castsi256_pd(mask)));
+    }
+
+    return n;
+}
+
+template<bool _larger>
+XXFL_TARGET_SSE42 inline uint32_t _simd_count_sse42(const int32_t* first, uint32_t count, int32_t key, int32_t bias) noexcept
+{
+    __m128i bias_vec = _mm_set1_epi32(bias);
+    __m128i key_vec = _mm_set1_epi32(key ^ bias);
+    uint32_t n = 0;
+
+    for (uint32_t i = 0; i + 4 <= count; i += 4)
+    {
+        __m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(first + i)), bias_vec);
+        __m128i mask = _larger? _mm_cmpgt_epi32(x, key_vec) : _mm_cmpgt_epi32(key_vec, x);
+        n += XXFL_POPCOUNT((uint32_t)_mm_movemask_ps(_mm_castsi128_ps(mask)));
+    }
+
+    return n;
+}
+
+template<bool _larger>
+XXFL_TARGET_SSE42 inline uint32_t _simd_count_sse42(const int64_t* first, uint32_t count, int64_t key, int64_t bias) noexcept
+{
+    __m128i bias_vec = _mm_set1_epi64x(bias);
+    __m128i key_vec = _mm_set1_epi64x(key ^ bias);
+    uint32_t n = 0;
+
+    for (uint32_t i = 0; i + 2 <= count; i += 2)
+    {
+        __m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(first + i)), bias_vec);
+        __m128i mask = _larger? _mm_cmpgt_epi64(x, key_vec) : _mm_cmpgt_epi64(key_vec, x);
+        n += XXFL_POPCOUNT((uint32_t)_mm_movemask_pd(_mm_castsi128_pd(mask)));
+    }
+
+    return n;
+}
+
+#endif
+
+template<typename _key_type>
+struct _simd_search
+{
+    static const bool __enabled = XXFL_BPLUS_TREE_SIMD_X86 && std::is_integral<_key_type>::value &&
+                                  (sizeof(_key_type) == 4 || sizeof(_key_type) == 8);
+
+    // the binary search stops at one cache line of keys, which is then counted as a whole
+    static const uint32_t __scan_count = 64 / sizeof(_key_type);
+
+    typedef typename std::conditional<sizeof(_key_type) == 8, int64_t, int32_t>::type _lane_type;
+
+    template<bool _upper>
+    static bool go_right(const _key_type& key, const _key_type& x) noexcept
+    { return _upper? !(key < x) : x < key; }
+
+    // number of keys in [first, first + __scan_count) which are less than key (not larger than key for _upper)
+    template<bool _upper>
+    static uint32_t count_scan(const _key_type* first, _key_type key, _simd_level level) noexcept
+    {
+#if XXFL_BPLUS_TREE_SIMD_X86
+        const _lane_type bias = std::is_signed<_key_type>::value? 0 : (_lane_type)((uint64_t)1 << (sizeof(_key_type) * 8 - 1));
+
+        uint32_t n = (level == _simd_level_avx2)?
+                     _simd_count_avx2<_upper>((const _lane_type*)first, __scan_count, (_lane_type)key, bias) :
+                     _simd_count_sse42<_upper>((const _lane_type*)first, __scan_count, (_lane_type)key, bias);
+
+        return _upper? __scan_count - n : n;
+#else
+        return 0;
+#endif
+    }
+
+    template<bool _upper>
+    static const _key_type* search(const _key_type* first, uint32_t count, _key_type key) noexcept
+    {
+        _simd_level level = simd_level();
+
+        if (level != _simd_level_none && count >= __scan_count)
+        {
+            const _key_type* scan_last = first + (count - __scan_count);
+
+            while (count > __scan_count)
+            {
+                uint32_t step = count >> 1;
+
+                bool right = go_right<_upper>(key, first[step]);
+
+                count = (count - right) >> 1;
+                first += (step + 1) * right;
+            }
+
+            // the result lies in [first, first + count], all keys before it in the scanned line count
+            if (first > scan_last)
+            {
+                first = scan_last;
+            }
+
+            return first + count_scan<_upper>(first, key, level);
+        }
+
+        while (count > 0)
+        {
+            uint32_t step = count >> 1;
+
+            bool right = go_right<_upper>(key, first[step]);
+
+            count = (count - right) >> 1;
+            first += (step + 1) * right;
+        }
+
+        return first;
+    }
+
+    static const _key_type* lower_bound(const _key_type* first, uint32_t count, _key_type key) noexcept
+    { return search<false>(first, count, key); }
+
+    static const _key_type* upper_bound(const _key_type* first, uint32_t count, _key_type key) noexcept
+    { return search<true>(first, count, key); }
+};
+
+} // xxfl
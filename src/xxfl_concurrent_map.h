@@ -0,0 +1,592 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include "xxfl_bplus_tree.h"
+
+namespace xxfl {
+
+// the header of the nodes of a concurrent_map. _version counts the writes to the node, and its lowest bit is set
+// while a writer holds the node. readers never write it: they note the version before reading a node and check it
+// is unchanged afterwards, and start again from the root when it isn't.
+struct _olc_node_base
+{
+    std::atomic<uint64_t> _version;
+    uint32_t _count;
+    bool _is_leaf;
+
+    explicit _olc_node_base(bool is_leaf) noexcept : _version(0), _count(0), _is_leaf(is_leaf) {}
+
+    uint64_t read_lock(bool& restart) const noexcept
+    {
+        uint64_t version = _version.load(std::memory_order_acquire);
+        if ((version & 1) != 0)
+        {
+            std::this_thread::yield();
+            restart = true;
+        }
+        return version;
+    }
+
+    bool check(uint64_t version) const noexcept
+    {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return _version.load(std::memory_order_relaxed) == version;
+    }
+
+    // succeeds only when nobody wrote the node since the version was read
+    bool upgrade(uint64_t version) noexcept
+    {
+        return _version.compare_exchange_strong(version, version + 1, std::memory_order_acquire);
+    }
+
+    void write_unlock() noexcept
+    {
+        _version.fetch_add(1, std::memory_order_release);
+    }
+};
+
+// a map for many threads at once. readers take no lock at all, they validate the versions of the nodes they went
+// through (optimistic lock coupling), and a writer locks only the leaf it changes, or a node and its parent while
+// splitting. full inner nodes are split on the way down so a split never climbs further than one parent.
+// keys and mapped values are copied out of the nodes while writers may change them, so both must be trivially
+// copyable. erasing never merges nodes and the nodes are freed only by clear() and the destructor, so a reader never
+// follows a pointer to freed memory. clear() and the destructor must not run concurrently with anything else.
+template<typename _key_type,
+         typename _mapped_type,
+         typename _compare = std::less<_key_type>,
+         typename _allocator = std::allocator<std::pair<const _key_type, _mapped_type> >,
+         uint32_t _node_bysize_max = XXFL_BPLUS_TREE_BUCKET_BYSIZE_MAX_DEFAULT>
+class concurrent_map
+{
+public:
+    typedef _key_type    key_type;
+    typedef _mapped_type mapped_type;
+    typedef _compare     key_compare;
+    typedef _allocator   allocator_type;
+    typedef size_t       size_type;
+
+    static_assert(std::is_trivially_copyable<key_type>::value && std::is_trivially_copyable<mapped_type>::value,
+                  "concurrent_map copies keys and mapped values while writers may change them");
+
+private:
+    typedef _olc_node_base _node_type;
+
+    static const uint32_t __leaf_capacity = (uint32_t)((_node_bysize_max - sizeof(_node_type) - sizeof(void*)) /
+                                                       (sizeof(key_type) + sizeof(mapped_type)));
+    static const uint32_t __inner_capacity = (uint32_t)((_node_bysize_max - sizeof(_node_type) - sizeof(void*)) /
+                                                        (sizeof(key_type) + sizeof(void*)));
+
+    static_assert(__leaf_capacity >= 4 && __inner_capacity >= 4, "_node_bysize_max is too small");
+
+    struct _leaf_type : _node_type
+    {
+        _leaf_type* _next;
+        key_type _keys[__leaf_capacity];
+        mapped_type _values[__leaf_capacity];
+
+        _leaf_type() noexcept : _node_type(true), _next(nullptr) {}
+    };
+
+    // _children[i] holds the keys not greater than _keys[i], the last child the rest
+    struct _inner_type : _node_type
+    {
+        key_type _keys[__inner_capacity];
+        _node_type* _children[__inner_capacity + 1];
+
+        _inner_type() noexcept : _node_type(false) {}
+    };
+
+    typedef typename std::allocator_traits<_allocator>::template rebind_alloc<_leaf_type>  _leaf_allocator;
+    typedef typename std::allocator_traits<_allocator>::template rebind_alloc<_inner_type> _inner_allocator;
+
+public:
+    explicit concurrent_map(const key_compare& comp = key_compare(), const allocator_type& alloc = allocator_type())
+        : _comp(comp), _leaf_alloc(alloc), _inner_alloc(alloc), _root(nullptr), _size(0)
+    {
+        _root.store(allocate_leaf(), std::memory_order_relaxed);
+    }
+
+    concurrent_map(const concurrent_map&) = delete;
+    concurrent_map& operator=(const concurrent_map&) = delete;
+
+    ~concurrent_map()
+    {
+        deallocate_node(_root.load(std::memory_order_relaxed));
+    }
+
+    size_type size() const noexcept { return _size.load(std::memory_order_relaxed); }
+    bool empty() const noexcept { return size() == 0; }
+
+    key_compare key_comp() const { return _comp; }
+
+    // copies the mapped value of key into mapped, returns false when key is absent
+    bool find(const key_type& key, mapped_type& mapped) const
+    {
+        while (true)
+        {
+            uint64_t version = 0;
+            const _leaf_type* leaf = find_leaf(key, version);
+            uint32_t pos = lower_bound(leaf, key);
+            bool found = pos < leaf->_count && !_comp(key, leaf->_keys[pos]);
+            mapped_type tmp;
+            if (found)
+            {
+                tmp = leaf->_values[pos];
+            }
+
+            if (leaf->check(version))
+            {
+                if (found)
+                {
+                    mapped = tmp;
+                }
+                return found;
+            }
+        }
+    }
+
+    bool contains(const key_type& key) const
+    {
+        mapped_type mapped;
+        return find(key, mapped);
+    }
+
+    // returns false, leaving the map unchanged, when key is present
+    bool insert(const key_type& key, const mapped_type& mapped)
+    {
+        return insert_core(key, mapped, false);
+    }
+
+    // returns true when key was inserted, false when its mapped value was assigned
+    bool insert_or_assign(const key_type& key, const mapped_type& mapped)
+    {
+        return insert_core(key, mapped, true);
+    }
+
+    bool erase(const key_type& key)
+    {
+        while (true)
+        {
+            uint64_t version = 0;
+            _leaf_type* leaf = const_cast<_leaf_type*>(find_leaf(key, version));
+            uint32_t pos = lower_bound(leaf, key);
+
+            if (pos >= leaf->_count || _comp(key, leaf->_keys[pos]))
+            {
+                if (leaf->check(version))
+                {
+                    return false;
+                }
+                continue;
+            }
+
+            if (!leaf->upgrade(version))
+            {
+                continue;
+            }
+
+            for (uint32_t i = pos + 1; i < leaf->_count; ++i)
+            {
+                leaf->_keys[i - 1] = leaf->_keys[i];
+                leaf->_values[i - 1] = leaf->_values[i];
+            }
+            --leaf->_count;
+
+            leaf->write_unlock();
+            _size.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    // calls f(key, mapped) on copies of the values in [lo, hi) in order. every leaf is copied and validated before f
+    // sees it, so each leaf is seen consistently, but writes to leaves already passed or not reached yet may or may
+    // not show, as with any scan running beside writers.
+    template<typename _function>
+    _function for_each_range(const key_type& lo, const key_type& hi, _function f) const
+    {
+        key_type keys[__leaf_capacity];
+        mapped_type values[__leaf_capacity];
+
+        key_type from = lo;
+        bool after_from = false;
+
+        while (true)
+        {
+            uint64_t version = 0;
+            const _leaf_type* leaf = find_leaf(from, version);
+
+            while (true)
+            {
+                uint32_t count = leaf->_count;
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    keys[i] = leaf->_keys[i];
+                    values[i] = leaf->_values[i];
+                }
+                const _leaf_type* next = leaf->_next;
+
+                if (!leaf->check(version))
+                {
+                    break;
+                }
+
+                uint32_t pos = 0;
+                while (pos < count && (after_from? !_comp(from, keys[pos]) : _comp(keys[pos], from)))
+                {
+                    ++pos;
+                }
+
+                for (; pos < count; ++pos)
+                {
+                    if (!_comp(keys[pos], hi))
+                    {
+                        return f;
+                    }
+
+                    f((const key_type&)keys[pos], (const mapped_type&)values[pos]);
+                    from = keys[pos];
+                    after_from = true;
+                }
+
+                if (next == nullptr)
+                {
+                    return f;
+                }
+
+                bool restart = false;
+                version = next->read_lock(restart);
+                if (restart)
+                {
+                    break;
+                }
+                leaf = next;
+            }
+        }
+    }
+
+    // not thread safe
+    void clear()
+    {
+        deallocate_node(_root.load(std::memory_order_relaxed));
+        _root.store(allocate_leaf(), std::memory_order_relaxed);
+        _size.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    template<typename _node>
+    uint32_t lower_bound(const _node* node, const key_type& key) const
+    {
+        // the count may be read in the middle of a write, but never leaves [0, capacity]
+        uint32_t first = 0;
+        uint32_t len = node->_count;
+
+        while (len > 0)
+        {
+            uint32_t half = len / 2;
+            if (_comp(node->_keys[first + half], key))
+            {
+                first += half + 1;
+                len -= half + 1;
+            }
+            else
+            {
+                len = half;
+            }
+        }
+
+        return first;
+    }
+
+    // reads the version of a child whose pointer was read from inner. the pointer is followed only when inner did not
+    // change meanwhile, and inner is checked again after, as the child may have split in between and moved the key
+    // elsewhere, which changed inner too
+    template<typename _child>
+    static bool read_child(const _inner_type* inner, uint64_t version, _child* child, uint64_t& child_version)
+    {
+        bool restart = false;
+        if (!inner->check(version))
+        {
+            return false;
+        }
+
+        child_version = child->read_lock(restart);
+        return !restart && inner->check(version);
+    }
+
+    // the leaf which may hold key, and its version when it was reached
+    const _leaf_type* find_leaf(const key_type& key, uint64_t& leaf_version) const
+    {
+        while (true)
+        {
+            bool restart = false;
+            const _node_type* node = _root.load(std::memory_order_acquire);
+            uint64_t version = node->read_lock(restart);
+            if (restart || node != _root.load(std::memory_order_acquire))
+            {
+                continue;
+            }
+
+            while (!node->_is_leaf)
+            {
+                const _inner_type* inner = static_cast<const _inner_type*>(node);
+                const _node_type* child = inner->_children[lower_bound(inner, key)];
+                uint64_t child_version = 0;
+                if (!read_child(inner, version, child, child_version))
+                {
+                    restart = true;
+                    break;
+                }
+
+                node = child;
+                version = child_version;
+            }
+
+            if (!restart)
+            {
+                leaf_version = version;
+                return static_cast<const _leaf_type*>(node);
+            }
+        }
+    }
+
+    bool insert_core(const key_type& key, const mapped_type& mapped, bool assign)
+    {
+        while (true)
+        {
+            bool restart = false;
+            _node_type* node = _root.load(std::memory_order_acquire);
+            uint64_t version = node->read_lock(restart);
+            if (restart || node != _root.load(std::memory_order_acquire))
+            {
+                continue;
+            }
+
+            _inner_type* parent = nullptr;
+            uint64_t parent_version = 0;
+
+            while (!node->_is_leaf)
+            {
+                _inner_type* inner = static_cast<_inner_type*>(node);
+
+                if (inner->_count == __inner_capacity)
+                {
+                    split_node(inner, version, parent, parent_version);
+                    restart = true;
+                    break;
+                }
+
+                _node_type* child = inner->_children[lower_bound(inner, key)];
+                uint64_t child_version = 0;
+                if (!read_child(inner, version, child, child_version))
+                {
+                    restart = true;
+                    break;
+                }
+
+                parent = inner;
+                parent_version = version;
+                node = child;
+                version = child_version;
+            }
+
+            if (restart)
+            {
+                continue;
+            }
+
+            _leaf_type* leaf = static_cast<_leaf_type*>(node);
+            uint32_t pos = lower_bound(leaf, key);
+            uint32_t count = leaf->_count;
+            bool found = pos < count && !_comp(key, leaf->_keys[pos]);
+
+            if (found && !assign)
+            {
+                if (leaf->check(version))
+                {
+                    return false;
+                }
+                continue;
+            }
+
+            if (!found && count == __leaf_capacity)
+            {
+                split_node(leaf, version, parent, parent_version);
+                continue;
+            }
+
+            // the leaf is unchanged since pos was found once the upgrade succeeds
+            if (!leaf->upgrade(version))
+            {
+                continue;
+            }
+
+            if (found)
+            {
+                leaf->_values[pos] = mapped;
+            }
+            else
+            {
+                for (uint32_t i = count; i > pos; --i)
+                {
+                    leaf->_keys[i] = leaf->_keys[i - 1];
+                    leaf->_values[i] = leaf->_values[i - 1];
+                }
+                leaf->_keys[pos] = key;
+                leaf->_values[pos] = mapped;
+                ++leaf->_count;
+            }
+
+            leaf->write_unlock();
+
+            if (!found)
+            {
+                _size.fetch_add(1, std::memory_order_relaxed);
+            }
+            return !found;
+        }
+    }
+
+    // locks the parent and the node as they were read, splits the node into the parent or a new root and unlocks.
+    // the caller starts again from the root whether it worked or not.
+    void split_node(_node_type* node, uint64_t version, _inner_type* parent, uint64_t parent_version)
+    {
+        if (parent != nullptr && !parent->upgrade(parent_version))
+        {
+            return;
+        }
+
+        if (!node->upgrade(version))
+        {
+            if (parent != nullptr)
+            {
+                parent->write_unlock();
+            }
+            return;
+        }
+
+        // a node without parent may have stopped being the root before it was locked
+        if (parent == nullptr && node != _root.load(std::memory_order_relaxed))
+        {
+            node->write_unlock();
+            return;
+        }
+
+        key_type separator;
+        _node_type* new_node = node->_is_leaf? (_node_type*)split_leaf(static_cast<_leaf_type*>(node), separator) :
+                                               (_node_type*)split_inner(static_cast<_inner_type*>(node), separator);
+
+        if (parent != nullptr)
+        {
+            uint32_t pos = lower_bound(parent, separator);
+            for (uint32_t i = parent->_count; i > pos; --i)
+            {
+                parent->_keys[i] = parent->_keys[i - 1];
+                parent->_children[i + 1] = parent->_children[i];
+            }
+            parent->_keys[pos] = separator;
+            parent->_children[pos + 1] = new_node;
+            ++parent->_count;
+        }
+        else
+        {
+            _inner_type* root = allocate_inner();
+            root->_keys[0] = separator;
+            root->_children[0] = node;
+            root->_children[1] = new_node;
+            root->_count = 1;
+            _root.store(root, std::memory_order_release);
+        }
+
+        node->write_unlock();
+        if (parent != nullptr)
+        {
+            parent->write_unlock();
+        }
+    }
+
+    // moves the upper half of leaf to a new leaf, separator is the last key left in leaf
+    _leaf_type* split_leaf(_leaf_type* leaf, key_type& separator)
+    {
+        _leaf_type* new_leaf = allocate_leaf();
+        uint32_t left_count = leaf->_count / 2;
+
+        for (uint32_t i = left_count; i < leaf->_count; ++i)
+        {
+            new_leaf->_keys[i - left_count] = leaf->_keys[i];
+            new_leaf->_values[i - left_count] = leaf->_values[i];
+        }
+        new_leaf->_count = leaf->_count - left_count;
+        new_leaf->_next = leaf->_next;
+
+        leaf->_count = left_count;
+        leaf->_next = new_leaf;
+        separator = leaf->_keys[left_count - 1];
+
+        return new_leaf;
+    }
+
+    // moves the keys above the middle one to a new inner node, the middle key goes up as separator
+    _inner_type* split_inner(_inner_type* inner, key_type& separator)
+    {
+        _inner_type* new_inner = allocate_inner();
+        uint32_t left_count = inner->_count / 2;
+
+        for (uint32_t i = left_count + 1; i < inner->_count; ++i)
+        {
+            new_inner->_keys[i - left_count - 1] = inner->_keys[i];
+        }
+        for (uint32_t i = left_count + 1; i <= inner->_count; ++i)
+        {
+            new_inner->_children[i - left_count - 1] = inner->_children[i];
+        }
+        new_inner->_count = inner->_count - left_count - 1;
+
+        separator = inner->_keys[left_count];
+        inner->_count = left_count;
+
+        return new_inner;
+    }
+
+    _leaf_type* allocate_leaf()
+    {
+        _leaf_type* leaf = std::allocator_traits<_leaf_allocator>::allocate(_leaf_alloc, 1);
+        return ::new((void*)leaf) _leaf_type();
+    }
+
+    _inner_type* allocate_inner()
+    {
+        _inner_type* inner = std::allocator_traits<_inner_allocator>::allocate(_inner_alloc, 1);
+        return ::new((void*)inner) _inner_type();
+    }
+
+    void deallocate_node(_node_type* node)
+    {
+        if (node->_is_leaf)
+        {
+            _leaf_type* leaf = static_cast<_leaf_type*>(node);
+            leaf->~_leaf_type();
+            std::allocator_traits<_leaf_allocator>::deallocate(_leaf_alloc, leaf, 1);
+        }
+        else
+        {
+            _inner_type* inner = static_cast<_inner_type*>(node);
+            for (uint32_t i = 0; i <= inner->_count; ++i)
+            {
+                deallocate_node(inner->_children[i]);
+            }
+            inner->~_inner_type();
+            std::allocator_traits<_inner_allocator>::deallocate(_inner_alloc, inner, 1);
+        }
+    }
+
+    key_compare _comp;
+    _leaf_allocator _leaf_alloc;
+    _inner_allocator _inner_alloc;
+    std::atomic<_node_type*> _root;
+    std::atomic<size_type> _size;
+};
+
+}
@@ -1,15 +1,86 @@
 #pragma once
 
+#include <limits>
 #include "xxfl_bplus_tree.h"
 
 namespace xxfl {
 
+// monoids of the aggregates kept by a map. a monoid has a trivially copyable value_type, its identity(), lift(key,
+// mapped) making the aggregate of a single value and an associative combine(x, y). it must not throw.
+template<typename _type>
+struct sum_of_mapped
+{
+    typedef _type value_type;
+
+    value_type identity() const noexcept { return value_type(); }
+
+    template<typename _key_type, typename _mapped_type>
+    value_type lift(const _key_type&, const _mapped_type& mapped) const noexcept { return (value_type)mapped; }
+
+    value_type combine(const value_type& x, const value_type& y) const noexcept { return x + y; }
+};
+
+template<typename _type>
+struct min_of_mapped
+{
+    typedef _type value_type;
+
+    value_type identity() const noexcept { return std::numeric_limits<value_type>::max(); }
+
+    template<typename _key_type, typename _mapped_type>
+    value_type lift(const _key_type&, const _mapped_type& mapped) const noexcept { return (value_type)mapped; }
+
+    value_type combine(const value_type& x, const value_type& y) const noexcept { return (y < x)? y : x; }
+};
+
+template<typename _type>
+struct max_of_mapped
+{
+    typedef _type value_type;
+
+    value_type identity() const noexcept { return std::numeric_limits<value_type>::lowest(); }
+
+    template<typename _key_type, typename _mapped_type>
+    value_type lift(const _key_type&, const _mapped_type& mapped) const noexcept { return (value_type)mapped; }
+
+    value_type combine(const value_type& x, const value_type& y) const noexcept { return (x < y)? y : x; }
+};
+
+// what operator [] and at() of a map keeping aggregates return instead of mapped_type&. a mapped value assigned
+// through it is written in place and the aggregates on its path are recomputed right away, so reduce() is never
+// stale. such a map has no mutable iterators for the same reason.
+template<typename _bplus_tree_type, typename _mapped_type>
+struct _aggregate_mapped_reference
+{
+    typedef typename _bplus_tree_type::_const_iterator _const_iterator;
+
+    _bplus_tree_type* _tree;
+    _const_iterator _it;
+
+    _aggregate_mapped_reference(_bplus_tree_type* tree, const _const_iterator& it) noexcept : _tree(tree), _it(it) {}
+
+    operator const _mapped_type& () const noexcept { return _it->second; }
+
+    template<typename _obj>
+    _aggregate_mapped_reference& operator = (_obj&& obj)
+    {
+        const_cast<_mapped_type&>(_it->second) = std::forward<_obj>(obj);
+        _tree->update_aggregates(_it);
+        return *this;
+    }
+
+    _aggregate_mapped_reference& operator = (const _aggregate_mapped_reference& x)
+    { return *this = (const _mapped_type&)x; }
+};
+
 template<typename _key_type,
          typename _mapped_type,
          typename _compare = std::less<_key_type>,
          typename _allocator = std::allocator<std::pair<const _key_type, _mapped_type> >,
-         uint32_t _bucket_bysize_max = XXFL_BPLUS_TREE_BUCKET_BYSIZE_MAX_DEFAULT,
-         uint32_t _tree_height_max = XXFL_BPLUS_TREE_HEIGHT_MAX_DEFAULT>
+         uint32_t _leaf_bucket_bysize_max = XXFL_BPLUS_TREE_BUCKET_BYSIZE_MAX_DEFAULT,
+         uint32_t _tree_height_max = XXFL_BPLUS_TREE_HEIGHT_MAX_DEFAULT,
+         uint32_t _internal_bucket_bysize_max = _leaf_bucket_bysize_max,
+         typename _monoid = void>
 class map
 {
 public:
@@ -20,9 +91,9 @@ public:
     typedef _compare                                 key_compare;
     typedef _allocator                               allocator_type;
 
-    typedef _bplus_tree<key_type, value_type, moveable_value_type,
+    typedef _bplus_tree<key_type, value_type, moveable_value_type, void,
                         std::__select1st<value_type>, key_compare, allocator_type,
-                        _bucket_bysize_max, _tree_height_max> _bplus_tree_type;
+                        _leaf_bucket_bysize_max, _internal_bucket_bysize_max, _tree_height_max, _monoid> _bplus_tree_type;
 
     struct value_compare
     {
@@ -45,13 +116,31 @@ public:
     typedef typename _alloc_wrapper::const_pointer             const_pointer;
     typedef typename _alloc_wrapper::reference                 reference;
     typedef typename _alloc_wrapper::const_reference           const_reference;
-    typedef typename _bplus_tree_type::_iterator               iterator;
-    typedef typename _bplus_tree_type::_const_iterator         const_iterator;
-    typedef typename _bplus_tree_type::_reverse_iterator       reverse_iterator;
-    typedef typename _bplus_tree_type::_const_reverse_iterator const_reverse_iterator;
     typedef size_t                                             size_type;
     typedef ptrdiff_t                                          difference_type;
 
+    // with a monoid the mapped values are only written through operator [], at() and insert_or_assign(), which keep
+    // the aggregates, so the iterators are all const
+    static const bool __aggregates = _bplus_tree_type::__aggregates;
+
+    typedef typename std::conditional<__aggregates, typename _bplus_tree_type::_const_iterator,
+                                      typename _bplus_tree_type::_iterator>::type iterator;
+    typedef typename _bplus_tree_type::_const_iterator                             const_iterator;
+    typedef typename std::conditional<__aggregates, typename _bplus_tree_type::_const_reverse_iterator,
+                                      typename _bplus_tree_type::_reverse_iterator>::type reverse_iterator;
+    typedef typename _bplus_tree_type::_const_reverse_iterator                     const_reverse_iterator;
+
+    typedef typename std::conditional<__aggregates, _aggregate_mapped_reference<_bplus_tree_type, mapped_type>,
+                                      mapped_type&>::type mapped_reference;
+
+    struct node_type : _node_handle_base<moveable_value_type, allocator_type>
+    {
+        key_type& key() const noexcept { return this->_value().first; }
+        mapped_type& mapped() const noexcept { return this->_value().second; }
+    };
+
+    typedef _insert_return_type<iterator, node_type> insert_return_type;
+
     map() {}
 
     explicit map(const key_compare& comp, const allocator_type& alloc = allocator_type())
@@ -88,6 +177,14 @@ public:
              _alloc_wrapper::allocator_always_compares_equal())
     : _tree(std::move(x._tree), _pair_alloc_type(alloc)) {}
 
+    // the range must be sorted by comp without equal keys, the tree is then built in linear time
+    template<typename _input_iterator>
+    map(sorted_unique_t, _input_iterator first, _input_iterator last,
+        const key_compare& comp = key_compare(),
+        const allocator_type& alloc = allocator_type())
+    : _tree(comp, _pair_alloc_type(alloc))
+    { _tree.bulk_load(first, last, 1.0f); }
+
     map(std::initializer_list<value_type> il,
         const key_compare& comp = key_compare(),
         const allocator_type& alloc = allocator_type())
@@ -123,14 +220,14 @@ public:
     value_compare value_comp() const { return value_compare(_tree._comp); }
     allocator_type get_allocator() const noexcept { return _tree._awrapper._alloc; }
 
-    iterator begin() noexcept { return _tree.begin(); }
+    iterator begin() { return _tree.template writable<iterator>(_tree.begin()); }
     const_iterator begin() const noexcept { return _tree.cbegin(); }
     iterator end() noexcept { return _tree.end(); }
     const_iterator end() const noexcept { return _tree.cend(); }
 
     reverse_iterator rbegin() noexcept { return _tree.rbegin(); }
     const_reverse_iterator rbegin() const noexcept { return _tree.crbegin(); }
-    reverse_iterator rend() noexcept { return _tree.rend(); }
+    reverse_iterator rend() { return reverse_iterator(begin()); }
     const_reverse_iterator rend() const noexcept { return _tree.crend(); }
 
     const_iterator cbegin() const noexcept { return _tree.cbegin(); }
@@ -146,27 +243,39 @@ public:
 
     void swap(map& x) noexcept(_alloc_wrapper::is_nothrow_swap()) { _tree.swap(x._tree); }
 
+    // a copy of this map taking constant time, the two share their nodes until either changes, which first copies
+    // just the nodes on the path to the change. a snapshot can be read on another thread while this map is written.
+    // the iterators this map hands out afterwards lead through nodes it alone owns, their path is copied first, so
+    // mapped values written through them never reach the snapshot. iterators taken before snapshot() must not be
+    // written through any more. with leaf links it copies every node.
+    map snapshot()
+    {
+        map x(key_comp(), get_allocator());
+        _tree.share_with(x._tree);
+        return x;
+    }
+
     template<typename... _args>
     std::pair<iterator, bool> emplace(_args&&... args)
-    { return _tree.template insert<iterator>(value_type(std::forward<_args>(args)...)); }
+    { return _tree.writable(_tree.template insert<iterator>(value_type(std::forward<_args>(args)...))); }
 
     template<typename... _args>
     iterator emplace_hint(const const_iterator& position, _args&&... args)
-    { return _tree.template insert<iterator>(position, value_type(std::forward<_args>(args)...)); }
+    { return _tree.writable(_tree.template insert<iterator>(position, value_type(std::forward<_args>(args)...))); }
 
     std::pair<iterator, bool> insert(const value_type& x)
-    { return _tree.template insert<iterator>(x); }
+    { return _tree.writable(_tree.template insert<iterator>(x)); }
 
     template<typename _pair, typename = typename std::enable_if<std::is_constructible<value_type, _pair&&>::value>::type>
     std::pair<iterator, bool> insert(_pair&& x)
-    { return _tree.template insert<iterator>(std::forward<_pair>(x)); }
+    { return _tree.writable(_tree.template insert<iterator>(std::forward<_pair>(x))); }
 
     iterator insert(const const_iterator& position, const value_type& x)
-    { return _tree.template insert<iterator>(position, x); }
+    { return _tree.writable(_tree.template insert<iterator>(position, x)); }
 
     template<typename _pair, typename = typename std::enable_if<std::is_constructible<value_type, _pair&&>::value>::type>
     iterator insert(const const_iterator& position, _pair&& x)
-    { return _tree.template insert<iterator>(position, std::forward<_pair>(x)); }
+    { return _tree.writable(_tree.template insert<iterator>(position, std::forward<_pair>(x))); }
 
     template<typename _input_iterator>
     void insert(_input_iterator first, _input_iterator last)
@@ -175,63 +284,370 @@ public:
     void insert(std::initializer_list<value_type> il)
     { _tree.insert_range(il.begin(), il.end()); }
 
-    iterator erase(const iterator& position)
-    { return _tree.template erase<iterator>(position); }
+    // like insert(first, last) with the range in any order, but the range is sorted first and each leaf is reached
+    // once for all the keys falling into it, which pays off for large unsorted batches
+    template<typename _input_iterator>
+    void insert_batch(_input_iterator first, _input_iterator last)
+    { _tree.template insert_batch<moveable_value_type>(first, last); }
+
+    iterator erase(const typename _bplus_tree_type::_iterator& position)
+    { return _tree.writable(_tree.template erase<iterator>(position)); }
 
     iterator erase(const const_iterator& position)
-    { return _tree.template erase<iterator>(position); }
+    { return _tree.writable(_tree.template erase<iterator>(position)); }
 
     size_type erase(const key_type& key)
-    { return _tree.erase(key); }
+    { return _tree.erase_key(key); }
+
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent,
+             typename = typename std::enable_if<!std::is_convertible<const _k&, const_iterator>::value>::type>
+    size_type erase(const _k& key)
+    { return _tree.erase_key(key); }
 
     iterator erase(const const_iterator& first, const const_iterator& last)
-    { return _tree.template erase_range<iterator>(first, last); }
+    { return _tree.writable(_tree.template erase_range<iterator>(first, last)); }
+
+    // the value is moved out of its leaf into the handle and erased from the tree
+    node_type extract(const const_iterator& position)
+    {
+        node_type nh;
+        nh._alloc = get_allocator();
+        _tree.extract(position, nh);
+        return nh;
+    }
+
+    node_type extract(const key_type& key)
+    {
+        const_iterator it = _tree.template find<const_iterator>(key);
+        return (it._value_ptr != nullptr)? extract(it) : node_type();
+    }
+
+    insert_return_type insert(node_type&& nh)
+    {
+        insert_return_type ret;
+
+        if (nh.empty())
+        {
+            ret.position = end();
+            ret.inserted = false;
+            return ret;
+        }
+
+        std::pair<iterator, bool> result = _tree.writable(_tree.template insert<iterator>(std::move(nh._value())));
+
+        ret.position = result.first;
+        ret.inserted = result.second;
+
+        if (result.second)
+        {
+            nh._reset();
+        }
+        else
+        {
+            ret.node = std::move(nh);
+        }
+
+        return ret;
+    }
+
+    iterator insert(const const_iterator& position, node_type&& nh)
+    {
+        if (nh.empty())
+        {
+            return end();
+        }
+
+        size_type values_count = size();
+        iterator it = _tree.writable(_tree.template insert<iterator>(position, std::move(nh._value())));
+
+        if (size() != values_count)
+        {
+            nh._reset();
+        }
+
+        return it;
+    }
+
+    // moves the values of x which are missing here into this map, x keeps the others. when the key ranges don't
+    // interleave the trees are joined and no value is moved. the allocators must be equal.
+    void merge(map& x)
+    { _tree.merge(x._tree); }
+
+    void merge(map&& x)
+    { _tree.merge(x._tree); }
 
     void clear() noexcept { _tree.clear(); }
 
+    // replaces the content by a range sorted by key_comp() without equal keys, the nodes are filled up to
+    // fill_factor of their capacity to leave room for later insertions
+    template<typename _input_iterator>
+    void bulk_load(_input_iterator first, _input_iterator last, float fill_factor = 1.0f)
+    {
+        _tree.clear();
+        _tree.bulk_load(first, last, fill_factor);
+    }
+
+    // moves the values with keys not less than key into the returned container. only the nodes on the path of key
+    // are cut, so it takes time proportional to the height of the tree instead of the number of values moved.
+    map split(const key_type& key)
+    {
+        map x(key_comp(), get_allocator());
+        _tree.split(key, x._tree);
+        return x;
+    }
+
+    // appends the values of x, whose keys must all be larger than the keys here, and leaves x empty. the lower tree is
+    // hung into the edge of the higher one. the allocators must be equal.
+    void join(map& x)
+    { _tree.join(x._tree); }
+
     size_type count(const key_type& key) const
     { return _tree.template find<const_iterator>(key)._value_ptr != nullptr; }
 
     iterator find(const key_type& key)
-    { return _tree.template find<iterator>(key); }
+    { return _tree.writable(_tree.template find<iterator>(key)); }
 
     const_iterator find(const key_type& key) const
     { return _tree.template find<const_iterator>(key); }
 
+    // looks up the keys of [first, last) and writes an iterator for each one to out, end() when it's missing. the
+    // lookups advance a level at a time in groups so their cache misses overlap, which pays off on large trees. while
+    // nodes are shared with a snapshot the keys are looked up one by one, each path is copied before the next lookup.
+    template<typename _forward_iterator, typename _output_iterator>
+    _output_iterator find_batch(_forward_iterator first, _forward_iterator last, _output_iterator out)
+    {
+        if (!__aggregates && _tree._shared_nodes)
+        {
+            for (; first != last; ++first, ++out)
+            {
+                *out = find(*first);
+            }
+
+            return out;
+        }
+
+        return _tree.template find_batch<iterator>(first, last, out);
+    }
+
+    template<typename _forward_iterator, typename _output_iterator>
+    _output_iterator find_batch(_forward_iterator first, _forward_iterator last, _output_iterator out) const
+    { return _tree.template find_batch<const_iterator>(first, last, out); }
+
+    // like find_batch, but writes whether each key is present
+    template<typename _forward_iterator, typename _output_iterator>
+    _output_iterator contains_batch(_forward_iterator first, _forward_iterator last, _output_iterator out) const
+    { return _tree.contains_batch(first, last, out); }
+
     iterator lower_bound(const key_type& key)
-    { return _tree.template lower_bound<iterator>(key); }
+    { return _tree.writable(_tree.template lower_bound<iterator>(key)); }
 
     const_iterator lower_bound(const key_type& key) const
     { return _tree.template lower_bound<const_iterator>(key); }
 
     iterator upper_bound(const key_type& key)
-    { return _tree.template upper_bound<iterator>(key); }
+    { return _tree.writable(_tree.template upper_bound<iterator>(key)); }
 
     const_iterator upper_bound(const key_type& key) const
     { return _tree.template upper_bound<const_iterator>(key); }
 
     std::pair<iterator, iterator> equal_range(const key_type& key)
-    { return _tree.template equal_range<iterator>(key); }
+    { return _tree.writable(_tree.template equal_range<iterator>(key)); }
 
     std::pair<const_iterator, const_iterator> equal_range(const key_type& key) const
     { return _tree.template equal_range<const_iterator>(key); }
 
-    mapped_type& operator [] (const key_type& key)
+    // the overloads below take keys of any type when key_compare declares is_transparent, like std::less<>, so a
+    // lookup by e.g. a string_view doesn't build a key_type first. such a key must match one key_type key at most.
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent>
+    size_type count(const _k& key) const
+    { return _tree.template find<const_iterator>(key)._value_ptr != nullptr; }
+
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent>
+    iterator find(const _k& key)
+    { return _tree.writable(_tree.template find<iterator>(key)); }
+
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent>
+    const_iterator find(const _k& key) const
+    { return _tree.template find<const_iterator>(key); }
+
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent>
+    iterator lower_bound(const _k& key)
+    { return _tree.writable(_tree.template lower_bound<iterator>(key)); }
+
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent>
+    const_iterator lower_bound(const _k& key) const
+    { return _tree.template lower_bound<const_iterator>(key); }
+
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent>
+    iterator upper_bound(const _k& key)
+    { return _tree.writable(_tree.template upper_bound<iterator>(key)); }
+
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent>
+    const_iterator upper_bound(const _k& key) const
+    { return _tree.template upper_bound<const_iterator>(key); }
+
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent>
+    std::pair<iterator, iterator> equal_range(const _k& key)
+    { return _tree.writable(_tree.template equal_range<iterator>(key)); }
+
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent>
+    std::pair<const_iterator, const_iterator> equal_range(const _k& key) const
+    { return _tree.template equal_range<const_iterator>(key); }
+
+    // order statistics, they take O(log n) when XXFL_BPLUS_TREE_SUBTREE_COUNTS is set and otherwise walk the subtrees
+    // they skip. select(index_of(it) + n) moves an iterator by n values at once.
+    size_type rank(const key_type& key) const
+    { return _tree.rank(key); }
+
+    size_type count_range(const key_type& lower_key, const key_type& upper_key) const
+    { return _tree.count_range(lower_key, upper_key); }
+
+    iterator select(size_type index)
+    { return _tree.writable(_tree.template select<iterator>(index)); }
+
+    const_iterator select(size_type index) const
+    { return _tree.template select<const_iterator>(index); }
+
+    size_type index_of(const_iterator position) const
+    { return _tree.index_of(position); }
+
+    // internal iteration: f(value) for each value, or f(first, last) for the values of each leaf as one contiguous
+    // block. there is no iterator to step, so loops over the blocks can be vectorized by the compiler. f must not
+    // change the container.
+    template<typename _function>
+    _function for_each(_function f) const
+    {
+        _tree.for_each_value(f);
+        return f;
+    }
+
+    // the values not less than lower_key and less than upper_key
+    template<typename _function>
+    _function for_each_range(const key_type& lower_key, const key_type& upper_key, _function f) const
     {
-        iterator it(&_tree);
+        _tree.for_each_value_range(lower_key, upper_key, f);
+        return f;
+    }
+
+    template<typename _function>
+    _function for_each_span(_function f) const
+    {
+        _tree.for_each_value_span(f);
+        return f;
+    }
+
+    template<typename _function>
+    _function for_each_span_range(const key_type& lower_key, const key_type& upper_key, _function f) const
+    {
+        _tree.for_each_value_span_range(lower_key, upper_key, f);
+        return f;
+    }
+
+    // for_each() and for_each_range() on the threads of executor, which is called with a std::function<void()> for
+    // each run of values and may run it on any thread, see thread_executor. the runs begin at the first values of the
+    // subtrees under the root, or of a lower level when the root has too few, so cutting them takes no search through
+    // the values. each run calls a copy of f, the calls return when all runs are done. the runs are made in
+    // xxfl_parallel.h, which has to be included to call these, so the containers alone pull in no thread headers.
+    template<typename _executor, typename _function>
+    void parallel_for_each(_executor&& executor, const _function& f) const
+    { parallel_for_each_value(_tree, executor, (const key_type*)nullptr, (const key_type*)nullptr, f); }
+
+    template<typename _executor, typename _function>
+    void parallel_for_each_range(_executor&& executor, const key_type& lower_key, const key_type& upper_key,
+                                 const _function& f) const
+    { parallel_for_each_value(_tree, executor, &lower_key, &upper_key, f); }
+
+    // folds the values with keys in [lower_key, upper_key) with result = f(result, value) in each run, starting from
+    // identity, then the results of the runs in key order with result = combine(result, run_result)
+    template<typename _executor, typename _type, typename _function, typename _combine>
+    _type parallel_reduce(_executor&& executor, const key_type& lower_key, const key_type& upper_key,
+                          const _type& identity, const _function& f, const _combine& combine) const
+    { return parallel_reduce_values(_tree, executor, &lower_key, &upper_key, identity, f, combine); }
+
+    typedef typename _bplus_tree_type::_aggregate_type aggregate_type;
+
+    // combines the values with keys in [lower_key, upper_key) by the monoid the map was given, whole subtrees are
+    // taken from the aggregates kept in the internal nodes
+    aggregate_type reduce(const key_type& lower_key, const key_type& upper_key) const
+    { return _tree.reduce(lower_key, upper_key); }
+
+    // the value is only constructed from args when key is missing, found by the same descent as the insertion
+    template<typename... _args>
+    std::pair<iterator, bool> try_emplace(const key_type& key, _args&&... args)
+    { return _tree.writable(_tree.template try_emplace<iterator>(key, std::forward<_args>(args)...)); }
+
+    template<typename... _args>
+    std::pair<iterator, bool> try_emplace(key_type&& key, _args&&... args)
+    { return _tree.writable(_tree.template try_emplace<iterator>(std::move(key), std::forward<_args>(args)...)); }
+
+    template<typename... _args>
+    iterator try_emplace(const const_iterator& /*position*/, const key_type& key, _args&&... args)
+    { return try_emplace(key, std::forward<_args>(args)...).first; }
+
+    template<typename... _args>
+    iterator try_emplace(const const_iterator& /*position*/, key_type&& key, _args&&... args)
+    { return try_emplace(std::move(key), std::forward<_args>(args)...).first; }
+
+    template<typename _obj>
+    std::pair<iterator, bool> insert_or_assign(const key_type& key, _obj&& obj)
+    {
+        typedef typename _bplus_tree_type::_iterator _mutable_iterator;
+        std::pair<_mutable_iterator, bool> ret = _tree.template try_emplace<_mutable_iterator>(key, std::forward<_obj>(obj));
+
+        if (!ret.second)
+        {
+            _tree.unshare_value(ret.first);
+            ret.first->second = std::forward<_obj>(obj);
+            _tree.update_aggregates(ret.first);
+        }
+
+        return std::pair<iterator, bool>(ret.first, ret.second);
+    }
+
+    template<typename _obj>
+    std::pair<iterator, bool> insert_or_assign(key_type&& key, _obj&& obj)
+    {
+        typedef typename _bplus_tree_type::_iterator _mutable_iterator;
+        std::pair<_mutable_iterator, bool> ret = _tree.template try_emplace<_mutable_iterator>(std::move(key), std::forward<_obj>(obj));
+
+        if (!ret.second)
+        {
+            _tree.unshare_value(ret.first);
+            ret.first->second = std::forward<_obj>(obj);
+            _tree.update_aggregates(ret.first);
+        }
+
+        return std::pair<iterator, bool>(ret.first, ret.second);
+    }
+
+    template<typename _obj>
+    iterator insert_or_assign(const const_iterator& /*position*/, const key_type& key, _obj&& obj)
+    { return insert_or_assign(key, std::forward<_obj>(obj)).first; }
+
+    template<typename _obj>
+    iterator insert_or_assign(const const_iterator& /*position*/, key_type&& key, _obj&& obj)
+    { return insert_or_assign(std::move(key), std::forward<_obj>(obj)).first; }
+
+    mapped_reference operator [] (const key_type& key)
+    {
+        typename _bplus_tree_type::_path it(&_tree);
 
         if (_tree._values_count > 0)
         {
             _bplus_tree_node<value_type>* cur_node;
             it._value_ptr = _tree.lower_bound_core(key, it._stack, cur_node);
 
-            if (it._value_ptr == cur_node->values_end() || _tree.key_less(key, *it))
+            if (it._value_ptr == cur_node->values_end() || _tree.key_less(key, *it._value_ptr))
             {
                 _tree.insert_core(it,
                                   std::piecewise_construct,
                                   std::tuple<const key_type&>(key),
                                   std::tuple<>());
             }
+            else
+            {
+                _tree.unshare_value(it);
+            }
         }
         else
         {
@@ -241,25 +657,29 @@ public:
                                      std::tuple<>());
         }
 
-        return (*it).second;
+        return mapped_reference_of(it);
     }
 
-    mapped_type& operator [] (key_type&& key)
+    mapped_reference operator [] (key_type&& key)
     {
-        iterator it(&_tree);
+        typename _bplus_tree_type::_path it(&_tree);
 
         if (_tree._values_count > 0)
         {
             _bplus_tree_node<value_type>* cur_node;
             it._value_ptr = _tree.lower_bound_core(key, it._stack, cur_node);
 
-            if (it._value_ptr == cur_node->values_end() || _tree.key_less(key, *it))
+            if (it._value_ptr == cur_node->values_end() || _tree.key_less(key, *it._value_ptr))
             {
                 _tree.insert_core(it,
                                   std::piecewise_construct,
                                   std::forward_as_tuple<const key_type&>(std::move(key)),
                                   std::tuple<>());
             }
+            else
+            {
+                _tree.unshare_value(it);
+            }
         }
         else
         {
@@ -269,17 +689,18 @@ public:
                                      std::tuple<>());
         }
 
-        return (*it).second;
+        return mapped_reference_of(it);
     }
 
-    mapped_type& at(const key_type& key)
+    mapped_reference at(const key_type& key)
     {
-        iterator it = _tree.template find<iterator>(key);
+        typename _bplus_tree_type::_iterator it = _tree.template find<typename _bplus_tree_type::_iterator>(key);
         if (it._value_ptr == nullptr)
         {
             std::__throw_out_of_range("xxfl::map::at");
         }
-        return (*it).second;
+        _tree.unshare_value(it);
+        return mapped_reference_of(it);
     }
 
     const mapped_type& at(const key_type& key) const
@@ -291,41 +712,67 @@ public:
         }
         return (*it).second;
     }
+
+protected:
+    template<typename _iterator_type>
+    mapped_type& mapped_reference_of(const _iterator_type& it, std::false_type /*aggregates*/) noexcept
+    { return it._value_ptr->second; }
+
+    template<typename _iterator_type>
+    _aggregate_mapped_reference<_bplus_tree_type, mapped_type>
+    mapped_reference_of(const _iterator_type& it, std::true_type /*aggregates*/) noexcept
+    { return _aggregate_mapped_reference<_bplus_tree_type, mapped_type>(&_tree, const_iterator(it)); }
+
+    template<typename _iterator_type>
+    mapped_reference mapped_reference_of(const _iterator_type& it) noexcept
+    { return mapped_reference_of(it, std::integral_constant<bool, __aggregates>()); }
 };
 
-template<typename _a, typename _b, typename _c, typename _d, uint32_t _e, uint32_t _f>
-inline bool operator == (const xxfl::map<_a, _b, _c, _d, _e, _f>& x,
-                         const xxfl::map<_a, _b, _c, _d, _e, _f>& y)
+template<typename _a, typename _b, typename _c, typename _d, uint32_t _e, uint32_t _f, uint32_t _g, typename _h>
+inline bool operator == (const xxfl::map<_a, _b, _c, _d, _e, _f, _g, _h>& x,
+                         const xxfl::map<_a, _b, _c, _d, _e, _f, _g, _h>& y)
 { return x._tree == y._tree; }
 
-template<typename _a, typename _b, typename _c, typename _d, uint32_t _e, uint32_t _f>
-inline bool operator < (const xxfl::map<_a, _b, _c, _d, _e, _f>& x,
-                        const xxfl::map<_a, _b, _c, _d, _e, _f>& y)
+template<typename _a, typename _b, typename _c, typename _d, uint32_t _e, uint32_t _f, uint32_t _g, typename _h>
+inline bool operator < (const xxfl::map<_a, _b, _c, _d, _e, _f, _g, _h>& x,
+                        const xxfl::map<_a, _b, _c, _d, _e, _f, _g, _h>& y)
 { return x._tree < y._tree; }
 
-template<typename _a, typename _b, typename _c, typename _d, uint32_t _e, uint32_t _f>
-inline bool operator != (const xxfl::map<_a, _b, _c, _d, _e, _f>& x,
-                         const xxfl::map<_a, _b, _c, _d, _e, _f>& y)
+template<typename _a, typename _b, typename _c, typename _d, uint32_t _e, uint32_t _f, uint32_t _g, typename _h>
+inline bool operator != (const xxfl::map<_a, _b, _c, _d, _e, _f, _g, _h>& x,
+                         const xxfl::map<_a, _b, _c, _d, _e, _f, _g, _h>& y)
 { return !(x == y); }
 
-template<typename _a, typename _b, typename _c, typename _d, uint32_t _e, uint32_t _f>
-inline bool operator > (const xxfl::map<_a, _b, _c, _d, _e, _f>& x,
-                        const xxfl::map<_a, _b, _c, _d, _e, _f>& y)
+template<typename _a, typename _b, typename _c, typename _d, uint32_t _e, uint32_t _f, uint32_t _g, typename _h>
+inline bool operator > (const xxfl::map<_a, _b, _c, _d, _e, _f, _g, _h>& x,
+                        const xxfl::map<_a, _b, _c, _d, _e, _f, _g, _h>& y)
 { return y < x; }
 
-template<typename _a, typename _b, typename _c, typename _d, uint32_t _e, uint32_t _f>
-inline bool operator <= (const xxfl::map<_a, _b, _c, _d, _e, _f>& x,
-                         const xxfl::map<_a, _b, _c, _d, _e, _f>& y)
+template<typename _a, typename _b, typename _c, typename _d, uint32_t _e, uint32_t _f, uint32_t _g, typename _h>
+inline bool operator <= (const xxfl::map<_a, _b, _c, _d, _e, _f, _g, _h>& x,
+                         const xxfl::map<_a, _b, _c, _d, _e, _f, _g, _h>& y)
 { return !(y < x); }
 
-template<typename _a, typename _b, typename _c, typename _d, uint32_t _e, uint32_t _f>
-inline bool operator >= (const xxfl::map<_a, _b, _c, _d, _e, _f>& x,
-                         const xxfl::map<_a, _b, _c, _d, _e, _f>& y)
+template<typename _a, typename _b, typename _c, typename _d, uint32_t _e, uint32_t _f, uint32_t _g, typename _h>
+inline bool operator >= (const xxfl::map<_a, _b, _c, _d, _e, _f, _g, _h>& x,
+                         const xxfl::map<_a, _b, _c, _d, _e, _f, _g, _h>& y)
 { return !(x < y); }
 
-template<typename _a, typename _b, typename _c, typename _d, uint32_t _e, uint32_t _f>
-inline void swap(xxfl::map<_a, _b, _c, _d, _e, _f>& x,
-                 xxfl::map<_a, _b, _c, _d, _e, _f>& y)
+template<typename _a, typename _b, typename _c, typename _d, uint32_t _e, uint32_t _f, uint32_t _g, typename _h>
+inline void swap(xxfl::map<_a, _b, _c, _d, _e, _f, _g, _h>& x,
+                 xxfl::map<_a, _b, _c, _d, _e, _f, _g, _h>& y)
 { x.swap(y); }
 
+// a map keeping the aggregates of _monoid, e.g. aggregate_map<uint64_t, double, sum_of_mapped<double> >
+template<typename _key_type,
+         typename _mapped_type,
+         typename _monoid,
+         typename _compare = std::less<_key_type>,
+         typename _allocator = std::allocator<std::pair<const _key_type, _mapped_type> >,
+         uint32_t _leaf_bucket_bysize_max = XXFL_BPLUS_TREE_BUCKET_BYSIZE_MAX_DEFAULT,
+         uint32_t _tree_height_max = XXFL_BPLUS_TREE_HEIGHT_MAX_DEFAULT,
+         uint32_t _internal_bucket_bysize_max = _leaf_bucket_bysize_max>
+using aggregate_map = map<_key_type, _mapped_type, _compare, _allocator,
+                          _leaf_bucket_bysize_max, _tree_height_max, _internal_bucket_bysize_max, _monoid>;
+
 } // xxfl
@@ -0,0 +1,414 @@
+#pragma once
+
+#include "xxfl_bplus_tree.h"
+
+namespace xxfl {
+
+// a map keeping equal keys, in the order they were inserted. the equal keys of a run may span several leaves.
+template<typename _key_type,
+         typename _mapped_type,
+         typename _compare = std::less<_key_type>,
+         typename _allocator = std::allocator<std::pair<const _key_type, _mapped_type> >,
+         uint32_t _leaf_bucket_bysize_max = XXFL_BPLUS_TREE_BUCKET_BYSIZE_MAX_DEFAULT,
+         uint32_t _tree_height_max = XXFL_BPLUS_TREE_HEIGHT_MAX_DEFAULT,
+         uint32_t _internal_bucket_bysize_max = _leaf_bucket_bysize_max>
+class multimap
+{
+public:
+    typedef _key_type                                key_type;
+    typedef _mapped_type                             mapped_type;
+    typedef std::pair<const _key_type, _mapped_type> value_type;
+    typedef std::pair<_key_type, _mapped_type>       moveable_value_type;
+    typedef _compare                                 key_compare;
+    typedef _allocator                               allocator_type;
+
+    typedef _bplus_tree<key_type, value_type, moveable_value_type, void,
+                        std::__select1st<value_type>, key_compare, allocator_type,
+                        _leaf_bucket_bysize_max, _internal_bucket_bysize_max, _tree_height_max, void, true> _bplus_tree_type;
+
+    struct value_compare
+    {
+        key_compare _comp;
+
+        value_compare(key_compare comp) : _comp(comp) {}
+
+        bool operator () (const value_type& x, const value_type& y) const
+        { return _comp(x.first, y.first); }
+    };
+
+    _bplus_tree_type _tree;
+
+protected:
+    typedef typename __alloc_wrapper<allocator_type>::template rebind<key_type>::other _pair_alloc_type;
+    typedef __alloc_wrapper<_pair_alloc_type> _alloc_wrapper;
+
+public:
+    typedef typename _alloc_wrapper::pointer                   pointer;
+    typedef typename _alloc_wrapper::const_pointer             const_pointer;
+    typedef typename _alloc_wrapper::reference                 reference;
+    typedef typename _alloc_wrapper::const_reference           const_reference;
+    typedef typename _bplus_tree_type::_iterator               iterator;
+    typedef typename _bplus_tree_type::_const_iterator         const_iterator;
+    typedef typename _bplus_tree_type::_reverse_iterator       reverse_iterator;
+    typedef typename _bplus_tree_type::_const_reverse_iterator const_reverse_iterator;
+    typedef size_t                                             size_type;
+    typedef ptrdiff_t                                          difference_type;
+
+    struct node_type : _node_handle_base<moveable_value_type, allocator_type>
+    {
+        key_type& key() const noexcept { return this->_value().first; }
+        mapped_type& mapped() const noexcept { return this->_value().second; }
+    };
+
+    multimap() {}
+
+    explicit multimap(const key_compare& comp, const allocator_type& alloc = allocator_type())
+    : _tree(comp, _pair_alloc_type(alloc)) {}
+
+    explicit multimap(const allocator_type& alloc) : _tree(key_compare(), _pair_alloc_type(alloc)) {}
+
+    template<typename _input_iterator>
+    multimap(_input_iterator first, _input_iterator last)
+    { _tree.insert_equal_range(first, last); }
+
+    template<typename _input_iterator>
+    multimap(_input_iterator first, _input_iterator last,
+             const key_compare& comp,
+             const allocator_type& alloc = allocator_type())
+    : _tree(comp, _pair_alloc_type(alloc))
+    { _tree.insert_equal_range(first, last); }
+
+    template<typename _input_iterator>
+    multimap(_input_iterator first, _input_iterator last,
+             const allocator_type& alloc)
+    : _tree(key_compare(), _pair_alloc_type(alloc))
+    { _tree.insert_equal_range(first, last); }
+
+    multimap(const multimap& x) : _tree(x._tree) {}
+    multimap(const multimap& x, const allocator_type& alloc) : _tree(x._tree, _pair_alloc_type(alloc)) {}
+
+    multimap(multimap&& x)
+    noexcept(std::is_nothrow_copy_constructible<key_compare>::value)
+    : _tree(std::move(x._tree)) {}
+
+    multimap(multimap&& x, const allocator_type& alloc)
+    noexcept(std::is_nothrow_copy_constructible<key_compare>::value &&
+             _alloc_wrapper::allocator_always_compares_equal())
+    : _tree(std::move(x._tree), _pair_alloc_type(alloc)) {}
+
+    multimap(std::initializer_list<value_type> il,
+             const key_compare& comp = key_compare(),
+             const allocator_type& alloc = allocator_type())
+    : _tree(comp, _pair_alloc_type(alloc))
+    { _tree.insert_equal_range(il.begin(), il.end()); }
+
+    multimap(std::initializer_list<value_type> il, const allocator_type& alloc)
+    : _tree(key_compare(), _pair_alloc_type(alloc))
+    { _tree.insert_equal_range(il.begin(), il.end()); }
+
+    multimap& operator = (const multimap& x)
+    {
+        _tree = x._tree;
+        return *this;
+    }
+
+    multimap& operator = (multimap&& x)
+    noexcept(_alloc_wrapper::propagate_on_container_move_assignment() ||
+             _alloc_wrapper::allocator_always_compares_equal())
+    {
+        _tree.move_assign(x._tree);
+        return *this;
+    }
+
+    multimap& operator = (std::initializer_list<value_type> il)
+    {
+        _tree.clear();
+        _tree.insert_equal_range(il.begin(), il.end());
+        return *this;
+    }
+
+    key_compare key_comp() const { return _tree._comp; }
+    value_compare value_comp() const { return value_compare(_tree._comp); }
+    allocator_type get_allocator() const noexcept { return _tree._awrapper._alloc; }
+
+    iterator begin() { return _tree.template writable<iterator>(_tree.begin()); }
+    const_iterator begin() const noexcept { return _tree.cbegin(); }
+    iterator end() noexcept { return _tree.end(); }
+    const_iterator end() const noexcept { return _tree.cend(); }
+
+    reverse_iterator rbegin() noexcept { return _tree.rbegin(); }
+    const_reverse_iterator rbegin() const noexcept { return _tree.crbegin(); }
+    reverse_iterator rend() { return reverse_iterator(begin()); }
+    const_reverse_iterator rend() const noexcept { return _tree.crend(); }
+
+    const_iterator cbegin() const noexcept { return _tree.cbegin();}
+    const_iterator cend() const noexcept { return _tree.cend(); }
+
+    const_reverse_iterator crbegin() const noexcept { return _tree.crbegin(); }
+    const_reverse_iterator crend() const noexcept { return _tree.crend(); }
+
+    bool empty() const noexcept { return _tree._values_count == 0; }
+
+    size_type size() const noexcept { return _tree._values_count; }
+    size_type max_size() const noexcept { return _tree.max_size(); }
+
+    void swap(multimap& x) noexcept(_alloc_wrapper::is_nothrow_swap()) { _tree.swap(x._tree); }
+
+    // see map::snapshot()
+    multimap snapshot()
+    {
+        multimap x(key_comp(), get_allocator());
+        _tree.share_with(x._tree);
+        return x;
+    }
+
+    template<typename... _args>
+    iterator emplace(_args&&... args)
+    { return _tree.writable(_tree.template insert_equal<iterator>(value_type(std::forward<_args>(args)...))); }
+
+    template<typename... _args>
+    iterator emplace_hint(const const_iterator& position, _args&&... args)
+    { return _tree.writable(_tree.template insert_equal<iterator>(position, value_type(std::forward<_args>(args)...))); }
+
+    iterator insert(const value_type& x)
+    { return _tree.writable(_tree.template insert_equal<iterator>(x)); }
+
+    template<typename _pair, typename = typename std::enable_if<std::is_constructible<value_type, _pair&&>::value>::type>
+    iterator insert(_pair&& x)
+    { return _tree.writable(_tree.template insert_equal<iterator>(std::forward<_pair>(x))); }
+
+    iterator insert(const const_iterator& position, const value_type& x)
+    { return _tree.writable(_tree.template insert_equal<iterator>(position, x)); }
+
+    template<typename _pair, typename = typename std::enable_if<std::is_constructible<value_type, _pair&&>::value>::type>
+    iterator insert(const const_iterator& position, _pair&& x)
+    { return _tree.writable(_tree.template insert_equal<iterator>(position, std::forward<_pair>(x))); }
+
+    template<typename _input_iterator>
+    void insert(_input_iterator first, _input_iterator last)
+    { _tree.insert_equal_range(first, last); }
+
+    void insert(std::initializer_list<value_type> il)
+    { _tree.insert_equal_range(il.begin(), il.end()); }
+
+    iterator erase(const iterator& position)
+    { return _tree.writable(_tree.template erase<iterator>(position)); }
+
+    iterator erase(const const_iterator& position)
+    { return _tree.writable(_tree.template erase<iterator>(position)); }
+
+    // the run of equal keys is erased as a range
+    size_type erase(const key_type& key)
+    { return _tree.erase_key(key); }
+
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent,
+             typename = typename std::enable_if<!std::is_convertible<const _k&, const_iterator>::value>::type>
+    size_type erase(const _k& key)
+    { return _tree.erase_key(key); }
+
+    iterator erase(const const_iterator& first, const const_iterator& last)
+    { return _tree.writable(_tree.template erase_range<iterator>(first, last)); }
+
+    node_type extract(const const_iterator& position)
+    {
+        node_type nh;
+        nh._alloc = get_allocator();
+        _tree.extract(position, nh);
+        return nh;
+    }
+
+    node_type extract(const key_type& key)
+    {
+        const_iterator it = _tree.template find<const_iterator>(key);
+        return (it._value_ptr != nullptr)? extract(it) : node_type();
+    }
+
+    iterator insert(node_type&& nh)
+    {
+        if (nh.empty())
+        {
+            return end();
+        }
+
+        iterator it = _tree.writable(_tree.template insert_equal<iterator>(std::move(nh._value())));
+        nh._reset();
+        return it;
+    }
+
+    iterator insert(const const_iterator& position, node_type&& nh)
+    {
+        if (nh.empty())
+        {
+            return end();
+        }
+
+        iterator it = _tree.writable(_tree.template insert_equal<iterator>(position, std::move(nh._value())));
+        nh._reset();
+        return it;
+    }
+
+    void clear() noexcept { _tree.clear(); }
+
+    // counts the run of key by walking its bounds up until they meet, see count_key
+    size_type count(const key_type& key) const
+    { return _tree.count_key(key); }
+
+    // the first of the equal keys
+    iterator find(const key_type& key)
+    { return _tree.writable(_tree.template find<iterator>(key)); }
+
+    const_iterator find(const key_type& key) const
+    { return _tree.template find<const_iterator>(key); }
+
+    iterator lower_bound(const key_type& key)
+    { return _tree.writable(_tree.template lower_bound<iterator>(key)); }
+
+    const_iterator lower_bound(const key_type& key) const
+    { return _tree.template lower_bound<const_iterator>(key); }
+
+    iterator upper_bound(const key_type& key)
+    { return _tree.writable(_tree.template upper_bound<iterator>(key)); }
+
+    const_iterator upper_bound(const key_type& key) const
+    { return _tree.template upper_bound<const_iterator>(key); }
+
+    std::pair<iterator, iterator> equal_range(const key_type& key)
+    { return _tree.writable(_tree.template equal_range<iterator>(key)); }
+
+    std::pair<const_iterator, const_iterator> equal_range(const key_type& key) const
+    { return _tree.template equal_range<const_iterator>(key); }
+
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent>
+    size_type count(const _k& key) const
+    { return _tree.count_key(key); }
+
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent>
+    iterator find(const _k& key)
+    { return _tree.writable(_tree.template find<iterator>(key)); }
+
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent>
+    const_iterator find(const _k& key) const
+    { return _tree.template find<const_iterator>(key); }
+
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent>
+    iterator lower_bound(const _k& key)
+    { return _tree.writable(_tree.template lower_bound<iterator>(key)); }
+
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent>
+    const_iterator lower_bound(const _k& key) const
+    { return _tree.template lower_bound<const_iterator>(key); }
+
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent>
+    iterator upper_bound(const _k& key)
+    { return _tree.writable(_tree.template upper_bound<iterator>(key)); }
+
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent>
+    const_iterator upper_bound(const _k& key) const
+    { return _tree.template upper_bound<const_iterator>(key); }
+
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent>
+    std::pair<iterator, iterator> equal_range(const _k& key)
+    { return _tree.writable(_tree.template equal_range<iterator>(key)); }
+
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent>
+    std::pair<const_iterator, const_iterator> equal_range(const _k& key) const
+    { return _tree.template equal_range<const_iterator>(key); }
+
+    // order statistics, see map
+    size_type rank(const key_type& key) const
+    { return _tree.rank(key); }
+
+    size_type count_range(const key_type& lower_key, const key_type& upper_key) const
+    { return _tree.count_range(lower_key, upper_key); }
+
+    iterator select(size_type index)
+    { return _tree.writable(_tree.template select<iterator>(index)); }
+
+    const_iterator select(size_type index) const
+    { return _tree.template select<const_iterator>(index); }
+
+    size_type index_of(const_iterator position) const
+    { return _tree.index_of(position); }
+
+    // internal iteration, see map
+    template<typename _function>
+    _function for_each(_function f) const
+    {
+        _tree.for_each_value(f);
+        return f;
+    }
+
+    // the values not less than lower_key and less than upper_key
+    template<typename _function>
+    _function for_each_range(const key_type& lower_key, const key_type& upper_key, _function f) const
+    {
+        _tree.for_each_value_range(lower_key, upper_key, f);
+        return f;
+    }
+
+    template<typename _function>
+    _function for_each_span(_function f) const
+    {
+        _tree.for_each_value_span(f);
+        return f;
+    }
+
+    template<typename _function>
+    _function for_each_span_range(const key_type& lower_key, const key_type& upper_key, _function f) const
+    {
+        _tree.for_each_value_span_range(lower_key, upper_key, f);
+        return f;
+    }
+
+    // parallel internal iteration, see set
+    template<typename _executor, typename _function>
+    void parallel_for_each(_executor&& executor, const _function& f) const
+    { parallel_for_each_value(_tree, executor, (const key_type*)nullptr, (const key_type*)nullptr, f); }
+
+    template<typename _executor, typename _function>
+    void parallel_for_each_range(_executor&& executor, const key_type& lower_key, const key_type& upper_key,
+                                 const _function& f) const
+    { parallel_for_each_value(_tree, executor, &lower_key, &upper_key, f); }
+
+    template<typename _executor, typename _type, typename _function, typename _combine>
+    _type parallel_reduce(_executor&& executor, const key_type& lower_key, const key_type& upper_key,
+                          const _type& identity, const _function& f, const _combine& combine) const
+    { return parallel_reduce_values(_tree, executor, &lower_key, &upper_key, identity, f, combine); }
+};
+
+template<typename _a, typename _b, typename _c, typename _d, uint32_t _e, uint32_t _f, uint32_t _g>
+inline bool operator == (const xxfl::multimap<_a, _b, _c, _d, _e, _f, _g>& x,
+                         const xxfl::multimap<_a, _b, _c, _d, _e, _f, _g>& y)
+{ return x._tree == y._tree; }
+
+template<typename _a, typename _b, typename _c, typename _d, uint32_t _e, uint32_t _f, uint32_t _g>
+inline bool operator < (const xxfl::multimap<_a, _b, _c, _d, _e, _f, _g>& x,
+                        const xxfl::multimap<_a, _b, _c, _d, _e, _f, _g>& y)
+{ return x._tree < y._tree; }
+
+template<typename _a, typename _b, typename _c, typename _d, uint32_t _e, uint32_t _f, uint32_t _g>
+inline bool operator != (const xxfl::multimap<_a, _b, _c, _d, _e, _f, _g>& x,
+                         const xxfl::multimap<_a, _b, _c, _d, _e, _f, _g>& y)
+{ return !(x == y); }
+
+template<typename _a, typename _b, typename _c, typename _d, uint32_t _e, uint32_t _f, uint32_t _g>
+inline bool operator > (const xxfl::multimap<_a, _b, _c, _d, _e, _f, _g>& x,
+                        const xxfl::multimap<_a, _b, _c, _d, _e, _f, _g>& y)
+{ return y < x; }
+
+template<typename _a, typename _b, typename _c, typename _d, uint32_t _e, uint32_t _f, uint32_t _g>
+inline bool operator <= (const xxfl::multimap<_a, _b, _c, _d, _e, _f, _g>& x,
+                         const xxfl::multimap<_a, _b, _c, _d, _e, _f, _g>& y)
+{ return !(y < x); }
+
+template<typename _a, typename _b, typename _c, typename _d, uint32_t _e, uint32_t _f, uint32_t _g>
+inline bool operator >= (const xxfl::multimap<_a, _b, _c, _d, _e, _f, _g>& x,
+                         const xxfl::multimap<_a, _b, _c, _d, _e, _f, _g>& y)
+{ return !(x < y); }
+
+template<typename _a, typename _b, typename _c, typename _d, uint32_t _e, uint32_t _f, uint32_t _g>
+inline void swap(xxfl::multimap<_a, _b, _c, _d, _e, _f, _g>& x,
+                 xxfl::multimap<_a, _b, _c, _d, _e, _f, _g>& y)
+{ x.swap(y); }
+
+} // xxfl
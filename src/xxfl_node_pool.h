@@ -0,0 +1,240 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32)
+#if !defined(NOMINMAX)
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+// the nodes are carved from regions of this size, which are backed by huge pages when the system has them
+#if !defined(XXFL_NODE_POOL_REGION_BYSIZE)
+#define XXFL_NODE_POOL_REGION_BYSIZE (32u << 20)
+#endif
+
+namespace xxfl {
+
+// a process wide pool handing out blocks of a few fixed sizes, which is what the trees ask for. a block is aligned
+// to the lowest set bit of its size, at most a page, so nodes whose size is a power of two up to 4096 bytes never
+// straddle pages. freed blocks go to a free list of their size and the regions are never given back to the system.
+class _node_pool
+{
+public:
+    static const size_t __huge_page_bysize = 2u << 20;
+    static const size_t __page_bysize = 4096;
+    static const size_t __size_class_bysize = 64;
+    static const size_t __region_bysize = XXFL_NODE_POOL_REGION_BYSIZE;
+
+    // never destroyed, containers with static storage duration may still give their nodes back after it would be
+    static _node_pool& instance()
+    {
+        static _node_pool* pool = new _node_pool;
+        return *pool;
+    }
+
+    void* allocate(size_t bysize)
+    {
+        bysize = round_up(bysize);
+
+        // blocks this large would waste too much of a region, they get their own mapping
+        if (bysize > __region_bysize / 4)
+        {
+            return map_region(bysize);
+        }
+
+        size_t size_class = bysize / __size_class_bysize;
+
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (size_class < _free_lists.size() && _free_lists[size_class] != nullptr)
+        {
+            void* block = _free_lists[size_class];
+            _free_lists[size_class] = *(void**)block;
+            return block;
+        }
+
+        size_t align = (bysize < __page_bysize)? bysize & (0 - bysize) : __page_bysize;
+        uint8_t* block = (uint8_t*)(((uintptr_t)_region_cur + align - 1) & ~(uintptr_t)(align - 1));
+
+        if (_region_cur == nullptr || block + bysize > _region_end)
+        {
+            _region_cur = (uint8_t*)map_region(__region_bysize);
+            _region_end = _region_cur + __region_bysize;
+            block = _region_cur;
+        }
+
+        _region_cur = block + bysize;
+        return block;
+    }
+
+    void deallocate(void* block, size_t bysize) noexcept
+    {
+        bysize = round_up(bysize);
+
+        if (bysize > __region_bysize / 4)
+        {
+            unmap_region(block, bysize);
+            return;
+        }
+
+        size_t size_class = bysize / __size_class_bysize;
+
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (size_class >= _free_lists.size())
+        {
+            _free_lists.resize(size_class + 1, nullptr);
+        }
+
+        *(void**)block = _free_lists[size_class];
+        _free_lists[size_class] = block;
+    }
+
+private:
+    std::mutex _mutex;
+    std::vector<void*> _free_lists;
+    uint8_t* _region_cur;
+    uint8_t* _region_end;
+
+    _node_pool() noexcept : _region_cur(nullptr), _region_end(nullptr) {}
+
+    static size_t round_up(size_t bysize) noexcept
+    { return (bysize + __size_class_bysize - 1) & ~(__size_class_bysize - 1); }
+
+#if defined(_WIN32)
+    static void* map_region(size_t bysize)
+    {
+        void* region = nullptr;
+
+        // large pages need the lock pages privilege, fall back to normal pages without it
+        size_t large_page_bysize = GetLargePageMinimum();
+        if (large_page_bysize != 0 && bysize % large_page_bysize == 0)
+        {
+            region = VirtualAlloc(nullptr, bysize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        }
+
+        if (region == nullptr)
+        {
+            region = VirtualAlloc(nullptr, bysize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        }
+
+        if (region == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+
+        return region;
+    }
+
+    static void unmap_region(void* region, size_t) noexcept
+    { VirtualFree(region, 0, MEM_RELEASE); }
+#else
+    static void* map_region(size_t bysize)
+    {
+        void* region = MAP_FAILED;
+
+#if defined(MAP_HUGETLB)
+        // explicit huge pages only exist if the administrator reserved some
+        if (bysize % __huge_page_bysize == 0)
+        {
+            region = mmap(nullptr, bysize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        }
+#endif
+
+        if (region == MAP_FAILED)
+        {
+            // map one huge page more to align the region, transparent huge pages only back aligned ranges
+            size_t map_bysize = bysize + __huge_page_bysize;
+            uint8_t* map_begin = (uint8_t*)mmap(nullptr, map_bysize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+            if (map_begin == (uint8_t*)MAP_FAILED)
+            {
+                throw std::bad_alloc();
+            }
+
+            uint8_t* begin = (uint8_t*)(((uintptr_t)map_begin + __huge_page_bysize - 1) & ~(uintptr_t)(__huge_page_bysize - 1));
+            uint8_t* end = begin + bysize;
+
+            if (begin > map_begin)
+            {
+                munmap(map_begin, begin - map_begin);
+            }
+            if (map_begin + map_bysize > end)
+            {
+                munmap(end, map_begin + map_bysize - end);
+            }
+
+#if defined(MADV_HUGEPAGE)
+            madvise(begin, bysize, MADV_HUGEPAGE);
+#endif
+            region = begin;
+        }
+
+        return region;
+    }
+
+    static void unmap_region(void* region, size_t bysize) noexcept
+    { munmap(region, bysize); }
+#endif
+};
+
+// an allocator for xxfl::set and xxfl::map which takes the nodes from the process wide node pool. with
+// XXFL_BPLUS_TREE_BUCKET_INCLUDES_HEADER and bucket sizes of 4096, every node is one aligned page.
+template<typename _tp>
+class node_pool_allocator
+{
+public:
+    typedef _tp         value_type;
+    typedef _tp*        pointer;
+    typedef const _tp*  const_pointer;
+    typedef _tp&        reference;
+    typedef const _tp&  const_reference;
+    typedef size_t      size_type;
+    typedef ptrdiff_t   difference_type;
+
+    typedef std::true_type is_always_equal;
+
+    template<typename _other>
+    struct rebind { typedef node_pool_allocator<_other> other; };
+
+    node_pool_allocator() noexcept {}
+
+    template<typename _other>
+    node_pool_allocator(const node_pool_allocator<_other>&) noexcept {}
+
+    pointer allocate(size_type n)
+    { return (pointer)_node_pool::instance().allocate(n * sizeof(_tp)); }
+
+    void deallocate(pointer p, size_type n) noexcept
+    { _node_pool::instance().deallocate(p, n * sizeof(_tp)); }
+
+    template<typename _up, typename... _args>
+    void construct(_up* p, _args&&... args)
+    { ::new((void*)p) _up(std::forward<_args>(args)...); }
+
+    template<typename _up>
+    void destroy(_up* p)
+    { p->~_up(); }
+
+    size_type max_size() const noexcept
+    { return (size_t)-1 / sizeof(_tp); }
+};
+
+template<typename _a, typename _b>
+inline bool operator == (const node_pool_allocator<_a>&, const node_pool_allocator<_b>&) noexcept
+{ return true; }
+
+template<typename _a, typename _b>
+inline bool operator != (const node_pool_allocator<_a>&, const node_pool_allocator<_b>&) noexcept
+{ return false; }
+
+} // xxfl
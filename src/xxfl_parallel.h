@@ -0,0 +1,155 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "xxfl_bplus_tree.h"
+
+namespace xxfl {
+
+// the executors taken by the parallel functions of the containers are called with a std::function<void()> for each
+// task and may run it on any thread, at once or later. thread_executor is meant for tests and examples: it starts a
+// thread for each task, so a call runs as many threads as parallel_runs_count() at once. a thread pool can be handed
+// over instead by wrapping its submit function.
+struct thread_executor
+{
+    void operator () (std::function<void()> task) const
+    {
+        std::thread(std::move(task)).detach();
+    }
+};
+
+// the number of runs the parallel functions cut the values into, one per core
+inline size_t parallel_runs_count()
+{
+    unsigned int cores_count = std::thread::hardware_concurrency();
+    return (cores_count > 0)? cores_count : 4;
+}
+
+// runs f(i) for i in [0, count) through executor and waits for all of them, the first exception thrown by f is
+// rethrown here. the tasks refer to this frame, so when executor throws, the tasks it took are waited for before its
+// exception is rethrown.
+template<typename _executor, typename _function>
+void run_tasks(_executor& executor, size_t count, const _function& f)
+{
+    std::mutex mutex;
+    std::condition_variable tasks_done;
+    size_t tasks_left = count;
+    std::exception_ptr error;
+
+    size_t submitted = 0;
+
+    try
+    {
+        for (; submitted < count; ++submitted)
+        {
+            size_t i = submitted;
+
+            executor(std::function<void()>([&mutex, &tasks_done, &tasks_left, &error, &f, i]()
+            {
+                std::exception_ptr task_error;
+
+                try
+                {
+                    f(i);
+                }
+                catch (...)
+                {
+                    task_error = std::current_exception();
+                }
+
+                std::lock_guard<std::mutex> lock(mutex);
+
+                if (task_error && !error)
+                {
+                    error = task_error;
+                }
+                if (--tasks_left == 0)
+                {
+                    tasks_done.notify_all();
+                }
+            }));
+        }
+    }
+    catch (...)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        tasks_left -= count - submitted;
+        tasks_done.wait(lock, [&tasks_left]() { return tasks_left == 0; });
+        throw;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    tasks_done.wait(lock, [&tasks_left]() { return tasks_left == 0; });
+
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+// for_each_value of tree on the threads of executor, over the values with keys in [lower_key, upper_key), all of them
+// when the keys are null. a copy of f for each run, see _bplus_tree::partitions().
+template<typename _tree_type, typename _executor, typename _kt1, typename _kt2, typename _function>
+void parallel_for_each_value(const _tree_type& tree, _executor& executor, const _kt1* lower_key, const _kt2* upper_key,
+                             const _function& f)
+{
+    std::vector<typename _tree_type::_partition> parts;
+    tree.partitions(lower_key, upper_key, parallel_runs_count(), parts);
+
+    run_tasks(executor, parts.size(), [&tree, &parts, &f](size_t i)
+    {
+        _function run_f(f);
+        typename _tree_type::template _value_caller<_function> caller(run_f);
+        tree.for_each_leaf_core(parts[i]._first, parts[i]._last_node, parts[i]._last_pos, caller);
+    });
+}
+
+// folds the values of a run into _result, by result = f(result, value) or f(result, key, mapped value)
+template<typename _type, typename _function>
+struct _run_accumulator
+{
+    _type& _result;
+    _function& _f;
+
+    _run_accumulator(_type& result, _function& f) : _result(result), _f(f) {}
+
+    template<typename... _args>
+    void operator () (const _args&... args)
+    { _result = _f(_result, args...); }
+};
+
+// the result of each run starts from identity, the results are combined in the order of the runs
+template<typename _tree_type, typename _executor, typename _kt1, typename _kt2,
+         typename _type, typename _function, typename _combine>
+_type parallel_reduce_values(const _tree_type& tree, _executor& executor, const _kt1* lower_key, const _kt2* upper_key,
+                             const _type& identity, const _function& f, const _combine& combine)
+{
+    std::vector<typename _tree_type::_partition> parts;
+    tree.partitions(lower_key, upper_key, parallel_runs_count(), parts);
+
+    std::deque<_type> results(parts.size(), identity);
+
+    run_tasks(executor, parts.size(), [&tree, &parts, &results, &f](size_t i)
+    {
+        _function run_f(f);
+        _run_accumulator<_type, _function> accumulator(results[i], run_f);
+        typename _tree_type::template _value_caller<_run_accumulator<_type, _function> > caller(accumulator);
+        tree.for_each_leaf_core(parts[i]._first, parts[i]._last_node, parts[i]._last_pos, caller);
+    });
+
+    _type result = identity;
+    for (const _type& run_result : results)
+    {
+        result = combine(result, run_result);
+    }
+
+    return result;
+}
+
+}
@@ -7,8 +7,9 @@ namespace xxfl {
 template<typename _key_type,
          typename _compare = std::less<_key_type>,
          typename _allocator = std::allocator<_key_type>,
-         uint32_t _bucket_bysize_max = XXFL_BPLUS_TREE_BUCKET_BYSIZE_MAX_DEFAULT,
-         uint32_t _tree_height_max = XXFL_BPLUS_TREE_HEIGHT_MAX_DEFAULT>
+         uint32_t _leaf_bucket_bysize_max = XXFL_BPLUS_TREE_BUCKET_BYSIZE_MAX_DEFAULT,
+         uint32_t _tree_height_max = XXFL_BPLUS_TREE_HEIGHT_MAX_DEFAULT,
+         uint32_t _internal_bucket_bysize_max = _leaf_bucket_bysize_max>
 class set
 {
 public:
@@ -18,9 +19,9 @@ public:
     typedef _compare   value_compare;
     typedef _allocator allocator_type;
 
-    typedef _bplus_tree<key_type, value_type, value_type,
+    typedef _bplus_tree<key_type, value_type, value_type, void,
                         std::__identity<value_type>, key_compare, allocator_type,
-                        _bucket_bysize_max, _tree_height_max> _bplus_tree_type;
+                        _leaf_bucket_bysize_max, _internal_bucket_bysize_max, _tree_height_max> _bplus_tree_type;
 
     _bplus_tree_type _tree;
 
@@ -40,6 +41,13 @@ public:
     typedef size_t                                             size_type;
     typedef ptrdiff_t                                          difference_type;
 
+    struct node_type : _node_handle_base<value_type, allocator_type>
+    {
+        value_type& value() const noexcept { return this->_value(); }
+    };
+
+    typedef _insert_return_type<iterator, node_type> insert_return_type;
+
     set() {}
 
     explicit set(const key_compare& comp, const allocator_type& alloc = allocator_type())
@@ -76,6 +84,14 @@ public:
              _alloc_wrapper::allocator_always_compares_equal())
     : _tree(std::move(x._tree), _key_alloc_type(alloc)) {}
 
+    // the range must be sorted by comp without equal keys, the tree is then built in linear time
+    template<typename _input_iterator>
+    set(sorted_unique_t, _input_iterator first, _input_iterator last,
+        const key_compare& comp = key_compare(),
+        const allocator_type& alloc = allocator_type())
+    : _tree(comp, _key_alloc_type(alloc))
+    { _tree.bulk_load(first, last, 1.0f); }
+
     set(std::initializer_list<value_type> il,
         const key_compare& comp = key_compare(),
         const allocator_type& alloc = allocator_type())
@@ -130,6 +146,16 @@ public:
 
     void swap(set& x) noexcept(_alloc_wrapper::is_nothrow_swap()) { _tree.swap(x._tree); }
 
+    // a copy of this set taking constant time, the two share their nodes until either changes, which first copies
+    // just the nodes on the path to the change. a snapshot can be read on another thread while this set is written.
+    // with leaf links it copies every node.
+    set snapshot()
+    {
+        set x(key_comp(), get_allocator());
+        _tree.share_with(x._tree);
+        return x;
+    }
+
     template<typename... _args>
     std::pair<iterator, bool> emplace(_args&&... args)
     { return _tree.template insert<iterator>(value_type(std::forward<_args>(args)...)); }
@@ -157,17 +183,120 @@ public:
     void insert(std::initializer_list<value_type> il)
     { _tree.insert_range(il.begin(), il.end()); }
 
+    // like insert(first, last) with the range in any order, but the range is sorted first and each leaf is reached
+    // once for all the keys falling into it, which pays off for large unsorted batches
+    template<typename _input_iterator>
+    void insert_batch(_input_iterator first, _input_iterator last)
+    { _tree.template insert_batch<value_type>(first, last); }
+
     iterator erase(const const_iterator& position)
     { return _tree.template erase<iterator>(position); }
 
     size_type erase(const key_type& key)
-    { return _tree.erase(key); }
+    { return _tree.erase_key(key); }
+
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent,
+             typename = typename std::enable_if<!std::is_convertible<const _k&, const_iterator>::value>::type>
+    size_type erase(const _k& key)
+    { return _tree.erase_key(key); }
 
     iterator erase(const const_iterator& first, const const_iterator& last)
     { return _tree.template erase_range<iterator>(first, last); }
 
+    // the value is moved out of its leaf into the handle and erased from the tree
+    node_type extract(const const_iterator& position)
+    {
+        node_type nh;
+        nh._alloc = get_allocator();
+        _tree.extract(position, nh);
+        return nh;
+    }
+
+    node_type extract(const key_type& key)
+    {
+        const_iterator it = _tree.template find<const_iterator>(key);
+        return (it._value_ptr != nullptr)? extract(it) : node_type();
+    }
+
+    insert_return_type insert(node_type&& nh)
+    {
+        insert_return_type ret;
+
+        if (nh.empty())
+        {
+            ret.position = end();
+            ret.inserted = false;
+            return ret;
+        }
+
+        std::pair<iterator, bool> result = _tree.template insert<iterator>(std::move(nh._value()));
+
+        ret.position = result.first;
+        ret.inserted = result.second;
+
+        if (result.second)
+        {
+            nh._reset();
+        }
+        else
+        {
+            ret.node = std::move(nh);
+        }
+
+        return ret;
+    }
+
+    iterator insert(const const_iterator& position, node_type&& nh)
+    {
+        if (nh.empty())
+        {
+            return end();
+        }
+
+        size_type values_count = size();
+        iterator it = _tree.template insert<iterator>(position, std::move(nh._value()));
+
+        if (size() != values_count)
+        {
+            nh._reset();
+        }
+
+        return it;
+    }
+
+    // moves the keys of x which are missing here into this set, x keeps the others. when the key ranges don't
+    // interleave the trees are joined and no value is moved. the allocators must be equal.
+    void merge(set& x)
+    { _tree.merge(x._tree); }
+
+    void merge(set&& x)
+    { _tree.merge(x._tree); }
+
     void clear() noexcept { _tree.clear(); }
 
+    // replaces the content by a range sorted by key_comp() without equal keys, the nodes are filled up to
+    // fill_factor of their capacity to leave room for later insertions
+    template<typename _input_iterator>
+    void bulk_load(_input_iterator first, _input_iterator last, float fill_factor = 1.0f)
+    {
+        _tree.clear();
+        _tree.bulk_load(first, last, fill_factor);
+    }
+
+    // moves the keys not less than key into the returned container. only the nodes on the path of key
+    // are cut, so it takes time proportional to the height of the tree instead of the number of values moved.
+    set split(const key_type& key)
+    {
+        set x(key_comp(), get_allocator());
+        _tree.split(key, x._tree);
+        return x;
+    }
+
+    // appends the keys of x, whose keys must all be larger than the keys here, and leaves x empty. the lower tree is
+    // hung into the edge of the higher one. the allocators must be equal.
+    void join(set& x)
+    { _tree.join(x._tree); }
+
     size_type count(const key_type& key) const
     { return _tree.template find<const_iterator>(key)._value_ptr != nullptr; }
 
@@ -177,6 +306,17 @@ public:
     const_iterator find(const key_type& key) const
     { return _tree.template find<const_iterator>(key); }
 
+    // looks up the keys of [first, last) and writes an iterator for each one to out, end() when it's missing. the
+    // lookups advance a level at a time in groups so their cache misses overlap, which pays off on large trees
+    template<typename _forward_iterator, typename _output_iterator>
+    _output_iterator find_batch(_forward_iterator first, _forward_iterator last, _output_iterator out) const
+    { return _tree.template find_batch<const_iterator>(first, last, out); }
+
+    // like find_batch, but writes whether each key is present
+    template<typename _forward_iterator, typename _output_iterator>
+    _output_iterator contains_batch(_forward_iterator first, _forward_iterator last, _output_iterator out) const
+    { return _tree.contains_batch(first, last, out); }
+
     iterator lower_bound(const key_type& key)
     { return _tree.template lower_bound<iterator>(key); }
 
@@ -194,41 +334,179 @@ public:
 
     std::pair<const_iterator, const_iterator> equal_range(const key_type& key) const
     { return _tree.template equal_range<const_iterator>(key); }
+
+    // the overloads below take keys of any type when key_compare declares is_transparent, like std::less<>, so a
+    // lookup by e.g. a string_view doesn't build a key_type first. such a key must match one key_type key at most.
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent>
+    size_type count(const _k& key) const
+    { return _tree.template find<const_iterator>(key)._value_ptr != nullptr; }
+
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent>
+    iterator find(const _k& key)
+    { return _tree.template find<iterator>(key); }
+
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent>
+    const_iterator find(const _k& key) const
+    { return _tree.template find<const_iterator>(key); }
+
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent>
+    iterator lower_bound(const _k& key)
+    { return _tree.template lower_bound<iterator>(key); }
+
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent>
+    const_iterator lower_bound(const _k& key) const
+    { return _tree.template lower_bound<const_iterator>(key); }
+
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent>
+    iterator upper_bound(const _k& key)
+    { return _tree.template upper_bound<iterator>(key); }
+
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent>
+    const_iterator upper_bound(const _k& key) const
+    { return _tree.template upper_bound<const_iterator>(key); }
+
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent>
+    std::pair<iterator, iterator> equal_range(const _k& key)
+    { return _tree.template equal_range<iterator>(key); }
+
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent>
+    std::pair<const_iterator, const_iterator> equal_range(const _k& key) const
+    { return _tree.template equal_range<const_iterator>(key); }
+
+    // order statistics, they take O(log n) when XXFL_BPLUS_TREE_SUBTREE_COUNTS is set and otherwise walk the subtrees
+    // they skip. select(index_of(it) + n) moves an iterator by n values at once.
+    size_type rank(const key_type& key) const
+    { return _tree.rank(key); }
+
+    size_type count_range(const key_type& lower_key, const key_type& upper_key) const
+    { return _tree.count_range(lower_key, upper_key); }
+
+    iterator select(size_type index)
+    { return _tree.template select<iterator>(index); }
+
+    const_iterator select(size_type index) const
+    { return _tree.template select<const_iterator>(index); }
+
+    size_type index_of(const_iterator position) const
+    { return _tree.index_of(position); }
+
+    // internal iteration: f(value) for each value, or f(first, last) for the values of each leaf as one contiguous
+    // block. there is no iterator to step, so loops over the blocks can be vectorized by the compiler. f must not
+    // change the container.
+    template<typename _function>
+    _function for_each(_function f) const
+    {
+        _tree.for_each_value(f);
+        return f;
+    }
+
+    // the values not less than lower_key and less than upper_key
+    template<typename _function>
+    _function for_each_range(const key_type& lower_key, const key_type& upper_key, _function f) const
+    {
+        _tree.for_each_value_range(lower_key, upper_key, f);
+        return f;
+    }
+
+    template<typename _function>
+    _function for_each_span(_function f) const
+    {
+        _tree.for_each_value_span(f);
+        return f;
+    }
+
+    template<typename _function>
+    _function for_each_span_range(const key_type& lower_key, const key_type& upper_key, _function f) const
+    {
+        _tree.for_each_value_span_range(lower_key, upper_key, f);
+        return f;
+    }
+
+    // for_each() and for_each_range() on the threads of executor, which is called with a std::function<void()> for
+    // each run of values and may run it on any thread, see thread_executor. the runs begin at the first values of the
+    // subtrees under the root, or of a lower level when the root has too few, so cutting them takes no search through
+    // the values. each run calls a copy of f, the calls return when all runs are done. the runs are made in
+    // xxfl_parallel.h, which has to be included to call these, so the containers alone pull in no thread headers.
+    template<typename _executor, typename _function>
+    void parallel_for_each(_executor&& executor, const _function& f) const
+    { parallel_for_each_value(_tree, executor, (const key_type*)nullptr, (const key_type*)nullptr, f); }
+
+    template<typename _executor, typename _function>
+    void parallel_for_each_range(_executor&& executor, const key_type& lower_key, const key_type& upper_key,
+                                 const _function& f) const
+    { parallel_for_each_value(_tree, executor, &lower_key, &upper_key, f); }
+
+    // folds the values with keys in [lower_key, upper_key) with result = f(result, value) in each run, starting from
+    // identity, then the results of the runs in key order with result = combine(result, run_result)
+    template<typename _executor, typename _type, typename _function, typename _combine>
+    _type parallel_reduce(_executor&& executor, const key_type& lower_key, const key_type& upper_key,
+                          const _type& identity, const _function& f, const _combine& combine) const
+    { return parallel_reduce_values(_tree, executor, &lower_key, &upper_key, identity, f, combine); }
 };
 
-template<typename _a, typename _b, typename _c, uint32_t _d, uint32_t _e>
-inline bool operator == (const xxfl::set<_a, _b, _c, _d, _e>& x,
-                         const xxfl::set<_a, _b, _c, _d, _e>& y)
+template<typename _a, typename _b, typename _c, uint32_t _d, uint32_t _e, uint32_t _f>
+inline bool operator == (const xxfl::set<_a, _b, _c, _d, _e, _f>& x,
+                         const xxfl::set<_a, _b, _c, _d, _e, _f>& y)
 { return x._tree == y._tree; }
 
-template<typename _a, typename _b, typename _c, uint32_t _d, uint32_t _e>
-inline bool operator < (const xxfl::set<_a, _b, _c, _d, _e>& x,
-                        const xxfl::set<_a, _b, _c, _d, _e>& y)
+template<typename _a, typename _b, typename _c, uint32_t _d, uint32_t _e, uint32_t _f>
+inline bool operator < (const xxfl::set<_a, _b, _c, _d, _e, _f>& x,
+                        const xxfl::set<_a, _b, _c, _d, _e, _f>& y)
 { return x._tree < y._tree; }
 
-template<typename _a, typename _b, typename _c, uint32_t _d, uint32_t _e>
-inline bool operator != (const xxfl::set<_a, _b, _c, _d, _e>& x,
-                         const xxfl::set<_a, _b, _c, _d, _e>& y)
+template<typename _a, typename _b, typename _c, uint32_t _d, uint32_t _e, uint32_t _f>
+inline bool operator != (const xxfl::set<_a, _b, _c, _d, _e, _f>& x,
+                         const xxfl::set<_a, _b, _c, _d, _e, _f>& y)
 { return !(x == y); }
 
-template<typename _a, typename _b, typename _c, uint32_t _d, uint32_t _e>
-inline bool operator > (const xxfl::set<_a, _b, _c, _d, _e>& x,
-                        const xxfl::set<_a, _b, _c, _d, _e>& y)
+template<typename _a, typename _b, typename _c, uint32_t _d, uint32_t _e, uint32_t _f>
+inline bool operator > (const xxfl::set<_a, _b, _c, _d, _e, _f>& x,
+                        const xxfl::set<_a, _b, _c, _d, _e, _f>& y)
 { return y < x; }
 
-template<typename _a, typename _b, typename _c, uint32_t _d, uint32_t _e>
-inline bool operator <= (const xxfl::set<_a, _b, _c, _d, _e>& x,
-                         const xxfl::set<_a, _b, _c, _d, _e>& y)
+template<typename _a, typename _b, typename _c, uint32_t _d, uint32_t _e, uint32_t _f>
+inline bool operator <= (const xxfl::set<_a, _b, _c, _d, _e, _f>& x,
+                         const xxfl::set<_a, _b, _c, _d, _e, _f>& y)
 { return !(y < x); }
 
-template<typename _a, typename _b, typename _c, uint32_t _d, uint32_t _e>
-inline bool operator >= (const xxfl::set<_a, _b, _c, _d, _e>& x,
-                         const xxfl::set<_a, _b, _c, _d, _e>& y)
+template<typename _a, typename _b, typename _c, uint32_t _d, uint32_t _e, uint32_t _f>
+inline bool operator >= (const xxfl::set<_a, _b, _c, _d, _e, _f>& x,
+                         const xxfl::set<_a, _b, _c, _d, _e, _f>& y)
 { return !(x < y); }
 
-template<typename _a, typename _b, typename _c, uint32_t _d, uint32_t _e>
-inline void swap(xxfl::set<_a, _b, _c, _d, _e>& x,
-                 xxfl::set<_a, _b, _c, _d, _e>& y)
+template<typename _a, typename _b, typename _c, uint32_t _d, uint32_t _e, uint32_t _f>
+inline void swap(xxfl::set<_a, _b, _c, _d, _e, _f>& x,
+                 xxfl::set<_a, _b, _c, _d, _e, _f>& y)
 { x.swap(y); }
 
+// the keys in x or y, computed on the trees directly
+template<typename _a, typename _b, typename _c, uint32_t _d, uint32_t _e, uint32_t _f>
+inline xxfl::set<_a, _b, _c, _d, _e, _f> set_union(const xxfl::set<_a, _b, _c, _d, _e, _f>& x,
+                                                   const xxfl::set<_a, _b, _c, _d, _e, _f>& y)
+{
+    xxfl::set<_a, _b, _c, _d, _e, _f> z(x.key_comp(), x.get_allocator());
+    z._tree.set_union(x._tree, y._tree);
+    return z;
+}
+
+// the keys in both x and y, computed on the trees directly
+template<typename _a, typename _b, typename _c, uint32_t _d, uint32_t _e, uint32_t _f>
+inline xxfl::set<_a, _b, _c, _d, _e, _f> set_intersection(const xxfl::set<_a, _b, _c, _d, _e, _f>& x,
+                                                          const xxfl::set<_a, _b, _c, _d, _e, _f>& y)
+{
+    xxfl::set<_a, _b, _c, _d, _e, _f> z(x.key_comp(), x.get_allocator());
+    z._tree.set_intersection(x._tree, y._tree);
+    return z;
+}
+
+// the keys in x but not in y, computed on the trees directly
+template<typename _a, typename _b, typename _c, uint32_t _d, uint32_t _e, uint32_t _f>
+inline xxfl::set<_a, _b, _c, _d, _e, _f> set_difference(const xxfl::set<_a, _b, _c, _d, _e, _f>& x,
+                                                        const xxfl::set<_a, _b, _c, _d, _e, _f>& y)
+{
+    xxfl::set<_a, _b, _c, _d, _e, _f> z(x.key_comp(), x.get_allocator());
+    z._tree.set_difference(x._tree, y._tree);
+    return z;
+}
+
 } // xxfl
@@ -25,6 +25,14 @@ struct __select1st : public unary_function<_pair, typename _pair::first_type>
 
     const typename _pair::first_type& operator () (const _pair& x) const
     { return x.first; }
+
+    template<typename _pair2>
+    typename _pair2::first_type& operator () (_pair2& x) const
+    { return x.first; }
+
+    template<typename _pair2>
+    const typename _pair2::first_type& operator () (const _pair2& x) const
+    { return x.first; }
 };
 
 template<typename _input_iterator>
@@ -0,0 +1,409 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include "xxfl_map.h"
+
+namespace xxfl {
+
+// a map for many threads at once made of _shards_count xxfl::map shards, each behind a mutex of its own. the shards
+// partition the keys by ranges instead of hashes, so the values stay ordered across them: shard i holds the keys from
+// the lower bound of shard i up to the lower bound of shard i + 1, and lookups, ordered scans and range queries go
+// from one shard to the next. the shards are kept balanced by moving the values at the edge of one to its neighbour
+// with split() and join(), which hand over whole subtrees. shards past the last one in use have no lower bound and
+// are taken into use by the rebalancing. a shard's bounds are read and changed only with its mutex held, the bound
+// between two shards only with both, so an operation finds its shard by trying a few and checking their bounds.
+// values are copied out, the mutex of a shard is held while a function given to a scan runs on it.
+template<typename _key_type,
+         typename _mapped_type,
+         uint32_t _shards_count = 16,
+         typename _compare = std::less<_key_type>,
+         typename _allocator = std::allocator<std::pair<const _key_type, _mapped_type> > >
+class sharded_map
+{
+public:
+    typedef _key_type                                   key_type;
+    typedef _mapped_type                                mapped_type;
+    typedef std::pair<const key_type, mapped_type>      value_type;
+    typedef _compare                                    key_compare;
+    typedef _allocator                                  allocator_type;
+    typedef size_t                                      size_type;
+    typedef map<key_type, mapped_type, key_compare, allocator_type> shard_type;
+
+    static_assert(_shards_count >= 1, "sharded_map needs a shard");
+
+private:
+    // values are moved between neighbouring shards when one holds more than twice the other by this many
+    static const size_t __rebalance_min = 4096;
+
+    struct _shard
+    {
+        mutable std::mutex _mutex;
+        shard_type _map;
+        key_type _lower_key; // the keys here are not less than it, unused by shard 0 and the shards not in use
+        bool _in_use;
+        std::atomic<size_t> _size; // the size of _map, read by its neighbours without the mutex
+
+        _shard() : _in_use(false), _size(0) {}
+    };
+
+public:
+    explicit sharded_map(const key_compare& comp = key_compare(), const allocator_type& alloc = allocator_type())
+        : _comp(comp), _size(0), _rebalancing(false)
+    {
+        for (uint32_t i = 0; i < _shards_count; ++i)
+        {
+            _shards[i]._map = shard_type(comp, alloc);
+        }
+
+        _shards[0]._in_use = true;
+    }
+
+    sharded_map(const sharded_map&) = delete;
+    sharded_map& operator=(const sharded_map&) = delete;
+
+    size_type size() const noexcept { return _size.load(std::memory_order_relaxed); }
+    bool empty() const noexcept { return size() == 0; }
+
+    key_compare key_comp() const { return _comp; }
+
+    // copies the mapped value of key into mapped, returns false when key is absent
+    bool find(const key_type& key, mapped_type& mapped) const
+    {
+        uint32_t pos;
+        std::unique_lock<std::mutex> lock = lock_shard(key, pos);
+
+        typename shard_type::const_iterator it = _shards[pos]._map.find(key);
+        if (it == _shards[pos]._map.end())
+        {
+            return false;
+        }
+
+        mapped = it->second;
+        return true;
+    }
+
+    bool contains(const key_type& key) const
+    {
+        uint32_t pos;
+        std::unique_lock<std::mutex> lock = lock_shard(key, pos);
+
+        return _shards[pos]._map.find(key) != _shards[pos]._map.end();
+    }
+
+    // copies the first value with a key not less than key into x, which may be in any shard after the one of key
+    bool lower_bound(const key_type& key, std::pair<key_type, mapped_type>& x) const
+    {
+        key_type cur_key = key;
+
+        while (true)
+        {
+            uint32_t pos;
+            std::unique_lock<std::mutex> lock = lock_shard(cur_key, pos);
+
+            typename shard_type::const_iterator it = _shards[pos]._map.lower_bound(cur_key);
+            if (it != _shards[pos]._map.end())
+            {
+                x.first = it->first;
+                x.second = it->second;
+                return true;
+            }
+
+            if (!upper_key_of(pos, cur_key))
+            {
+                return false;
+            }
+        }
+    }
+
+    // returns false when key is present already
+    bool insert(const key_type& key, const mapped_type& mapped)
+    {
+        uint32_t pos;
+        std::unique_lock<std::mutex> lock = lock_shard(key, pos);
+
+        if (!_shards[pos]._map.emplace(key, mapped).second)
+        {
+            return false;
+        }
+
+        inserted(pos, lock);
+        return true;
+    }
+
+    // returns true when key was inserted, false when its mapped value was assigned
+    bool insert_or_assign(const key_type& key, const mapped_type& mapped)
+    {
+        uint32_t pos;
+        std::unique_lock<std::mutex> lock = lock_shard(key, pos);
+
+        if (!_shards[pos]._map.insert_or_assign(key, mapped).second)
+        {
+            return false;
+        }
+
+        inserted(pos, lock);
+        return true;
+    }
+
+    bool erase(const key_type& key)
+    {
+        uint32_t pos;
+        std::unique_lock<std::mutex> lock = lock_shard(key, pos);
+
+        if (_shards[pos]._map.erase(key) == 0)
+        {
+            return false;
+        }
+
+        _size.fetch_sub(1, std::memory_order_relaxed);
+        resized(pos, lock);
+        return true;
+    }
+
+    // calls f on the values in key order, one shard at a time. values inserted or erased meanwhile may be missed,
+    // but none is seen twice.
+    template<typename _function>
+    _function for_each(_function f) const
+    {
+        key_type cur_key;
+
+        {
+            std::unique_lock<std::mutex> lock(_shards[0]._mutex);
+
+            _shards[0]._map.for_each(std::ref(f));
+            if (!upper_key_of(0, cur_key))
+            {
+                return f;
+            }
+        }
+
+        while (true)
+        {
+            uint32_t pos;
+            std::unique_lock<std::mutex> lock = lock_shard(cur_key, pos);
+
+            const shard_type& shard_map = _shards[pos]._map;
+            for (typename shard_type::const_iterator it = shard_map.lower_bound(cur_key); it != shard_map.end(); ++it)
+            {
+                f(*it);
+            }
+
+            if (!upper_key_of(pos, cur_key))
+            {
+                return f;
+            }
+        }
+    }
+
+    // the values with keys in [lower_key, upper_key), as for_each()
+    template<typename _function>
+    _function for_each_range(const key_type& lower_key, const key_type& upper_key, _function f) const
+    {
+        key_type cur_key = lower_key;
+
+        while (_comp(cur_key, upper_key))
+        {
+            uint32_t pos;
+            std::unique_lock<std::mutex> lock = lock_shard(cur_key, pos);
+
+            _shards[pos]._map.for_each_range(cur_key, upper_key, std::ref(f));
+
+            if (!upper_key_of(pos, cur_key))
+            {
+                break;
+            }
+        }
+
+        return f;
+    }
+
+    // not thread safe
+    void clear()
+    {
+        for (uint32_t i = 0; i < _shards_count; ++i)
+        {
+            _shards[i]._map.clear();
+            _shards[i]._in_use = (i == 0);
+            _shards[i]._size.store(0, std::memory_order_relaxed);
+        }
+
+        _size.store(0, std::memory_order_relaxed);
+    }
+
+    // the values in shard pos, for watching the balance
+    size_type shard_size(uint32_t pos) const
+    {
+        std::lock_guard<std::mutex> lock(_shards[pos]._mutex);
+        return _shards[pos]._map.size();
+    }
+
+    // evens out the sizes of neighbouring shards, sweeping up then down, so values can travel across all the shards.
+    // inserts and erases call it when they leave a shard out of balance with a neighbour, as rebalance_pair() tells,
+    // another thread already rebalancing is left alone.
+    void rebalance()
+    {
+        if (_rebalancing.exchange(true, std::memory_order_acquire))
+        {
+            return;
+        }
+
+        for (uint32_t i = 0; i + 1 < _shards_count; ++i)
+        {
+            rebalance_pair(i);
+        }
+        for (uint32_t i = _shards_count - 1; i > 0; --i)
+        {
+            rebalance_pair(i - 1);
+        }
+
+        _rebalancing.store(false, std::memory_order_release);
+    }
+
+private:
+    // -1 when key is below shard pos, 1 when above, 0 when in it. the mutex of shard pos is held.
+    int compare_to_shard(uint32_t pos, const key_type& key) const
+    {
+        if (pos > 0 && (!_shards[pos]._in_use || _comp(key, _shards[pos]._lower_key)))
+        {
+            return -1;
+        }
+
+        if (pos + 1 < _shards_count && _shards[pos + 1]._in_use && !_comp(key, _shards[pos + 1]._lower_key))
+        {
+            return 1;
+        }
+
+        return 0;
+    }
+
+    // a binary search over the shards which locks each it looks at, and starts again if the bounds moved meanwhile
+    std::unique_lock<std::mutex> lock_shard(const key_type& key, uint32_t& pos) const
+    {
+        while (true)
+        {
+            uint32_t first = 0;
+            uint32_t last = _shards_count;
+
+            while (first < last)
+            {
+                uint32_t mid = first + (last - first) / 2;
+                std::unique_lock<std::mutex> lock(_shards[mid]._mutex);
+
+                int cmp = compare_to_shard(mid, key);
+                if (cmp == 0)
+                {
+                    pos = mid;
+                    return lock;
+                }
+
+                if (cmp < 0)
+                {
+                    last = mid;
+                }
+                else
+                {
+                    first = mid + 1;
+                }
+            }
+        }
+    }
+
+    // the lower bound of the shard after shard pos, whose mutex is held. false when pos is the last shard in use.
+    bool upper_key_of(uint32_t pos, key_type& key) const
+    {
+        if (pos + 1 < _shards_count && _shards[pos + 1]._in_use)
+        {
+            key = _shards[pos + 1]._lower_key;
+            return true;
+        }
+
+        return false;
+    }
+
+    void inserted(uint32_t pos, std::unique_lock<std::mutex>& lock)
+    {
+        _size.fetch_add(1, std::memory_order_relaxed);
+        resized(pos, lock);
+    }
+
+    // the sizes of the neighbours are read without their mutexes, a stale one only delays or repeats a rebalancing.
+    // comparing against the neighbours rather than a size reached before lets erases start it too, a window of keys
+    // sliding upwards would otherwise pile up in the last shard.
+    void resized(uint32_t pos, std::unique_lock<std::mutex>& lock)
+    {
+        size_t size = _shards[pos]._map.size();
+        _shards[pos]._size.store(size, std::memory_order_relaxed);
+
+        if ((pos > 0 && unbalanced(_shards[pos - 1]._size.load(std::memory_order_relaxed), size)) ||
+            (pos + 1 < _shards_count && unbalanced(size, _shards[pos + 1]._size.load(std::memory_order_relaxed))))
+        {
+            lock.unlock();
+            rebalance();
+        }
+    }
+
+    static bool unbalanced(size_t size, size_t next_size) noexcept
+    {
+        return size > next_size * 2 + __rebalance_min || next_size > size * 2 + __rebalance_min;
+    }
+
+    // moves values between shard pos and shard pos + 1 when one is more than twice the other by __rebalance_min
+    void rebalance_pair(uint32_t pos)
+    {
+        std::lock_guard<std::mutex> lock(_shards[pos]._mutex);
+        std::lock_guard<std::mutex> next_lock(_shards[pos + 1]._mutex);
+
+        _shard& cur_shard = _shards[pos];
+        _shard& next_shard = _shards[pos + 1];
+
+        if (!cur_shard._in_use)
+        {
+            return;
+        }
+
+        size_t cur_size = cur_shard._map.size();
+        size_t next_size = next_shard._map.size();
+
+        if (cur_size > next_size * 2 + __rebalance_min)
+        {
+            // the upper values of this shard go to the front of the next one
+            typename shard_type::iterator it = cur_shard._map.select(cur_size - (cur_size - next_size) / 2);
+            key_type split_key = it->first;
+
+            shard_type moved_map = cur_shard._map.split(split_key);
+            moved_map.join(next_shard._map);
+            next_shard._map.swap(moved_map);
+
+            next_shard._lower_key = split_key;
+            next_shard._in_use = true;
+        }
+        else if (next_shard._in_use && next_size > cur_size * 2 + __rebalance_min)
+        {
+            // the lower values of the next shard go to the back of this one
+            typename shard_type::iterator it = next_shard._map.select((next_size - cur_size) / 2);
+            key_type split_key = it->first;
+
+            shard_type kept_map = next_shard._map.split(split_key);
+            cur_shard._map.join(next_shard._map);
+            next_shard._map.swap(kept_map);
+
+            next_shard._lower_key = split_key;
+        }
+        else
+        {
+            return;
+        }
+
+        cur_shard._size.store(cur_shard._map.size(), std::memory_order_relaxed);
+        next_shard._size.store(next_shard._map.size(), std::memory_order_relaxed);
+    }
+
+    key_compare _comp;
+    std::atomic<size_type> _size;
+    std::atomic<bool> _rebalancing;
+    _shard _shards[_shards_count];
+};
+
+}
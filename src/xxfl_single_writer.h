@@ -0,0 +1,190 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "xxfl_bplus_tree.h"
+
+namespace xxfl {
+
+// one writer thread and any number of reader threads on a set or map, the readers take no lock. the writer changes a
+// container of its own, and publish() hands the readers a snapshot() of it through an atomic pointer. the nodes of a
+// published snapshot are never written: the writer copies the nodes on the path of each change, and on the path of each
+// iterator its container hands out, see snapshot(). so an iterator taken from writer() before a publish() must not be
+// written through after it. the snapshot replaced by publish() is freed, with the nodes only it still refers to, once
+// no reader can hold it any longer (epoch based reclamation): a reader notes the epoch it started in, publish() moves
+// to the next epoch, and a snapshot is kept as long as a reader which started in its epoch or before is still reading.
+// with finger search the lookups of a container write its finger, so readers can't share one. with leaf links
+// snapshot() copies every node, and so does each publish().
+template<typename _container, uint32_t _readers_max = 64>
+class single_writer
+{
+public:
+    typedef _container container_type;
+
+    static_assert(sizeof(_container) > 0 && !XXFL_BPLUS_TREE_FINGER_SEARCH,
+                  "the readers of single_writer can't share the finger of a container");
+
+private:
+    // an epoch and the snapshot published before it
+    typedef std::pair<uint64_t, const _container*> _retired_type;
+
+    // the epoch a reader started in, 0 for a free slot. padded to a cache line, since readers on different cores
+    // write different slots.
+    struct _reader_slot
+    {
+        std::atomic<uint64_t> _epoch;
+        uint8_t _padding[64 - sizeof(std::atomic<uint64_t>)];
+
+        _reader_slot() noexcept : _epoch(0) {}
+    };
+
+public:
+    // keeps the snapshot a reader got valid until it is destroyed
+    class read_guard
+    {
+    public:
+        read_guard(read_guard&& x) noexcept : _slot(x._slot), _published(x._published) { x._slot = nullptr; }
+
+        read_guard(const read_guard&) = delete;
+        read_guard& operator=(const read_guard&) = delete;
+
+        ~read_guard()
+        {
+            if (_slot != nullptr)
+            {
+                _slot->_epoch.store(0, std::memory_order_release);
+            }
+        }
+
+        const _container& operator * () const noexcept { return *_published; }
+        const _container* operator -> () const noexcept { return _published; }
+
+    private:
+        friend class single_writer;
+
+        read_guard(_reader_slot* slot, const _container* published) noexcept : _slot(slot), _published(published) {}
+
+        _reader_slot* _slot;
+        const _container* _published;
+    };
+
+    single_writer() : _published(nullptr), _epoch(1)
+    {
+        _published.store(new _container(_writer.snapshot()), std::memory_order_relaxed);
+    }
+
+    explicit single_writer(_container&& x) : _writer(std::move(x)), _published(nullptr), _epoch(1)
+    {
+        _published.store(new _container(_writer.snapshot()), std::memory_order_relaxed);
+    }
+
+    single_writer(const single_writer&) = delete;
+    single_writer& operator=(const single_writer&) = delete;
+
+    // no reader may be left
+    ~single_writer()
+    {
+        delete _published.load(std::memory_order_relaxed);
+
+        for (const _retired_type& retired : _retired)
+        {
+            delete retired.second;
+        }
+    }
+
+    // any thread. the guard holds a reader slot, a reader finding all the _readers_max slots taken waits for one.
+    read_guard read() const
+    {
+        size_t slot_pos = std::hash<std::thread::id>()(std::this_thread::get_id()) % _readers_max;
+
+        while (true)
+        {
+            // the epoch is read before the slot is taken, so it is never later than the published snapshot read
+            // below: publish() moves to the next epoch only after it replaced the snapshot
+            uint64_t epoch = _epoch.load(std::memory_order_seq_cst);
+            uint64_t free_epoch = 0;
+
+            if (_slots[slot_pos]._epoch.compare_exchange_strong(free_epoch, epoch, std::memory_order_seq_cst))
+            {
+                return read_guard(&_slots[slot_pos], _published.load(std::memory_order_seq_cst));
+            }
+
+            if (++slot_pos == _readers_max)
+            {
+                slot_pos = 0;
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    template<typename _function>
+    auto read(_function f) const -> decltype(f(std::declval<const _container&>()))
+    {
+        read_guard guard = read();
+        return f(*guard);
+    }
+
+    // the writer thread only. changes to the container reach the readers at the next publish(), the iterators taken
+    // before that publish() must not be written through after it.
+    _container& writer() noexcept { return _writer; }
+
+    void publish()
+    {
+        const _container* retired = _published.exchange(new _container(_writer.snapshot()), std::memory_order_seq_cst);
+        _retired.push_back(_retired_type(_epoch.load(std::memory_order_relaxed), retired));
+        _epoch.fetch_add(1, std::memory_order_seq_cst);
+
+        reclaim();
+    }
+
+    template<typename _function>
+    void write(_function f)
+    {
+        f(_writer);
+        publish();
+    }
+
+    // frees the snapshots no reader can hold any longer, publish() calls it
+    void reclaim()
+    {
+        if (_retired.empty())
+        {
+            return;
+        }
+
+        uint64_t epoch_min = _epoch.load(std::memory_order_relaxed);
+        for (uint32_t i = 0; i < _readers_max; ++i)
+        {
+            uint64_t epoch = _slots[i]._epoch.load(std::memory_order_seq_cst);
+            if (epoch != 0 && epoch < epoch_min)
+            {
+                epoch_min = epoch;
+            }
+        }
+
+        // the snapshots are retired in the order of their epochs
+        size_t count = 0;
+        while (count < _retired.size() && _retired[count].first < epoch_min)
+        {
+            delete _retired[count].second;
+            ++count;
+        }
+
+        _retired.erase(_retired.begin(), _retired.begin() + count);
+    }
+
+    // the snapshots waiting for their readers
+    size_t retired_count() const noexcept { return _retired.size(); }
+
+private:
+    _container _writer;
+    std::atomic<const _container*> _published;
+    std::atomic<uint64_t> _epoch;
+    std::vector<_retired_type> _retired;
+    mutable _reader_slot _slots[_readers_max];
+};
+
+}
@@ -0,0 +1,846 @@
+#pragma once
+
+#include "xxfl_bplus_tree.h"
+
+namespace xxfl {
+
+// the leaves of soa_map hold the keys only, the mapped values are kept in a parallel array of the same node.
+// searching a leaf never pulls mapped values into the cache and integral keys can be searched with simd,
+// in exchange the iterators return proxy pairs of references instead of real value_type references.
+
+template<typename _key_type>
+struct _soa_key_of_value
+{
+    const _key_type& operator () (const _key_type& x) const
+    { return x; }
+
+    template<typename _pair>
+    const _key_type& operator () (const _pair& x) const
+    { return x.first; }
+};
+
+// see the path stack of _bplus_tree_iterator_base
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+template<typename _key_type, typename _mapped_type, uint32_t _tree_height_max, uint32_t _mapped_values_offset>
+struct _soa_map_iterator : _bplus_tree_public_iterator_base<_key_type, _tree_height_max>
+{
+    typedef _bplus_tree_public_iterator_base<_key_type, _tree_height_max> _base;
+
+    typedef std::pair<const _key_type, _mapped_type> value_type;
+    typedef std::pair<const _key_type&, _mapped_type&> reference;
+    typedef _arrow_proxy<reference> pointer;
+
+    using typename _base::_bplus_tree_type;
+
+    _soa_map_iterator() noexcept {}
+
+    _soa_map_iterator(_bplus_tree_type* tree) noexcept : _base(tree) {}
+
+    _soa_map_iterator(_bplus_tree_type* tree, _key_type* value_ptr) noexcept
+    : _base(tree, value_ptr) {}
+
+#if XXFL_BPLUS_TREE_LEAF_LINKS
+    _soa_map_iterator(const typename _base::_path_type& path) noexcept : _base(path) {}
+#endif
+
+    _soa_map_iterator(const _soa_map_iterator& it) noexcept : _base(it) {}
+
+    explicit _soa_map_iterator(const _base& it) noexcept : _base(it) {}
+
+    _soa_map_iterator& _const_cast() const noexcept { return const_cast<_soa_map_iterator&>(*this); }
+
+    _mapped_type& mapped() const noexcept
+    {
+        auto node = _base::leaf_node();
+        return ((_mapped_type*)((uint8_t*)node->values() + _mapped_values_offset))[_base::_value_ptr - node->values()];
+    }
+
+    reference operator * () const noexcept { return reference(*_base::_value_ptr, mapped()); }
+    pointer operator -> () const noexcept { return pointer{ **this }; }
+
+    _soa_map_iterator& operator ++ ()
+    {
+        _base::increment();
+        _base::unshare_stepped(true);
+        return *this;
+    }
+
+    _soa_map_iterator operator ++ (int)
+    {
+        _soa_map_iterator tmp(*this);
+        _base::increment();
+        _base::unshare_stepped(true);
+        return tmp;
+    }
+
+    _soa_map_iterator& operator -- ()
+    {
+        _base::decrement();
+        _base::unshare_stepped(false);
+        return *this;
+    }
+
+    _soa_map_iterator operator -- (int)
+    {
+        _soa_map_iterator tmp(*this);
+        _base::decrement();
+        _base::unshare_stepped(false);
+        return tmp;
+    }
+
+    bool operator == (const _soa_map_iterator& x) const noexcept
+    { return _base::_value_ptr == x._value_ptr; }
+
+    bool operator != (const _soa_map_iterator& x) const noexcept
+    { return _base::_value_ptr != x._value_ptr; }
+};
+
+template<typename _key_type, typename _mapped_type, uint32_t _tree_height_max, uint32_t _mapped_values_offset>
+struct _soa_map_const_iterator : _bplus_tree_public_iterator_base<_key_type, _tree_height_max>
+{
+    typedef _bplus_tree_public_iterator_base<_key_type, _tree_height_max> _base;
+
+    typedef std::pair<const _key_type, _mapped_type> value_type;
+    typedef std::pair<const _key_type&, const _mapped_type&> reference;
+    typedef _arrow_proxy<reference> pointer;
+
+    typedef _soa_map_iterator<_key_type, _mapped_type, _tree_height_max, _mapped_values_offset> iterator;
+
+    using typename _base::_bplus_tree_type;
+
+    _soa_map_const_iterator() noexcept {}
+
+    _soa_map_const_iterator(_bplus_tree_type* tree) noexcept : _base(tree) {}
+
+    _soa_map_const_iterator(_bplus_tree_type* tree, _key_type* value_ptr) noexcept
+    : _base(tree, value_ptr) {}
+
+#if XXFL_BPLUS_TREE_LEAF_LINKS
+    _soa_map_const_iterator(const typename _base::_path_type& path) noexcept : _base(path) {}
+#endif
+
+    _soa_map_const_iterator(const _base& it) noexcept : _base(it) {}
+
+    iterator& _const_cast() const noexcept { return (iterator&)(const_cast<_soa_map_const_iterator&>(*this)); }
+
+    const _mapped_type& mapped() const noexcept
+    {
+        auto node = _base::leaf_node();
+        return ((const _mapped_type*)((const uint8_t*)node->values() + _mapped_values_offset))[_base::_value_ptr - node->values()];
+    }
+
+    reference operator * () const noexcept { return reference(*_base::_value_ptr, mapped()); }
+    pointer operator -> () const noexcept { return pointer{ **this }; }
+
+    _soa_map_const_iterator& operator ++ () noexcept
+    {
+        _base::increment();
+        return *this;
+    }
+
+    _soa_map_const_iterator operator ++ (int) noexcept
+    {
+        _soa_map_const_iterator tmp(*this);
+        _base::increment();
+        return tmp;
+    }
+
+    _soa_map_const_iterator& operator -- () noexcept
+    {
+        _base::decrement();
+        return *this;
+    }
+
+    _soa_map_const_iterator operator -- (int) noexcept
+    {
+        _soa_map_const_iterator tmp(*this);
+        _base::decrement();
+        return tmp;
+    }
+
+    bool operator == (const _soa_map_const_iterator& x) const noexcept
+    { return _base::_value_ptr == x._value_ptr; }
+
+    bool operator != (const _soa_map_const_iterator& x) const noexcept
+    { return _base::_value_ptr != x._value_ptr; }
+};
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+template<typename _a, typename _b, uint32_t _c, uint32_t _d>
+inline bool operator == (const xxfl::_soa_map_iterator<_a, _b, _c, _d>& x,
+                         const xxfl::_soa_map_const_iterator<_a, _b, _c, _d>& y) noexcept
+{ return x._value_ptr == y._value_ptr; }
+
+template<typename _a, typename _b, uint32_t _c, uint32_t _d>
+inline bool operator != (const xxfl::_soa_map_iterator<_a, _b, _c, _d>& x,
+                         const xxfl::_soa_map_const_iterator<_a, _b, _c, _d>& y) noexcept
+{ return x._value_ptr != y._value_ptr; }
+
+template<typename _key_type,
+         typename _mapped_type,
+         typename _compare = std::less<_key_type>,
+         typename _allocator = std::allocator<std::pair<const _key_type, _mapped_type> >,
+         uint32_t _leaf_bucket_bysize_max = XXFL_BPLUS_TREE_BUCKET_BYSIZE_MAX_DEFAULT,
+         uint32_t _tree_height_max = XXFL_BPLUS_TREE_HEIGHT_MAX_DEFAULT,
+         uint32_t _internal_bucket_bysize_max = _leaf_bucket_bysize_max>
+class soa_map
+{
+public:
+    typedef _key_type                                key_type;
+    typedef _mapped_type                             mapped_type;
+    typedef std::pair<const _key_type, _mapped_type> value_type;
+    typedef _compare                                 key_compare;
+    typedef _allocator                               allocator_type;
+
+    typedef _bplus_tree<key_type, key_type, key_type, mapped_type,
+                        _soa_key_of_value<key_type>, key_compare, allocator_type,
+                        _leaf_bucket_bysize_max, _internal_bucket_bysize_max, _tree_height_max> _bplus_tree_type;
+
+    struct value_compare
+    {
+        key_compare _comp;
+
+        value_compare(key_compare comp) : _comp(comp) {}
+
+        bool operator () (const value_type& x, const value_type& y) const
+        { return _comp(x.first, y.first); }
+    };
+
+    _bplus_tree_type _tree;
+
+protected:
+    typedef typename __alloc_wrapper<allocator_type>::template rebind<key_type>::other _pair_alloc_type;
+    typedef __alloc_wrapper<_pair_alloc_type> _alloc_wrapper;
+
+    typedef typename _bplus_tree_type::_path _path;
+
+public:
+    typedef _soa_map_iterator<key_type, mapped_type, _tree_height_max,
+                              _bplus_tree_type::__mapped_values_offset>       iterator;
+    typedef _soa_map_const_iterator<key_type, mapped_type, _tree_height_max,
+                                    _bplus_tree_type::__mapped_values_offset> const_iterator;
+    typedef std::reverse_iterator<iterator>                                   reverse_iterator;
+    typedef std::reverse_iterator<const_iterator>                             const_reverse_iterator;
+    typedef typename iterator::pointer                                        pointer;
+    typedef typename const_iterator::pointer                                  const_pointer;
+    typedef typename iterator::reference                                      reference;
+    typedef typename const_iterator::reference                                const_reference;
+    typedef size_t                                                            size_type;
+    typedef ptrdiff_t                                                         difference_type;
+
+    struct node_type : _node_handle_base<std::pair<key_type, mapped_type>, allocator_type>
+    {
+        key_type& key() const noexcept { return this->_value().first; }
+        mapped_type& mapped() const noexcept { return this->_value().second; }
+    };
+
+    typedef _insert_return_type<iterator, node_type> insert_return_type;
+
+    soa_map() {}
+
+    explicit soa_map(const key_compare& comp, const allocator_type& alloc = allocator_type())
+    : _tree(comp, _pair_alloc_type(alloc)) {}
+
+    explicit soa_map(const allocator_type& alloc) : _tree(key_compare(), _pair_alloc_type(alloc)) {}
+
+    template<typename _input_iterator>
+    soa_map(_input_iterator first, _input_iterator last)
+    { _tree.insert_range(first, last); }
+
+    template<typename _input_iterator>
+    soa_map(_input_iterator first, _input_iterator last,
+            const key_compare& comp,
+            const allocator_type& alloc = allocator_type())
+    : _tree(comp, _pair_alloc_type(alloc))
+    { _tree.insert_range(first, last); }
+
+    template<typename _input_iterator>
+    soa_map(_input_iterator first, _input_iterator last,
+            const allocator_type& alloc)
+    : _tree(key_compare(), _pair_alloc_type(alloc))
+    { _tree.insert_range(first, last); }
+
+    soa_map(const soa_map& x) : _tree(x._tree) {}
+    soa_map(const soa_map& x, const allocator_type& alloc) : _tree(x._tree, _pair_alloc_type(alloc)) {}
+
+    soa_map(soa_map&& x)
+    noexcept(std::is_nothrow_copy_constructible<key_compare>::value)
+    : _tree(std::move(x._tree)) {}
+
+    soa_map(soa_map&& x, const allocator_type& alloc)
+    noexcept(std::is_nothrow_copy_constructible<key_compare>::value &&
+             _alloc_wrapper::allocator_always_compares_equal())
+    : _tree(std::move(x._tree), _pair_alloc_type(alloc)) {}
+
+    // the range must be sorted by comp without equal keys, the tree is then built in linear time
+    template<typename _input_iterator>
+    soa_map(sorted_unique_t, _input_iterator first, _input_iterator last,
+            const key_compare& comp = key_compare(),
+            const allocator_type& alloc = allocator_type())
+    : _tree(comp, _pair_alloc_type(alloc))
+    { _tree.bulk_load(first, last, 1.0f); }
+
+    soa_map(std::initializer_list<value_type> il,
+            const key_compare& comp = key_compare(),
+            const allocator_type& alloc = allocator_type())
+    : _tree(comp, _pair_alloc_type(alloc))
+    { _tree.insert_range(il.begin(), il.end()); }
+
+    soa_map(std::initializer_list<value_type> il, const allocator_type& alloc)
+    : _tree(key_compare(), _pair_alloc_type(alloc))
+    { _tree.insert_range(il.begin(), il.end()); }
+
+    soa_map& operator = (const soa_map& x)
+    {
+        _tree = x._tree;
+        return *this;
+    }
+
+    soa_map& operator = (soa_map&& x)
+    noexcept(_alloc_wrapper::propagate_on_container_move_assignment() ||
+             _alloc_wrapper::allocator_always_compares_equal())
+    {
+        _tree.move_assign(x._tree);
+        return *this;
+    }
+
+    soa_map& operator = (std::initializer_list<value_type> il)
+    {
+        _tree.clear();
+        _tree.insert_range(il.begin(), il.end());
+        return *this;
+    }
+
+    key_compare key_comp() const { return _tree._comp; }
+    value_compare value_comp() const { return value_compare(_tree._comp); }
+    allocator_type get_allocator() const noexcept { return _tree._awrapper._alloc; }
+
+    iterator begin() { return _tree.writable(iterator(_tree.begin())); }
+    const_iterator begin() const noexcept { return _tree.cbegin(); }
+    iterator end() noexcept { return iterator(_tree.end()); }
+    const_iterator end() const noexcept { return _tree.cend(); }
+
+    reverse_iterator rbegin() noexcept { return reverse_iterator(end()); }
+    const_reverse_iterator rbegin() const noexcept { return const_reverse_iterator(cend()); }
+    reverse_iterator rend() { return reverse_iterator(begin()); }
+    const_reverse_iterator rend() const noexcept { return const_reverse_iterator(cbegin()); }
+
+    const_iterator cbegin() const noexcept { return _tree.cbegin(); }
+    const_iterator cend() const noexcept { return _tree.cend(); }
+
+    const_reverse_iterator crbegin() const noexcept { return const_reverse_iterator(cend()); }
+    const_reverse_iterator crend() const noexcept { return const_reverse_iterator(cbegin()); }
+
+    bool empty() const noexcept { return _tree._values_count == 0; }
+
+    size_type size() const noexcept { return _tree._values_count; }
+    size_type max_size() const noexcept { return _tree.max_size(); }
+
+    void swap(soa_map& x) noexcept(_alloc_wrapper::is_nothrow_swap()) { _tree.swap(x._tree); }
+
+    // see map::snapshot()
+    soa_map snapshot()
+    {
+        soa_map x(key_comp(), get_allocator());
+        _tree.share_with(x._tree);
+        return x;
+    }
+
+    template<typename... _args>
+    std::pair<iterator, bool> emplace(_args&&... args)
+    { return _tree.writable(_tree.template insert<iterator>(value_type(std::forward<_args>(args)...))); }
+
+    template<typename... _args>
+    iterator emplace_hint(const const_iterator& position, _args&&... args)
+    { return _tree.writable(_tree.template insert<iterator>(position, value_type(std::forward<_args>(args)...))); }
+
+    std::pair<iterator, bool> insert(const value_type& x)
+    { return _tree.writable(_tree.template insert<iterator>(x)); }
+
+    template<typename _pair, typename = typename std::enable_if<std::is_constructible<value_type, _pair&&>::value>::type>
+    std::pair<iterator, bool> insert(_pair&& x)
+    { return _tree.writable(_tree.template insert<iterator>(std::forward<_pair>(x))); }
+
+    iterator insert(const const_iterator& position, const value_type& x)
+    { return _tree.writable(_tree.template insert<iterator>(position, x)); }
+
+    template<typename _pair, typename = typename std::enable_if<std::is_constructible<value_type, _pair&&>::value>::type>
+    iterator insert(const const_iterator& position, _pair&& x)
+    { return _tree.writable(_tree.template insert<iterator>(position, std::forward<_pair>(x))); }
+
+    template<typename _input_iterator>
+    void insert(_input_iterator first, _input_iterator last)
+    { _tree.insert_range(first, last); }
+
+    void insert(std::initializer_list<value_type> il)
+    { _tree.insert_range(il.begin(), il.end()); }
+
+    // like insert(first, last) with the range in any order, but the range is sorted first and each leaf is reached
+    // once for all the keys falling into it, which pays off for large unsorted batches
+    template<typename _input_iterator>
+    void insert_batch(_input_iterator first, _input_iterator last)
+    { _tree.template insert_batch<std::pair<key_type, mapped_type>>(first, last); }
+
+    iterator erase(const iterator& position)
+    { return _tree.writable(_tree.template erase<iterator>(position)); }
+
+    iterator erase(const const_iterator& position)
+    { return _tree.writable(_tree.template erase<iterator>(position)); }
+
+    size_type erase(const key_type& key)
+    { return _tree.erase_key(key); }
+
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent,
+             typename = typename std::enable_if<!std::is_convertible<const _k&, const_iterator>::value>::type>
+    size_type erase(const _k& key)
+    { return _tree.erase_key(key); }
+
+    iterator erase(const const_iterator& first, const const_iterator& last)
+    { return _tree.writable(_tree.template erase_range<iterator>(first, last)); }
+
+    // the key and the mapped value are moved out of their leaf into the handle and erased from the tree
+    node_type extract(const const_iterator& position)
+    {
+        node_type nh;
+        nh._alloc = get_allocator();
+        _tree.extract(position, nh);
+        return nh;
+    }
+
+    node_type extract(const key_type& key)
+    {
+        const_iterator it = _tree.template find<const_iterator>(key);
+        return (it._value_ptr != nullptr)? extract(it) : node_type();
+    }
+
+    insert_return_type insert(node_type&& nh)
+    {
+        insert_return_type ret;
+
+        if (nh.empty())
+        {
+            ret.position = end();
+            ret.inserted = false;
+            return ret;
+        }
+
+        std::pair<iterator, bool> result = _tree.writable(_tree.template insert<iterator>(std::move(nh._value())));
+
+        ret.position = result.first;
+        ret.inserted = result.second;
+
+        if (result.second)
+        {
+            nh._reset();
+        }
+        else
+        {
+            ret.node = std::move(nh);
+        }
+
+        return ret;
+    }
+
+    iterator insert(const const_iterator& position, node_type&& nh)
+    {
+        if (nh.empty())
+        {
+            return end();
+        }
+
+        size_type values_count = size();
+        iterator it = _tree.writable(_tree.template insert<iterator>(position, std::move(nh._value())));
+
+        if (size() != values_count)
+        {
+            nh._reset();
+        }
+
+        return it;
+    }
+
+    // moves the values of x which are missing here into this soa_map, x keeps the others. when the key ranges don't
+    // interleave the trees are joined and no value is moved. the allocators must be equal.
+    void merge(soa_map& x)
+    { _tree.merge(x._tree); }
+
+    void merge(soa_map&& x)
+    { _tree.merge(x._tree); }
+
+    void clear() noexcept { _tree.clear(); }
+
+    // replaces the content by a range sorted by key_comp() without equal keys, the nodes are filled up to
+    // fill_factor of their capacity to leave room for later insertions
+    template<typename _input_iterator>
+    void bulk_load(_input_iterator first, _input_iterator last, float fill_factor = 1.0f)
+    {
+        _tree.clear();
+        _tree.bulk_load(first, last, fill_factor);
+    }
+
+    // moves the values with keys not less than key into the returned container. only the nodes on the path of key
+    // are cut, so it takes time proportional to the height of the tree instead of the number of values moved.
+    soa_map split(const key_type& key)
+    {
+        soa_map x(key_comp(), get_allocator());
+        _tree.split(key, x._tree);
+        return x;
+    }
+
+    // appends the values of x, whose keys must all be larger than the keys here, and leaves x empty. the lower tree is
+    // hung into the edge of the higher one. the allocators must be equal.
+    void join(soa_map& x)
+    { _tree.join(x._tree); }
+
+    size_type count(const key_type& key) const
+    { return _tree.template find<const_iterator>(key)._value_ptr != nullptr; }
+
+    iterator find(const key_type& key)
+    { return _tree.writable(_tree.template find<iterator>(key)); }
+
+    const_iterator find(const key_type& key) const
+    { return _tree.template find<const_iterator>(key); }
+
+    // looks up the keys of [first, last) and writes an iterator for each one to out, end() when it's missing. the
+    // lookups advance a level at a time in groups so their cache misses overlap, which pays off on large trees. while
+    // nodes are shared with a snapshot the keys are looked up one by one, each path is copied before the next lookup.
+    template<typename _forward_iterator, typename _output_iterator>
+    _output_iterator find_batch(_forward_iterator first, _forward_iterator last, _output_iterator out)
+    {
+        if (_tree._shared_nodes)
+        {
+            for (; first != last; ++first, ++out)
+            {
+                *out = find(*first);
+            }
+
+            return out;
+        }
+
+        return _tree.template find_batch<iterator>(first, last, out);
+    }
+
+    template<typename _forward_iterator, typename _output_iterator>
+    _output_iterator find_batch(_forward_iterator first, _forward_iterator last, _output_iterator out) const
+    { return _tree.template find_batch<const_iterator>(first, last, out); }
+
+    // like find_batch, but writes whether each key is present
+    template<typename _forward_iterator, typename _output_iterator>
+    _output_iterator contains_batch(_forward_iterator first, _forward_iterator last, _output_iterator out) const
+    { return _tree.contains_batch(first, last, out); }
+
+    iterator lower_bound(const key_type& key)
+    { return _tree.writable(_tree.template lower_bound<iterator>(key)); }
+
+    const_iterator lower_bound(const key_type& key) const
+    { return _tree.template lower_bound<const_iterator>(key); }
+
+    iterator upper_bound(const key_type& key)
+    { return _tree.writable(_tree.template upper_bound<iterator>(key)); }
+
+    const_iterator upper_bound(const key_type& key) const
+    { return _tree.template upper_bound<const_iterator>(key); }
+
+    std::pair<iterator, iterator> equal_range(const key_type& key)
+    { return _tree.writable(_tree.template equal_range<iterator>(key)); }
+
+    std::pair<const_iterator, const_iterator> equal_range(const key_type& key) const
+    { return _tree.template equal_range<const_iterator>(key); }
+
+    // the overloads below take keys of any type when key_compare declares is_transparent, like std::less<>, so a
+    // lookup by e.g. a string_view doesn't build a key_type first. such a key must match one key_type key at most.
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent>
+    size_type count(const _k& key) const
+    { return _tree.template find<const_iterator>(key)._value_ptr != nullptr; }
+
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent>
+    iterator find(const _k& key)
+    { return _tree.writable(_tree.template find<iterator>(key)); }
+
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent>
+    const_iterator find(const _k& key) const
+    { return _tree.template find<const_iterator>(key); }
+
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent>
+    iterator lower_bound(const _k& key)
+    { return _tree.writable(_tree.template lower_bound<iterator>(key)); }
+
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent>
+    const_iterator lower_bound(const _k& key) const
+    { return _tree.template lower_bound<const_iterator>(key); }
+
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent>
+    iterator upper_bound(const _k& key)
+    { return _tree.writable(_tree.template upper_bound<iterator>(key)); }
+
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent>
+    const_iterator upper_bound(const _k& key) const
+    { return _tree.template upper_bound<const_iterator>(key); }
+
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent>
+    std::pair<iterator, iterator> equal_range(const _k& key)
+    { return _tree.writable(_tree.template equal_range<iterator>(key)); }
+
+    template<typename _k, typename _c = key_compare, typename = typename _c::is_transparent>
+    std::pair<const_iterator, const_iterator> equal_range(const _k& key) const
+    { return _tree.template equal_range<const_iterator>(key); }
+
+    // order statistics, they take O(log n) when XXFL_BPLUS_TREE_SUBTREE_COUNTS is set and otherwise walk the subtrees
+    // they skip. select(index_of(it) + n) moves an iterator by n values at once.
+    size_type rank(const key_type& key) const
+    { return _tree.rank(key); }
+
+    size_type count_range(const key_type& lower_key, const key_type& upper_key) const
+    { return _tree.count_range(lower_key, upper_key); }
+
+    iterator select(size_type index)
+    { return _tree.writable(_tree.template select<iterator>(index)); }
+
+    const_iterator select(size_type index) const
+    { return _tree.template select<const_iterator>(index); }
+
+    size_type index_of(const_iterator position) const
+    { return _tree.index_of(position); }
+
+    // internal iteration: f(key, mapped) for each value, or f(keys_first, keys_last, mapped_first) for the keys and
+    // mapped values of each leaf as two parallel blocks. there is no iterator to step, so loops over the blocks can be
+    // vectorized by the compiler. f must not change the map.
+    template<typename _function>
+    _function for_each(_function f) const
+    {
+        _tree.for_each_value(f);
+        return f;
+    }
+
+    // the values not less than lower_key and less than upper_key
+    template<typename _function>
+    _function for_each_range(const key_type& lower_key, const key_type& upper_key, _function f) const
+    {
+        _tree.for_each_value_range(lower_key, upper_key, f);
+        return f;
+    }
+
+    template<typename _function>
+    _function for_each_span(_function f) const
+    {
+        _tree.for_each_value_span(f);
+        return f;
+    }
+
+    template<typename _function>
+    _function for_each_span_range(const key_type& lower_key, const key_type& upper_key, _function f) const
+    {
+        _tree.for_each_value_span_range(lower_key, upper_key, f);
+        return f;
+    }
+
+    // for_each() and for_each_range() on the threads of executor, which is called with a std::function<void()> for
+    // each run of values and may run it on any thread, see thread_executor. the runs begin at the first values of the
+    // subtrees under the root, or of a lower level when the root has too few, so cutting them takes no search through
+    // the values. each run calls a copy of f, the calls return when all runs are done. the runs are made in
+    // xxfl_parallel.h, which has to be included to call these, so the containers alone pull in no thread headers.
+    template<typename _executor, typename _function>
+    void parallel_for_each(_executor&& executor, const _function& f) const
+    { parallel_for_each_value(_tree, executor, (const key_type*)nullptr, (const key_type*)nullptr, f); }
+
+    template<typename _executor, typename _function>
+    void parallel_for_each_range(_executor&& executor, const key_type& lower_key, const key_type& upper_key,
+                                 const _function& f) const
+    { parallel_for_each_value(_tree, executor, &lower_key, &upper_key, f); }
+
+    // folds the values with keys in [lower_key, upper_key) with result = f(result, key, mapped) in each run,
+    // starting from identity, then the results of the runs in key order with result = combine(result, run_result)
+    template<typename _executor, typename _type, typename _function, typename _combine>
+    _type parallel_reduce(_executor&& executor, const key_type& lower_key, const key_type& upper_key,
+                          const _type& identity, const _function& f, const _combine& combine) const
+    { return parallel_reduce_values(_tree, executor, &lower_key, &upper_key, identity, f, combine); }
+
+    // the value is only constructed from args when key is missing, found by the same descent as the insertion
+    template<typename... _args>
+    std::pair<iterator, bool> try_emplace(const key_type& key, _args&&... args)
+    { return _tree.writable(_tree.template try_emplace<iterator>(key, std::forward<_args>(args)...)); }
+
+    template<typename... _args>
+    std::pair<iterator, bool> try_emplace(key_type&& key, _args&&... args)
+    { return _tree.writable(_tree.template try_emplace<iterator>(std::move(key), std::forward<_args>(args)...)); }
+
+    template<typename... _args>
+    iterator try_emplace(const const_iterator& /*position*/, const key_type& key, _args&&... args)
+    { return try_emplace(key, std::forward<_args>(args)...).first; }
+
+    template<typename... _args>
+    iterator try_emplace(const const_iterator& /*position*/, key_type&& key, _args&&... args)
+    { return try_emplace(std::move(key), std::forward<_args>(args)...).first; }
+
+    template<typename _obj>
+    std::pair<iterator, bool> insert_or_assign(const key_type& key, _obj&& obj)
+    {
+        std::pair<iterator, bool> ret = _tree.template try_emplace<iterator>(key, std::forward<_obj>(obj));
+
+        if (!ret.second)
+        {
+            _tree.unshare_value(ret.first);
+            ret.first.mapped() = std::forward<_obj>(obj);
+        }
+
+        return ret;
+    }
+
+    template<typename _obj>
+    std::pair<iterator, bool> insert_or_assign(key_type&& key, _obj&& obj)
+    {
+        std::pair<iterator, bool> ret = _tree.template try_emplace<iterator>(std::move(key), std::forward<_obj>(obj));
+
+        if (!ret.second)
+        {
+            _tree.unshare_value(ret.first);
+            ret.first.mapped() = std::forward<_obj>(obj);
+        }
+
+        return ret;
+    }
+
+    template<typename _obj>
+    iterator insert_or_assign(const const_iterator& /*position*/, const key_type& key, _obj&& obj)
+    { return insert_or_assign(key, std::forward<_obj>(obj)).first; }
+
+    template<typename _obj>
+    iterator insert_or_assign(const const_iterator& /*position*/, key_type&& key, _obj&& obj)
+    { return insert_or_assign(std::move(key), std::forward<_obj>(obj)).first; }
+
+    mapped_type& operator [] (const key_type& key)
+    {
+        _path it(&_tree);
+
+        if (_tree._values_count > 0)
+        {
+            _bplus_tree_node<key_type>* cur_node;
+            it._value_ptr = _tree.lower_bound_core(key, it._stack, cur_node);
+
+            if (it._value_ptr == cur_node->values_end() || _tree.key_less(key, *it._value_ptr))
+            {
+                _tree.insert_core(it,
+                                  std::piecewise_construct,
+                                  std::tuple<const key_type&>(key),
+                                  std::tuple<>());
+            }
+            else
+            {
+                _tree.unshare_value(it);
+            }
+        }
+        else
+        {
+            _tree.insert_first_value(it,
+                                     std::piecewise_construct,
+                                     std::tuple<const key_type&>(key),
+                                     std::tuple<>());
+        }
+
+        return mapped_value(it);
+    }
+
+    mapped_type& operator [] (key_type&& key)
+    {
+        _path it(&_tree);
+
+        if (_tree._values_count > 0)
+        {
+            _bplus_tree_node<key_type>* cur_node;
+            it._value_ptr = _tree.lower_bound_core(key, it._stack, cur_node);
+
+            if (it._value_ptr == cur_node->values_end() || _tree.key_less(key, *it._value_ptr))
+            {
+                _tree.insert_core(it,
+                                  std::piecewise_construct,
+                                  std::forward_as_tuple(std::move(key)),
+                                  std::tuple<>());
+            }
+            else
+            {
+                _tree.unshare_value(it);
+            }
+        }
+        else
+        {
+            _tree.insert_first_value(it,
+                                     std::piecewise_construct,
+                                     std::forward_as_tuple(std::move(key)),
+                                     std::tuple<>());
+        }
+
+        return mapped_value(it);
+    }
+
+    mapped_type& at(const key_type& key)
+    {
+        iterator it = _tree.template find<iterator>(key);
+        if (it._value_ptr == nullptr)
+        {
+            std::__throw_out_of_range("xxfl::soa_map::at");
+        }
+        _tree.unshare_value(it);
+        return it.mapped();
+    }
+
+    const mapped_type& at(const key_type& key) const
+    {
+        const_iterator it = _tree.template find<const_iterator>(key);
+        if (it._value_ptr == nullptr)
+        {
+            std::__throw_out_of_range("xxfl::soa_map::at");
+        }
+        return it.mapped();
+    }
+
+protected:
+    mapped_type& mapped_value(const _path& it) noexcept
+    {
+        _bplus_tree_node<key_type>* node = it.leaf_node();
+        return _bplus_tree_type::mapped_values(node)[it._value_ptr - node->values()];
+    }
+};
+
+template<typename _a, typename _b, typename _c, typename _d, uint32_t _e, uint32_t _f, uint32_t _g>
+inline bool operator == (const xxfl::soa_map<_a, _b, _c, _d, _e, _f, _g>& x,
+                         const xxfl::soa_map<_a, _b, _c, _d, _e, _f, _g>& y)
+{ return x._tree == y._tree; }
+
+template<typename _a, typename _b, typename _c, typename _d, uint32_t _e, uint32_t _f, uint32_t _g>
+inline bool operator < (const xxfl::soa_map<_a, _b, _c, _d, _e, _f, _g>& x,
+                        const xxfl::soa_map<_a, _b, _c, _d, _e, _f, _g>& y)
+{ return x._tree < y._tree; }
+
+template<typename _a, typename _b, typename _c, typename _d, uint32_t _e, uint32_t _f, uint32_t _g>
+inline bool operator != (const xxfl::soa_map<_a, _b, _c, _d, _e, _f, _g>& x,
+                         const xxfl::soa_map<_a, _b, _c, _d, _e, _f, _g>& y)
+{ return !(x == y); }
+
+template<typename _a, typename _b, typename _c, typename _d, uint32_t _e, uint32_t _f, uint32_t _g>
+inline bool operator > (const xxfl::soa_map<_a, _b, _c, _d, _e, _f, _g>& x,
+                        const xxfl::soa_map<_a, _b, _c, _d, _e, _f, _g>& y)
+{ return y < x; }
+
+template<typename _a, typename _b, typename _c, typename _d, uint32_t _e, uint32_t _f, uint32_t _g>
+inline bool operator <= (const xxfl::soa_map<_a, _b, _c, _d, _e, _f, _g>& x,
+                         const xxfl::soa_map<_a, _b, _c, _d, _e, _f, _g>& y)
+{ return !(y < x); }
+
+template<typename _a, typename _b, typename _c, typename _d, uint32_t _e, uint32_t _f, uint32_t _g>
+inline bool operator >= (const xxfl::soa_map<_a, _b, _c, _d, _e, _f, _g>& x,
+                         const xxfl::soa_map<_a, _b, _c, _d, _e, _f, _g>& y)
+{ return !(x < y); }
+
+template<typename _a, typename _b, typename _c, typename _d, uint32_t _e, uint32_t _f, uint32_t _g>
+inline void swap(xxfl::soa_map<_a, _b, _c, _d, _e, _f, _g>& x,
+                 xxfl::soa_map<_a, _b, _c, _d, _e, _f, _g>& y)
+{ x.swap(y); }
+
+} // xxfl
@@ -0,0 +1,361 @@
+#pragma once
+
+#include "xxfl_string_tree.h"
+
+namespace xxfl {
+
+// string_map packs its keys like string_set, the mapped values sit next to the offsets of the keys. the iterators
+// hand out pairs of a string_view of the key and a reference to the mapped value. the view lives in the iterator like
+// the ones of string_set, so (*m.find(k)).first dangles once the iterator is gone, the mapped reference doesn't.
+
+template<typename _mapped_type>
+struct _string_map_iterator : _string_tree_iterator_base<_mapped_type>
+{
+    typedef _string_tree_iterator_base<_mapped_type> _base;
+
+    typedef std::pair<const std::string, _mapped_type> value_type;
+    typedef std::pair<string_view, _mapped_type&>      reference;
+    typedef _arrow_proxy<reference>                    pointer;
+
+    using typename _base::_string_tree_type;
+    using typename _base::_leaf_type;
+
+    _string_map_iterator() noexcept {}
+
+    _string_map_iterator(const _string_tree_type* tree, _leaf_type* leaf, uint32_t pos) noexcept
+    : _base(tree, leaf, pos) {}
+
+    explicit _string_map_iterator(const _base& it) noexcept : _base(it) {}
+
+    _mapped_type& mapped() const noexcept { return _base::entry()._mapped; }
+
+    reference operator * () const { return reference(_base::key(), mapped()); }
+    pointer operator -> () const { return pointer{ **this }; }
+
+    _string_map_iterator& operator ++ () noexcept
+    {
+        _base::increment();
+        return *this;
+    }
+
+    _string_map_iterator operator ++ (int) noexcept
+    {
+        _string_map_iterator tmp(*this);
+        _base::increment();
+        return tmp;
+    }
+
+    _string_map_iterator& operator -- () noexcept
+    {
+        _base::decrement();
+        return *this;
+    }
+
+    _string_map_iterator operator -- (int) noexcept
+    {
+        _string_map_iterator tmp(*this);
+        _base::decrement();
+        return tmp;
+    }
+};
+
+template<typename _mapped_type>
+struct _string_map_const_iterator : _string_tree_iterator_base<_mapped_type>
+{
+    typedef _string_tree_iterator_base<_mapped_type> _base;
+
+    typedef std::pair<const std::string, _mapped_type>  value_type;
+    typedef std::pair<string_view, const _mapped_type&> reference;
+    typedef _arrow_proxy<reference>                     pointer;
+
+    using typename _base::_string_tree_type;
+    using typename _base::_leaf_type;
+
+    _string_map_const_iterator() noexcept {}
+
+    _string_map_const_iterator(const _string_tree_type* tree, _leaf_type* leaf, uint32_t pos) noexcept
+    : _base(tree, leaf, pos) {}
+
+    _string_map_const_iterator(const _string_map_iterator<_mapped_type>& it) noexcept : _base(it) {}
+
+    explicit _string_map_const_iterator(const _base& it) noexcept : _base(it) {}
+
+    const _mapped_type& mapped() const noexcept { return _base::entry()._mapped; }
+
+    reference operator * () const { return reference(_base::key(), mapped()); }
+    pointer operator -> () const { return pointer{ **this }; }
+
+    _string_map_const_iterator& operator ++ () noexcept
+    {
+        _base::increment();
+        return *this;
+    }
+
+    _string_map_const_iterator operator ++ (int) noexcept
+    {
+        _string_map_const_iterator tmp(*this);
+        _base::increment();
+        return tmp;
+    }
+
+    _string_map_const_iterator& operator -- () noexcept
+    {
+        _base::decrement();
+        return *this;
+    }
+
+    _string_map_const_iterator operator -- (int) noexcept
+    {
+        _string_map_const_iterator tmp(*this);
+        _base::decrement();
+        return tmp;
+    }
+};
+
+template<typename _mapped_type,
+         typename _allocator = std::allocator<std::pair<const std::string, _mapped_type>>,
+         uint32_t _leaf_bucket_bysize_max = XXFL_BPLUS_TREE_BUCKET_BYSIZE_MAX_DEFAULT>
+class string_map
+{
+public:
+    typedef std::string                                key_type;
+    typedef _mapped_type                               mapped_type;
+    typedef std::pair<const std::string, _mapped_type> value_type;
+    typedef std::less<std::string>                     key_compare;
+    typedef _allocator                                 allocator_type;
+
+    struct value_compare
+    {
+        bool operator () (const value_type& x, const value_type& y) const
+        { return x.first < y.first; }
+    };
+
+    typedef _string_bplus_tree<mapped_type, allocator_type, _leaf_bucket_bysize_max> _string_tree_type;
+
+    _string_tree_type _tree;
+
+protected:
+    typedef typename _string_tree_type::_alloc_wrapper _alloc_wrapper;
+
+public:
+    typedef _string_map_iterator<mapped_type>                                    iterator;
+    typedef _string_map_const_iterator<mapped_type>                              const_iterator;
+    typedef _string_tree_reverse_iterator<iterator>                              reverse_iterator;
+    typedef _string_tree_reverse_iterator<const_iterator>                        const_reverse_iterator;
+    typedef typename iterator::reference                                         reference;
+    typedef typename const_iterator::reference                                   const_reference;
+    typedef size_t                                                               size_type;
+    typedef ptrdiff_t                                                            difference_type;
+
+    string_map() {}
+
+    explicit string_map(const key_compare&, const allocator_type& alloc = allocator_type()) : _tree(alloc) {}
+
+    explicit string_map(const allocator_type& alloc) : _tree(alloc) {}
+
+    template<typename _input_iterator>
+    string_map(_input_iterator first, _input_iterator last)
+    { insert(first, last); }
+
+    template<typename _input_iterator>
+    string_map(_input_iterator first, _input_iterator last,
+               const key_compare&,
+               const allocator_type& alloc = allocator_type())
+    : _tree(alloc)
+    { insert(first, last); }
+
+    template<typename _input_iterator>
+    string_map(_input_iterator first, _input_iterator last,
+               const allocator_type& alloc)
+    : _tree(alloc)
+    { insert(first, last); }
+
+    string_map(const string_map& x) : _tree(x._tree) {}
+    string_map(const string_map& x, const allocator_type& alloc) : _tree(x._tree, alloc) {}
+
+    string_map(string_map&& x) : _tree(std::move(x._tree)) {}
+    string_map(string_map&& x, const allocator_type& alloc) : _tree(std::move(x._tree), alloc) {}
+
+    string_map(std::initializer_list<value_type> il,
+               const key_compare& = key_compare(),
+               const allocator_type& alloc = allocator_type())
+    : _tree(alloc)
+    { insert(il.begin(), il.end()); }
+
+    string_map(std::initializer_list<value_type> il, const allocator_type& alloc)
+    : _tree(alloc)
+    { insert(il.begin(), il.end()); }
+
+    string_map& operator = (const string_map& x)
+    {
+        _tree = x._tree;
+        return *this;
+    }
+
+    string_map& operator = (string_map&& x)
+    {
+        _tree.move_assign(x._tree);
+        return *this;
+    }
+
+    string_map& operator = (std::initializer_list<value_type> il)
+    {
+        _tree.clear();
+        insert(il.begin(), il.end());
+        return *this;
+    }
+
+    key_compare key_comp() const { return key_compare(); }
+    value_compare value_comp() const { return value_compare(); }
+    allocator_type get_allocator() const noexcept { return allocator_type(_tree._awrapper._alloc); }
+
+    iterator begin() noexcept { return iterator(&_tree, _tree._first_leaf, 0); }
+    const_iterator begin() const noexcept { return const_iterator(&_tree, _tree._first_leaf, 0); }
+
+    iterator end() noexcept { return iterator(&_tree, nullptr, 0); }
+    const_iterator end() const noexcept { return const_iterator(&_tree, nullptr, 0); }
+
+    reverse_iterator rbegin() noexcept { return reverse_iterator(end()); }
+    const_reverse_iterator rbegin() const noexcept { return const_reverse_iterator(end()); }
+
+    reverse_iterator rend() noexcept { return reverse_iterator(begin()); }
+    const_reverse_iterator rend() const noexcept { return const_reverse_iterator(begin()); }
+
+    const_iterator cbegin() const noexcept { return begin(); }
+    const_iterator cend() const noexcept { return end(); }
+
+    const_reverse_iterator crbegin() const noexcept { return rbegin(); }
+    const_reverse_iterator crend() const noexcept { return rend(); }
+
+    bool empty() const noexcept { return _tree._values_count == 0; }
+
+    size_type size() const noexcept { return _tree._values_count; }
+    size_type max_size() const noexcept { return _tree.max_size(); }
+
+    void swap(string_map& x) noexcept(_alloc_wrapper::is_nothrow_swap()) { _tree.swap(x._tree); }
+
+    mapped_type& operator [] (string_view key)
+    { return _tree.template insert<iterator>(key).first.mapped(); }
+
+    mapped_type& at(string_view key)
+    {
+        iterator it = _tree.template find<iterator>(key);
+        if (it._leaf == nullptr)
+        {
+            std::__throw_out_of_range("xxfl::string_map::at");
+        }
+
+        return it.mapped();
+    }
+
+    const mapped_type& at(string_view key) const
+    {
+        const_iterator it = _tree.template find<const_iterator>(key);
+        if (it._leaf == nullptr)
+        {
+            std::__throw_out_of_range("xxfl::string_map::at");
+        }
+
+        return it.mapped();
+    }
+
+    template<typename... _args>
+    std::pair<iterator, bool> emplace(_args&&... args)
+    { return insert(value_type(std::forward<_args>(args)...)); }
+
+    template<typename... _args>
+    iterator emplace_hint(const const_iterator&, _args&&... args)
+    { return insert(value_type(std::forward<_args>(args)...)).first; }
+
+    std::pair<iterator, bool> insert(const value_type& x)
+    { return _tree.template insert<iterator>(x.first, x.second); }
+
+    std::pair<iterator, bool> insert(value_type&& x)
+    { return _tree.template insert<iterator>(x.first, std::move(x.second)); }
+
+    iterator insert(const const_iterator&, const value_type& x)
+    { return insert(x).first; }
+
+    iterator insert(const const_iterator&, value_type&& x)
+    { return insert(std::move(x)).first; }
+
+    template<typename _input_iterator>
+    void insert(_input_iterator first, _input_iterator last)
+    {
+        for (; first != last; ++first)
+        {
+            _tree.template insert<iterator>(first->first, first->second);
+        }
+    }
+
+    void insert(std::initializer_list<value_type> il)
+    { insert(il.begin(), il.end()); }
+
+    iterator erase(const const_iterator& position)
+    { return _tree.template erase<iterator>(position); }
+
+    size_type erase(string_view key)
+    { return _tree.erase(key); }
+
+    iterator erase(const const_iterator& first, const const_iterator& last)
+    { return _tree.template erase_range<iterator>(first, last); }
+
+    void clear() noexcept { _tree.clear(); }
+
+    size_type count(string_view key) const
+    { return _tree.template find<const_iterator>(key)._leaf != nullptr; }
+
+    iterator find(string_view key)
+    { return _tree.template find<iterator>(key); }
+
+    const_iterator find(string_view key) const
+    { return _tree.template find<const_iterator>(key); }
+
+    iterator lower_bound(string_view key)
+    { return _tree.template lower_bound<iterator>(key); }
+
+    const_iterator lower_bound(string_view key) const
+    { return _tree.template lower_bound<const_iterator>(key); }
+
+    iterator upper_bound(string_view key)
+    { return _tree.template upper_bound<iterator>(key); }
+
+    const_iterator upper_bound(string_view key) const
+    { return _tree.template upper_bound<const_iterator>(key); }
+
+    std::pair<iterator, iterator> equal_range(string_view key)
+    { return _tree.template equal_range<iterator>(key); }
+
+    std::pair<const_iterator, const_iterator> equal_range(string_view key) const
+    { return _tree.template equal_range<const_iterator>(key); }
+};
+
+template<typename _a, typename _b, uint32_t _c>
+inline bool operator == (const xxfl::string_map<_a, _b, _c>& x, const xxfl::string_map<_a, _b, _c>& y)
+{ return x.size() == y.size() && std::equal(x.begin(), x.end(), y.begin()); }
+
+template<typename _a, typename _b, uint32_t _c>
+inline bool operator < (const xxfl::string_map<_a, _b, _c>& x, const xxfl::string_map<_a, _b, _c>& y)
+{ return std::lexicographical_compare(x.begin(), x.end(), y.begin(), y.end()); }
+
+template<typename _a, typename _b, uint32_t _c>
+inline bool operator != (const xxfl::string_map<_a, _b, _c>& x, const xxfl::string_map<_a, _b, _c>& y)
+{ return !(x == y); }
+
+template<typename _a, typename _b, uint32_t _c>
+inline bool operator > (const xxfl::string_map<_a, _b, _c>& x, const xxfl::string_map<_a, _b, _c>& y)
+{ return y < x; }
+
+template<typename _a, typename _b, uint32_t _c>
+inline bool operator <= (const xxfl::string_map<_a, _b, _c>& x, const xxfl::string_map<_a, _b, _c>& y)
+{ return !(y < x); }
+
+template<typename _a, typename _b, uint32_t _c>
+inline bool operator >= (const xxfl::string_map<_a, _b, _c>& x, const xxfl::string_map<_a, _b, _c>& y)
+{ return !(x < y); }
+
+template<typename _a, typename _b, uint32_t _c>
+inline void swap(xxfl::string_map<_a, _b, _c>& x, xxfl::string_map<_a, _b, _c>& y)
+{ x.swap(y); }
+
+} // xxfl
@@ -0,0 +1,248 @@
+#pragma once
+
+#include "xxfl_string_tree.h"
+
+namespace xxfl {
+
+// string_set packs its keys into the leaves with their common prefix removed. the keys are ordered bytewise like
+// std::less<std::string>, and the iterators hand out string_views of a key rebuilt inside the iterator, which stay
+// valid until the iterator changes or is destroyed: a view of *s.find(k) dangles after the statement, copy it into a
+// std::string to keep it. the iterators are input iterators for the same reason, see _string_tree_iterator_base. any
+// insertion or erasure invalidates the iterators.
+
+struct _string_set_iterator : _string_tree_iterator_base<void>
+{
+    typedef _string_tree_iterator_base<void> _base;
+
+    typedef std::string             value_type;
+    typedef string_view             reference;
+    typedef _arrow_proxy<reference> pointer;
+
+    _string_set_iterator() noexcept {}
+
+    _string_set_iterator(const _string_tree_type* tree, _leaf_type* leaf, uint32_t pos) noexcept
+    : _base(tree, leaf, pos) {}
+
+    explicit _string_set_iterator(const _base& it) noexcept : _base(it) {}
+
+    reference operator * () const { return _base::key(); }
+    pointer operator -> () const { return pointer{ **this }; }
+
+    _string_set_iterator& operator ++ () noexcept
+    {
+        _base::increment();
+        return *this;
+    }
+
+    _string_set_iterator operator ++ (int) noexcept
+    {
+        _string_set_iterator tmp(*this);
+        _base::increment();
+        return tmp;
+    }
+
+    _string_set_iterator& operator -- () noexcept
+    {
+        _base::decrement();
+        return *this;
+    }
+
+    _string_set_iterator operator -- (int) noexcept
+    {
+        _string_set_iterator tmp(*this);
+        _base::decrement();
+        return tmp;
+    }
+};
+
+template<typename _allocator = std::allocator<std::string>,
+         uint32_t _leaf_bucket_bysize_max = XXFL_BPLUS_TREE_BUCKET_BYSIZE_MAX_DEFAULT>
+class string_set
+{
+public:
+    typedef std::string            key_type;
+    typedef std::string            value_type;
+    typedef std::less<std::string> key_compare;
+    typedef std::less<std::string> value_compare;
+    typedef _allocator             allocator_type;
+
+    typedef _string_bplus_tree<void, allocator_type, _leaf_bucket_bysize_max> _string_tree_type;
+
+    _string_tree_type _tree;
+
+protected:
+    typedef typename _string_tree_type::_alloc_wrapper _alloc_wrapper;
+
+public:
+    typedef string_view                                          reference;
+    typedef string_view                                          const_reference;
+    typedef _string_set_iterator                                 iterator;
+    typedef _string_set_iterator                                 const_iterator;
+    typedef _string_tree_reverse_iterator<_string_set_iterator>  reverse_iterator;
+    typedef _string_tree_reverse_iterator<_string_set_iterator>  const_reverse_iterator;
+    typedef size_t                                               size_type;
+    typedef ptrdiff_t                                            difference_type;
+
+    string_set() {}
+
+    explicit string_set(const key_compare&, const allocator_type& alloc = allocator_type()) : _tree(alloc) {}
+
+    explicit string_set(const allocator_type& alloc) : _tree(alloc) {}
+
+    template<typename _input_iterator>
+    string_set(_input_iterator first, _input_iterator last)
+    { insert(first, last); }
+
+    template<typename _input_iterator>
+    string_set(_input_iterator first, _input_iterator last,
+               const key_compare&,
+               const allocator_type& alloc = allocator_type())
+    : _tree(alloc)
+    { insert(first, last); }
+
+    template<typename _input_iterator>
+    string_set(_input_iterator first, _input_iterator last,
+               const allocator_type& alloc)
+    : _tree(alloc)
+    { insert(first, last); }
+
+    string_set(const string_set& x) : _tree(x._tree) {}
+    string_set(const string_set& x, const allocator_type& alloc) : _tree(x._tree, alloc) {}
+
+    string_set(string_set&& x) : _tree(std::move(x._tree)) {}
+    string_set(string_set&& x, const allocator_type& alloc) : _tree(std::move(x._tree), alloc) {}
+
+    string_set(std::initializer_list<value_type> il,
+               const key_compare& = key_compare(),
+               const allocator_type& alloc = allocator_type())
+    : _tree(alloc)
+    { insert(il.begin(), il.end()); }
+
+    string_set(std::initializer_list<value_type> il, const allocator_type& alloc)
+    : _tree(alloc)
+    { insert(il.begin(), il.end()); }
+
+    string_set& operator = (const string_set& x)
+    {
+        _tree = x._tree;
+        return *this;
+    }
+
+    string_set& operator = (string_set&& x)
+    {
+        _tree.move_assign(x._tree);
+        return *this;
+    }
+
+    string_set& operator = (std::initializer_list<value_type> il)
+    {
+        _tree.clear();
+        insert(il.begin(), il.end());
+        return *this;
+    }
+
+    key_compare key_comp() const { return key_compare(); }
+    value_compare value_comp() const { return value_compare(); }
+    allocator_type get_allocator() const noexcept { return allocator_type(_tree._awrapper._alloc); }
+
+    iterator begin() const noexcept { return iterator(&_tree, _tree._first_leaf, 0); }
+    iterator end() const noexcept { return iterator(&_tree, nullptr, 0); }
+
+    reverse_iterator rbegin() const noexcept { return reverse_iterator(end()); }
+    reverse_iterator rend() const noexcept { return reverse_iterator(begin()); }
+
+    const_iterator cbegin() const noexcept { return begin(); }
+    const_iterator cend() const noexcept { return end(); }
+
+    const_reverse_iterator crbegin() const noexcept { return rbegin(); }
+    const_reverse_iterator crend() const noexcept { return rend(); }
+
+    bool empty() const noexcept { return _tree._values_count == 0; }
+
+    size_type size() const noexcept { return _tree._values_count; }
+    size_type max_size() const noexcept { return _tree.max_size(); }
+
+    void swap(string_set& x) noexcept(_alloc_wrapper::is_nothrow_swap()) { _tree.swap(x._tree); }
+
+    template<typename... _args>
+    std::pair<iterator, bool> emplace(_args&&... args)
+    { return insert(value_type(std::forward<_args>(args)...)); }
+
+    template<typename... _args>
+    iterator emplace_hint(const const_iterator&, _args&&... args)
+    { return insert(value_type(std::forward<_args>(args)...)).first; }
+
+    std::pair<iterator, bool> insert(string_view x)
+    { return _tree.template insert<iterator>(x); }
+
+    iterator insert(const const_iterator&, string_view x)
+    { return _tree.template insert<iterator>(x).first; }
+
+    template<typename _input_iterator>
+    void insert(_input_iterator first, _input_iterator last)
+    {
+        for (; first != last; ++first)
+        {
+            _tree.template insert<iterator>(string_view(*first));
+        }
+    }
+
+    void insert(std::initializer_list<value_type> il)
+    { insert(il.begin(), il.end()); }
+
+    iterator erase(const const_iterator& position)
+    { return _tree.template erase<iterator>(position); }
+
+    size_type erase(string_view key)
+    { return _tree.erase(key); }
+
+    iterator erase(const const_iterator& first, const const_iterator& last)
+    { return _tree.template erase_range<iterator>(first, last); }
+
+    void clear() noexcept { _tree.clear(); }
+
+    size_type count(string_view key) const
+    { return _tree.template find<const_iterator>(key)._leaf != nullptr; }
+
+    const_iterator find(string_view key) const
+    { return _tree.template find<const_iterator>(key); }
+
+    const_iterator lower_bound(string_view key) const
+    { return _tree.template lower_bound<const_iterator>(key); }
+
+    const_iterator upper_bound(string_view key) const
+    { return _tree.template upper_bound<const_iterator>(key); }
+
+    std::pair<const_iterator, const_iterator> equal_range(string_view key) const
+    { return _tree.template equal_range<const_iterator>(key); }
+};
+
+template<typename _a, uint32_t _b>
+inline bool operator == (const xxfl::string_set<_a, _b>& x, const xxfl::string_set<_a, _b>& y)
+{ return x.size() == y.size() && std::equal(x.begin(), x.end(), y.begin()); }
+
+template<typename _a, uint32_t _b>
+inline bool operator < (const xxfl::string_set<_a, _b>& x, const xxfl::string_set<_a, _b>& y)
+{ return std::lexicographical_compare(x.begin(), x.end(), y.begin(), y.end()); }
+
+template<typename _a, uint32_t _b>
+inline bool operator != (const xxfl::string_set<_a, _b>& x, const xxfl::string_set<_a, _b>& y)
+{ return !(x == y); }
+
+template<typename _a, uint32_t _b>
+inline bool operator > (const xxfl::string_set<_a, _b>& x, const xxfl::string_set<_a, _b>& y)
+{ return y < x; }
+
+template<typename _a, uint32_t _b>
+inline bool operator <= (const xxfl::string_set<_a, _b>& x, const xxfl::string_set<_a, _b>& y)
+{ return !(y < x); }
+
+template<typename _a, uint32_t _b>
+inline bool operator >= (const xxfl::string_set<_a, _b>& x, const xxfl::string_set<_a, _b>& y)
+{ return !(x < y); }
+
+template<typename _a, uint32_t _b>
+inline void swap(xxfl::string_set<_a, _b>& x, xxfl::string_set<_a, _b>& y)
+{ x.swap(y); }
+
+} // xxfl
@@ -0,0 +1,1177 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "xxfl_set.h"
+
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#include <string_view>
+#define XXFL_STD_STRING_VIEW 1
+#else
+#define XXFL_STD_STRING_VIEW 0
+#endif
+
+namespace xxfl {
+
+#if XXFL_STD_STRING_VIEW
+typedef std::string_view string_view;
+#else
+// a minimal stand-in of std::string_view before C++17
+class string_view
+{
+public:
+    typedef char        value_type;
+    typedef const char* iterator;
+    typedef const char* const_iterator;
+    typedef size_t      size_type;
+
+    string_view() noexcept : _data(nullptr), _size(0) {}
+    string_view(const char* data, size_t size) noexcept : _data(data), _size(size) {}
+    string_view(const char* str) noexcept : _data(str), _size(std::strlen(str)) {}
+    string_view(const std::string& str) noexcept : _data(str.data()), _size(str.size()) {}
+
+    explicit operator std::string () const { return std::string(_data, _size); }
+
+    const char* data() const noexcept { return _data; }
+    size_t size() const noexcept { return _size; }
+    size_t length() const noexcept { return _size; }
+    bool empty() const noexcept { return _size == 0; }
+
+    const char* begin() const noexcept { return _data; }
+    const char* end() const noexcept { return _data + _size; }
+
+    char operator [] (size_t pos) const noexcept { return _data[pos]; }
+
+    int compare(string_view x) const noexcept
+    {
+        int result = std::char_traits<char>::compare(_data, x._data, std::min(_size, x._size));
+        return (result != 0)? result : (_size < x._size)? -1 : (_size > x._size)? 1 : 0;
+    }
+
+    friend bool operator == (string_view x, string_view y) noexcept { return x._size == y._size && x.compare(y) == 0; }
+    friend bool operator != (string_view x, string_view y) noexcept { return !(x == y); }
+    friend bool operator < (string_view x, string_view y) noexcept { return x.compare(y) < 0; }
+    friend bool operator > (string_view x, string_view y) noexcept { return x.compare(y) > 0; }
+    friend bool operator <= (string_view x, string_view y) noexcept { return x.compare(y) <= 0; }
+    friend bool operator >= (string_view x, string_view y) noexcept { return x.compare(y) >= 0; }
+
+private:
+    const char* _data;
+    size_t _size;
+};
+#endif
+
+template<typename _mapped_type>
+struct _string_leaf_entry
+{
+    uint32_t _offset;
+    _mapped_type _mapped;
+
+    template<typename... _args>
+    explicit _string_leaf_entry(uint32_t offset, _args&&... args)
+    : _offset(offset), _mapped(std::forward<_args>(args)...) {}
+
+    _string_leaf_entry(uint32_t offset, _string_leaf_entry&& x)
+    : _offset(offset), _mapped(std::move(x._mapped)) {}
+};
+
+template<>
+struct _string_leaf_entry<void>
+{
+    uint32_t _offset;
+
+    explicit _string_leaf_entry(uint32_t offset) noexcept : _offset(offset) {}
+    _string_leaf_entry(uint32_t offset, _string_leaf_entry&&) noexcept : _offset(offset) {}
+};
+
+// the keys of a leaf are stored without their common prefix, the suffixes are packed from the end of the bucket
+// towards the entries: [entries][free space][suffix n-1]...[suffix 1][suffix 0][prefix]
+// the offset of an entry is the distance from the end of the bucket to the beginning of its suffix.
+template<typename _mapped_type>
+struct _string_leaf
+{
+    typedef _string_leaf_entry<_mapped_type> _entry_type;
+
+    _string_leaf* _prev_leaf;
+    _string_leaf* _next_leaf;
+    uint32_t _bucket_bysize;
+    uint32_t _count;
+    uint32_t _prefix_size;
+
+    static uint32_t header_bysize() noexcept
+    { return (sizeof(_string_leaf) + alignof(_entry_type) - 1) & ~(uint32_t)(alignof(_entry_type) - 1); }
+
+    _entry_type* entries() const noexcept { return (_entry_type*)((uint8_t*)this + header_bysize()); }
+    char* bucket_end() const noexcept { return (char*)entries() + _bucket_bysize; }
+
+    const char* prefix() const noexcept { return bucket_end() - _prefix_size; }
+
+    uint32_t suffix_end_offset(uint32_t pos) const noexcept
+    { return (pos > 0)? entries()[pos - 1]._offset : _prefix_size; }
+
+    const char* suffix(uint32_t pos) const noexcept { return bucket_end() - entries()[pos]._offset; }
+    uint32_t suffix_size(uint32_t pos) const noexcept { return entries()[pos]._offset - suffix_end_offset(pos); }
+
+    uint32_t bytes_size() const noexcept { return (_count > 0)? entries()[_count - 1]._offset : _prefix_size; }
+    uint32_t used_bysize() const noexcept { return _count * sizeof(_entry_type) + bytes_size(); }
+
+    void copy_key(uint32_t pos, std::string& str) const
+    {
+        str.assign(prefix(), _prefix_size);
+        str.append(suffix(pos), suffix_size(pos));
+    }
+};
+
+// the leaves are indexed by their current first keys. those only change by erasing the first key of a leaf or by
+// inserting before the first key of the first leaf, neither breaks the order of the index.
+template<typename _leaf_type>
+struct _string_index_key
+{
+    _leaf_type* _leaf; // nullptr for the keys being searched
+    const char* _data;
+    size_t _size;
+
+    _string_index_key(_leaf_type* leaf) noexcept : _leaf(leaf), _data(nullptr), _size(0) {}
+    _string_index_key(const char* data, size_t size) noexcept : _leaf(nullptr), _data(data), _size(size) {}
+
+    // not trivially copyable, so the index never copies them into its internal nodes as separators
+    _string_index_key(const _string_index_key& x) noexcept : _leaf(x._leaf), _data(x._data), _size(x._size) {}
+
+    _string_index_key& operator = (const _string_index_key& x) noexcept
+    {
+        _leaf = x._leaf;
+        _data = x._data;
+        _size = x._size;
+        return *this;
+    }
+};
+
+template<typename _leaf_type>
+struct _string_index_less
+{
+    typedef _string_index_key<_leaf_type> _key_type;
+
+    // the key of a leaf is made of two pieces, its prefix and its first suffix
+    static void key_pieces(const _key_type& x, const char** data, size_t* size) noexcept
+    {
+        if (x._leaf != nullptr)
+        {
+            data[0] = x._leaf->prefix();
+            size[0] = x._leaf->_prefix_size;
+            data[1] = x._leaf->suffix(0);
+            size[1] = x._leaf->suffix_size(0);
+        }
+        else
+        {
+            data[0] = x._data;
+            size[0] = x._size;
+            data[1] = nullptr;
+            size[1] = 0;
+        }
+    }
+
+    bool operator () (const _key_type& x, const _key_type& y) const noexcept
+    {
+        const char* x_data[2];
+        const char* y_data[2];
+        size_t x_size[2];
+        size_t y_size[2];
+
+        key_pieces(x, x_data, x_size);
+        key_pieces(y, y_data, y_size);
+
+        uint32_t x_piece = 0;
+        uint32_t y_piece = 0;
+
+        for (;;)
+        {
+            while (x_piece < 2 && x_size[x_piece] == 0)
+            {
+                ++x_piece;
+            }
+            while (y_piece < 2 && y_size[y_piece] == 0)
+            {
+                ++y_piece;
+            }
+
+            if (y_piece == 2)
+            {
+                return false;
+            }
+            if (x_piece == 2)
+            {
+                return true;
+            }
+
+            size_t size = std::min(x_size[x_piece], y_size[y_piece]);
+            int result = std::memcmp(x_data[x_piece], y_data[y_piece], size);
+
+            if (result != 0)
+            {
+                return result < 0;
+            }
+
+            x_data[x_piece] += size;
+            x_size[x_piece] -= size;
+            y_data[y_piece] += size;
+            y_size[y_piece] -= size;
+        }
+    }
+};
+
+template<typename _mapped_type>
+struct _string_bplus_tree_base
+{
+    typedef _string_leaf<_mapped_type> _leaf_type;
+
+    _leaf_type* _first_leaf;
+    _leaf_type* _last_leaf;
+    size_t _values_count;
+
+    _string_bplus_tree_base() noexcept : _first_leaf(nullptr), _last_leaf(nullptr), _values_count(0) {}
+};
+
+// the full key is rebuilt in the iterator, the views handed out stay valid until the iterator changes or is destroyed,
+// so *s.find(k) can't be kept past the full expression. two iterators to the same key hand out different views, which
+// breaks the multipass guarantee of forward iterators, so the iterators are declared input iterators even though they
+// can also be decremented.
+template<typename _mapped_type>
+struct _string_tree_iterator_base
+{
+    typedef std::input_iterator_tag iterator_category;
+    typedef std::ptrdiff_t                  difference_type;
+
+    typedef _string_bplus_tree_base<_mapped_type> _string_tree_type;
+    typedef _string_leaf<_mapped_type>            _leaf_type;
+    typedef _string_leaf_entry<_mapped_type>      _entry_type;
+
+    const _string_tree_type* _tree;
+    _leaf_type* _leaf; // nullptr for the end
+    uint32_t _pos;
+    mutable std::string _key;
+
+    _string_tree_iterator_base() noexcept : _tree(nullptr), _leaf(nullptr), _pos(0) {}
+
+    _string_tree_iterator_base(const _string_tree_type* tree, _leaf_type* leaf, uint32_t pos) noexcept
+    : _tree(tree), _leaf(leaf), _pos(pos) {}
+
+    // the key buffer isn't copied, it's rebuilt on demand
+    _string_tree_iterator_base(const _string_tree_iterator_base& it) noexcept
+    : _tree(it._tree), _leaf(it._leaf), _pos(it._pos) {}
+
+    _string_tree_iterator_base& operator = (const _string_tree_iterator_base& it) noexcept
+    {
+        _tree = it._tree;
+        _leaf = it._leaf;
+        _pos = it._pos;
+        return *this;
+    }
+
+    string_view key() const
+    {
+        _leaf->copy_key(_pos, _key);
+        return string_view(_key.data(), _key.size());
+    }
+
+    _entry_type& entry() const noexcept { return _leaf->entries()[_pos]; }
+
+    void increment() noexcept
+    {
+        if (++_pos == _leaf->_count)
+        {
+            _leaf = _leaf->_next_leaf;
+            _pos = 0;
+        }
+    }
+
+    void decrement() noexcept
+    {
+        if (_leaf == nullptr)
+        {
+            _leaf = _tree->_last_leaf;
+            _pos = _leaf->_count - 1;
+        }
+        else if (_pos == 0)
+        {
+            _leaf = _leaf->_prev_leaf;
+            _pos = _leaf->_count - 1;
+        }
+        else
+        {
+            --_pos;
+        }
+    }
+
+    bool equal(const _string_tree_iterator_base& it) const noexcept
+    { return _leaf == it._leaf && _pos == it._pos; }
+};
+
+template<typename _mapped_type>
+inline bool operator == (const _string_tree_iterator_base<_mapped_type>& x, const _string_tree_iterator_base<_mapped_type>& y) noexcept
+{ return x.equal(y); }
+
+template<typename _mapped_type>
+inline bool operator != (const _string_tree_iterator_base<_mapped_type>& x, const _string_tree_iterator_base<_mapped_type>& y) noexcept
+{ return !x.equal(y); }
+
+// std::reverse_iterator dereferences a temporary iterator, which would leave the view dangling
+template<typename _iterator>
+struct _string_tree_reverse_iterator
+{
+    typedef typename _iterator::iterator_category iterator_category;
+    typedef typename _iterator::value_type        value_type;
+    typedef typename _iterator::difference_type   difference_type;
+    typedef typename _iterator::reference         reference;
+    typedef typename _iterator::pointer           pointer;
+
+    _iterator _current;
+    mutable _iterator _deref;
+
+    _string_tree_reverse_iterator() {}
+
+    explicit _string_tree_reverse_iterator(const _iterator& it) : _current(it) {}
+
+    template<typename _other_iterator>
+    _string_tree_reverse_iterator(const _string_tree_reverse_iterator<_other_iterator>& it) : _current(it.base()) {}
+
+    _iterator base() const { return _current; }
+
+    reference operator * () const
+    {
+        _deref = _current;
+        --_deref;
+        return *_deref;
+    }
+
+    pointer operator -> () const { return pointer{ **this }; }
+
+    _string_tree_reverse_iterator& operator ++ ()
+    {
+        --_current;
+        return *this;
+    }
+
+    _string_tree_reverse_iterator operator ++ (int)
+    {
+        _string_tree_reverse_iterator tmp(*this);
+        --_current;
+        return tmp;
+    }
+
+    _string_tree_reverse_iterator& operator -- ()
+    {
+        ++_current;
+        return *this;
+    }
+
+    _string_tree_reverse_iterator operator -- (int)
+    {
+        _string_tree_reverse_iterator tmp(*this);
+        ++_current;
+        return tmp;
+    }
+};
+
+template<typename _a, typename _b>
+inline bool operator == (const _string_tree_reverse_iterator<_a>& x, const _string_tree_reverse_iterator<_b>& y)
+{ return x.base() == y.base(); }
+
+template<typename _a, typename _b>
+inline bool operator != (const _string_tree_reverse_iterator<_a>& x, const _string_tree_reverse_iterator<_b>& y)
+{ return x.base() != y.base(); }
+
+// a b+ tree whose leaves pack string keys with their common prefix removed, the leaves are found through an
+// xxfl::set indexing them by their first keys. keys are ordered bytewise like std::less<std::string>.
+template<typename _mapped_type, typename _allocator, uint32_t _leaf_bucket_bysize_max>
+struct _string_bplus_tree : _string_bplus_tree_base<_mapped_type>
+{
+    typedef _string_bplus_tree_base<_mapped_type> _base;
+
+    using typename _base::_leaf_type;
+
+    using _base::_first_leaf;
+    using _base::_last_leaf;
+    using _base::_values_count;
+
+    typedef _string_leaf_entry<_mapped_type> _entry_type;
+    typedef _string_index_key<_leaf_type>    _index_key;
+
+    typedef typename __alloc_wrapper<_allocator>::template rebind<_index_key>::other _index_allocator;
+    typedef xxfl::set<_index_key, _string_index_less<_leaf_type>, _index_allocator>  _index_type;
+    typedef typename _index_type::const_iterator                                     _index_iterator;
+
+    typedef typename __alloc_wrapper<_allocator>::template rebind<uint8_t>::other _leaf_allocator;
+    typedef __alloc_wrapper<_leaf_allocator> _alloc_wrapper;
+
+    _index_type _index;
+    _alloc_wrapper _awrapper;
+
+    // a key gathered for repacking leaves, the keys are concatenated in one buffer
+    struct _packed_item
+    {
+        uint32_t _key_end;
+        _entry_type* _entry;
+    };
+
+    _string_bplus_tree() {}
+
+    explicit _string_bplus_tree(const _allocator& alloc)
+    : _index(_index_allocator(alloc)), _awrapper(_leaf_allocator(alloc)) {}
+
+    _string_bplus_tree(const _string_bplus_tree& tree)
+    : _index(_index_allocator(tree._awrapper.select_on_container_copy_construction())),
+      _awrapper(tree._awrapper.select_on_container_copy_construction())
+    { clone_leaves(tree); }
+
+    _string_bplus_tree(const _string_bplus_tree& tree, const _allocator& alloc)
+    : _index(_index_allocator(alloc)), _awrapper(_leaf_allocator(alloc))
+    { clone_leaves(tree); }
+
+    _string_bplus_tree(_string_bplus_tree&& tree)
+    : _index(std::move(tree._index)), _awrapper(tree._awrapper)
+    { move_data(tree); }
+
+    _string_bplus_tree(_string_bplus_tree&& tree, const _allocator& alloc)
+    : _index(_index_allocator(alloc)), _awrapper(_leaf_allocator(alloc))
+    {
+        if (_awrapper._alloc == tree._awrapper._alloc)
+        {
+            _index = std::move(tree._index);
+            move_data(tree);
+        }
+        else
+        {
+            clone_leaves(tree);
+            tree.clear();
+        }
+    }
+
+    ~_string_bplus_tree() noexcept { destroy_leaves(); }
+
+    _string_bplus_tree& operator = (const _string_bplus_tree& tree)
+    {
+        if (this != &tree)
+        {
+            clear();
+
+            if (_alloc_wrapper::propagate_on_container_copy_assignment())
+            {
+                _awrapper.copy_allocator(tree._awrapper._alloc);
+            }
+
+            clone_leaves(tree);
+        }
+
+        return *this;
+    }
+
+    void move_assign(_string_bplus_tree& tree)
+    {
+        clear();
+
+        if (_alloc_wrapper::propagate_on_container_move_assignment() ||
+            _alloc_wrapper::allocator_always_compares_equal() ||
+            _awrapper._alloc == tree._awrapper._alloc)
+        {
+            _index = std::move(tree._index);
+            move_data(tree);
+            _awrapper.move_allocator(tree._awrapper._alloc);
+        }
+        else
+        {
+            clone_leaves(tree);
+            tree.clear();
+        }
+    }
+
+    void move_data(_string_bplus_tree& tree) noexcept
+    {
+        _first_leaf = tree._first_leaf;
+        _last_leaf = tree._last_leaf;
+        _values_count = tree._values_count;
+
+        tree._first_leaf = nullptr;
+        tree._last_leaf = nullptr;
+        tree._values_count = 0;
+    }
+
+    void swap(_string_bplus_tree& tree) noexcept(_alloc_wrapper::is_nothrow_swap())
+    {
+        _index.swap(tree._index);
+        std::swap(_first_leaf, tree._first_leaf);
+        std::swap(_last_leaf, tree._last_leaf);
+        std::swap(_values_count, tree._values_count);
+        _awrapper.swap_allocator(tree._awrapper._alloc);
+    }
+
+    size_t max_size() const noexcept
+    { return _awrapper.max_size() / sizeof(_entry_type); }
+
+    void clear() noexcept
+    {
+        _index.clear();
+        destroy_leaves();
+
+        _first_leaf = nullptr;
+        _last_leaf = nullptr;
+        _values_count = 0;
+    }
+
+    _leaf_type* allocate_leaf(uint32_t bucket_bysize)
+    {
+        _leaf_type* leaf = (_leaf_type*)_awrapper.allocate(_leaf_type::header_bysize() + bucket_bysize);
+
+        leaf->_prev_leaf = nullptr;
+        leaf->_next_leaf = nullptr;
+        leaf->_bucket_bysize = bucket_bysize;
+        leaf->_count = 0;
+        leaf->_prefix_size = 0;
+
+        return leaf;
+    }
+
+    void deallocate_leaf(_leaf_type* leaf)
+    {
+        _awrapper.destroy(leaf->entries(), leaf->entries() + leaf->_count);
+        _awrapper.deallocate((uint8_t*)leaf, _leaf_type::header_bysize() + leaf->_bucket_bysize);
+    }
+
+    void destroy_leaves() noexcept
+    {
+        _leaf_type* leaf = _first_leaf;
+
+        while (leaf != nullptr)
+        {
+            _leaf_type* next_leaf = leaf->_next_leaf;
+            deallocate_leaf(leaf);
+            leaf = next_leaf;
+        }
+    }
+
+    void clone_leaves(const _string_bplus_tree& tree)
+    {
+        for (const _leaf_type* leaf = tree._first_leaf; leaf != nullptr; leaf = leaf->_next_leaf)
+        {
+            _leaf_type* new_leaf = allocate_leaf(leaf->_bucket_bysize);
+            uint32_t bytes_size = leaf->bytes_size();
+
+            std::memcpy(new_leaf->bucket_end() - bytes_size, leaf->bucket_end() - bytes_size, bytes_size);
+
+            for (uint32_t i = 0; i < leaf->_count; ++i)
+            {
+                _awrapper.construct(new_leaf->entries() + i, leaf->entries()[i]);
+            }
+
+            new_leaf->_count = leaf->_count;
+            new_leaf->_prefix_size = leaf->_prefix_size;
+
+            link_leaves(new_leaf, new_leaf, _last_leaf, nullptr);
+            _index.insert(_index.cend(), _index_key(new_leaf));
+        }
+
+        _values_count = tree._values_count;
+    }
+
+    // links the chain [first_leaf, last_leaf] between prev_leaf and next_leaf
+    void link_leaves(_leaf_type* first_leaf, _leaf_type* last_leaf, _leaf_type* prev_leaf, _leaf_type* next_leaf) noexcept
+    {
+        first_leaf->_prev_leaf = prev_leaf;
+        last_leaf->_next_leaf = next_leaf;
+
+        if (prev_leaf != nullptr)
+        {
+            prev_leaf->_next_leaf = first_leaf;
+        }
+        else
+        {
+            _first_leaf = first_leaf;
+        }
+
+        if (next_leaf != nullptr)
+        {
+            next_leaf->_prev_leaf = last_leaf;
+        }
+        else
+        {
+            _last_leaf = last_leaf;
+        }
+    }
+
+    static int compare_bytes(const char* x, size_t x_size, const char* y, size_t y_size) noexcept
+    {
+        int result = std::memcmp(x, y, std::min(x_size, y_size));
+        return (result != 0)? result : (x_size < y_size)? -1 : (x_size > y_size)? 1 : 0;
+    }
+
+    static uint32_t common_prefix_size(const char* x, uint32_t x_size, const char* y, uint32_t y_size) noexcept
+    {
+        uint32_t size = std::min(x_size, y_size);
+        uint32_t i = 0;
+
+        while (i < size && x[i] == y[i])
+        {
+            ++i;
+        }
+
+        return i;
+    }
+
+    static bool has_prefix(const _leaf_type* leaf, string_view key) noexcept
+    {
+        return key.size() >= leaf->_prefix_size &&
+               std::memcmp(key.data(), leaf->prefix(), leaf->_prefix_size) == 0;
+    }
+
+    // the leaf whose range holds key: the last leaf whose first key isn't larger than key, or the first leaf
+    _index_iterator locate(string_view key) const
+    {
+        _index_iterator it = _index.upper_bound(_index_key(key.data(), key.size()));
+
+        if (it != _index.cbegin())
+        {
+            --it;
+        }
+
+        return it;
+    }
+
+    // the position of the first key not less than key, the prefix is compared once and stripped from key
+    static uint32_t search_leaf(const _leaf_type* leaf, string_view key, bool& found) noexcept
+    {
+        found = false;
+
+        const char* key_data = key.data();
+        size_t key_size = key.size();
+        uint32_t prefix_size = leaf->_prefix_size;
+
+        if (prefix_size > 0)
+        {
+            int result = std::memcmp(key_data, leaf->prefix(), std::min(key_size, (size_t)prefix_size));
+
+            if (result < 0 || (result == 0 && key_size < prefix_size))
+            {
+                return 0;
+            }
+            if (result > 0)
+            {
+                return leaf->_count;
+            }
+
+            key_data += prefix_size;
+            key_size -= prefix_size;
+        }
+
+        uint32_t first_pos = 0;
+        uint32_t check_count = leaf->_count;
+
+        while (check_count > 0)
+        {
+            uint32_t step = check_count >> 1;
+            uint32_t pos = first_pos + step;
+
+            if (compare_bytes(leaf->suffix(pos), leaf->suffix_size(pos), key_data, key_size) < 0)
+            {
+                first_pos = pos + 1;
+                check_count -= step + 1;
+            }
+            else
+            {
+                check_count = step;
+            }
+        }
+
+        found = first_pos < leaf->_count &&
+                compare_bytes(leaf->suffix(first_pos), leaf->suffix_size(first_pos), key_data, key_size) == 0;
+
+        return first_pos;
+    }
+
+    template<typename _output_iterator>
+    _output_iterator make_iterator(_leaf_type* leaf, uint32_t pos) const noexcept
+    {
+        if (leaf != nullptr && pos == leaf->_count)
+        {
+            leaf = leaf->_next_leaf;
+            pos = 0;
+        }
+
+        return _output_iterator(this, leaf, pos);
+    }
+
+    template<typename _output_iterator>
+    _output_iterator find(string_view key) const
+    {
+        if (_values_count > 0)
+        {
+            _leaf_type* leaf = locate(key)->_leaf;
+
+            bool found;
+            uint32_t pos = search_leaf(leaf, key, found);
+
+            if (found)
+            {
+                return _output_iterator(this, leaf, pos);
+            }
+        }
+
+        return _output_iterator(this, nullptr, 0);
+    }
+
+    template<typename _output_iterator>
+    _output_iterator lower_bound(string_view key) const
+    {
+        if (_values_count > 0)
+        {
+            _leaf_type* leaf = locate(key)->_leaf;
+
+            bool found;
+            uint32_t pos = search_leaf(leaf, key, found);
+
+            return make_iterator<_output_iterator>(leaf, pos);
+        }
+
+        return _output_iterator(this, nullptr, 0);
+    }
+
+    template<typename _output_iterator>
+    _output_iterator upper_bound(string_view key) const
+    {
+        if (_values_count > 0)
+        {
+            _leaf_type* leaf = locate(key)->_leaf;
+
+            bool found;
+            uint32_t pos = search_leaf(leaf, key, found);
+
+            return make_iterator<_output_iterator>(leaf, pos + found);
+        }
+
+        return _output_iterator(this, nullptr, 0);
+    }
+
+    template<typename _output_iterator>
+    std::pair<_output_iterator, _output_iterator> equal_range(string_view key) const
+    {
+        if (_values_count > 0)
+        {
+            _leaf_type* leaf = locate(key)->_leaf;
+
+            bool found;
+            uint32_t pos = search_leaf(leaf, key, found);
+
+            return std::pair<_output_iterator, _output_iterator>(make_iterator<_output_iterator>(leaf, pos),
+                                                                 make_iterator<_output_iterator>(leaf, pos + found));
+        }
+
+        return std::pair<_output_iterator, _output_iterator>(_output_iterator(this, nullptr, 0),
+                                                             _output_iterator(this, nullptr, 0));
+    }
+
+    // the entry is only constructed from args if key isn't in the tree yet
+    template<typename _output_iterator, typename... _args>
+    std::pair<_output_iterator, bool> insert(string_view key, _args&&... args)
+    {
+        if (_values_count == 0)
+        {
+            _entry_type entry(0, std::forward<_args>(args)...);
+
+            _leaf_type* leaf = allocate_leaf(std::max(_leaf_bucket_bysize_max, (uint32_t)(sizeof(_entry_type) + key.size())));
+            insert_entry(leaf, 0, key.data(), (uint32_t)key.size(), std::move(entry));
+
+            link_leaves(leaf, leaf, nullptr, nullptr);
+            _index.insert(_index_key(leaf));
+            ++_values_count;
+
+            return std::pair<_output_iterator, bool>(_output_iterator(this, leaf, 0), true);
+        }
+
+        _index_iterator index_it = locate(key);
+        _leaf_type* leaf = index_it->_leaf;
+
+        bool found;
+        uint32_t pos = search_leaf(leaf, key, found);
+
+        if (found)
+        {
+            return std::pair<_output_iterator, bool>(_output_iterator(this, leaf, pos), false);
+        }
+
+        _entry_type entry(0, std::forward<_args>(args)...);
+
+        if (has_prefix(leaf, key) &&
+            leaf->used_bysize() + sizeof(_entry_type) + key.size() - leaf->_prefix_size <= leaf->_bucket_bysize)
+        {
+            insert_entry(leaf, pos, key.data() + leaf->_prefix_size, (uint32_t)(key.size() - leaf->_prefix_size), std::move(entry));
+        }
+        else
+        {
+            std::string keys;
+            std::vector<_packed_item> items;
+            items.reserve(leaf->_count + 1);
+
+            gather_items(leaf, 0, pos, keys, items);
+
+            keys.append(key.data(), key.size());
+            items.push_back(_packed_item{ (uint32_t)keys.size(), &entry });
+
+            gather_items(leaf, pos, leaf->_count, keys, items);
+
+            repack(index_it, 1, keys, items, pos, leaf, pos);
+        }
+
+        ++_values_count;
+
+        return std::pair<_output_iterator, bool>(_output_iterator(this, leaf, pos), true);
+    }
+
+    void insert_entry(_leaf_type* leaf, uint32_t pos, const char* suffix, uint32_t suffix_size, _entry_type&& entry)
+    {
+        _entry_type* entries = leaf->entries();
+        char* bucket_end = leaf->bucket_end();
+        uint32_t end_offset = leaf->suffix_end_offset(pos);
+        uint32_t bytes_size = leaf->bytes_size();
+
+        // the suffixes from pos on move towards the entries to make room
+        std::memmove(bucket_end - bytes_size - suffix_size, bucket_end - bytes_size, bytes_size - end_offset);
+        std::memcpy(bucket_end - end_offset - suffix_size, suffix, suffix_size);
+
+        if (pos < leaf->_count)
+        {
+            _awrapper.construct(entries + leaf->_count, std::move(entries[leaf->_count - 1]));
+            std::move_backward(entries + pos, entries + leaf->_count - 1, entries + leaf->_count);
+
+            entries[pos] = std::move(entry);
+        }
+        else
+        {
+            _awrapper.construct(entries + pos, std::move(entry));
+        }
+
+        ++leaf->_count;
+
+        entries[pos]._offset = end_offset + suffix_size;
+        for (uint32_t i = pos + 1; i < leaf->_count; ++i)
+        {
+            entries[i]._offset += suffix_size;
+        }
+    }
+
+    void erase_entry(_leaf_type* leaf, uint32_t pos)
+    {
+        _entry_type* entries = leaf->entries();
+        char* bucket_end = leaf->bucket_end();
+        uint32_t begin_offset = entries[pos]._offset;
+        uint32_t suffix_size = begin_offset - leaf->suffix_end_offset(pos);
+        uint32_t bytes_size = leaf->bytes_size();
+
+        // the suffixes after pos move back towards the end of the bucket
+        std::memmove(bucket_end - bytes_size + suffix_size, bucket_end - bytes_size, bytes_size - begin_offset);
+
+        std::move(entries + pos + 1, entries + leaf->_count, entries + pos);
+        _awrapper.destroy(entries + leaf->_count - 1);
+
+        --leaf->_count;
+
+        for (uint32_t i = pos; i < leaf->_count; ++i)
+        {
+            entries[i]._offset -= suffix_size;
+        }
+    }
+
+    size_t erase(string_view key)
+    {
+        if (_values_count == 0)
+        {
+            return 0;
+        }
+
+        _index_iterator index_it = locate(key);
+        _leaf_type* leaf = index_it->_leaf;
+
+        bool found;
+        uint32_t pos = search_leaf(leaf, key, found);
+
+        if (!found)
+        {
+            return 0;
+        }
+
+        --_values_count;
+
+        if (leaf->_count == 1)
+        {
+            // the index still compares with the key of the leaf while erasing it
+            _index.erase(index_it);
+            link_leaves_around(leaf);
+            deallocate_leaf(leaf);
+            return 1;
+        }
+
+        erase_entry(leaf, pos);
+
+        if (leaf->used_bysize() < _leaf_bucket_bysize_max / 4)
+        {
+            merge_leaf(index_it);
+        }
+
+        return 1;
+    }
+
+    // the erased entry may take its leaf and neighbours along, so the position is looked up again by its key
+    template<typename _output_iterator>
+    _output_iterator erase(const _string_tree_iterator_base<_mapped_type>& position)
+    {
+        if (position._leaf == nullptr)
+        {
+            return _output_iterator(this, nullptr, 0);
+        }
+
+        std::string key;
+        position._leaf->copy_key(position._pos, key);
+
+        erase(key);
+        return lower_bound<_output_iterator>(key);
+    }
+
+    template<typename _output_iterator>
+    _output_iterator erase_range(const _string_tree_iterator_base<_mapped_type>& first,
+                                 const _string_tree_iterator_base<_mapped_type>& last)
+    {
+        _output_iterator it(first);
+
+        if (last._leaf == nullptr)
+        {
+            while (it._leaf != nullptr)
+            {
+                it = erase<_output_iterator>(it);
+            }
+        }
+        else
+        {
+            std::string last_key;
+            last._leaf->copy_key(last._pos, last_key);
+
+            while (it.key() != string_view(last_key))
+            {
+                it = erase<_output_iterator>(it);
+            }
+        }
+
+        return it;
+    }
+
+    void link_leaves_around(_leaf_type* leaf) noexcept
+    {
+        if (leaf->_prev_leaf != nullptr)
+        {
+            leaf->_prev_leaf->_next_leaf = leaf->_next_leaf;
+        }
+        else
+        {
+            _first_leaf = leaf->_next_leaf;
+        }
+
+        if (leaf->_next_leaf != nullptr)
+        {
+            leaf->_next_leaf->_prev_leaf = leaf->_prev_leaf;
+        }
+        else
+        {
+            _last_leaf = leaf->_prev_leaf;
+        }
+    }
+
+    // merges a small leaf with its next leaf, or with its previous one for the last leaf, if the result fits
+    void merge_leaf(_index_iterator index_it)
+    {
+        _leaf_type* leaf = index_it->_leaf;
+
+        if (leaf->_next_leaf == nullptr)
+        {
+            if (leaf->_prev_leaf == nullptr)
+            {
+                return;
+            }
+
+            --index_it;
+            leaf = leaf->_prev_leaf;
+        }
+
+        _leaf_type* next_leaf = leaf->_next_leaf;
+
+        if (leaf->used_bysize() + next_leaf->used_bysize() > _leaf_bucket_bysize_max)
+        {
+            return;
+        }
+
+        std::string keys;
+        std::vector<_packed_item> items;
+        items.reserve(leaf->_count + next_leaf->_count);
+
+        gather_items(leaf, 0, leaf->_count, keys, items);
+        gather_items(next_leaf, 0, next_leaf->_count, keys, items);
+
+        uint32_t prefix_size = common_prefix_size(keys.data(), items[0]._key_end,
+                                                  keys.data() + items[items.size() - 2]._key_end,
+                                                  items.back()._key_end - items[items.size() - 2]._key_end);
+
+        if (packed_bysize(items, 0, (uint32_t)items.size(), prefix_size) > _leaf_bucket_bysize_max)
+        {
+            return;
+        }
+
+        // erasing from the index invalidates its iterators
+        _index_iterator next_index_it = index_it;
+        index_it = _index.erase(++next_index_it);
+        --index_it;
+
+        _leaf_type* dummy_leaf;
+        uint32_t dummy_pos;
+        repack(index_it, 2, keys, items, 0, dummy_leaf, dummy_pos);
+    }
+
+    static uint32_t item_key_begin(const std::vector<_packed_item>& items, uint32_t i) noexcept
+    { return (i > 0)? items[i - 1]._key_end : 0; }
+
+    static uint32_t packed_bysize(const std::vector<_packed_item>& items, uint32_t first, uint32_t last, uint32_t prefix_size) noexcept
+    {
+        return (last - first) * sizeof(_entry_type) +
+               (items[last - 1]._key_end - item_key_begin(items, first)) - (last - first - 1) * prefix_size;
+    }
+
+    static void gather_items(_leaf_type* leaf, uint32_t first_pos, uint32_t last_pos,
+                             std::string& keys, std::vector<_packed_item>& items)
+    {
+        for (uint32_t i = first_pos; i < last_pos; ++i)
+        {
+            keys.append(leaf->prefix(), leaf->_prefix_size);
+            keys.append(leaf->suffix(i), leaf->suffix_size(i));
+            items.push_back(_packed_item{ (uint32_t)keys.size(), leaf->entries() + i });
+        }
+    }
+
+    // replaces the leaves_count leaves starting from index_it by leaves packed from items. a group of items takes
+    // the whole rest if it fits into one bucket, otherwise about half a bucket. the leaf and the position of the
+    // item at item_pos are returned.
+    void repack(_index_iterator index_it, uint32_t leaves_count,
+                const std::string& keys, const std::vector<_packed_item>& items,
+                uint32_t item_pos, _leaf_type*& item_leaf, uint32_t& item_leaf_pos)
+    {
+        const char* key_data = keys.data();
+        uint32_t items_count = (uint32_t)items.size();
+
+        std::vector<uint32_t> group_ends;
+        std::vector<uint32_t> group_prefix_sizes;
+
+        for (uint32_t first = 0; first < items_count; )
+        {
+            uint32_t first_key_begin = item_key_begin(items, first);
+            uint32_t first_key_size = items[first]._key_end - first_key_begin;
+
+            uint32_t last = items_count;
+            uint32_t prefix_size = common_prefix_size(key_data + first_key_begin, first_key_size,
+                                                      key_data + item_key_begin(items, last - 1),
+                                                      items[last - 1]._key_end - item_key_begin(items, last - 1));
+
+            if (packed_bysize(items, first, last, prefix_size) > _leaf_bucket_bysize_max)
+            {
+                last = first + 1;
+                prefix_size = first_key_size;
+
+                while (last < items_count)
+                {
+                    uint32_t next_prefix_size = common_prefix_size(key_data + first_key_begin, first_key_size,
+                                                                   key_data + item_key_begin(items, last),
+                                                                   items[last]._key_end - item_key_begin(items, last));
+
+                    if (packed_bysize(items, first, last + 1, next_prefix_size) > _leaf_bucket_bysize_max / 2)
+                    {
+                        break;
+                    }
+
+                    prefix_size = next_prefix_size;
+                    ++last;
+                }
+            }
+
+            group_ends.push_back(last);
+            group_prefix_sizes.push_back(prefix_size);
+            first = last;
+        }
+
+        std::vector<_leaf_type*> new_leaves(group_ends.size());
+
+        for (uint32_t g = 0, first = 0; g < group_ends.size(); first = group_ends[g++])
+        {
+            uint32_t bysize = packed_bysize(items, first, group_ends[g], group_prefix_sizes[g]);
+            new_leaves[g] = allocate_leaf(std::max(_leaf_bucket_bysize_max, bysize));
+        }
+
+        for (uint32_t g = 0, first = 0; g < group_ends.size(); first = group_ends[g++])
+        {
+            _leaf_type* leaf = new_leaves[g];
+            char* bucket_end = leaf->bucket_end();
+            uint32_t prefix_size = group_prefix_sizes[g];
+
+            std::memcpy(bucket_end - prefix_size, key_data + item_key_begin(items, first), prefix_size);
+            leaf->_prefix_size = prefix_size;
+
+            uint32_t offset = prefix_size;
+
+            for (uint32_t i = first; i < group_ends[g]; ++i)
+            {
+                uint32_t key_begin = item_key_begin(items, i);
+                uint32_t suffix_size = items[i]._key_end - key_begin - prefix_size;
+
+                offset += suffix_size;
+                std::memcpy(bucket_end - offset, key_data + key_begin + prefix_size, suffix_size);
+
+                _awrapper.construct(leaf->entries() + (i - first), offset, std::move(*items[i]._entry));
+            }
+
+            leaf->_count = group_ends[g] - first;
+
+            if (item_pos >= first && item_pos < group_ends[g])
+            {
+                item_leaf = leaf;
+                item_leaf_pos = item_pos - first;
+            }
+        }
+
+        for (uint32_t g = 0; g + 1 < new_leaves.size(); ++g)
+        {
+            new_leaves[g]->_next_leaf = new_leaves[g + 1];
+            new_leaves[g + 1]->_prev_leaf = new_leaves[g];
+        }
+
+        _leaf_type* first_old_leaf = index_it->_leaf;
+        _leaf_type* last_old_leaf = first_old_leaf;
+
+        for (uint32_t i = 1; i < leaves_count; ++i)
+        {
+            last_old_leaf = last_old_leaf->_next_leaf;
+        }
+
+        link_leaves(new_leaves.front(), new_leaves.back(), first_old_leaf->_prev_leaf, last_old_leaf->_next_leaf);
+
+        // the first new leaf starts with the same key as the first old one, unless a key was inserted before
+        // the first key of the first leaf. either way its place in the index stays right.
+        const_cast<_index_key&>(*index_it)._leaf = new_leaves.front();
+
+        for (uint32_t g = 1; g < new_leaves.size(); ++g)
+        {
+            _index.insert(_index_key(new_leaves[g]));
+        }
+
+        for (uint32_t i = 0; i < leaves_count; ++i)
+        {
+            _leaf_type* next_leaf = first_old_leaf->_next_leaf;
+            deallocate_leaf(first_old_leaf);
+            first_old_leaf = next_leaf;
+        }
+    }
+};
+
+} // xxfl
@@ -6,16 +6,29 @@
 #define _CRT_SECURE_NO_DEPRECATE
 #endif
 
+#include <chrono>
 #include <cinttypes>
 #include <cstdio>
 #include <cstdlib>
 #include <random>
 #include <string>
 #include <set>
+#include <stdexcept>
+#include <thread>
 #include <map>
 #include <vector>
 #include "src/xxfl_set.h"
 #include "src/xxfl_map.h"
+#include "src/xxfl_soa_map.h"
+#include "src/xxfl_multiset.h"
+#include "src/xxfl_multimap.h"
+#include "src/xxfl_concurrent_map.h"
+#include "src/xxfl_sharded_map.h"
+#include "src/xxfl_single_writer.h"
+#include "src/xxfl_string_set.h"
+#include "src/xxfl_string_map.h"
+#include "src/xxfl_node_pool.h"
+#include "src/xxfl_parallel.h"
 
 typedef uint32_t test_int; // uint32_t or uint64_t
 
@@ -33,12 +46,57 @@ typedef xxfl::set<std::string> xxfl_string_set;
 typedef xxfl::map<test_int, test_int>       xxfl_int_map;
 typedef xxfl::map<std::string, std::string> xxfl_string_map;
 
+typedef xxfl::soa_map<test_int, test_int> xxfl_soa_int_map;
+
+typedef xxfl::multiset<test_int>           xxfl_int_multiset;
+typedef xxfl::multimap<test_int, test_int> xxfl_int_multimap;
+
+// small nodes so the threads split them often
+typedef xxfl::concurrent_map<test_int, test_int, def_int_compare, std::allocator<int_pair>, 256> xxfl_concurrent_int_map;
+typedef xxfl::single_writer<xxfl::map<test_int, test_int, def_int_compare, std::allocator<int_pair>, 256> > xxfl_single_writer_int_map;
+
+typedef xxfl::sharded_map<test_int, test_int, 8> xxfl_sharded_int_map;
+
+// looks strings up by c strings without building a std::string
+struct transparent_string_compare
+{
+    typedef void is_transparent;
+
+    bool operator () (const std::string& x, const std::string& y) const { return x < y; }
+    bool operator () (const std::string& x, const char* y) const { return x.compare(y) < 0; }
+    bool operator () (const char* x, const std::string& y) const { return y.compare(x) > 0; }
+};
+
+typedef xxfl::map<std::string, std::string, transparent_string_compare> xxfl_transparent_string_map;
+
+// keeps the sums of the mapped values under the children of internal nodes
+typedef xxfl::aggregate_map<test_int, test_int, xxfl::sum_of_mapped<uint64_t> > xxfl_sum_int_map;
+
+typedef xxfl::string_set<>            xxfl_packed_string_set;
+typedef xxfl::string_map<std::string> xxfl_packed_string_map;
+
+// small leaves for cheap shifting, internal nodes keep the default size
+typedef xxfl::set<test_int, def_int_compare, std::allocator<test_int>, 256,
+                  XXFL_BPLUS_TREE_HEIGHT_MAX_DEFAULT, XXFL_BPLUS_TREE_BUCKET_BYSIZE_MAX_DEFAULT> xxfl_small_leaf_int_set;
+typedef xxfl::map<test_int, test_int, def_int_compare, std::allocator<int_pair>, 256,
+                  XXFL_BPLUS_TREE_HEIGHT_MAX_DEFAULT, XXFL_BPLUS_TREE_BUCKET_BYSIZE_MAX_DEFAULT> xxfl_small_leaf_int_map;
+
+// small nodes and a low height bound, a tree growing higher than insertions make it overflows the iterator stack
+typedef xxfl::set<test_int, def_int_compare, std::allocator<test_int>, 128, 6, 128> xxfl_small_node_int_set;
+
+// page sized nodes carved from the node pool
+typedef xxfl::set<test_int, def_int_compare, xxfl::node_pool_allocator<test_int>, 4096,
+                  XXFL_BPLUS_TREE_HEIGHT_MAX_DEFAULT, 4096> xxfl_pooled_int_set;
+
 typedef std::set<test_int>    std_int_set;
 typedef std::set<std::string> std_string_set;
 
 typedef std::map<test_int, test_int>       std_int_map;
 typedef std::map<std::string, std::string> std_string_map;
 
+typedef std::multiset<test_int>           std_int_multiset;
+typedef std::multimap<test_int, test_int> std_int_multimap;
+
 typedef std::vector<test_int>    std_int_vector;
 typedef std::vector<std::string> std_string_vector;
 typedef std::vector<int_pair>    std_int_pair_vector;